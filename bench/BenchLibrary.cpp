@@ -0,0 +1,74 @@
+#include "BenchLibrary.hpp"
+#include "LibraryGenerator.hpp"
+#include <SQLiteCpp/SQLiteCpp.h>
+#include <ZoteroDB.hpp>
+#include <fmt/format.h>
+#include <fstream>
+#include <string>
+
+BenchLibrary::BenchLibrary(std::string_view name)
+    : m_libraryDir(std::filesystem::temp_directory_path() / fmt::format("zotero_to_file_tree_bench_{}", name)) {
+  std::filesystem::remove_all(m_libraryDir);
+  std::filesystem::create_directories(m_libraryDir / "storage");
+
+  create_zotero_db(zotero_db_path());
+}
+
+BenchLibrary::~BenchLibrary() {
+  std::error_code errorCode;
+  std::filesystem::remove_all(m_libraryDir, errorCode);
+}
+
+std::filesystem::path BenchLibrary::zotero_db_path() const {
+  return m_libraryDir / zotfiles::standard_zotero_db_name();
+}
+
+std::set<std::int64_t> write_collection_chains(const std::filesystem::path& zoteroDBPath, std::size_t chainCount, std::size_t depth) {
+  SQLite::Database db(zoteroDBPath, SQLite::OPEN_READWRITE);
+  SQLite::Transaction transaction(db);
+  SQLite::Statement insert(db,
+                           "INSERT INTO collections (collectionID, collectionName, parentCollectionID, libraryID, key) VALUES (?,?,?,1,?)");
+
+  std::set<std::int64_t> leafCollectionIDs;
+  std::int64_t collectionID = 0;
+  for (std::size_t chain = 0; chain < chainCount; ++chain)
+  {
+    std::int64_t parentCollectionID = -1;
+    for (std::size_t level = 0; level < depth; ++level)
+    {
+      ++collectionID;
+      insert.reset();
+      insert.bind(1, collectionID);
+      insert.bind(2, fmt::format("Collection {}-{}", chain, level));
+      if (parentCollectionID == -1)
+      {
+        insert.bind(3);
+      }
+      else
+      {
+        insert.bind(3, parentCollectionID);
+      }
+      insert.bind(4, fmt::format("C{:07}", collectionID));
+      insert.exec();
+      parentCollectionID = collectionID;
+    }
+    leafCollectionIDs.insert(parentCollectionID);
+  }
+
+  transaction.commit();
+  return leafCollectionIDs;
+}
+
+std::vector<std::filesystem::path> write_storage_pdfs(const std::filesystem::path& libraryDir, std::size_t pdfCount, std::size_t pdfSize) {
+  const std::string content(pdfSize, 'x');
+  std::vector<std::filesystem::path> pdfFilePaths;
+  pdfFilePaths.reserve(pdfCount);
+  for (std::size_t i = 0; i < pdfCount; ++i)
+  {
+    const std::filesystem::path keyDir = libraryDir / "storage" / fmt::format("K{:07}", i);
+    std::filesystem::create_directories(keyDir);
+    pdfFilePaths.push_back(keyDir / fmt::format("Paper {}.pdf", i));
+    std::ofstream(pdfFilePaths.back(), std::ios::binary) << content;
+  }
+  return pdfFilePaths;
+}
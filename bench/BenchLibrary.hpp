@@ -0,0 +1,61 @@
+#ifndef ZOTERO_TO_FILE_TREE_BENCHLIBRARY_HPP
+#define ZOTERO_TO_FILE_TREE_BENCHLIBRARY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <set>
+#include <string_view>
+#include <vector>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+/** @brief A zotero library in the temp directory that is removed when the BenchLibrary is destroyed.
+ *
+ * The zotero db of the library contains the tables that are queried by zotero_to_file_tree and the supported version entries.
+ */
+class BenchLibrary {
+  std::filesystem::path m_libraryDir;
+
+public:
+  explicit BenchLibrary(std::string_view name);
+  ~BenchLibrary();
+
+  BenchLibrary(const BenchLibrary&) = delete;
+  BenchLibrary& operator=(const BenchLibrary&) = delete;
+
+  [[nodiscard]] const std::filesystem::path& library_dir() const { return m_libraryDir; }
+  [[nodiscard]] std::filesystem::path zotero_db_path() const;
+};
+
+/** @brief Writes chainCount independent collection chains with the given depth to the zotero db.
+ *
+ * @return The collection IDs of the deepest collection of every chain.
+ */
+std::set<std::int64_t> write_collection_chains(const std::filesystem::path& zoteroDBPath, std::size_t chainCount, std::size_t depth);
+
+/** @brief Writes pdfCount pdf files with pdfSize bytes each to the storage directory of the library, one key directory per pdf.
+ *
+ * @return The absolute paths of the written pdf files.
+ */
+std::vector<std::filesystem::path> write_storage_pdfs(const std::filesystem::path& libraryDir, std::size_t pdfCount, std::size_t pdfSize);
+
+/** @brief Bytes allocated on the heap by createResult and still held by its result. Only measured with glibc, 0 otherwise.
+ */
+template <typename CreateResult>
+double heap_bytes(CreateResult createResult) {
+#if defined(__GLIBC__)
+  const auto allocatedBefore = mallinfo2().uordblks;
+  auto result = createResult();
+  const auto allocatedAfter = mallinfo2().uordblks;
+  static_cast<void>(result);
+  return static_cast<double>(allocatedAfter - allocatedBefore);
+#else
+  static_cast<void>(createResult);
+  return 0.0;
+#endif
+}
+
+#endif // ZOTERO_TO_FILE_TREE_BENCHLIBRARY_HPP
@@ -0,0 +1,35 @@
+#include "LibraryGenerator.hpp"
+#include <CLI/CLI.hpp>
+#include <chrono>
+#include <fmt/format.h>
+
+/**
+ *\brief Writes a synthetic zotero library for scaling measurements, e.g.
+ *
+ * zotero_library_generator -o /tmp/library --items 100000 --depth 4 --fan-out 5 --collections-per-item 2
+ */
+int main(int argc, char** argv) {
+  CLI::App app{"Writes a synthetic zotero library with a zotero.sqlite and a storage directory."};
+
+  std::string libraryDirStr;
+  app.add_option("-o,--output_dir", libraryDirStr, "Directory of the generated library.")->required();
+
+  LibraryShape shape;
+  app.add_option("--items", shape.itemCount, "Number of items, each with one pdf attachment. Default is 1000.");
+  app.add_option("--depth", shape.collectionDepth, "Number of levels of the collection tree. Default is 3.")->check(CLI::PositiveNumber);
+  app.add_option("--fan-out", shape.collectionFanOut, "Number of root collections and of children per collection. Default is 4.")
+      ->check(CLI::PositiveNumber);
+  app.add_option("--collections-per-item", shape.collectionsPerItem, "Number of collections every item is in. Default is 1.");
+  app.add_option("--pdf-size", shape.pdfSize, "Size of every pdf file in bytes. Default is 1024.");
+
+  CLI11_PARSE(app, argc, argv);
+
+  const auto start = std::chrono::steady_clock::now();
+  const std::size_t collectionCount = generate_library(libraryDirStr, shape);
+  fmt::print("Generated {} items in {} collections in {:.1f} s: {}\n",
+             shape.itemCount,
+             collectionCount,
+             std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(),
+             libraryDirStr);
+  return 0;
+}
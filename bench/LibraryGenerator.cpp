@@ -0,0 +1,165 @@
+#include "LibraryGenerator.hpp"
+#include <SQLiteCpp/SQLiteCpp.h>
+#include <ZoteroDB.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <fmt/format.h>
+#include <fstream>
+#include <string>
+
+void create_zotero_db(const std::filesystem::path& zoteroDBPath) {
+  SQLite::Database db(zoteroDBPath, SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+  db.exec(R"(
+    CREATE TABLE version (schema TEXT PRIMARY KEY, version INT NOT NULL);
+    CREATE TABLE items (
+      itemID INTEGER PRIMARY KEY,
+      itemTypeID INT NOT NULL,
+      dateAdded TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP,
+      dateModified TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP,
+      clientDateModified TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP,
+      libraryID INT NOT NULL,
+      key TEXT NOT NULL,
+      version INT NOT NULL DEFAULT 0,
+      synced INT NOT NULL DEFAULT 0,
+      UNIQUE (libraryID, key));
+    CREATE TABLE itemAttachments (
+      itemID INTEGER PRIMARY KEY,
+      parentItemID INT,
+      linkMode INT,
+      contentType TEXT,
+      charsetID INT,
+      path TEXT,
+      syncState INT DEFAULT 0,
+      storageModTime INT,
+      storageHash TEXT,
+      lastProcessedModificationTime INT);
+    CREATE INDEX itemAttachmentContentType ON itemAttachments(contentType);
+    CREATE TABLE collections (
+      collectionID INTEGER PRIMARY KEY,
+      collectionName TEXT NOT NULL,
+      parentCollectionID INT DEFAULT NULL,
+      clientDateModified TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP,
+      libraryID INT NOT NULL,
+      key TEXT NOT NULL,
+      version INT NOT NULL DEFAULT 0,
+      synced INT NOT NULL DEFAULT 0,
+      UNIQUE (libraryID, key));
+    CREATE TABLE collectionItems (
+      collectionID INT NOT NULL,
+      itemID INT NOT NULL,
+      orderIndex INT NOT NULL DEFAULT 0,
+      PRIMARY KEY (collectionID, itemID));
+    CREATE INDEX itemID ON collectionItems(itemID);
+  )");
+
+  const zotfiles::ZoteroDBInfo info = zotfiles::supported_zotero_db_info();
+  db.exec(fmt::format("INSERT INTO version VALUES ('userdata', {}), ('triggers', {}), ('translators', {}), ('system', {}), "
+                      "('styles', {}), ('repository', {}), ('globalSchema', {}), ('delete', {}), ('compatibility', {})",
+                      info.userdata,
+                      info.triggers,
+                      info.translators,
+                      info.system,
+                      info.styles,
+                      info.repository,
+                      info.globalSchema,
+                      info.deletes,
+                      info.compatibility));
+}
+
+/**
+ *\brief Writes the collections level by level, the collection ids of a level are consecutive.
+ */
+static std::size_t write_collections(SQLite::Database& db, const LibraryShape& shape) {
+  SQLite::Statement insert(db,
+                           "INSERT INTO collections (collectionID, collectionName, parentCollectionID, libraryID, key) VALUES (?,?,?,1,?)");
+
+  std::int64_t collectionID = 0;
+  std::int64_t firstParentID = 0;
+  std::size_t parentCount = 0;
+  for (std::size_t level = 0; level < shape.collectionDepth; ++level)
+  {
+    const std::int64_t firstLevelID = collectionID + 1;
+    const std::size_t levelCount = level == 0 ? shape.collectionFanOut : parentCount * shape.collectionFanOut;
+    for (std::size_t i = 0; i < levelCount; ++i)
+    {
+      ++collectionID;
+      insert.reset();
+      insert.bind(1, collectionID);
+      insert.bind(2, fmt::format("Collection {}-{}", level, i));
+      if (level == 0)
+      {
+        insert.bind(3);
+      }
+      else
+      {
+        insert.bind(3, firstParentID + static_cast<std::int64_t>(i / shape.collectionFanOut));
+      }
+      insert.bind(4, fmt::format("C{:07}", collectionID));
+      insert.exec();
+    }
+    firstParentID = firstLevelID;
+    parentCount = levelCount;
+  }
+  return static_cast<std::size_t>(collectionID);
+}
+
+std::size_t generate_library(const std::filesystem::path& libraryDir, const LibraryShape& shape) {
+  std::filesystem::create_directories(libraryDir / "storage");
+  const std::filesystem::path zoteroDBPath = libraryDir / zotfiles::standard_zotero_db_name();
+  std::filesystem::remove(zoteroDBPath);
+  create_zotero_db(zoteroDBPath);
+
+  SQLite::Database db(zoteroDBPath, SQLite::OPEN_READWRITE);
+  SQLite::Transaction transaction(db);
+  const std::size_t collectionCount = write_collections(db, shape);
+  const std::size_t collectionsPerItem = std::min(shape.collectionsPerItem, collectionCount);
+
+  SQLite::Statement insertItem(db, "INSERT INTO items (itemID, itemTypeID, libraryID, key) VALUES (?,?,1,?)");
+  SQLite::Statement insertAttachment(
+      db, "INSERT INTO itemAttachments (itemID, parentItemID, linkMode, contentType, path) VALUES (?,?,0,'application/pdf',?)");
+  SQLite::Statement insertCollectionItem(db, "INSERT INTO collectionItems (collectionID, itemID) VALUES (?,?)");
+
+  const std::string content(shape.pdfSize, 'x');
+  for (std::size_t i = 0; i < shape.itemCount; ++i)
+  {
+    const auto parentItemID = static_cast<std::int64_t>(2 * i + 1);
+    const std::int64_t attachmentItemID = parentItemID + 1;
+    const std::string attachmentKey = fmt::format("K{:07}", i);
+    const std::string pdfName = fmt::format("Paper {}.pdf", i);
+
+    insertItem.reset();
+    insertItem.bind(1, parentItemID);
+    insertItem.bind(2, 2);
+    insertItem.bind(3, fmt::format("P{:07}", i));
+    insertItem.exec();
+
+    insertItem.reset();
+    insertItem.bind(1, attachmentItemID);
+    insertItem.bind(2, 3);
+    insertItem.bind(3, attachmentKey);
+    insertItem.exec();
+
+    insertAttachment.reset();
+    insertAttachment.bind(1, attachmentItemID);
+    insertAttachment.bind(2, parentItemID);
+    insertAttachment.bind(3, "storage:" + pdfName);
+    insertAttachment.exec();
+
+    // Consecutive collection ids are distinct, the multiplier spreads the items over all levels of the tree.
+    const std::size_t firstCollection = (i * 7919) % collectionCount;
+    for (std::size_t membership = 0; membership < collectionsPerItem; ++membership)
+    {
+      insertCollectionItem.reset();
+      insertCollectionItem.bind(1, static_cast<std::int64_t>((firstCollection + membership) % collectionCount + 1));
+      insertCollectionItem.bind(2, parentItemID);
+      insertCollectionItem.exec();
+    }
+
+    const std::filesystem::path keyDir = libraryDir / "storage" / attachmentKey;
+    std::filesystem::create_directories(keyDir);
+    std::ofstream(keyDir / pdfName, std::ios::binary) << content;
+  }
+
+  transaction.commit();
+  return collectionCount;
+}
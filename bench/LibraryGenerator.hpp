@@ -0,0 +1,30 @@
+#ifndef ZOTERO_TO_FILE_TREE_LIBRARYGENERATOR_HPP
+#define ZOTERO_TO_FILE_TREE_LIBRARYGENERATOR_HPP
+
+#include <cstddef>
+#include <filesystem>
+
+/** @brief The shape of a synthetic zotero library.
+ */
+struct LibraryShape {
+  std::size_t itemCount{1000};       /**< Number of regular items, each with one pdf attachment. */
+  std::size_t collectionDepth{3};    /**< Number of levels of the collection tree. */
+  std::size_t collectionFanOut{4};   /**< Number of root collections and of children per collection. */
+  std::size_t collectionsPerItem{1}; /**< Number of collections every item is in. */
+  std::size_t pdfSize{1024};         /**< Size of every pdf file in bytes. */
+};
+
+/** @brief Creates a zotero db with the tables that are queried by zotero_to_file_tree and the supported version entries.
+ */
+void create_zotero_db(const std::filesystem::path& zoteroDBPath);
+
+/** @brief Writes a zotero library with the given shape to libraryDir: a zotero.sqlite and a storage directory with one pdf per item.
+ *
+ * The collections form a complete tree with collectionFanOut children per collection. Every item is in collectionsPerItem collections of
+ * all levels of the tree, the pdf attachment is a child of the item. The library is deterministic for a given shape.
+ *
+ * @return The number of collections.
+ */
+std::size_t generate_library(const std::filesystem::path& libraryDir, const LibraryShape& shape);
+
+#endif // ZOTERO_TO_FILE_TREE_LIBRARYGENERATOR_HPP
@@ -0,0 +1,80 @@
+#include "BenchLibrary.hpp"
+#include <ZoteroDB.hpp>
+#include <benchmark/benchmark.h>
+
+// Resolves the ancestry with one parent_collections query per level of the collection hierarchy.
+// If reopenPerLevel is set, every level opens its own connection like the loop in all_pdf_item_collections did before the session.
+static std::unordered_map<std::int64_t, zotfiles::ZoteroCollection>
+iterative_ancestry(std::set<std::int64_t> missingCollections, zotfiles::ZoteroDBSession& session, bool reopenPerLevel) {
+  std::unordered_map<std::int64_t, zotfiles::ZoteroCollection> collectionMap;
+  while (!missingCollections.empty())
+  {
+    std::set<zotfiles::ZoteroCollection> res;
+    if (reopenPerLevel)
+    {
+      zotfiles::ZoteroDBSession levelSession(session.zotero_db_path());
+      res = zotfiles::parent_collections(missingCollections, levelSession);
+    }
+    else
+    {
+      res = zotfiles::parent_collections(missingCollections, session);
+    }
+    missingCollections.clear();
+    for (const auto& collection: res)
+    {
+      collectionMap.try_emplace(collection.collectionID, collection);
+      if (collection.parentCollectionID != -1 && !collectionMap.contains(collection.parentCollectionID))
+      {
+        missingCollections.emplace(collection.parentCollectionID);
+      }
+    }
+  }
+  return collectionMap;
+}
+
+static void BM_AncestryIterative(benchmark::State& state) {
+  const BenchLibrary library("ancestry_iterative");
+  const auto leafCollectionIDs =
+      write_collection_chains(library.zotero_db_path(), static_cast<std::size_t>(state.range(0)), static_cast<std::size_t>(state.range(1)));
+  zotfiles::ZoteroDBSession session(library.zotero_db_path());
+
+  for (auto _: state)
+  {
+    auto collectionMap = iterative_ancestry(leafCollectionIDs, session, false);
+    benchmark::DoNotOptimize(collectionMap);
+  }
+  state.counters["collections"] = static_cast<double>(state.range(0) * state.range(1));
+}
+
+static void BM_AncestryIterativeReopen(benchmark::State& state) {
+  const BenchLibrary library("ancestry_iterative_reopen");
+  const auto leafCollectionIDs =
+      write_collection_chains(library.zotero_db_path(), static_cast<std::size_t>(state.range(0)), static_cast<std::size_t>(state.range(1)));
+  zotfiles::ZoteroDBSession session(library.zotero_db_path());
+
+  for (auto _: state)
+  {
+    auto collectionMap = iterative_ancestry(leafCollectionIDs, session, true);
+    benchmark::DoNotOptimize(collectionMap);
+  }
+  state.counters["collections"] = static_cast<double>(state.range(0) * state.range(1));
+}
+
+static void BM_AncestryRecursiveCTE(benchmark::State& state) {
+  const BenchLibrary library("ancestry_recursive");
+  const auto leafCollectionIDs =
+      write_collection_chains(library.zotero_db_path(), static_cast<std::size_t>(state.range(0)), static_cast<std::size_t>(state.range(1)));
+  zotfiles::ZoteroDBSession session(library.zotero_db_path());
+
+  for (auto _: state)
+  {
+    auto collectionMap = zotfiles::collection_ancestry(leafCollectionIDs, session);
+    benchmark::DoNotOptimize(collectionMap);
+  }
+  state.counters["collections"] = static_cast<double>(state.range(0) * state.range(1));
+}
+
+// {number of collection chains, depth of each chain}
+BENCHMARK(BM_AncestryIterativeReopen)->ArgsProduct({{16, 256}, {2, 12, 32, 128}})->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_AncestryIterative)->ArgsProduct({{16, 256}, {2, 12, 32, 128}})->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_AncestryRecursiveCTE)->ArgsProduct({{16, 256}, {2, 12, 32, 128}})->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,166 @@
+#include "BenchLibrary.hpp"
+#include <FlatCollectionTree.hpp>
+#include <benchmark/benchmark.h>
+#include <deque>
+#include <fmt/format.h>
+
+// A collection tree with a fan out of 4 children per collection, like in benchWritePdfs.cpp.
+static zotfiles::CollectionTree build_collection_tree(std::int64_t collectionCount) {
+  std::unordered_map<std::int64_t, std::shared_ptr<zotfiles::CollectionNode>> collectionNodes;
+  for (std::int64_t collectionID = 0; collectionID < collectionCount; ++collectionID)
+  {
+    const std::int64_t parentCollectionID = collectionID == 0 ? -1 : (collectionID - 1) / 4;
+    collectionNodes.emplace(collectionID,
+                            std::make_shared<zotfiles::CollectionNode>(
+                                zotfiles::CollectionNode{collectionID, parentCollectionID, fmt::format("Collection {}", collectionID)}));
+  }
+  return zotfiles::CollectionTree::build(std::move(collectionNodes));
+}
+
+// Populates the tree like ZoteroToFileTree::create_collectiontree: one find per collection membership of every pdf item.
+static void BM_CollectionTreePopulate(benchmark::State& state) {
+  static constexpr std::int64_t membershipsPerItem = 2;
+  const std::int64_t collectionCount = state.range(0);
+  const std::int64_t itemCount = state.range(1);
+
+  for (auto _: state)
+  {
+    state.PauseTiming();
+    zotfiles::CollectionTree collectionTree = build_collection_tree(collectionCount);
+    state.ResumeTiming();
+
+    for (std::int64_t itemID = 0; itemID < itemCount; ++itemID)
+    {
+      for (std::int64_t membership = 0; membership < membershipsPerItem; ++membership)
+      {
+        auto collection = collectionTree.find((itemID * 7919 + membership * 104729) % collectionCount);
+        collection->collectionPDFItems.push_back(zotfiles::CollectionPDFItem{itemID, "item.pdf", {}});
+      }
+    }
+    benchmark::DoNotOptimize(collectionTree);
+  }
+  state.SetItemsProcessed(state.iterations() * itemCount);
+}
+
+// Arguments: number of collections, number of pdf items
+BENCHMARK(BM_CollectionTreePopulate)
+    ->ArgNames({"collections", "items"})
+    ->ArgsProduct({{100, 1000, 8000}, {1000, 10000}})
+    ->Unit(benchmark::kMillisecond);
+
+// The collection nodes of build_collection_tree with itemCount pdf items, every item is in 2 collections.
+static std::unordered_map<std::int64_t, std::shared_ptr<zotfiles::CollectionNode>> collection_nodes(std::int64_t collectionCount,
+                                                                                                    std::int64_t itemCount) {
+  std::unordered_map<std::int64_t, std::shared_ptr<zotfiles::CollectionNode>> collectionNodes;
+  for (std::int64_t collectionID = 0; collectionID < collectionCount; ++collectionID)
+  {
+    const std::int64_t parentCollectionID = collectionID == 0 ? -1 : (collectionID - 1) / 4;
+    collectionNodes.emplace(collectionID,
+                            std::make_shared<zotfiles::CollectionNode>(
+                                zotfiles::CollectionNode{collectionID, parentCollectionID, fmt::format("Collection {}", collectionID)}));
+  }
+  for (std::int64_t itemID = 0; itemID < itemCount; ++itemID)
+  {
+    const std::string pdfName = fmt::format("Author - 2024 - Title of item {}.pdf", itemID);
+    const std::filesystem::path pdfFilePath = std::filesystem::path("/zotero/storage") / fmt::format("{:08X}", itemID) / pdfName;
+    for (std::int64_t membership = 0; membership < 2; ++membership)
+    {
+      collectionNodes.at((itemID * 7919 + membership * 104729) % collectionCount)
+          ->collectionPDFItems.push_back(zotfiles::CollectionPDFItem{itemID, pdfName, pdfFilePath});
+    }
+  }
+  return collectionNodes;
+}
+
+static void BM_CollectionTreeBuild(benchmark::State& state) {
+  for (auto _: state)
+  {
+    state.PauseTiming();
+    auto collectionNodes = collection_nodes(state.range(0), state.range(1));
+    state.ResumeTiming();
+
+    zotfiles::CollectionTree collectionTree = zotfiles::CollectionTree::build(std::move(collectionNodes));
+    benchmark::DoNotOptimize(collectionTree);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.counters["heap_bytes"] = heap_bytes(
+      [&state] { return zotfiles::CollectionTree::build(collection_nodes(state.range(0), state.range(1))); });
+}
+
+static void BM_FlatCollectionTreeBuild(benchmark::State& state) {
+  for (auto _: state)
+  {
+    state.PauseTiming();
+    auto collectionNodes = collection_nodes(state.range(0), state.range(1));
+    state.ResumeTiming();
+
+    zotfiles::FlatCollectionTree collectionTree = zotfiles::FlatCollectionTree::build(std::move(collectionNodes));
+    benchmark::DoNotOptimize(collectionTree);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.counters["heap_bytes"] = heap_bytes(
+      [&state] { return zotfiles::FlatCollectionTree::build(collection_nodes(state.range(0), state.range(1))); });
+}
+
+// Breadth-first traversal over all collections and their pdf items, the access pattern of write_pdfs.
+static void BM_CollectionTreeTraverse(benchmark::State& state) {
+  const zotfiles::CollectionTree collectionTree = zotfiles::CollectionTree::build(collection_nodes(state.range(0), state.range(1)));
+  for (auto _: state)
+  {
+    std::size_t pdfNameBytes = 0;
+    std::deque<std::shared_ptr<zotfiles::CollectionNode>> queue{collectionTree.find(0)};
+    while (!queue.empty())
+    {
+      const std::shared_ptr<zotfiles::CollectionNode> node = queue.front();
+      queue.pop_front();
+      queue.insert(queue.end(), node->childrenNodes.begin(), node->childrenNodes.end());
+      for (const zotfiles::CollectionPDFItem& pdfItem: node->collectionPDFItems)
+      {
+        pdfNameBytes += pdfItem.pdfName.size();
+      }
+    }
+    benchmark::DoNotOptimize(pdfNameBytes);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_FlatCollectionTreeTraverse(benchmark::State& state) {
+  const zotfiles::FlatCollectionTree collectionTree =
+      zotfiles::FlatCollectionTree::build(collection_nodes(state.range(0), state.range(1)));
+  for (auto _: state)
+  {
+    // The node array is stored in breadth-first order.
+    std::size_t pdfNameBytes = 0;
+    for (const zotfiles::FlatCollectionNode& node: collectionTree.nodes())
+    {
+      for (const zotfiles::CollectionPDFItem& pdfItem: collectionTree.pdf_items(node))
+      {
+        pdfNameBytes += pdfItem.pdfName.size();
+      }
+    }
+    benchmark::DoNotOptimize(pdfNameBytes);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Arguments: number of collections, number of pdf items
+BENCHMARK(BM_CollectionTreeBuild)
+    ->ArgNames({"collections", "items"})
+    ->Args({1000, 10000})
+    ->Args({8000, 60000})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_FlatCollectionTreeBuild)
+    ->ArgNames({"collections", "items"})
+    ->Args({1000, 10000})
+    ->Args({8000, 60000})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_CollectionTreeTraverse)
+    ->ArgNames({"collections", "items"})
+    ->Args({1000, 10000})
+    ->Args({8000, 60000})
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_FlatCollectionTreeTraverse)
+    ->ArgNames({"collections", "items"})
+    ->Args({1000, 10000})
+    ->Args({8000, 60000})
+    ->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,268 @@
+#include "BenchLibrary.hpp"
+#include "LibraryGenerator.hpp"
+#include <MetadataCache.hpp>
+#include <RunArena.hpp>
+#include <StreamingExport.hpp>
+#include <ZoteroDB.hpp>
+#include <ZoteroToFileTree.hpp>
+#include <benchmark/benchmark.h>
+#include <map>
+#include <memory>
+
+// The stages of an export, measured separately on generated libraries with 1k, 10k and 100k items.
+
+/**
+ *\brief Returns the generated library with itemCount items. Every library is generated once and removed when the benchmarks end.
+ */
+static const BenchLibrary& stage_library(std::int64_t itemCount) {
+  static std::map<std::int64_t, std::unique_ptr<BenchLibrary>> libraries;
+  auto& library = libraries[itemCount];
+  if (!library)
+  {
+    library = std::make_unique<BenchLibrary>("stages_" + std::to_string(itemCount));
+    static_cast<void>(generate_library(library->library_dir(),
+                                       LibraryShape{static_cast<std::size_t>(itemCount), 3, 6, 2, 1024}));
+  }
+  return *library;
+}
+
+static void BM_StagePdfAttachments(benchmark::State& state) {
+  zotfiles::ZoteroDBSession session(stage_library(state.range(0)).zotero_db_path());
+  for (auto _: state)
+  {
+    auto pdfAttachments = zotfiles::pdf_attachments(session);
+    benchmark::DoNotOptimize(pdfAttachments);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_StagePdfItems(benchmark::State& state) {
+  zotfiles::ZoteroDBSession session(stage_library(state.range(0)).zotero_db_path());
+  const auto pdfAttachments = zotfiles::pdf_attachments(session);
+  for (auto _: state)
+  {
+    auto pdfItems = zotfiles::pdf_items(pdfAttachments, session);
+    benchmark::DoNotOptimize(pdfItems);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_StageRetrievePdfItemCollections(benchmark::State& state) {
+  zotfiles::ZoteroDBSession session(stage_library(state.range(0)).zotero_db_path());
+  const auto pdfItems = zotfiles::pdf_items(zotfiles::pdf_attachments(session), session);
+  for (auto _: state)
+  {
+    state.PauseTiming();
+    auto pdfItemsWithCollections = pdfItems;
+    state.ResumeTiming();
+
+    zotfiles::retrieve_pdf_item_collections(pdfItemsWithCollections, session);
+    benchmark::DoNotOptimize(pdfItemsWithCollections);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_StageAllPdfItemCollections(benchmark::State& state) {
+  zotfiles::ZoteroDBSession session(stage_library(state.range(0)).zotero_db_path());
+  const auto pdfItems = zotfiles::pdf_attachment_items(session);
+  for (auto _: state)
+  {
+    auto collections = zotfiles::all_pdf_item_collections(pdfItems, session);
+    benchmark::DoNotOptimize(collections);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_StageCollectionTreeBuild(benchmark::State& state) {
+  zotfiles::ZoteroDBSession session(stage_library(state.range(0)).zotero_db_path());
+  const auto collections = zotfiles::all_pdf_item_collections(zotfiles::pdf_attachment_items(session), session);
+  for (auto _: state)
+  {
+    state.PauseTiming();
+    std::unordered_map<std::int64_t, std::shared_ptr<zotfiles::CollectionNode>> collectionNodes;
+    for (const auto& [collectionID, collection]: collections)
+    {
+      collectionNodes.emplace(
+          collectionID,
+          std::make_shared<zotfiles::CollectionNode>(
+              zotfiles::CollectionNode{collection.collectionID, collection.parentCollectionID, collection.collectionName}));
+    }
+    state.ResumeTiming();
+
+    zotfiles::CollectionTree collectionTree = zotfiles::CollectionTree::build(std::move(collectionNodes));
+    benchmark::DoNotOptimize(collectionTree);
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(collections.size()));
+}
+
+static void BM_StageCreateCollectionTree(benchmark::State& state) {
+  zotfiles::ZoteroDBSession session(stage_library(state.range(0)).zotero_db_path());
+  const auto pdfItems = zotfiles::pdf_items(zotfiles::pdf_attachments(session), session);
+  auto pdfItemsWithCollections = pdfItems;
+  zotfiles::retrieve_pdf_item_collections(pdfItemsWithCollections, session);
+  for (auto _: state)
+  {
+    auto collectionTree = zotfiles::ZoteroToFileTree::create_collectiontree(pdfItemsWithCollections, session);
+    benchmark::DoNotOptimize(collectionTree);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_StageWritePdfs(benchmark::State& state) {
+  const BenchLibrary& library = stage_library(state.range(0));
+  zotfiles::ZoteroDBSession session(library.zotero_db_path());
+  auto pdfItems = zotfiles::pdf_items(zotfiles::pdf_attachments(session), session);
+  zotfiles::retrieve_pdf_item_collections(pdfItems, session);
+  const zotfiles::FlatCollectionTree collectionTree = zotfiles::ZoteroToFileTree::create_collectiontree(pdfItems, session);
+  const std::filesystem::path outputDir = library.library_dir() / "output";
+  const zotfiles::WriteOptions writeOptions{false, 4};
+
+  for (auto _: state)
+  {
+    state.PauseTiming();
+    std::filesystem::remove_all(outputDir);
+    state.ResumeTiming();
+
+    zotfiles::WriteSummary writeSummary = collectionTree.write_pdfs(outputDir, writeOptions);
+    benchmark::DoNotOptimize(writeSummary);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+/**
+ *\brief Milliseconds from the creation of the tracer to the start of the first copy. The statistics of the tracer start over.
+ */
+static double first_copy_ms(zotfiles::Tracer& tracer) {
+  double firstCopyMs = 0.0;
+  for (const auto& [name, stageStats]: tracer.stage_stats())
+  {
+    if (name == "copy file")
+    {
+      firstCopyMs = std::chrono::duration<double, std::milli>(stageStats.firstStart).count();
+    }
+  }
+  static_cast<void>(tracer.report());
+  return firstCopyMs;
+}
+
+// A whole export from the zotero db to the output directory, reading all pdf items before the first copy.
+static void BM_ExportStaged(benchmark::State& state) {
+  const BenchLibrary& library = stage_library(state.range(0));
+  zotfiles::ZoteroDBSession session(library.zotero_db_path());
+  const std::filesystem::path outputDir = library.library_dir() / "output";
+  double firstCopyMs = 0.0;
+
+  for (auto _: state)
+  {
+    state.PauseTiming();
+    std::filesystem::remove_all(outputDir);
+    zotfiles::Tracer tracer(false, {});
+    const zotfiles::WriteOptions writeOptions{false, 4, zotfiles::LinkMode::COPY, nullptr, nullptr, {}, &tracer};
+    state.ResumeTiming();
+
+    auto pdfItems = zotfiles::pdf_attachment_items(session);
+    zotfiles::resolve_pdf_file_paths(pdfItems, zotfiles::StorageIndex::build(session.storage_dir()));
+    pdfItems.erase_if([](const zotfiles::PDFItem& item) { return item.pdfFilePath.empty(); });
+    const zotfiles::FlatCollectionTree collectionTree = zotfiles::ZoteroToFileTree::create_collectiontree(pdfItems, session);
+    zotfiles::WriteSummary writeSummary = collectionTree.write_pdfs(outputDir, writeOptions);
+    benchmark::DoNotOptimize(writeSummary);
+    firstCopyMs = first_copy_ms(tracer);
+  }
+  state.counters["first_copy_ms"] = firstCopyMs;
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// The same export streamed from the cursor of the attachment query to the copy workers, see stream_pdfs.
+static void BM_ExportStreamed(benchmark::State& state) {
+  const BenchLibrary& library = stage_library(state.range(0));
+  zotfiles::ZoteroDBSession session(library.zotero_db_path());
+  const std::filesystem::path outputDir = library.library_dir() / "output";
+  double firstCopyMs = 0.0;
+
+  for (auto _: state)
+  {
+    state.PauseTiming();
+    std::filesystem::remove_all(outputDir);
+    zotfiles::Tracer tracer(false, {});
+    const zotfiles::WriteOptions writeOptions{false, 4, zotfiles::LinkMode::COPY, nullptr, nullptr, {}, &tracer};
+    state.ResumeTiming();
+
+    zotfiles::StreamSummary streamSummary = zotfiles::stream_pdfs(session, outputDir, writeOptions, zotfiles::DuplicatePolicy::SKIP);
+    benchmark::DoNotOptimize(streamSummary);
+    firstCopyMs = first_copy_ms(tracer);
+  }
+  state.counters["first_copy_ms"] = firstCopyMs;
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Heap bytes of the pdf items of an export, including their collections and strings.
+static void BM_StagePdfAttachmentItemsMemory(benchmark::State& state) {
+  zotfiles::ZoteroDBSession session(stage_library(state.range(0)).zotero_db_path());
+  for (auto _: state)
+  {
+    auto pdfItems = zotfiles::pdf_attachment_items(session);
+    benchmark::DoNotOptimize(pdfItems);
+  }
+  const double heapBytes = heap_bytes([&session] { return zotfiles::pdf_attachment_items(session); });
+  state.counters["heap_bytes"] = heapBytes;
+  state.counters["heap_bytes_per_item"] = heapBytes / static_cast<double>(state.range(0));
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// The pdf items of an export allocated from a RunArena, like in an export. Reports the allocations served by the arena.
+static void BM_StagePdfAttachmentItemsArena(benchmark::State& state) {
+  zotfiles::ZoteroDBSession session(stage_library(state.range(0)).zotero_db_path());
+  zotfiles::ArenaStats arenaStats;
+  for (auto _: state)
+  {
+    zotfiles::RunArena runArena;
+    {
+      auto pdfItems = zotfiles::pdf_attachment_items(session, runArena.resource());
+      benchmark::DoNotOptimize(pdfItems);
+    }
+    arenaStats = runArena.stats();
+  }
+  state.counters["arena_allocations"] = static_cast<double>(arenaStats.allocations);
+  state.counters["heap_allocations"] = static_cast<double>(arenaStats.heapAllocations);
+  state.counters["heap_bytes_per_item"] = static_cast<double>(arenaStats.heapBytes) / static_cast<double>(state.range(0));
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Restores the pdf items with their pdf files and the collections of the tree from the metadata cache, which replaces the attachment
+// query, the storage scan and the collection query of an export of an unchanged zotero db.
+static void BM_StageMetadataCacheLoad(benchmark::State& state) {
+  const BenchLibrary& library = stage_library(state.range(0));
+  zotfiles::ZoteroDBSession session(library.zotero_db_path());
+  zotfiles::PDFItems pdfItems = zotfiles::pdf_attachment_items(session);
+  zotfiles::resolve_pdf_file_paths(pdfItems, session);
+  const std::filesystem::path cacheDir = library.library_dir() / "metadata_cache";
+  std::filesystem::create_directories(cacheDir);
+  const zotfiles::MetadataCacheKey key = zotfiles::metadata_cache_key(session);
+  static_cast<void>(zotfiles::MetadataCache::save(
+      cacheDir, key, zotfiles::zotero_db_state(session), pdfItems, zotfiles::all_pdf_item_collections(pdfItems, session)));
+
+  for (auto _: state)
+  {
+    const std::optional<zotfiles::MetadataCache> metadataCache = zotfiles::MetadataCache::open(cacheDir, key);
+    auto cachedItems = metadataCache->pdf_items();
+    auto cachedCollections = metadataCache->pdf_item_collections();
+    benchmark::DoNotOptimize(cachedItems);
+    benchmark::DoNotOptimize(cachedCollections);
+  }
+  state.counters["cache_bytes"] = static_cast<double>(std::filesystem::file_size(cacheDir / zotfiles::MetadataCache::fileName));
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Argument: number of items of the generated library
+BENCHMARK(BM_StagePdfAttachments)->RangeMultiplier(10)->Range(1000, 100000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_StagePdfItems)->RangeMultiplier(10)->Range(1000, 100000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_StageRetrievePdfItemCollections)->RangeMultiplier(10)->Range(1000, 100000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_StageAllPdfItemCollections)->RangeMultiplier(10)->Range(1000, 100000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_StagePdfAttachmentItemsMemory)->RangeMultiplier(10)->Range(1000, 100000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_StagePdfAttachmentItemsArena)->RangeMultiplier(10)->Range(1000, 100000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_StageMetadataCacheLoad)->RangeMultiplier(10)->Range(1000, 100000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_StageCollectionTreeBuild)->RangeMultiplier(10)->Range(1000, 100000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_StageCreateCollectionTree)->RangeMultiplier(10)->Range(1000, 100000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_StageWritePdfs)->RangeMultiplier(10)->Range(1000, 100000)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_ExportStaged)->RangeMultiplier(10)->Range(1000, 100000)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_ExportStreamed)->RangeMultiplier(10)->Range(1000, 100000)->Unit(benchmark::kMillisecond)->UseRealTime();
@@ -0,0 +1,112 @@
+#include "BenchLibrary.hpp"
+#include <CollectionTree.hpp>
+#include <benchmark/benchmark.h>
+#include <fmt/format.h>
+
+// Distributes the pdf files round robin over collectionCount collections with a fan out of 4 children per collection.
+static zotfiles::CollectionTree build_synthetic_tree(const std::vector<std::filesystem::path>& pdfFilePaths, std::int64_t collectionCount) {
+  std::unordered_map<std::int64_t, std::shared_ptr<zotfiles::CollectionNode>> collectionNodes;
+  for (std::int64_t collectionID = 0; collectionID < collectionCount; ++collectionID)
+  {
+    const std::int64_t parentCollectionID = collectionID == 0 ? -1 : (collectionID - 1) / 4;
+    collectionNodes.emplace(collectionID,
+                            std::make_shared<zotfiles::CollectionNode>(
+                                zotfiles::CollectionNode{collectionID, parentCollectionID, fmt::format("Collection {}", collectionID)}));
+  }
+
+  for (std::size_t i = 0; i < pdfFilePaths.size(); ++i)
+  {
+    auto& node = collectionNodes.at(static_cast<std::int64_t>(i) % collectionCount);
+    node->collectionPDFItems.push_back(
+        zotfiles::CollectionPDFItem{static_cast<std::int64_t>(i), pdfFilePaths[i].filename().string(), pdfFilePaths[i]});
+  }
+
+  return zotfiles::CollectionTree::build(std::move(collectionNodes));
+}
+
+static void BM_WritePdfs(benchmark::State& state) {
+  static constexpr std::int64_t pdfCount = 2000;
+  static constexpr std::int64_t pdfSize = 256 * 1024;
+  const BenchLibrary library("write_pdfs");
+  const auto pdfFilePaths =
+      write_storage_pdfs(library.library_dir(), static_cast<std::size_t>(pdfCount), static_cast<std::size_t>(pdfSize));
+  zotfiles::CollectionTree collectionTree = build_synthetic_tree(pdfFilePaths, 200);
+  const std::filesystem::path outputDir = library.library_dir() / "output";
+  const zotfiles::WriteOptions writeOptions{false,
+                                            static_cast<std::size_t>(state.range(0)),
+                                            static_cast<zotfiles::LinkMode>(state.range(1))};
+
+  for (auto _: state)
+  {
+    state.PauseTiming();
+    std::filesystem::remove_all(outputDir);
+    state.ResumeTiming();
+
+    zotfiles::WriteSummary writeSummary = collectionTree.write_pdfs(outputDir, writeOptions);
+    benchmark::DoNotOptimize(writeSummary);
+  }
+  state.SetItemsProcessed(state.iterations() * pdfCount);
+  state.SetBytesProcessed(state.iterations() * pdfCount * pdfSize);
+}
+
+// Arguments: number of copy jobs, zotfiles::LinkMode (0 copy, 1 hardlink, 2 symlink, 4 auto)
+BENCHMARK(BM_WritePdfs)
+    ->ArgNames({"jobs", "link_mode"})
+    ->ArgsProduct({{1, 4, 16}, {0, 1, 2, 4}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// An export into an output directory that is up to date with its manifest, the nightly sync of an unchanged library.
+static void BM_WritePdfsUnchanged(benchmark::State& state) {
+  static constexpr std::int64_t pdfCount = 20000;
+  const BenchLibrary library("write_pdfs_unchanged");
+  const auto pdfFilePaths = write_storage_pdfs(library.library_dir(), static_cast<std::size_t>(pdfCount), 1024);
+  zotfiles::CollectionTree collectionTree = build_synthetic_tree(pdfFilePaths, 2000);
+  const std::filesystem::path outputDir = library.library_dir() / "output";
+  const zotfiles::WriteOptions writeOptions{false, static_cast<std::size_t>(state.range(0))};
+  static_cast<void>(collectionTree.write_pdfs(outputDir, writeOptions));
+
+  for (auto _: state)
+  {
+    zotfiles::WriteSummary writeSummary = collectionTree.write_pdfs(outputDir, writeOptions);
+    benchmark::DoNotOptimize(writeSummary);
+  }
+  state.SetItemsProcessed(state.iterations() * pdfCount);
+}
+
+// Argument: number of copy jobs
+BENCHMARK(BM_WritePdfsUnchanged)->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Many small byte copies, where the system calls per file and not the bytes dominate. Compares the blocking copies of the worker threads
+// with the copies in flight in an io_uring.
+static void BM_WritePdfsCopyBackend(benchmark::State& state) {
+  static constexpr std::int64_t pdfCount = 5000;
+  const auto pdfSize = static_cast<std::size_t>(state.range(2));
+  const BenchLibrary library("write_pdfs_copy_backend");
+  const auto pdfFilePaths = write_storage_pdfs(library.library_dir(), static_cast<std::size_t>(pdfCount), pdfSize);
+  zotfiles::CollectionTree collectionTree = build_synthetic_tree(pdfFilePaths, 500);
+  const std::filesystem::path outputDir = library.library_dir() / "output";
+  zotfiles::WriteOptions writeOptions;
+  writeOptions.jobs = static_cast<std::size_t>(state.range(0));
+  writeOptions.copyBackend = static_cast<zotfiles::CopyBackend>(state.range(1));
+  writeOptions.queueDepth = 64;
+
+  for (auto _: state)
+  {
+    state.PauseTiming();
+    std::filesystem::remove_all(outputDir);
+    state.ResumeTiming();
+
+    zotfiles::WriteSummary writeSummary = collectionTree.write_pdfs(outputDir, writeOptions);
+    benchmark::DoNotOptimize(writeSummary);
+  }
+  state.SetItemsProcessed(state.iterations() * pdfCount);
+  state.SetBytesProcessed(state.iterations() * pdfCount * static_cast<std::int64_t>(pdfSize));
+}
+
+// Arguments: number of copy jobs of the thread backend, zotfiles::CopyBackend (0 threads, 1 io_uring), pdf size in bytes
+BENCHMARK(BM_WritePdfsCopyBackend)
+    ->ArgNames({"jobs", "backend", "size"})
+    ->ArgsProduct({{1, 4}, {0, 1}, {4 * 1024, 256 * 1024}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
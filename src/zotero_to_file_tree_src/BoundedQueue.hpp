@@ -0,0 +1,93 @@
+#ifndef ZOTERO_TO_FILE_TREE_BOUNDEDQUEUE_HPP
+#define ZOTERO_TO_FILE_TREE_BOUNDEDQUEUE_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+namespace zotfiles
+{
+
+/**
+ *\brief A blocking multi producer, multi consumer queue with a fixed capacity.
+ *
+ * push blocks while the queue is full and pop blocks while the queue is empty. After close, push drops its value and pop drains the
+ * remaining values before it returns std::nullopt.
+ */
+template <typename T>
+class BoundedQueue {
+  std::size_t m_capacity;
+  std::deque<T> m_values;
+  bool m_closed{false};
+  std::mutex m_mutex;
+  std::condition_variable m_notFull;
+  std::condition_variable m_notEmpty;
+
+public:
+  explicit BoundedQueue(std::size_t capacity)
+      : m_capacity(capacity == 0 ? 1 : capacity) {}
+
+  /**
+   *\brief Adds a value to the queue. Returns false if the queue was closed.
+   */
+  bool push(T value) {
+    std::unique_lock lock(m_mutex);
+    m_notFull.wait(lock, [this] { return m_closed || m_values.size() < m_capacity; });
+    if (m_closed)
+    {
+      return false;
+    }
+    m_values.push_back(std::move(value));
+    lock.unlock();
+    m_notEmpty.notify_one();
+    return true;
+  }
+
+  /**
+   *\brief Removes the oldest value from the queue. Returns std::nullopt if the queue is closed and empty.
+   */
+  std::optional<T> pop() {
+    std::unique_lock lock(m_mutex);
+    m_notEmpty.wait(lock, [this] { return m_closed || !m_values.empty(); });
+    if (m_values.empty())
+    {
+      return std::nullopt;
+    }
+    T value = std::move(m_values.front());
+    m_values.pop_front();
+    lock.unlock();
+    m_notFull.notify_one();
+    return value;
+  }
+
+  /**
+   *\brief Removes the oldest value from the queue without blocking. Returns std::nullopt if the queue is empty.
+   */
+  std::optional<T> try_pop() {
+    std::unique_lock lock(m_mutex);
+    if (m_values.empty())
+    {
+      return std::nullopt;
+    }
+    T value = std::move(m_values.front());
+    m_values.pop_front();
+    lock.unlock();
+    m_notFull.notify_one();
+    return value;
+  }
+
+  void close() {
+    {
+      const std::lock_guard lock(m_mutex);
+      m_closed = true;
+    }
+    m_notFull.notify_all();
+    m_notEmpty.notify_all();
+  }
+};
+
+} // namespace zotfiles
+
+#endif // ZOTERO_TO_FILE_TREE_BOUNDEDQUEUE_HPP
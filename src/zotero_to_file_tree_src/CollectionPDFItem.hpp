@@ -0,0 +1,24 @@
+#ifndef ZOTERO_TO_FILE_TREE_COLLECTIONPDFITEM_H
+#define ZOTERO_TO_FILE_TREE_COLLECTIONPDFITEM_H
+
+#include <compare>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+namespace zotfiles
+{
+
+/** @brief The collection item represents a pdf item from the zotero db.
+ */
+struct CollectionPDFItem {
+  std::int64_t pdfItemId{};          /**< Identifies the CollectionPDFItem uniquely. */
+  std::string pdfName;               /**< The name of the pdf file. */
+  std::filesystem::path pdfFilePath; /**< The absolute path to the pdf file. */
+
+  std::strong_ordering operator<=>(const CollectionPDFItem& rhs) const { return pdfItemId <=> rhs.pdfItemId; }
+};
+
+} // namespace zotfiles
+
+#endif // ZOTERO_TO_FILE_TREE_COLLECTIONPDFITEM_H
@@ -1,4 +1,5 @@
 #include "CollectionTree.hpp"
+#include <algorithm>
 #include <cassert>
 #include <deque>
 #include <fmt/format.h>
@@ -7,21 +8,31 @@ namespace zotfiles
 {
 
 std::shared_ptr<CollectionNode> CollectionTree::find(std::int64_t collectionID) const {
-  std::deque<std::shared_ptr<CollectionNode>> queue;
-  for (auto& node: m_collectionNodes)
-    queue.push_back(node);
-
-  while (!queue.empty())
+  auto findIter = m_nodeIndex.find(collectionID);
+  return findIter != m_nodeIndex.end() ? findIter->second : nullptr;
+}
+void CollectionTree::index_subtree(const std::shared_ptr<CollectionNode>& subtreeRoot) {
+  std::vector<std::shared_ptr<CollectionNode>> stack{subtreeRoot};
+  while (!stack.empty())
   {
-    auto node = queue.front();
-    queue.pop_front();
-    if (node->collectionID == collectionID)
-      return node;
-    for (auto& childNode: node->childrenNodes)
-      queue.push_back(childNode);
+    std::shared_ptr<CollectionNode> node = std::move(stack.back());
+    stack.pop_back();
+    stack.insert(stack.end(), node->childrenNodes.begin(), node->childrenNodes.end());
+    m_nodeIndex.emplace(node->collectionID, std::move(node));
+  }
+}
+void CollectionTree::unindex_subtree(const CollectionNode& subtreeRoot) {
+  std::vector<const CollectionNode*> stack{&subtreeRoot};
+  while (!stack.empty())
+  {
+    const CollectionNode* node = stack.back();
+    stack.pop_back();
+    for (const auto& childNode: node->childrenNodes)
+    {
+      stack.push_back(childNode.get());
+    }
+    m_nodeIndex.erase(node->collectionID);
   }
-
-  return nullptr;
 }
 bool CollectionTree::erase_collection_node(std::vector<std::shared_ptr<CollectionNode>>& collectionNodes,
                                            const CollectionNode& collectionNode) {
@@ -37,30 +48,17 @@ bool CollectionTree::erase_collection_node(std::vector<std::shared_ptr<Collectio
   return false;
 }
 bool CollectionTree::remove(const CollectionNode& collectionNode) {
-  if (erase_collection_node(m_collectionNodes, collectionNode))
-    return true;
-
-  std::deque<std::shared_ptr<CollectionNode>> queue;
-  for (auto& node: m_collectionNodes)
-  {
-    queue.push_back(node);
-  }
-
-  while (!queue.empty())
-  {
-    auto node = queue.front();
-    queue.pop_front();
+  // Keep the node alive until its subtree is unindexed, collectionNode may be the node itself.
+  const std::shared_ptr<CollectionNode> node = find(collectionNode.collectionID);
+  if (!node)
+    return false;
 
-    if (erase_collection_node(node->childrenNodes, collectionNode))
-      return true;
+  const std::shared_ptr<CollectionNode> parentNode = find(node->parentCollectionID);
+  if (!erase_collection_node(parentNode ? parentNode->childrenNodes : m_collectionNodes, *node))
+    return false;
 
-    for (auto& childNode: node->childrenNodes)
-    {
-      queue.push_back(childNode);
-    }
-  }
-
-  return false;
+  unindex_subtree(*node);
+  return true;
 }
 CollectionTree CollectionTree::build(std::unordered_map<std::int64_t, std::shared_ptr<CollectionNode>> collectionNodes) {
   // Iterate over the nodes and add them as children of their parent nodes
@@ -83,13 +81,14 @@ CollectionTree CollectionTree::build(std::unordered_map<std::int64_t, std::share
     if (collectionNode->parentCollectionID == -1)
     {
       collectionTree.m_collectionNodes.push_back(collectionNode);
+      collectionTree.index_subtree(collectionNode);
     }
   }
 
   return collectionTree;
 }
 
-std::pair<std::size_t, std::size_t> CollectionTree::write_pdfs(std::filesystem::path outputDir, bool overwriteExistingFiles) {
+WriteSummary CollectionTree::write_pdfs(std::filesystem::path outputDir, const WriteOptions& writeOptions, Manifest* writtenManifest) {
   struct NodePathPair {
     CollectionNode* node{nullptr};
     std::filesystem::path relPath;
@@ -102,8 +101,8 @@ std::pair<std::size_t, std::size_t> CollectionTree::write_pdfs(std::filesystem::
     nodePathPairs.emplace_back(node.get(), std::filesystem::path(node->collectionName));
   }
 
-  std::size_t writtenPDFs{0};
-  std::size_t skippedPDFs{0};
+  OutputDirWriter outputDirWriter(std::move(outputDir), writeOptions);
+  TraceSpan traceSpan(writeOptions.tracer, "plan");
 
   while (!nodePathPairs.empty())
   {
@@ -115,33 +114,11 @@ std::pair<std::size_t, std::size_t> CollectionTree::write_pdfs(std::filesystem::
       nodePathPairs.emplace_back(childNode.get(), nodePathPair.relPath / childNode->collectionName);
     }
 
-    auto absCollectionDirPath = outputDir / nodePathPair.relPath;
-    std::filesystem::create_directories(absCollectionDirPath);
-
-    for (const auto& pdfItem: nodePathPair.node->collectionPDFItems)
-    {
-      std::filesystem::path targetFilePath = outputDir / nodePathPair.relPath / pdfItem.pdfName;
-      bool targetFileExists = std::filesystem::exists(targetFilePath);
-      if (!overwriteExistingFiles && targetFileExists)
-      {
-        ++skippedPDFs;
-        continue;
-      }
-
-      try
-      {
-        if (targetFileExists)
-        {
-          std::filesystem::remove(targetFilePath);
-        }
-        std::filesystem::copy(pdfItem.pdfFilePath, targetFilePath);
-        ++writtenPDFs;
-      }
-      catch (std::exception& e)
-      { fmt::print("Error copying PDF in collection: '{}',\n'{}'\n\n", nodePathPair.node->collectionName, e.what()); }
-    }
+    outputDirWriter.plan_directory(nodePathPair.relPath, nodePathPair.node->collectionName, nodePathPair.node->collectionPDFItems);
   }
+  traceSpan.set_item_count(outputDirWriter.finish_plan().operations().size());
+  traceSpan.finish();
 
-  return {writtenPDFs, skippedPDFs};
+  return outputDirWriter.execute(writtenManifest);
 }
-} // namespace zotfiles
\ No newline at end of file
+} // namespace zotfiles
@@ -1,26 +1,20 @@
 #ifndef ZOTERO_TO_FILE_TREE_COLLECTIONTREE_H
 #define ZOTERO_TO_FILE_TREE_COLLECTIONTREE_H
 
+#include "CollectionPDFItem.hpp"
+#include "OutputDirWriter.hpp"
 #include <cassert>
 #include <compare>
 #include <filesystem>
 #include <functional>
+#include <set>
+#include <string>
 #include <unordered_map>
 #include <utility>
 
 namespace zotfiles
 {
 
-/** @brief The collection item represents a pdf item from the zotero db.
- */
-struct CollectionPDFItem {
-  std::int64_t pdfItemId{};          /**< Identifies the CollectionPDFItem uniquely. */
-  std::string pdfName;               /**< The name of the pdf file. */
-  std::filesystem::path pdfFilePath; /**< The absolute path to the pdf file. */
-
-  std::strong_ordering operator<=>(const CollectionPDFItem& rhs) const { return pdfItemId <=> rhs.pdfItemId; }
-};
-
 /** @brief A tree node representing a collection containing pdf items.
  *
  * A CollectionNode must have a unique id.
@@ -42,26 +36,44 @@ struct CollectionNode {
  */
 class CollectionTree {
   std::vector<std::shared_ptr<CollectionNode>> m_collectionNodes;
+  std::unordered_map<std::int64_t, std::shared_ptr<CollectionNode>> m_nodeIndex; /**< All nodes of the tree by their collectionID. */
 
 public:
   /** @brief  Build the collection for a given set of collection nodes.
    *
+   * Nodes whose parent is not part of the given nodes are not part of the tree.
    */
   static CollectionTree build(std::unordered_map<std::int64_t, std::shared_ptr<CollectionNode>> collectionNodes);
 
+  /** @brief Returns the node with the given collectionID or nullptr if the tree has no such node. Constant time.
+   */
   std::shared_ptr<CollectionNode> find(std::int64_t collectionID) const;
 
+  /** @brief Removes the node with the collectionID of the given node and its subtree. Returns false if the tree has no such node.
+   *
+   * Looks up the parent in the index, so only the siblings of the node are searched.
+   */
+  bool remove(const CollectionNode& collectionNode);
+
   /** @brief Write the pdfs to the output directory.
    *
    * Write the pdf items to the given output directory with a directory tree structure matching the collection tree.
+   * The directories and pdf files are planned first, see OutputDirWriter. The directories are created in breadth-first order by the calling
+   * thread. The pdf files of a directory are handed to the copy workers after the directory was created.
    *
-   *  @return {written, skipped} The number of pdf files written and skipped.
+   * The written files are recorded in a Manifest in the output directory. The next write only transfers new and changed pdf files and
+   * removes the files that are not part of the collection tree anymore. With WriteOptions::patchedItemIds only the files of the patched
+   * items are written and removed.
+   *
+   *  @param writtenManifest If set, receives the manifest that was written to the output directory.
+   *  @return The number of pdf files written and skipped and how the written files were transferred.
    */
-  std::pair<std::size_t, std::size_t> write_pdfs(std::filesystem::path outputDir, bool overwriteExistingFiles);
+  WriteSummary write_pdfs(std::filesystem::path outputDir, const WriteOptions& writeOptions, Manifest* writtenManifest = nullptr);
 
 private:
   static bool erase_collection_node(std::vector<std::shared_ptr<CollectionNode>>& collectionNodes, const CollectionNode& collectionNode);
-  bool remove(const CollectionNode& collectionNode);
+  void index_subtree(const std::shared_ptr<CollectionNode>& subtreeRoot);
+  void unindex_subtree(const CollectionNode& subtreeRoot);
 };
 
 } // namespace zotfiles
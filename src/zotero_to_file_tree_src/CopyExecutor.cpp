@@ -0,0 +1,282 @@
+#include "CopyExecutor.hpp"
+#include "IoUringCopier.hpp"
+#include <algorithm>
+#include <chrono>
+#include <fmt/format.h>
+
+namespace zotfiles
+{
+
+CopyExecutor::CopyExecutor(std::size_t jobs,
+                           bool overwriteExistingFiles,
+                           LinkMode linkMode,
+                           Tracer* tracer,
+                           CopyBackend copyBackend,
+                           std::size_t queueDepth)
+    : m_overwriteExistingFiles(overwriteExistingFiles)
+    , m_tracer(tracer)
+    , m_fileTransfer(linkMode)
+    , m_queue(std::max(jobs * 64, copyBackend == CopyBackend::IO_URING ? queueDepth * 2 : 0)) {
+  // Links are created with a single system call each, the ring only pays off for byte copies.
+  if (copyBackend == CopyBackend::IO_URING && linkMode == LinkMode::COPY)
+  {
+    m_ring = IoUringCopier::create(queueDepth);
+    if (m_ring)
+    {
+      m_workers.emplace_back([this]() { run_ring(); });
+      return;
+    }
+    fmt::print("io_uring is not available, copying with {} thread(s).\n", std::max<std::size_t>(jobs, 1));
+  }
+
+  if (jobs < 2)
+  {
+    return;
+  }
+
+  m_workers.reserve(jobs);
+  for (std::size_t i = 0; i < jobs; ++i)
+  {
+    m_workers.emplace_back(
+        [this]()
+        {
+          while (auto job = m_queue.pop())
+          {
+            copy(*job);
+          }
+        });
+  }
+}
+
+CopyExecutor::~CopyExecutor() {
+  finish();
+}
+
+void CopyExecutor::submit(CopyJob job) {
+  if (m_workers.empty())
+  {
+    copy(job);
+    return;
+  }
+  m_queue.push(std::move(job));
+}
+
+WriteSummary CopyExecutor::finish() {
+  m_queue.close();
+  for (auto& worker: m_workers)
+  {
+    if (worker.joinable())
+    {
+      worker.join();
+    }
+  }
+
+  WriteSummary writeSummary;
+  writeSummary.skippedPDFs = m_skippedPDFs.load();
+  writeSummary.unchangedPDFs = m_unchangedPDFs.load();
+  for (std::size_t i = 0; i < transferMethodCount; ++i)
+  {
+    writeSummary.transferCounts[i] = m_transferCounts[i].load();
+    writeSummary.writtenPDFs += writeSummary.transferCounts[i];
+  }
+  return writeSummary;
+}
+
+std::vector<ManifestEntry> CopyExecutor::take_manifest_entries() {
+  const std::lock_guard lock(m_manifestMutex);
+  return std::move(m_manifestEntries);
+}
+
+namespace
+{
+
+/**
+ *\brief True if the target file still has the content of the source pdf file and was written with the link mode of the new entry. Sets the
+ * hash of the new entry.
+ *
+ * The contents are only compared if the size of the source file is unchanged but its mtime is not. A byte copy without a hash in the
+ * previous entry, e.g. one made with copy_file_range, is hashed then. Symbolic links always show the current source file, they are cheaper
+ * to create again than to compare.
+ */
+bool is_unchanged(const ManifestEntry& previousEntry,
+                  ManifestEntry& entry,
+                  const std::filesystem::path& sourceFilePath,
+                  const std::filesystem::path& targetFilePath) {
+  if (previousEntry.linkMode != entry.linkMode || previousEntry.sourceSize != entry.sourceSize)
+  {
+    return false;
+  }
+  // A dangling symbolic link, e.g. one that an older export created with a relative target, is created again.
+  std::error_code errorCode;
+  if (entry.linkMode == LinkMode::SYMLINK && !std::filesystem::exists(targetFilePath, errorCode))
+  {
+    return false;
+  }
+  if (previousEntry.sourceMTime == entry.sourceMTime)
+  {
+    entry.contentHash = previousEntry.contentHash;
+    return true;
+  }
+  std::uint64_t previousContentHash = previousEntry.contentHash;
+  if (previousContentHash == 0)
+  {
+    if (!std::filesystem::is_regular_file(std::filesystem::symlink_status(targetFilePath, errorCode)))
+    {
+      return false;
+    }
+    previousContentHash = content_hash(targetFilePath);
+    if (previousContentHash == 0)
+    {
+      return false;
+    }
+  }
+  entry.contentHash = content_hash(sourceFilePath);
+  return entry.contentHash == previousContentHash;
+}
+
+} // namespace
+
+void CopyExecutor::copy(const CopyJob& job) {
+  TraceSpan traceSpan(m_tracer, "copy file");
+  try
+  {
+    std::optional<ManifestEntry> entry = prepare_transfer(job);
+    if (!entry)
+    {
+      return;
+    }
+    // A buffered copy hashes the data while it copies. The other methods leave the hash empty, it is only computed if a later export
+    // finds the source metadata changed, see is_unchanged.
+    const TransferMethod transferMethod =
+        m_fileTransfer.transfer(job.sourceFilePath, job.targetFilePath, job.relPath.empty() ? nullptr : &entry->contentHash);
+    traceSpan.set_item_count(1);
+    transferred(std::move(*entry), transferMethod);
+  }
+  catch (std::exception& e)
+  {
+    report_failure(job, e.what());
+  }
+}
+
+std::optional<ManifestEntry> CopyExecutor::prepare_transfer(const CopyJob& job) {
+  // Links created by an earlier export count as existing files, even if their target was removed.
+  std::error_code errorCode;
+  const bool targetFileExists = std::filesystem::exists(std::filesystem::symlink_status(job.targetFilePath, errorCode));
+  const bool writtenByPreviousExport = targetFileExists && job.previousEntry != nullptr;
+  if (!m_overwriteExistingFiles && targetFileExists && !writtenByPreviousExport)
+  {
+    ++m_skippedPDFs;
+    return std::nullopt;
+  }
+
+  const SourceFileStat sourceFileStat = job.sourceFileStat ? *job.sourceFileStat : source_file_stat(job.sourceFilePath);
+  ManifestEntry entry{job.pdfItemId, job.relPath, sourceFileStat.size, sourceFileStat.mtime, 0, m_fileTransfer.link_mode()};
+  if (writtenByPreviousExport && !m_overwriteExistingFiles &&
+      is_unchanged(*job.previousEntry, entry, job.sourceFilePath, job.targetFilePath))
+  {
+    ++m_unchangedPDFs;
+    record(std::move(entry));
+    return std::nullopt;
+  }
+
+  if (targetFileExists)
+  {
+    std::filesystem::remove(job.targetFilePath);
+  }
+  return entry;
+}
+
+void CopyExecutor::transferred(ManifestEntry manifestEntry, TransferMethod transferMethod) {
+  ++m_transferCounts[static_cast<std::size_t>(transferMethod)];
+  record(std::move(manifestEntry));
+}
+
+void CopyExecutor::report_failure(const CopyJob& job, const char* message) {
+  fmt::print("Error copying PDF in collection: '{}',\n'{}'\n\n", job.collectionName ? *job.collectionName : "", message);
+  // Keep the file of the previous export under the control of the manifest.
+  std::error_code errorCode;
+  if (job.previousEntry != nullptr && std::filesystem::exists(std::filesystem::symlink_status(job.targetFilePath, errorCode)))
+  {
+    record(*job.previousEntry);
+  }
+}
+
+void CopyExecutor::run_ring() {
+  /** @brief A job whose copy is in flight in the ring. */
+  struct RingJob {
+    CopyJob job;
+    ManifestEntry entry;
+    std::chrono::steady_clock::time_point start;
+  };
+  std::vector<std::optional<RingJob>> ringJobs(m_ring->queue_depth());
+
+  while (true)
+  {
+    // Block for the next job only if the ring is idle, otherwise refill it with the jobs that are already queued.
+    while (m_ring->in_flight() < m_ring->queue_depth())
+    {
+      std::optional<CopyJob> job = m_ring->in_flight() == 0 ? m_queue.pop() : m_queue.try_pop();
+      if (!job)
+      {
+        break;
+      }
+      const auto start = std::chrono::steady_clock::now();
+      try
+      {
+        std::optional<ManifestEntry> entry = prepare_transfer(*job);
+        if (!entry)
+        {
+          if (m_tracer != nullptr)
+          {
+            m_tracer->record("copy file", start, std::chrono::steady_clock::now(), 0);
+          }
+          continue;
+        }
+        const std::size_t slot = m_ring->start(job->sourceFilePath, job->targetFilePath, !job->relPath.empty());
+        ringJobs[slot].emplace(RingJob{std::move(*job), std::move(*entry), start});
+      }
+      catch (std::exception& e)
+      {
+        report_failure(*job, e.what());
+      }
+    }
+    // The blocking pop returned std::nullopt: the queue is closed and drained.
+    if (m_ring->in_flight() == 0)
+    {
+      return;
+    }
+
+    for (const RingCopyResult& result: m_ring->advance())
+    {
+      RingJob& ringJob = *ringJobs[result.slot];
+      if (result.errorCode)
+      {
+        report_failure(ringJob.job,
+                       std::filesystem::filesystem_error("copy", ringJob.job.sourceFilePath, ringJob.job.targetFilePath, result.errorCode)
+                           .what());
+      }
+      else
+      {
+        // The ring hashed the content while copying it, the copy is not read again.
+        ringJob.entry.contentHash = result.contentHash;
+        transferred(std::move(ringJob.entry), TransferMethod::IO_URING);
+      }
+      if (m_tracer != nullptr)
+      {
+        m_tracer->record("copy file", ringJob.start, std::chrono::steady_clock::now(), result.errorCode ? 0 : 1);
+      }
+      ringJobs[result.slot].reset();
+    }
+  }
+}
+
+void CopyExecutor::record(ManifestEntry manifestEntry) {
+  if (manifestEntry.relPath.empty())
+  {
+    return;
+  }
+  const std::lock_guard lock(m_manifestMutex);
+  m_manifestEntries.push_back(std::move(manifestEntry));
+}
+
+} // namespace zotfiles
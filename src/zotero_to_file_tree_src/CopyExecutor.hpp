@@ -0,0 +1,124 @@
+#ifndef ZOTERO_TO_FILE_TREE_COPYEXECUTOR_HPP
+#define ZOTERO_TO_FILE_TREE_COPYEXECUTOR_HPP
+
+#include "BoundedQueue.hpp"
+#include "FileTransfer.hpp"
+#include "Manifest.hpp"
+#include "Trace.hpp"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace zotfiles
+{
+
+class IoUringCopier;
+
+/** @brief Copy of a single pdf file into the output directory tree. */
+struct CopyJob {
+  std::filesystem::path sourceFilePath;        /**< The absolute path to the pdf file in the zotero storage directory. */
+  std::filesystem::path targetFilePath;        /**< The absolute path of the copy. Its directory must exist when the job is submitted. */
+  const std::string* collectionName{nullptr}; /**< Name of the collection of the copy, used in error messages. */
+  std::string relPath;                         /**< Key of the manifest entry. Empty if the copy is not recorded in the manifest. */
+  std::int64_t pdfItemId{};                    /**< Item id of the pdf attachment, recorded in the manifest. */
+  const ManifestEntry* previousEntry{nullptr}; /**< Entry of the previous export for relPath or nullptr. */
+  std::optional<SourceFileStat> sourceFileStat; /**< Metadata of the source pdf file, if already read. Otherwise read by the copy. */
+};
+
+/** @brief Result of writing the pdf files to the output directory. */
+struct WriteSummary {
+  std::size_t writtenPDFs{};       /**< Number of pdf files written. */
+  std::size_t skippedPDFs{};       /**< Number of pdf files skipped because they already existed. */
+  std::size_t unchangedPDFs{};     /**< Number of pdf files of the previous export that did not change. */
+  std::size_t removedPDFs{};       /**< Number of pdf files of the previous export that are not part of the export anymore. */
+  TransferCounts transferCounts{}; /**< Number of written pdf files per TransferMethod. */
+};
+
+/**
+ *\brief Copies pdf files with a fixed number of worker threads.
+ *
+ * Jobs are handed to the workers through a bounded queue, so the producer blocks instead of buffering the whole export in memory. With a
+ * single job the files are copied inline by submit, without any worker thread. With CopyBackend::IO_URING and LinkMode::COPY a single
+ * worker keeps up to queueDepth copies in flight in an IoUringCopier instead, falling back to the worker threads if io_uring is not
+ * available.
+ *
+ * A job with an entry of the previous export is skipped if the source pdf file did not change, see Manifest. The manifest entries of all
+ * files that exist in the output directory after the job are collected for the next export.
+ */
+class CopyExecutor {
+  bool m_overwriteExistingFiles;
+  Tracer* m_tracer;
+  FileTransfer m_fileTransfer;
+  BoundedQueue<CopyJob> m_queue;
+  std::atomic<std::size_t> m_skippedPDFs{0};
+  std::atomic<std::size_t> m_unchangedPDFs{0};
+  std::array<std::atomic<std::size_t>, transferMethodCount> m_transferCounts{};
+  std::mutex m_manifestMutex;
+  std::vector<ManifestEntry> m_manifestEntries;
+  std::unique_ptr<IoUringCopier> m_ring;
+  std::vector<std::jthread> m_workers;
+
+public:
+  /**
+   * @param jobs Number of files that are copied concurrently. Values smaller than 1 are treated as 1.
+   * @param overwriteExistingFiles Replace existing target files instead of skipping them.
+   * @param linkMode How the pdf files are placed into the output directory.
+   * @param tracer If set, every copy is recorded as a span.
+   * @param copyBackend How the file content is copied with LinkMode::COPY.
+   * @param queueDepth Number of copies in flight with CopyBackend::IO_URING.
+   */
+  CopyExecutor(std::size_t jobs,
+               bool overwriteExistingFiles,
+               LinkMode linkMode = LinkMode::COPY,
+               Tracer* tracer = nullptr,
+               CopyBackend copyBackend = CopyBackend::THREADS,
+               std::size_t queueDepth = 64);
+  ~CopyExecutor();
+
+  CopyExecutor(const CopyExecutor&) = delete;
+  CopyExecutor& operator=(const CopyExecutor&) = delete;
+
+  void submit(CopyJob job);
+
+  /**
+   *\brief Waits until all submitted jobs are done.
+   *
+   * @return The number of pdf files written and skipped and how the written files were transferred.
+   */
+  WriteSummary finish();
+
+  /**
+   *\brief The manifest entries of the finished jobs, in no particular order. Call after finish.
+   */
+  [[nodiscard]] std::vector<ManifestEntry> take_manifest_entries();
+
+private:
+  void copy(const CopyJob& job);
+
+  /**
+   *\brief Decides whether the job transfers its file and removes an existing target file. Counts and records the jobs that do not.
+   *
+   * @return The manifest entry of the transferred file, std::nullopt if the job is done.
+   */
+  std::optional<ManifestEntry> prepare_transfer(const CopyJob& job);
+  void transferred(ManifestEntry manifestEntry, TransferMethod transferMethod);
+  void report_failure(const CopyJob& job, const char* message);
+  void record(ManifestEntry manifestEntry);
+
+  /**
+   *\brief The loop of the io_uring worker. Keeps the ring filled from the queue until the queue is closed and all copies finished.
+   */
+  void run_ring();
+};
+
+} // namespace zotfiles
+
+#endif // ZOTERO_TO_FILE_TREE_COPYEXECUTOR_HPP
@@ -0,0 +1,68 @@
+#include "DuplicatePolicy.hpp"
+#include <filesystem>
+#include <fmt/format.h>
+
+namespace zotfiles
+{
+
+std::optional<DuplicatePolicy> parse_duplicate_policy(std::string_view duplicatePolicy) {
+  if (duplicatePolicy == "skip")
+  {
+    return DuplicatePolicy::SKIP;
+  }
+  if (duplicatePolicy == "rename")
+  {
+    return DuplicatePolicy::RENAME;
+  }
+  if (duplicatePolicy == "keep")
+  {
+    return DuplicatePolicy::KEEP;
+  }
+  return std::nullopt;
+}
+
+std::optional<std::string> CollectionPDFNames::add(std::int64_t collectionID, std::string_view pdfName) {
+  if (m_duplicatePolicy == DuplicatePolicy::KEEP)
+  {
+    return std::string(pdfName);
+  }
+
+  std::pmr::unordered_set<std::pmr::string>& pdfNames = m_pdfNames[collectionID];
+  if (pdfNames.emplace(pdfName).second)
+  {
+    return std::string(pdfName);
+  }
+  if (m_duplicatePolicy == DuplicatePolicy::SKIP)
+  {
+    return std::nullopt;
+  }
+
+  const std::filesystem::path pdfNamePath(pdfName);
+  const std::string stem = pdfNamePath.stem().string();
+  const std::string extension = pdfNamePath.extension().string();
+  for (std::size_t suffix = 2;; ++suffix)
+  {
+    std::string renamedPdfName = fmt::format("{} ({}){}", stem, suffix, extension);
+    if (pdfNames.emplace(renamedPdfName).second)
+    {
+      return renamedPdfName;
+    }
+  }
+}
+
+void CollectionPDFNames::reserve(std::int64_t collectionID, std::string_view pdfName) {
+  if (m_duplicatePolicy != DuplicatePolicy::KEEP)
+  {
+    m_pdfNames[collectionID].emplace(pdfName);
+  }
+}
+
+void CollectionPDFNames::release(std::int64_t collectionID, std::string_view pdfName) {
+  auto pdfNamesIter = m_pdfNames.find(collectionID);
+  if (pdfNamesIter != m_pdfNames.end())
+  {
+    pdfNamesIter->second.erase(std::pmr::string(pdfName, m_pdfNames.get_allocator()));
+  }
+}
+
+} // namespace zotfiles
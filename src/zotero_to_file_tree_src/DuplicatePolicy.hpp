@@ -0,0 +1,66 @@
+#ifndef ZOTERO_TO_FILE_TREE_DUPLICATEPOLICY_HPP
+#define ZOTERO_TO_FILE_TREE_DUPLICATEPOLICY_HPP
+
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace zotfiles
+{
+
+/** @brief What happens to a pdf item whose pdf name is already used by another pdf item of the same collection. */
+enum class DuplicatePolicy
+{
+  SKIP,   /**< Only the first pdf item with the name is exported. */
+  RENAME, /**< The pdf item is exported with a " (2)", " (3)", ... suffix before the file extension. */
+  KEEP    /**< No duplicate check. The first pdf item written to the path wins, the others are counted as skipped. */
+};
+
+/**
+ *\brief Parses the value of the --duplicates option: skip, rename or keep.
+ */
+[[nodiscard]] std::optional<DuplicatePolicy> parse_duplicate_policy(std::string_view duplicatePolicy);
+
+/**
+ *\brief Applies the duplicate policy while the pdf items are added to their collections.
+ *
+ * The pdf names are kept in a hash set per collection, so adding a pdf item takes constant time instead of comparing it with every pdf
+ * item of the collection. The hash sets and the names in them are allocated from the given memory resource.
+ */
+class CollectionPDFNames {
+  DuplicatePolicy m_duplicatePolicy;
+  std::pmr::unordered_map<std::int64_t, std::pmr::unordered_set<std::pmr::string>> m_pdfNames;
+
+public:
+  explicit CollectionPDFNames(DuplicatePolicy duplicatePolicy,
+                              std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource())
+      : m_duplicatePolicy(duplicatePolicy)
+      , m_pdfNames(memoryResource) {}
+
+  /**
+   *\brief Registers the pdf name for the collection.
+   *
+   * @return The name the pdf item is exported with or std::nullopt if the pdf item is skipped.
+   */
+  [[nodiscard]] std::optional<std::string> add(std::int64_t collectionID, std::string_view pdfName);
+
+  /**
+   *\brief Registers a pdf name that is already used in the collection, e.g. by a file of the previous export that is kept.
+   *
+   * A pdf item added with the name afterwards is skipped or renamed.
+   */
+  void reserve(std::int64_t collectionID, std::string_view pdfName);
+
+  /**
+   *\brief Frees a pdf name of the collection, e.g. the name of a pdf item that was changed or deleted, so another pdf item can take it.
+   */
+  void release(std::int64_t collectionID, std::string_view pdfName);
+};
+
+} // namespace zotfiles
+
+#endif // ZOTERO_TO_FILE_TREE_DUPLICATEPOLICY_HPP
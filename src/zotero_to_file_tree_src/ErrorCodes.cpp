@@ -14,6 +14,10 @@ std::string ZoteroToFileTreeErrorCategory::message(int ev) const {
   case ErrorCodes::ZOTERO_DB_DOES_NOT_EXIST: return "The zotero library path does not exist";
   case ErrorCodes::ZOTERO_DB_NOT_SUPPORTED: return "The zotero library path does not point to a supported zotero database";
   case ErrorCodes::OUTPUT_DIR_INVALID: return "The output directory path is not valid";
+  case ErrorCodes::WATCH_FAILED: return "Watching the zotero library for changes failed";
+  case ErrorCodes::COLLECTION_NOT_FOUND: return "No collection with the given path was found in the zotero library";
+  case ErrorCodes::LIBRARY_NOT_FOUND: return "No library with the given name or id was found in the zotero library";
+  case ErrorCodes::LIBRARY_EXPORT_FAILED: return "The export of at least one library failed";
   default: return "Unknown ZoteroToFileTree error";
   }
 }
@@ -18,7 +18,11 @@ enum class ErrorCodes
   CLI_PARSE_ERROR,
   ZOTERO_DB_DOES_NOT_EXIST,
   ZOTERO_DB_NOT_SUPPORTED,
-  OUTPUT_DIR_INVALID
+  OUTPUT_DIR_INVALID,
+  WATCH_FAILED,
+  COLLECTION_NOT_FOUND,
+  LIBRARY_NOT_FOUND,
+  LIBRARY_EXPORT_FAILED
 };
 
 class ZoteroToFileTreeErrorCategory : public std::error_category {
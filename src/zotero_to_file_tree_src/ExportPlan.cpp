@@ -0,0 +1,141 @@
+#include "ExportPlan.hpp"
+#include <fmt/format.h>
+#include <iterator>
+
+namespace zotfiles
+{
+
+std::string_view to_string(PlanAction planAction) {
+  switch (planAction)
+  {
+  case PlanAction::MKDIR:
+    return "mkdir";
+  case PlanAction::COPY:
+    return "copy";
+  case PlanAction::LINK:
+    return "link";
+  case PlanAction::SKIP:
+    return "skip";
+  case PlanAction::UNCHANGED:
+    return "unchanged";
+  case PlanAction::REMOVE:
+    return "remove";
+  }
+  return "unknown";
+}
+
+PlanTotals ExportPlan::totals() const {
+  PlanTotals planTotals;
+  for (const PlanOperation& operation: m_operations)
+  {
+    const auto actionIndex = static_cast<std::size_t>(operation.action);
+    ++planTotals.counts[actionIndex];
+    if (operation.sourceFileStat)
+    {
+      planTotals.bytes[actionIndex] += operation.sourceFileStat->size;
+    }
+  }
+  return planTotals;
+}
+
+void ExportPlan::print() const {
+  for (const PlanOperation& operation: m_operations)
+  {
+    if (operation.sourceFileStat)
+    {
+      fmt::print("{:<10} {} ({} bytes)\n", to_string(operation.action), operation.relPath, operation.sourceFileStat->size);
+    }
+    else
+    {
+      fmt::print("{:<10} {}\n", to_string(operation.action), operation.relPath);
+    }
+  }
+
+  const PlanTotals planTotals = totals();
+  fmt::print("\nPlanned operations:\n");
+  for (std::size_t i = 0; i < planActionCount; ++i)
+  {
+    fmt::print("  {:<10} {:>8} {:>16} bytes\n", to_string(static_cast<PlanAction>(i)), planTotals.counts[i], planTotals.bytes[i]);
+  }
+}
+
+namespace
+{
+
+/**
+ *\brief Appends the string as a quoted JSON string. Paths are written as bytes, only quotes, backslashes and control characters are
+ * escaped.
+ */
+void append_json_string(fmt::memory_buffer& buffer, std::string_view value) {
+  buffer.push_back('"');
+  for (const char character: value)
+  {
+    switch (character)
+    {
+    case '"':
+      fmt::format_to(std::back_inserter(buffer), "\\\"");
+      break;
+    case '\\':
+      fmt::format_to(std::back_inserter(buffer), "\\\\");
+      break;
+    case '\n':
+      fmt::format_to(std::back_inserter(buffer), "\\n");
+      break;
+    case '\t':
+      fmt::format_to(std::back_inserter(buffer), "\\t");
+      break;
+    default:
+      if (static_cast<unsigned char>(character) < 0x20)
+      {
+        fmt::format_to(std::back_inserter(buffer), "\\u{:04x}", static_cast<unsigned int>(character));
+      }
+      else
+      {
+        buffer.push_back(character);
+      }
+    }
+  }
+  buffer.push_back('"');
+}
+
+} // namespace
+
+void ExportPlan::write_jsonl(std::ostream& stream) const {
+  fmt::memory_buffer buffer;
+  for (const PlanOperation& operation: m_operations)
+  {
+    fmt::format_to(std::back_inserter(buffer), "{{\"op\":\"{}\",\"path\":", to_string(operation.action));
+    append_json_string(buffer, operation.relPath);
+    if (operation.pdfItem)
+    {
+      fmt::format_to(std::back_inserter(buffer), ",\"source\":");
+      append_json_string(buffer, operation.pdfItem->pdfFilePath.string());
+      fmt::format_to(std::back_inserter(buffer), ",\"item\":{}", operation.pdfItem->pdfItemId);
+    }
+    else if (operation.previousEntry)
+    {
+      fmt::format_to(std::back_inserter(buffer), ",\"item\":{}", operation.previousEntry->pdfItemId);
+    }
+    if (operation.sourceFileStat)
+    {
+      fmt::format_to(std::back_inserter(buffer), ",\"bytes\":{}", operation.sourceFileStat->size);
+    }
+    fmt::format_to(std::back_inserter(buffer), "}}\n");
+  }
+
+  const PlanTotals planTotals = totals();
+  fmt::format_to(std::back_inserter(buffer), "{{\"op\":\"totals\"");
+  for (std::size_t i = 0; i < planActionCount; ++i)
+  {
+    fmt::format_to(std::back_inserter(buffer), ",\"{}\":{}", to_string(static_cast<PlanAction>(i)), planTotals.counts[i]);
+  }
+  for (std::size_t i = 0; i < planActionCount; ++i)
+  {
+    fmt::format_to(std::back_inserter(buffer), ",\"{}Bytes\":{}", to_string(static_cast<PlanAction>(i)), planTotals.bytes[i]);
+  }
+  fmt::format_to(std::back_inserter(buffer), "}}\n");
+
+  stream.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+}
+
+} // namespace zotfiles
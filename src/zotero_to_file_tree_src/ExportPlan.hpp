@@ -0,0 +1,79 @@
+#ifndef ZOTERO_TO_FILE_TREE_EXPORTPLAN_HPP
+#define ZOTERO_TO_FILE_TREE_EXPORTPLAN_HPP
+
+#include "CollectionPDFItem.hpp"
+#include "Manifest.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace zotfiles
+{
+
+/**
+ *\brief What an export does with a path of the output directory.
+ */
+enum class PlanAction
+{
+  MKDIR,     /**< Create the directory of a collection. */
+  COPY,      /**< Copy the pdf file. Also used for reflinks and LinkMode::AUTO, which fall back to a copy. */
+  LINK,      /**< Hard link or symbolic link the pdf file. */
+  SKIP,      /**< Keep a file that exists but was not written by a previous export, or a duplicate path of this export. */
+  UNCHANGED, /**< Keep the file of the previous export, its source pdf file did not change. */
+  REMOVE     /**< Remove the file of the previous export, it is not part of the export anymore. */
+};
+
+inline constexpr std::size_t planActionCount = 6;
+
+[[nodiscard]] std::string_view to_string(PlanAction planAction);
+
+/** @brief A single operation of an ExportPlan. */
+struct PlanOperation {
+  PlanAction action{PlanAction::MKDIR};
+  std::string relPath;                          /**< Path relative to the output directory, in generic format. */
+  const CollectionPDFItem* pdfItem{nullptr};    /**< The pdf item of a file operation, nullptr for MKDIR and REMOVE. */
+  const std::string* collectionName{nullptr};   /**< Name of the collection of a file operation, used in error messages. */
+  const ManifestEntry* previousEntry{nullptr};  /**< Entry of the previous export for relPath or nullptr. */
+  std::optional<SourceFileStat> sourceFileStat; /**< Size and modification time of the source pdf file, if it could be read. */
+};
+
+/** @brief Number of operations and bytes of the source files per PlanAction, indexed by the enum value. */
+struct PlanTotals {
+  std::array<std::size_t, planActionCount> counts{};
+  std::array<std::uint64_t, planActionCount> bytes{};
+};
+
+/**
+ *\brief The operations of an export in the order they are executed.
+ *
+ * The directory of a file is created before the file. The operations refer to the pdf items of the collection tree and to the manifest of
+ * the previous export, see OutputDirWriter.
+ */
+class ExportPlan {
+  std::vector<PlanOperation> m_operations;
+
+public:
+  void add(PlanOperation operation) { m_operations.push_back(std::move(operation)); }
+
+  [[nodiscard]] const std::vector<PlanOperation>& operations() const { return m_operations; }
+  [[nodiscard]] PlanTotals totals() const;
+
+  /**
+   *\brief Prints one line per operation and the totals.
+   */
+  void print() const;
+
+  /**
+   *\brief Writes one JSON object per line and operation. The last line holds the totals.
+   */
+  void write_jsonl(std::ostream& stream) const;
+};
+
+} // namespace zotfiles
+
+#endif // ZOTERO_TO_FILE_TREE_EXPORTPLAN_HPP
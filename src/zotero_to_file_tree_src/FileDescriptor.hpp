@@ -0,0 +1,32 @@
+#ifndef ZOTERO_TO_FILE_TREE_FILEDESCRIPTOR_HPP
+#define ZOTERO_TO_FILE_TREE_FILEDESCRIPTOR_HPP
+
+#include <unistd.h>
+
+namespace zotfiles
+{
+
+/** @brief Owns a posix file descriptor and closes it on destruction. */
+class FileDescriptor {
+  int m_fd{-1};
+
+public:
+  explicit FileDescriptor(int fd)
+      : m_fd(fd) {}
+  ~FileDescriptor() {
+    if (m_fd >= 0)
+    {
+      ::close(m_fd);
+    }
+  }
+
+  FileDescriptor(const FileDescriptor&) = delete;
+  FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+  [[nodiscard]] int get() const { return m_fd; }
+  [[nodiscard]] bool valid() const { return m_fd >= 0; }
+};
+
+} // namespace zotfiles
+
+#endif // ZOTERO_TO_FILE_TREE_FILEDESCRIPTOR_HPP
@@ -0,0 +1,343 @@
+#include "FileTransfer.hpp"
+#include "Manifest.hpp"
+#include <system_error>
+
+#if defined(__linux__)
+#include "FileDescriptor.hpp"
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <memory>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace zotfiles
+{
+
+std::optional<LinkMode> parse_link_mode(std::string_view linkMode) {
+  if (linkMode == "copy")
+  {
+    return LinkMode::COPY;
+  }
+  if (linkMode == "hardlink")
+  {
+    return LinkMode::HARDLINK;
+  }
+  if (linkMode == "symlink")
+  {
+    return LinkMode::SYMLINK;
+  }
+  if (linkMode == "reflink")
+  {
+    return LinkMode::REFLINK;
+  }
+  if (linkMode == "auto")
+  {
+    return LinkMode::AUTO;
+  }
+  return std::nullopt;
+}
+
+std::optional<CopyBackend> parse_copy_backend(std::string_view copyBackend) {
+  if (copyBackend == "threads")
+  {
+    return CopyBackend::THREADS;
+  }
+  if (copyBackend == "io_uring")
+  {
+    return CopyBackend::IO_URING;
+  }
+  return std::nullopt;
+}
+
+std::string_view to_string(LinkMode linkMode) {
+  switch (linkMode)
+  {
+  case LinkMode::COPY: return "copy";
+  case LinkMode::HARDLINK: return "hardlink";
+  case LinkMode::SYMLINK: return "symlink";
+  case LinkMode::REFLINK: return "reflink";
+  case LinkMode::AUTO: return "auto";
+  }
+  return "";
+}
+
+std::string_view to_string(TransferMethod transferMethod) {
+  switch (transferMethod)
+  {
+  case TransferMethod::REFLINK: return "reflink";
+  case TransferMethod::HARDLINK: return "hardlink";
+  case TransferMethod::SYMLINK: return "symlink";
+  case TransferMethod::COPY_FILE_RANGE: return "copy_file_range";
+  case TransferMethod::BUFFERED_COPY: return "buffered copy";
+  case TransferMethod::IO_URING: return "io_uring";
+  }
+  return "unknown";
+}
+
+namespace
+{
+
+#if defined(__linux__)
+
+std::error_code last_error() {
+  return {errno, std::generic_category()};
+}
+
+/**
+ *\brief The opened source file and the newly created target file. The target file is removed again unless commit() is called.
+ */
+class OpenedTransfer {
+  const std::filesystem::path& m_targetFilePath;
+  bool m_committed{false};
+
+public:
+  FileDescriptor source;
+  FileDescriptor target;
+  std::error_code errorCode;
+
+  OpenedTransfer(const std::filesystem::path& sourceFilePath, const std::filesystem::path& targetFilePath)
+      : m_targetFilePath(targetFilePath)
+      , source(::open(sourceFilePath.c_str(), O_RDONLY | O_CLOEXEC))
+      , target(open_target(source, targetFilePath)) {
+    if (!target.valid())
+    {
+      errorCode = last_error();
+      m_committed = true;
+    }
+  }
+  ~OpenedTransfer() {
+    if (!m_committed)
+    {
+      ::unlink(m_targetFilePath.c_str());
+    }
+  }
+
+  OpenedTransfer(const OpenedTransfer&) = delete;
+  OpenedTransfer& operator=(const OpenedTransfer&) = delete;
+
+  void commit() { m_committed = true; }
+
+private:
+  /** @brief Creates the target file with the permissions of the source file. Returns -1 and sets errno on failure. */
+  static int open_target(const FileDescriptor& source, const std::filesystem::path& targetFilePath) {
+    struct stat sourceStat{};
+    if (!source.valid() || ::fstat(source.get(), &sourceStat) != 0)
+    {
+      return -1;
+    }
+    return ::open(targetFilePath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, sourceStat.st_mode & 07777);
+  }
+};
+
+std::error_code reflink(const std::filesystem::path& sourceFilePath, const std::filesystem::path& targetFilePath) {
+  OpenedTransfer transfer(sourceFilePath, targetFilePath);
+  if (transfer.errorCode)
+  {
+    return transfer.errorCode;
+  }
+  if (::ioctl(transfer.target.get(), FICLONE, transfer.source.get()) != 0)
+  {
+    return last_error();
+  }
+  transfer.commit();
+  return {};
+}
+
+std::error_code buffered_copy(int sourceFd, int targetFd, ContentHasher* contentHasher) {
+  static constexpr std::size_t bufferSize = 128 * 1024;
+  const auto buffer = std::make_unique_for_overwrite<char[]>(bufferSize);
+  while (true)
+  {
+    const ssize_t readBytes = ::read(sourceFd, buffer.get(), bufferSize);
+    if (readBytes < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return last_error();
+    }
+    if (readBytes == 0)
+    {
+      return {};
+    }
+    if (contentHasher)
+    {
+      contentHasher->update(buffer.get(), static_cast<std::size_t>(readBytes));
+    }
+
+    ssize_t writtenBytes = 0;
+    while (writtenBytes < readBytes)
+    {
+      const ssize_t written = ::write(targetFd, buffer.get() + writtenBytes, static_cast<std::size_t>(readBytes - writtenBytes));
+      if (written < 0)
+      {
+        if (errno == EINTR)
+        {
+          continue;
+        }
+        return last_error();
+      }
+      writtenBytes += written;
+    }
+  }
+}
+
+/**
+ *\brief Copies the file content with copy_file_range and falls back to a buffered copy if the kernel or file system does not support it.
+ *
+ * @param contentHash If set, receives the content_hash of a buffered copy, 0 for a copy with copy_file_range.
+ */
+std::error_code copy_content(const std::filesystem::path& sourceFilePath,
+                             const std::filesystem::path& targetFilePath,
+                             TransferMethod& transferMethod,
+                             std::uint64_t* contentHash) {
+  OpenedTransfer transfer(sourceFilePath, targetFilePath);
+  if (transfer.errorCode)
+  {
+    return transfer.errorCode;
+  }
+
+  transferMethod = TransferMethod::COPY_FILE_RANGE;
+  bool copiedAnyBytes = false;
+  while (true)
+  {
+    const ssize_t copiedBytes = ::copy_file_range(transfer.source.get(), nullptr, transfer.target.get(), nullptr, 1 << 30, 0);
+    if (copiedBytes > 0)
+    {
+      copiedAnyBytes = true;
+      continue;
+    }
+    if (copiedBytes == 0)
+    {
+      transfer.commit();
+      return {};
+    }
+    if (errno == EINTR)
+    {
+      continue;
+    }
+    const bool unsupported = errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP;
+    if (!unsupported || copiedAnyBytes)
+    {
+      return last_error();
+    }
+    break;
+  }
+
+  transferMethod = TransferMethod::BUFFERED_COPY;
+  ContentHasher contentHasher;
+  if (std::error_code errorCode = buffered_copy(transfer.source.get(), transfer.target.get(), contentHash ? &contentHasher : nullptr))
+  {
+    return errorCode;
+  }
+  if (contentHash)
+  {
+    *contentHash = contentHasher.finish();
+  }
+  transfer.commit();
+  return {};
+}
+
+#else
+
+std::error_code reflink(const std::filesystem::path&, const std::filesystem::path&) {
+  return std::make_error_code(std::errc::operation_not_supported);
+}
+
+std::error_code copy_content(const std::filesystem::path& sourceFilePath,
+                             const std::filesystem::path& targetFilePath,
+                             TransferMethod& transferMethod,
+                             std::uint64_t*) {
+  transferMethod = TransferMethod::BUFFERED_COPY;
+  std::error_code errorCode;
+  std::filesystem::copy_file(sourceFilePath, targetFilePath, errorCode);
+  return errorCode;
+}
+
+#endif
+
+/**
+ *\brief True if the error means that the method can not work for any file of the export, e.g. output on another file system.
+ */
+bool is_unsupported(std::error_code errorCode) {
+  return errorCode == std::errc::operation_not_supported || errorCode == std::errc::cross_device_link ||
+         errorCode == std::errc::invalid_argument || errorCode == std::errc::inappropriate_io_control_operation ||
+         errorCode == std::errc::function_not_supported || errorCode == std::errc::operation_not_permitted;
+}
+
+[[noreturn]] void throw_transfer_error(std::string_view what,
+                                       const std::filesystem::path& sourceFilePath,
+                                       const std::filesystem::path& targetFilePath,
+                                       std::error_code errorCode) {
+  throw std::filesystem::filesystem_error(std::string(what), sourceFilePath, targetFilePath, errorCode);
+}
+
+} // namespace
+
+TransferMethod FileTransfer::transfer(const std::filesystem::path& sourceFilePath,
+                                      const std::filesystem::path& targetFilePath,
+                                      std::uint64_t* contentHash) {
+  if (contentHash)
+  {
+    *contentHash = 0;
+  }
+  std::error_code errorCode;
+  TransferMethod transferMethod{};
+  switch (m_linkMode)
+  {
+  case LinkMode::REFLINK:
+    errorCode = reflink(sourceFilePath, targetFilePath);
+    if (errorCode)
+    {
+      throw_transfer_error("reflink", sourceFilePath, targetFilePath, errorCode);
+    }
+    return TransferMethod::REFLINK;
+  case LinkMode::HARDLINK:
+    std::filesystem::create_hard_link(sourceFilePath, targetFilePath);
+    return TransferMethod::HARDLINK;
+  case LinkMode::SYMLINK:
+    // A relative target would resolve against the directory of the link in the output directory.
+    std::filesystem::create_symlink(std::filesystem::absolute(sourceFilePath), targetFilePath);
+    return TransferMethod::SYMLINK;
+  case LinkMode::AUTO:
+    if (!m_reflinkUnsupported.load(std::memory_order_relaxed))
+    {
+      errorCode = reflink(sourceFilePath, targetFilePath);
+      if (!errorCode)
+      {
+        return TransferMethod::REFLINK;
+      }
+      if (is_unsupported(errorCode))
+      {
+        m_reflinkUnsupported.store(true, std::memory_order_relaxed);
+      }
+    }
+    if (!m_hardlinkUnsupported.load(std::memory_order_relaxed))
+    {
+      std::filesystem::create_hard_link(sourceFilePath, targetFilePath, errorCode);
+      if (!errorCode)
+      {
+        return TransferMethod::HARDLINK;
+      }
+      if (is_unsupported(errorCode))
+      {
+        m_hardlinkUnsupported.store(true, std::memory_order_relaxed);
+      }
+    }
+    [[fallthrough]];
+  case LinkMode::COPY:
+    errorCode = copy_content(sourceFilePath, targetFilePath, transferMethod, contentHash);
+    if (errorCode)
+    {
+      throw_transfer_error("copy", sourceFilePath, targetFilePath, errorCode);
+    }
+    return transferMethod;
+  }
+  return transferMethod;
+}
+
+} // namespace zotfiles
@@ -0,0 +1,108 @@
+#ifndef ZOTERO_TO_FILE_TREE_FILETRANSFER_HPP
+#define ZOTERO_TO_FILE_TREE_FILETRANSFER_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+
+namespace zotfiles
+{
+
+/**
+ *\brief How the pdf files are placed into the output directory.
+ */
+enum class LinkMode
+{
+  COPY,     /**< Copy the file content, in kernel with copy_file_range where possible. */
+  HARDLINK, /**< Hard link the file in the zotero storage. Source and output must be on the same file system. */
+  SYMLINK,  /**< Symbolic link to the file in the zotero storage. */
+  REFLINK,  /**< Copy on write clone of the file. Requires a file system with reflink support, e.g. btrfs or xfs. */
+  AUTO      /**< Try reflink, hardlink, copy_file_range and a buffered copy, in that order. */
+};
+
+/**
+ *\brief How the copy workers copy the file content with LinkMode::COPY.
+ */
+enum class CopyBackend
+{
+  THREADS, /**< Every copy worker copies one file at a time with blocking system calls. */
+  IO_URING /**< One thread keeps many copies in flight in an io_uring. Falls back to THREADS if io_uring is not available. */
+};
+
+/**
+ *\brief The way a single file was actually transferred.
+ */
+enum class TransferMethod
+{
+  REFLINK,
+  HARDLINK,
+  SYMLINK,
+  COPY_FILE_RANGE,
+  BUFFERED_COPY,
+  IO_URING
+};
+
+inline constexpr std::size_t transferMethodCount = 6;
+
+/**
+ *\brief Number of transferred files per TransferMethod, indexed by the enum value.
+ */
+using TransferCounts = std::array<std::size_t, transferMethodCount>;
+
+/**
+ *\brief Parses the value of the --link-mode option. Returns std::nullopt for unknown values.
+ */
+[[nodiscard]] std::optional<LinkMode> parse_link_mode(std::string_view linkMode);
+
+/**
+ *\brief Parses the value of the --copy-backend option. Returns std::nullopt for unknown values.
+ */
+[[nodiscard]] std::optional<CopyBackend> parse_copy_backend(std::string_view copyBackend);
+
+/**
+ *\brief Returns the value of the --link-mode option for the link mode, see parse_link_mode.
+ */
+[[nodiscard]] std::string_view to_string(LinkMode linkMode);
+
+[[nodiscard]] std::string_view to_string(TransferMethod transferMethod);
+
+/**
+ *\brief Places files into the output directory with a fixed link mode.
+ *
+ * With LinkMode::AUTO a reflink or hardlink that fails because the file system or the pair of directories does not support it is not
+ * tried again for later files, so an export to another file system does not pay for a failed attempt per file. The methods can be
+ * called concurrently.
+ */
+class FileTransfer {
+  LinkMode m_linkMode;
+  std::atomic<bool> m_reflinkUnsupported{false};
+  std::atomic<bool> m_hardlinkUnsupported{false};
+
+public:
+  explicit FileTransfer(LinkMode linkMode)
+      : m_linkMode(linkMode) {}
+
+  [[nodiscard]] LinkMode link_mode() const { return m_linkMode; }
+
+  /**
+   *\brief Creates targetFilePath from sourceFilePath.
+   *
+   * The target file must not exist. A partially written target file is removed before the error is reported.
+   *
+   * @param contentHash If set, receives the content_hash of the data of a buffered copy, which is computed while the data is copied. Set
+   * to 0 for the other methods, which do not read the data in user space.
+   * @throws std::filesystem::filesystem_error if the file could not be transferred with the link mode.
+   * @return The method that was used to transfer the file.
+   */
+  TransferMethod transfer(const std::filesystem::path& sourceFilePath,
+                          const std::filesystem::path& targetFilePath,
+                          std::uint64_t* contentHash = nullptr);
+};
+
+} // namespace zotfiles
+
+#endif // ZOTERO_TO_FILE_TREE_FILETRANSFER_HPP
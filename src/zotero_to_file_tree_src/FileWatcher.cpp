@@ -0,0 +1,216 @@
+#include "FileWatcher.hpp"
+#include <algorithm>
+#include <fmt/format.h>
+
+#if defined(__linux__)
+#include "FileDescriptor.hpp"
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unordered_map>
+#else
+#include <thread>
+#endif
+
+namespace zotfiles
+{
+
+#if defined(__linux__)
+
+struct FileWatcher::Impl {
+  FileDescriptor inotifyFd{::inotify_init1(IN_CLOEXEC)};
+  std::unordered_map<int, WatchedDir> watches;
+
+  /**
+   *\brief Waits up to timeout for events and reads them. A negative timeout waits forever.
+   *
+   * @return 1 if a relevant event was read, 0 on timeout or irrelevant events only and -1 on error or if no watched directory is left.
+   */
+  int read_events(int timeoutMs) {
+    pollfd pollFd{inotifyFd.get(), POLLIN, 0};
+    const int ready = ::poll(&pollFd, 1, timeoutMs);
+    if (ready < 0)
+    {
+      return errno == EINTR ? 0 : -1;
+    }
+    if (ready == 0)
+    {
+      return 0;
+    }
+
+    alignas(inotify_event) std::array<char, 16 * 1024> buffer;
+    const ssize_t readBytes = ::read(inotifyFd.get(), buffer.data(), buffer.size());
+    if (readBytes <= 0)
+    {
+      return errno == EINTR ? 0 : -1;
+    }
+
+    bool relevant = false;
+    for (ssize_t offset = 0; offset < readBytes;)
+    {
+      inotify_event event{};
+      std::memcpy(&event, buffer.data() + offset, sizeof(event));
+      const char* namePtr = buffer.data() + offset + sizeof(inotify_event);
+      offset += static_cast<ssize_t>(sizeof(inotify_event) + event.len);
+
+      // An overflowed event queue lost events, so a change may have been missed.
+      if ((event.mask & IN_Q_OVERFLOW) != 0)
+      {
+        relevant = true;
+        continue;
+      }
+      auto watchIter = watches.find(event.wd);
+      if (watchIter == watches.end())
+      {
+        continue;
+      }
+      // The watch was removed because the watched directory was deleted or its file system unmounted.
+      if ((event.mask & IN_IGNORED) != 0)
+      {
+        watches.erase(watchIter);
+        continue;
+      }
+      // Events of the watched directory itself have no name. The name is padded with null bytes up to len.
+      const std::string_view name = event.len > 0 ? std::string_view(namePtr) : std::string_view();
+      const std::vector<std::string>& fileNames = watchIter->second.fileNames;
+      if (fileNames.empty() || std::find(fileNames.begin(), fileNames.end(), name) != fileNames.end())
+      {
+        relevant = true;
+      }
+    }
+    if (watches.empty())
+    {
+      return -1;
+    }
+    return relevant ? 1 : 0;
+  }
+};
+
+FileWatcher::FileWatcher(std::vector<WatchedDir> watchedDirs)
+    : m_impl(std::make_unique<Impl>()) {
+  if (!m_impl->inotifyFd.valid())
+  {
+    fmt::print("Could not initialize inotify: {}\n", std::strerror(errno));
+    return;
+  }
+
+  static constexpr std::uint32_t watchMask = IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+  for (WatchedDir& watchedDir: watchedDirs)
+  {
+    const int watchDescriptor = ::inotify_add_watch(m_impl->inotifyFd.get(), watchedDir.dirPath.c_str(), watchMask);
+    if (watchDescriptor < 0)
+    {
+      fmt::print("Could not watch the directory: {}\n", watchedDir.dirPath.string());
+      continue;
+    }
+    m_impl->watches.emplace(watchDescriptor, std::move(watchedDir));
+  }
+}
+
+bool FileWatcher::wait_for_changes(std::chrono::milliseconds debounce) {
+  if (!m_impl->inotifyFd.valid() || m_impl->watches.empty())
+  {
+    return false;
+  }
+
+  int result = 0;
+  while (result == 0)
+  {
+    result = m_impl->read_events(-1);
+  }
+  // poll takes the timeout as int milliseconds.
+  const int debounceMs = static_cast<int>(std::clamp<std::chrono::milliseconds::rep>(debounce.count(), 0, std::numeric_limits<int>::max()));
+  while (result == 1)
+  {
+    result = m_impl->read_events(debounceMs);
+  }
+  return result == 0;
+}
+
+#else
+
+struct FileWatcher::Impl {
+  std::vector<std::filesystem::path> watchedDirPaths;
+  std::vector<std::filesystem::path> watchedPaths;
+
+  [[nodiscard]] std::vector<std::filesystem::file_time_type> modification_times() const {
+    std::vector<std::filesystem::file_time_type> modificationTimes;
+    modificationTimes.reserve(watchedPaths.size());
+    for (const auto& watchedPath: watchedPaths)
+    {
+      std::error_code errorCode;
+      modificationTimes.push_back(std::filesystem::last_write_time(watchedPath, errorCode));
+    }
+    return modificationTimes;
+  }
+
+  [[nodiscard]] bool any_watched_dir_exists() const {
+    return std::any_of(watchedDirPaths.begin(),
+                       watchedDirPaths.end(),
+                       [](const std::filesystem::path& dirPath)
+                       {
+                         std::error_code errorCode;
+                         return std::filesystem::is_directory(dirPath, errorCode);
+                       });
+  }
+};
+
+FileWatcher::FileWatcher(std::vector<WatchedDir> watchedDirs)
+    : m_impl(std::make_unique<Impl>()) {
+  for (const WatchedDir& watchedDir: watchedDirs)
+  {
+    std::error_code errorCode;
+    if (!std::filesystem::is_directory(watchedDir.dirPath, errorCode))
+    {
+      fmt::print("Could not watch the directory: {}\n", watchedDir.dirPath.string());
+      continue;
+    }
+    m_impl->watchedDirPaths.push_back(watchedDir.dirPath);
+    if (watchedDir.fileNames.empty())
+    {
+      m_impl->watchedPaths.push_back(watchedDir.dirPath);
+    }
+    for (const std::string& fileName: watchedDir.fileNames)
+    {
+      m_impl->watchedPaths.push_back(watchedDir.dirPath / fileName);
+    }
+  }
+}
+
+bool FileWatcher::wait_for_changes(std::chrono::milliseconds debounce) {
+  static constexpr std::chrono::seconds pollInterval{1};
+  if (m_impl->watchedPaths.empty())
+  {
+    return false;
+  }
+  auto modificationTimes = m_impl->modification_times();
+  while (m_impl->modification_times() == modificationTimes)
+  {
+    std::this_thread::sleep_for(pollInterval);
+  }
+  if (!m_impl->any_watched_dir_exists())
+  {
+    return false;
+  }
+
+  modificationTimes = m_impl->modification_times();
+  while (true)
+  {
+    std::this_thread::sleep_for(std::max<std::chrono::milliseconds>(debounce, pollInterval));
+    auto currentModificationTimes = m_impl->modification_times();
+    if (currentModificationTimes == modificationTimes)
+    {
+      return true;
+    }
+    modificationTimes = std::move(currentModificationTimes);
+  }
+}
+
+#endif
+
+FileWatcher::~FileWatcher() = default;
+
+} // namespace zotfiles
@@ -0,0 +1,52 @@
+#ifndef ZOTERO_TO_FILE_TREE_FILEWATCHER_HPP
+#define ZOTERO_TO_FILE_TREE_FILEWATCHER_HPP
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace zotfiles
+{
+
+/** @brief A directory watched by the FileWatcher. */
+struct WatchedDir {
+  std::filesystem::path dirPath;      /**< Absolute path of the watched directory. */
+  std::vector<std::string> fileNames; /**< Only changes of these entries are reported. Changes of every entry if empty. */
+};
+
+/**
+ *\brief Blocks until the watched directories change.
+ *
+ * On linux the directories are watched with inotify. The watches are not recursive, changes in subdirectories are not reported. On other
+ * platforms the modification times of the watched directories and files are polled once per second.
+ */
+class FileWatcher {
+  struct Impl;
+  std::unique_ptr<Impl> m_impl;
+
+public:
+  /**
+   * @param watchedDirs The directories to watch. Directories that do not exist are ignored.
+   */
+  explicit FileWatcher(std::vector<WatchedDir> watchedDirs);
+  ~FileWatcher();
+
+  FileWatcher(const FileWatcher&) = delete;
+  FileWatcher& operator=(const FileWatcher&) = delete;
+
+  /**
+   *\brief Waits for the next burst of changes.
+   *
+   * Returns after the first reported change was followed by a quiet period of the given length, so a burst of changes, e.g. the writes of
+   * a zotero sync, is reported once.
+   *
+   * @return False if the watcher failed and no further changes can be reported, e.g. because all watched directories were deleted.
+   */
+  bool wait_for_changes(std::chrono::milliseconds debounce);
+};
+
+} // namespace zotfiles
+
+#endif // ZOTERO_TO_FILE_TREE_FILEWATCHER_HPP
@@ -0,0 +1,144 @@
+#include "FlatCollectionTree.hpp"
+#include <limits>
+
+namespace zotfiles
+{
+
+FlatCollectionTree FlatCollectionTree::build(std::unordered_map<std::int64_t, std::shared_ptr<CollectionNode>> collectionNodes) {
+  std::vector<ZoteroCollection> collections;
+  collections.reserve(collectionNodes.size());
+  std::vector<std::pair<std::uint32_t, CollectionPDFItem>> pdfItems;
+  for (auto& [collectionID, collectionNode]: collectionNodes)
+  {
+    const auto collectionIndex = static_cast<std::uint32_t>(collections.size());
+    collections.push_back(
+        ZoteroCollection{collectionNode->collectionID, collectionNode->parentCollectionID, collectionNode->collectionName});
+    for (CollectionPDFItem& pdfItem: collectionNode->collectionPDFItems)
+    {
+      pdfItems.emplace_back(collectionIndex, std::move(pdfItem));
+    }
+    collectionNode->collectionPDFItems.clear();
+  }
+  return build(collections, std::move(pdfItems));
+}
+
+FlatCollectionTree FlatCollectionTree::build(std::span<const ZoteroCollection> collections,
+                                             std::vector<std::pair<std::uint32_t, CollectionPDFItem>> pdfItems) {
+  std::unordered_map<std::int64_t, std::vector<std::uint32_t>> childrenByParentID;
+  for (std::uint32_t collectionIndex = 0; collectionIndex < collections.size(); ++collectionIndex)
+  {
+    childrenByParentID[collections[collectionIndex].parentCollectionID].push_back(collectionIndex);
+  }
+
+  FlatCollectionTree collectionTree;
+  collectionTree.m_nodes.reserve(collections.size());
+  collectionTree.m_nodeIndex.reserve(collections.size());
+
+  // Index of the node of every collection, noNode for the collections that are not part of the tree.
+  constexpr std::uint32_t noNode = std::numeric_limits<std::uint32_t>::max();
+  std::vector<std::uint32_t> nodeIndices(collections.size(), noNode);
+  auto appendChildren = [&collectionTree, &childrenByParentID, &nodeIndices, collections](std::int64_t parentCollectionID)
+  {
+    auto childrenIter = childrenByParentID.find(parentCollectionID);
+    if (childrenIter == childrenByParentID.end())
+    {
+      return std::uint32_t{0};
+    }
+    for (const std::uint32_t collectionIndex: childrenIter->second)
+    {
+      const ZoteroCollection& collection = collections[collectionIndex];
+      nodeIndices[collectionIndex] = static_cast<std::uint32_t>(collectionTree.m_nodes.size());
+      collectionTree.m_nodeIndex.emplace(collection.collectionID, nodeIndices[collectionIndex]);
+      collectionTree.m_nodes.push_back(
+          FlatCollectionNode{collection.collectionID, collection.parentCollectionID, collection.collectionName});
+    }
+    return static_cast<std::uint32_t>(childrenIter->second.size());
+  };
+
+  // The node array is the queue of the breadth-first traversal.
+  collectionTree.m_rootCount = appendChildren(-1);
+  for (std::size_t nodeIndex = 0; nodeIndex < collectionTree.m_nodes.size(); ++nodeIndex)
+  {
+    collectionTree.m_nodes[nodeIndex].firstChild = static_cast<std::uint32_t>(collectionTree.m_nodes.size());
+    collectionTree.m_nodes[nodeIndex].childCount = appendChildren(collectionTree.m_nodes[nodeIndex].collectionID);
+  }
+
+  // The pdf items are sorted into the pool by the node order with a counting sort. The pool is filled in order, so every pdf item is
+  // moved once into its place.
+  for (const auto& [collectionIndex, pdfItem]: pdfItems)
+  {
+    if (nodeIndices[collectionIndex] != noNode)
+    {
+      ++collectionTree.m_nodes[nodeIndices[collectionIndex]].pdfItemCount;
+    }
+  }
+  std::uint32_t pdfItemCount = 0;
+  for (FlatCollectionNode& node: collectionTree.m_nodes)
+  {
+    node.firstPDFItem = pdfItemCount;
+    pdfItemCount += node.pdfItemCount;
+  }
+  std::vector<std::uint32_t> nextPDFItems(collectionTree.m_nodes.size());
+  std::vector<std::uint32_t> sourceIndices(pdfItemCount);
+  for (std::uint32_t sourceIndex = 0; sourceIndex < pdfItems.size(); ++sourceIndex)
+  {
+    const std::uint32_t nodeIndex = nodeIndices[pdfItems[sourceIndex].first];
+    if (nodeIndex != noNode)
+    {
+      sourceIndices[collectionTree.m_nodes[nodeIndex].firstPDFItem + nextPDFItems[nodeIndex]++] = sourceIndex;
+    }
+  }
+  collectionTree.m_pdfItems.reserve(pdfItemCount);
+  for (const std::uint32_t sourceIndex: sourceIndices)
+  {
+    collectionTree.m_pdfItems.push_back(std::move(pdfItems[sourceIndex].second));
+  }
+
+  return collectionTree;
+}
+
+const FlatCollectionNode* FlatCollectionTree::find(std::int64_t collectionID) const {
+  auto findIter = m_nodeIndex.find(collectionID);
+  return findIter != m_nodeIndex.end() ? &m_nodes[findIter->second] : nullptr;
+}
+
+std::vector<std::filesystem::path> FlatCollectionTree::rel_dir_paths() const {
+  // A parent is stored before its children, so the directory path of the parent is always known.
+  std::vector<std::filesystem::path> relDirPaths(m_nodes.size());
+  for (std::uint32_t rootIndex = 0; rootIndex < m_rootCount; ++rootIndex)
+  {
+    relDirPaths[rootIndex] = m_nodes[rootIndex].collectionName;
+  }
+
+  for (std::size_t nodeIndex = 0; nodeIndex < m_nodes.size(); ++nodeIndex)
+  {
+    const FlatCollectionNode& node = m_nodes[nodeIndex];
+    for (std::uint32_t childIndex = node.firstChild; childIndex < node.firstChild + node.childCount; ++childIndex)
+    {
+      relDirPaths[childIndex] = relDirPaths[nodeIndex] / m_nodes[childIndex].collectionName;
+    }
+  }
+  return relDirPaths;
+}
+
+void FlatCollectionTree::plan_pdfs(OutputDirWriter& outputDirWriter) const {
+  const std::vector<std::filesystem::path> relDirPaths = rel_dir_paths();
+  for (std::size_t nodeIndex = 0; nodeIndex < m_nodes.size(); ++nodeIndex)
+  {
+    outputDirWriter.plan_directory(relDirPaths[nodeIndex], m_nodes[nodeIndex].collectionName, pdf_items(m_nodes[nodeIndex]));
+  }
+}
+
+WriteSummary FlatCollectionTree::write_pdfs(std::filesystem::path outputDir,
+                                            const WriteOptions& writeOptions,
+                                            Manifest* writtenManifest) const {
+  OutputDirWriter outputDirWriter(std::move(outputDir), writeOptions);
+  {
+    TraceSpan traceSpan(writeOptions.tracer, "plan");
+    plan_pdfs(outputDirWriter);
+    traceSpan.set_item_count(outputDirWriter.finish_plan().operations().size());
+  }
+  return outputDirWriter.execute(writtenManifest);
+}
+
+} // namespace zotfiles
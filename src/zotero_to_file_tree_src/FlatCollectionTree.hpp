@@ -0,0 +1,90 @@
+#ifndef ZOTERO_TO_FILE_TREE_FLATCOLLECTIONTREE_HPP
+#define ZOTERO_TO_FILE_TREE_FLATCOLLECTIONTREE_HPP
+
+#include "CollectionPDFItem.hpp"
+#include "CollectionTree.hpp"
+#include "OutputDirWriter.hpp"
+#include "ZoteroCollection.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace zotfiles
+{
+
+/** @brief A node of the FlatCollectionTree. Children and pdf items are ranges in the arrays of the tree.
+ */
+struct FlatCollectionNode {
+  std::int64_t collectionID{};       /**< Identifies the FlatCollectionNode uniquely. */
+  std::int64_t parentCollectionID{}; /**< CollectionID of the parent. -1 if no parent exists. */
+  std::string collectionName;
+  std::uint32_t firstChild{};   /**< Index of the first child in the node array. */
+  std::uint32_t childCount{};   /**< Number of children, stored next to each other after firstChild. */
+  std::uint32_t firstPDFItem{}; /**< Index of the first pdf item in the pdf item pool. */
+  std::uint32_t pdfItemCount{}; /**< Number of pdf items of this collection. */
+};
+
+/** @brief The collection tree stored in contiguous arrays.
+ *
+ * The nodes are stored in breadth-first order, so the children of every node are a contiguous range of the node array and a parent is
+ * always stored before its children. The pdf items of all nodes are stored in one pool in the same order. Unlike the CollectionTree, the
+ * pdf items are fixed when the tree is built.
+ */
+class FlatCollectionTree {
+  std::vector<FlatCollectionNode> m_nodes;
+  std::uint32_t m_rootCount{};
+  std::vector<CollectionPDFItem> m_pdfItems;
+  std::unordered_map<std::int64_t, std::uint32_t> m_nodeIndex; /**< Index into m_nodes by collectionID. */
+
+public:
+  /** @brief Build the tree from the given collection nodes and their pdf items, like CollectionTree::build.
+   *
+   * The childrenNodes of the given nodes are ignored, the tree structure is taken from the parentCollectionIDs. The pdf items are moved
+   * out of the given nodes. Nodes whose parent is not part of the given nodes are not part of the tree.
+   */
+  static FlatCollectionTree build(std::unordered_map<std::int64_t, std::shared_ptr<CollectionNode>> collectionNodes);
+
+  /** @brief Build the tree from the collections and the pdf items, each with the index of its collection in collections.
+   *
+   * The pdf items of a collection keep their order. Collections whose parent is not part of the given collections are not part of the
+   * tree, like their pdf items.
+   */
+  static FlatCollectionTree build(std::span<const ZoteroCollection> collections,
+                                  std::vector<std::pair<std::uint32_t, CollectionPDFItem>> pdfItems);
+
+  /** @brief Returns the node with the given collectionID or nullptr if the tree has no such node.
+   */
+  [[nodiscard]] const FlatCollectionNode* find(std::int64_t collectionID) const;
+
+  [[nodiscard]] std::span<const FlatCollectionNode> nodes() const { return m_nodes; }
+  [[nodiscard]] std::span<const FlatCollectionNode> roots() const { return std::span(m_nodes).first(m_rootCount); }
+  [[nodiscard]] std::span<const FlatCollectionNode> children(const FlatCollectionNode& node) const {
+    return std::span(m_nodes).subspan(node.firstChild, node.childCount);
+  }
+  [[nodiscard]] std::span<const CollectionPDFItem> pdf_items(const FlatCollectionNode& node) const {
+    return std::span(m_pdfItems).subspan(node.firstPDFItem, node.pdfItemCount);
+  }
+
+  /** @brief The directory path of every node relative to the output directory, in the order of nodes().
+   */
+  [[nodiscard]] std::vector<std::filesystem::path> rel_dir_paths() const;
+
+  /** @brief Plans the directories and pdf files of the tree in breadth-first order, see OutputDirWriter.
+   *
+   * The tree must outlive the writer, the plan refers to its pdf items.
+   */
+  void plan_pdfs(OutputDirWriter& outputDirWriter) const;
+
+  /** @brief Write the pdfs to the output directory, see CollectionTree::write_pdfs.
+   */
+  WriteSummary write_pdfs(std::filesystem::path outputDir, const WriteOptions& writeOptions, Manifest* writtenManifest = nullptr) const;
+};
+
+} // namespace zotfiles
+
+#endif // ZOTERO_TO_FILE_TREE_FLATCOLLECTIONTREE_HPP
@@ -0,0 +1,526 @@
+#include "IoUringCopier.hpp"
+
+#if defined(__linux__)
+#include "Manifest.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <linux/io_uring.h>
+#include <optional>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace zotfiles
+{
+
+#if defined(__linux__)
+
+namespace
+{
+
+/** Size of the copy buffer of every slot, the same as the buffer of content_hash. */
+constexpr std::uint32_t slotBufferSize = 128 * 1024;
+
+/** The operations of a copy, stored in the low bits of the user_data of a submission. */
+enum class RingOp : std::uint64_t
+{
+  OPEN_SOURCE,
+  STATX_SOURCE,
+  OPEN_TARGET,
+  READ,
+  WRITE,
+  CLOSE_SOURCE,
+  CLOSE_TARGET
+};
+
+constexpr std::uint64_t ringOpBits = 3;
+
+int io_uring_setup(unsigned entries, io_uring_params* params) {
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int io_uring_enter(int ringFd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+  return static_cast<int>(::syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+int io_uring_register(int ringFd, unsigned opcode, void* arg, unsigned argCount) {
+  return static_cast<int>(::syscall(__NR_io_uring_register, ringFd, opcode, arg, argCount));
+}
+
+/**
+ *\brief A memory mapping of the ring, unmapped on destruction.
+ */
+class RingMapping {
+  void* m_address{MAP_FAILED};
+  std::size_t m_size{};
+
+public:
+  RingMapping() = default;
+  RingMapping(int ringFd, std::size_t size, off_t offset)
+      : m_address(::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, offset))
+      , m_size(size) {}
+  ~RingMapping() {
+    if (m_address != MAP_FAILED)
+    {
+      ::munmap(m_address, m_size);
+    }
+  }
+
+  RingMapping(const RingMapping&) = delete;
+  RingMapping& operator=(const RingMapping&) = delete;
+
+  [[nodiscard]] bool valid() const { return m_address != MAP_FAILED; }
+  [[nodiscard]] char* get() const { return static_cast<char*>(m_address); }
+};
+
+/**
+ *\brief True if the kernel supports all operations of a copy.
+ */
+bool supports_copy_ops(int ringFd) {
+  static constexpr unsigned probeOpCount = 256;
+  std::vector<char> probeBuffer(sizeof(io_uring_probe) + probeOpCount * sizeof(io_uring_probe_op));
+  auto* probe = reinterpret_cast<io_uring_probe*>(probeBuffer.data());
+  if (io_uring_register(ringFd, IORING_REGISTER_PROBE, probe, probeOpCount) < 0)
+  {
+    return false;
+  }
+  return std::ranges::all_of(std::array{IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_CLOSE},
+                             [probe](auto op)
+                             { return op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED) != 0; });
+}
+
+} // namespace
+
+struct IoUringCopier::Impl {
+  /** @brief A copy in flight, its buffers stay valid while the kernel works on its submissions. */
+  struct Slot {
+    bool inUse{false};
+    std::string sourcePath;
+    std::string targetPath;
+    struct statx sourceStatx{};
+    int sourceFd{-1};
+    int targetFd{-1};
+    bool targetCreated{false};
+    std::uint64_t fileOffset{}; /**< Offset of the buffer content in the source file. */
+    std::uint32_t bufferBytes{};
+    std::uint32_t writtenBytes{};
+    int pendingOps{};
+    std::error_code errorCode;
+    bool hashContent{false};
+    ContentHasher hasher;
+    std::unique_ptr<char[]> buffer;
+  };
+
+  int ringFd{-1};
+  std::optional<RingMapping> sqMapping;
+  std::optional<RingMapping> cqMapping;
+  std::optional<RingMapping> sqeMapping;
+  std::uint32_t* sqHead{};
+  std::uint32_t* sqTail{};
+  std::uint32_t sqMask{};
+  std::uint32_t sqEntries{};
+  std::uint32_t* sqArray{};
+  io_uring_sqe* sqes{};
+  std::uint32_t* cqHead{};
+  std::uint32_t* cqTail{};
+  std::uint32_t cqMask{};
+  io_uring_cqe* cqes{};
+  std::uint32_t unsubmitted{};
+  std::vector<Slot> slots;
+  std::size_t inFlight{};
+
+  ~Impl() {
+    if (ringFd >= 0)
+    {
+      ::close(ringFd);
+    }
+  }
+
+  /**
+   *\brief Passes the unsubmitted entries to the kernel and waits for minComplete completions.
+   */
+  void enter(unsigned minComplete) {
+    while (true)
+    {
+      const int submitted = io_uring_enter(ringFd, unsubmitted, minComplete, minComplete > 0 ? IORING_ENTER_GETEVENTS : 0);
+      if (submitted >= 0)
+      {
+        unsubmitted -= static_cast<std::uint32_t>(submitted);
+        return;
+      }
+      // EBUSY and EAGAIN: the completion queue is full or the kernel is short of memory, the completions are reaped by the caller.
+      if (errno == EBUSY || errno == EAGAIN)
+      {
+        return;
+      }
+      if (errno != EINTR)
+      {
+        // The kernel may still write into the buffers of the slots, they can not be freed or reused.
+        fmt::print("io_uring_enter failed: {}\n", std::error_code(errno, std::generic_category()).message());
+        std::abort();
+      }
+    }
+  }
+
+  io_uring_sqe& next_sqe(std::size_t slotIndex, RingOp op, std::uint8_t opcode) {
+    const std::uint32_t tail = *sqTail;
+    if (tail - std::atomic_ref(*sqHead).load(std::memory_order_acquire) == sqEntries)
+    {
+      enter(0);
+    }
+    const std::uint32_t index = tail & sqMask;
+    io_uring_sqe& sqe = sqes[index];
+    sqe = io_uring_sqe{};
+    sqe.opcode = opcode;
+    sqe.user_data = (slotIndex << ringOpBits) | static_cast<std::uint64_t>(op);
+    sqArray[index] = index;
+    std::atomic_ref(*sqTail).store(tail + 1, std::memory_order_release);
+    ++unsubmitted;
+    ++slots[slotIndex].pendingOps;
+    return sqe;
+  }
+
+  void submit_open(std::size_t slotIndex, RingOp op, const std::string& path, int flags, std::uint32_t mode) {
+    io_uring_sqe& sqe = next_sqe(slotIndex, op, IORING_OP_OPENAT);
+    sqe.fd = AT_FDCWD;
+    sqe.addr = reinterpret_cast<std::uint64_t>(path.c_str());
+    sqe.len = mode;
+    sqe.open_flags = static_cast<std::uint32_t>(flags);
+  }
+
+  void submit_statx(std::size_t slotIndex) {
+    Slot& slot = slots[slotIndex];
+    io_uring_sqe& sqe = next_sqe(slotIndex, RingOp::STATX_SOURCE, IORING_OP_STATX);
+    sqe.fd = AT_FDCWD;
+    sqe.addr = reinterpret_cast<std::uint64_t>(slot.sourcePath.c_str());
+    sqe.len = STATX_MODE | STATX_SIZE;
+    sqe.off = reinterpret_cast<std::uint64_t>(&slot.sourceStatx);
+  }
+
+  void submit_read(std::size_t slotIndex) {
+    Slot& slot = slots[slotIndex];
+    io_uring_sqe& sqe = next_sqe(slotIndex, RingOp::READ, IORING_OP_READ);
+    sqe.fd = slot.sourceFd;
+    sqe.addr = reinterpret_cast<std::uint64_t>(slot.buffer.get());
+    sqe.len = slotBufferSize;
+    sqe.off = slot.fileOffset;
+  }
+
+  void submit_write(std::size_t slotIndex) {
+    Slot& slot = slots[slotIndex];
+    io_uring_sqe& sqe = next_sqe(slotIndex, RingOp::WRITE, IORING_OP_WRITE);
+    sqe.fd = slot.targetFd;
+    sqe.addr = reinterpret_cast<std::uint64_t>(slot.buffer.get() + slot.writtenBytes);
+    sqe.len = slot.bufferBytes - slot.writtenBytes;
+    sqe.off = slot.fileOffset + slot.writtenBytes;
+  }
+
+  void submit_close(std::size_t slotIndex) {
+    Slot& slot = slots[slotIndex];
+    next_sqe(slotIndex, RingOp::CLOSE_SOURCE, IORING_OP_CLOSE).fd = slot.sourceFd;
+    next_sqe(slotIndex, RingOp::CLOSE_TARGET, IORING_OP_CLOSE).fd = slot.targetFd;
+    slot.sourceFd = -1;
+    slot.targetFd = -1;
+  }
+
+  /**
+   *\brief Frees the slot of a finished copy. A failed copy closes its files and removes the target file if it created it.
+   */
+  RingCopyResult finish_slot(std::size_t slotIndex) {
+    Slot& slot = slots[slotIndex];
+    RingCopyResult result{slotIndex, slot.errorCode, 0};
+    if (slot.errorCode)
+    {
+      for (const int fd: {slot.sourceFd, slot.targetFd})
+      {
+        if (fd >= 0)
+        {
+          ::close(fd);
+        }
+      }
+      if (slot.targetCreated)
+      {
+        ::unlink(slot.targetPath.c_str());
+      }
+    }
+    else if (slot.hashContent)
+    {
+      result.contentHash = slot.hasher.finish();
+    }
+    slot.inUse = false;
+    slot.sourceFd = -1;
+    slot.targetFd = -1;
+    --inFlight;
+    return result;
+  }
+
+  void fail(Slot& slot, int error) {
+    if (!slot.errorCode)
+    {
+      slot.errorCode = std::error_code(error, std::generic_category());
+    }
+  }
+
+  /**
+   *\brief Advances the copy of the slot by one completion. Returns true if the copy finished.
+   */
+  bool complete(std::size_t slotIndex, RingOp op, int result) {
+    Slot& slot = slots[slotIndex];
+    --slot.pendingOps;
+    const bool retry = result == -EINTR || result == -EAGAIN;
+    switch (op)
+    {
+    case RingOp::OPEN_SOURCE:
+      if (result >= 0)
+      {
+        slot.sourceFd = result;
+      }
+      else
+      {
+        fail(slot, -result);
+      }
+      break;
+    case RingOp::STATX_SOURCE:
+      if (result < 0)
+      {
+        fail(slot, -result);
+      }
+      break;
+    case RingOp::OPEN_TARGET:
+      if (result >= 0)
+      {
+        slot.targetFd = result;
+        slot.targetCreated = true;
+        submit_read(slotIndex);
+        return false;
+      }
+      fail(slot, -result);
+      break;
+    case RingOp::READ:
+      if (retry)
+      {
+        submit_read(slotIndex);
+        return false;
+      }
+      if (result < 0)
+      {
+        fail(slot, -result);
+        break;
+      }
+      if (result == 0)
+      {
+        submit_close(slotIndex);
+        return false;
+      }
+      slot.bufferBytes = static_cast<std::uint32_t>(result);
+      slot.writtenBytes = 0;
+      if (slot.hashContent)
+      {
+        slot.hasher.update(slot.buffer.get(), slot.bufferBytes);
+      }
+      submit_write(slotIndex);
+      return false;
+    case RingOp::WRITE:
+      if (retry)
+      {
+        submit_write(slotIndex);
+        return false;
+      }
+      if (result <= 0)
+      {
+        fail(slot, result == 0 ? EIO : -result);
+        break;
+      }
+      slot.writtenBytes += static_cast<std::uint32_t>(result);
+      if (slot.writtenBytes < slot.bufferBytes)
+      {
+        submit_write(slotIndex);
+        return false;
+      }
+      slot.fileOffset += slot.bufferBytes;
+      // A short read up to the size of the source is the end of the file, which saves the final read of small files.
+      if (slot.bufferBytes < slotBufferSize && slot.fileOffset >= slot.sourceStatx.stx_size)
+      {
+        submit_close(slotIndex);
+        return false;
+      }
+      submit_read(slotIndex);
+      return false;
+    case RingOp::CLOSE_SOURCE:
+      break;
+    case RingOp::CLOSE_TARGET:
+      // A failed close of the target can lose data written to a network file system.
+      if (result < 0)
+      {
+        fail(slot, -result);
+      }
+      break;
+    }
+
+    if (slot.pendingOps > 0)
+    {
+      return false;
+    }
+    if (op == RingOp::OPEN_SOURCE || op == RingOp::STATX_SOURCE)
+    {
+      if (slot.errorCode)
+      {
+        return true;
+      }
+      submit_open(slotIndex,
+                  RingOp::OPEN_TARGET,
+                  slot.targetPath,
+                  O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                  static_cast<std::uint32_t>(slot.sourceStatx.stx_mode & 07777));
+      return false;
+    }
+    return true;
+  }
+};
+
+IoUringCopier::IoUringCopier(std::unique_ptr<Impl> impl)
+    : m_impl(std::move(impl)) {}
+
+IoUringCopier::~IoUringCopier() = default;
+
+std::unique_ptr<IoUringCopier> IoUringCopier::create(std::size_t queueDepth) {
+  queueDepth = std::max<std::size_t>(queueDepth, 1);
+  auto impl = std::make_unique<Impl>();
+
+  // A copy has at most two operations in flight, the rings never overflow.
+  io_uring_params params{};
+  impl->ringFd = io_uring_setup(static_cast<unsigned>(std::min<std::size_t>(queueDepth * 2, 4096)), &params);
+  if (impl->ringFd < 0 || !supports_copy_ops(impl->ringFd))
+  {
+    return nullptr;
+  }
+
+  const std::size_t sqRingSize = params.sq_off.array + params.sq_entries * sizeof(std::uint32_t);
+  const std::size_t cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  const bool singleMapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  impl->sqMapping.emplace(impl->ringFd, singleMapping ? std::max(sqRingSize, cqRingSize) : sqRingSize, IORING_OFF_SQ_RING);
+  if (!singleMapping)
+  {
+    impl->cqMapping.emplace(impl->ringFd, cqRingSize, IORING_OFF_CQ_RING);
+  }
+  impl->sqeMapping.emplace(impl->ringFd, params.sq_entries * sizeof(io_uring_sqe), IORING_OFF_SQES);
+  if (!impl->sqMapping->valid() || !impl->sqeMapping->valid() || (!singleMapping && !impl->cqMapping->valid()))
+  {
+    return nullptr;
+  }
+
+  char* const sqRing = impl->sqMapping->get();
+  char* const cqRing = singleMapping ? sqRing : impl->cqMapping->get();
+  impl->sqHead = reinterpret_cast<std::uint32_t*>(sqRing + params.sq_off.head);
+  impl->sqTail = reinterpret_cast<std::uint32_t*>(sqRing + params.sq_off.tail);
+  impl->sqMask = *reinterpret_cast<std::uint32_t*>(sqRing + params.sq_off.ring_mask);
+  impl->sqEntries = params.sq_entries;
+  impl->sqArray = reinterpret_cast<std::uint32_t*>(sqRing + params.sq_off.array);
+  impl->sqes = reinterpret_cast<io_uring_sqe*>(impl->sqeMapping->get());
+  impl->cqHead = reinterpret_cast<std::uint32_t*>(cqRing + params.cq_off.head);
+  impl->cqTail = reinterpret_cast<std::uint32_t*>(cqRing + params.cq_off.tail);
+  impl->cqMask = *reinterpret_cast<std::uint32_t*>(cqRing + params.cq_off.ring_mask);
+  impl->cqes = reinterpret_cast<io_uring_cqe*>(cqRing + params.cq_off.cqes);
+
+  impl->slots.resize(std::min<std::size_t>(queueDepth, params.sq_entries / 2));
+  for (Impl::Slot& slot: impl->slots)
+  {
+    slot.buffer = std::make_unique_for_overwrite<char[]>(slotBufferSize);
+  }
+  return std::unique_ptr<IoUringCopier>(new IoUringCopier(std::move(impl)));
+}
+
+std::size_t IoUringCopier::queue_depth() const {
+  return m_impl->slots.size();
+}
+
+std::size_t IoUringCopier::in_flight() const {
+  return m_impl->inFlight;
+}
+
+std::size_t
+IoUringCopier::start(const std::filesystem::path& sourceFilePath, const std::filesystem::path& targetFilePath, bool hashContent) {
+  const auto freeSlot = std::ranges::find(m_impl->slots, false, &Impl::Slot::inUse);
+  const auto slotIndex = static_cast<std::size_t>(freeSlot - m_impl->slots.begin());
+  Impl::Slot& slot = *freeSlot;
+  slot.inUse = true;
+  slot.sourcePath = sourceFilePath.string();
+  slot.targetPath = targetFilePath.string();
+  slot.targetCreated = false;
+  slot.fileOffset = 0;
+  slot.pendingOps = 0;
+  slot.errorCode.clear();
+  slot.hashContent = hashContent;
+  slot.hasher = ContentHasher();
+  ++m_impl->inFlight;
+
+  // The target is created with the permissions of the source, so the statx result is needed before the target is opened.
+  m_impl->submit_open(slotIndex, RingOp::OPEN_SOURCE, slot.sourcePath, O_RDONLY | O_CLOEXEC, 0);
+  m_impl->submit_statx(slotIndex);
+  return slotIndex;
+}
+
+std::vector<RingCopyResult> IoUringCopier::advance() {
+  std::vector<RingCopyResult> results;
+  Impl& impl = *m_impl;
+  while (results.empty() && impl.inFlight > 0)
+  {
+    impl.enter(1);
+    const std::uint32_t tail = std::atomic_ref(*impl.cqTail).load(std::memory_order_acquire);
+    std::uint32_t head = *impl.cqHead;
+    for (; head != tail; ++head)
+    {
+      const io_uring_cqe& cqe = impl.cqes[head & impl.cqMask];
+      const auto slotIndex = static_cast<std::size_t>(cqe.user_data >> ringOpBits);
+      const auto op = static_cast<RingOp>(cqe.user_data & ((1U << ringOpBits) - 1));
+      if (impl.complete(slotIndex, op, cqe.res))
+      {
+        results.push_back(impl.finish_slot(slotIndex));
+      }
+    }
+    std::atomic_ref(*impl.cqHead).store(head, std::memory_order_release);
+  }
+  return results;
+}
+
+#else
+
+struct IoUringCopier::Impl {};
+
+IoUringCopier::IoUringCopier(std::unique_ptr<Impl> impl)
+    : m_impl(std::move(impl)) {}
+
+IoUringCopier::~IoUringCopier() = default;
+
+std::unique_ptr<IoUringCopier> IoUringCopier::create(std::size_t /*queueDepth*/) {
+  return nullptr;
+}
+
+std::size_t IoUringCopier::queue_depth() const {
+  return 0;
+}
+
+std::size_t IoUringCopier::in_flight() const {
+  return 0;
+}
+
+std::size_t IoUringCopier::start(const std::filesystem::path& /*sourceFilePath*/,
+                                 const std::filesystem::path& /*targetFilePath*/,
+                                 bool /*hashContent*/) {
+  return 0;
+}
+
+std::vector<RingCopyResult> IoUringCopier::advance() {
+  return {};
+}
+
+#endif
+
+} // namespace zotfiles
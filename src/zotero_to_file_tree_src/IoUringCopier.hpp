@@ -0,0 +1,74 @@
+#ifndef ZOTERO_TO_FILE_TREE_IOURINGCOPIER_HPP
+#define ZOTERO_TO_FILE_TREE_IOURINGCOPIER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+namespace zotfiles
+{
+
+/** @brief A finished copy of the IoUringCopier. */
+struct RingCopyResult {
+  std::size_t slot{};          /**< The slot returned by IoUringCopier::start. */
+  std::error_code errorCode;   /**< Set if the copy failed. The target file was removed again. */
+  std::uint64_t contentHash{}; /**< The content_hash of the copied data if it was requested, otherwise 0. */
+};
+
+/**
+ *\brief Copies files with io_uring, keeping up to queueDepth copies in flight from a single thread.
+ *
+ * A copy opens the source file and reads its metadata with an openat and a statx submission, creates the target file with the permissions
+ * of the source and moves the content with read and write submissions through a buffer of its slot. The submissions of all copies in
+ * flight are passed to the kernel with one io_uring_enter call, so the latencies of many small files overlap, which pays off most on
+ * network file systems. The content hash is computed from the buffer while the data passes through, the copy is not read again.
+ *
+ * The ring is set up with raw system calls, no library is needed. Not thread safe.
+ */
+class IoUringCopier {
+  struct Impl;
+  std::unique_ptr<Impl> m_impl;
+
+  explicit IoUringCopier(std::unique_ptr<Impl> impl);
+
+public:
+  /**
+   *\brief Sets up the ring. Returns nullptr if io_uring or one of the needed operations is not available, e.g. on kernels before 5.6, in
+   * containers that block io_uring or on other platforms than linux.
+   *
+   * @param queueDepth Number of copies in flight. Values smaller than 1 are treated as 1.
+   */
+  [[nodiscard]] static std::unique_ptr<IoUringCopier> create(std::size_t queueDepth);
+
+  ~IoUringCopier();
+  IoUringCopier(const IoUringCopier&) = delete;
+  IoUringCopier& operator=(const IoUringCopier&) = delete;
+
+  [[nodiscard]] std::size_t queue_depth() const;
+  [[nodiscard]] std::size_t in_flight() const;
+
+  /**
+   *\brief Starts a copy in a free slot. The first submissions are passed to the kernel by the next advance().
+   *
+   * in_flight() must be smaller than queue_depth(). The target file must not exist.
+   *
+   * @param hashContent Compute the content_hash of the copied data.
+   * @return The slot of the copy, smaller than queue_depth().
+   */
+  std::size_t start(const std::filesystem::path& sourceFilePath, const std::filesystem::path& targetFilePath, bool hashContent);
+
+  /**
+   *\brief Submits the pending operations, waits for at least one completion and advances the copies. Returns at once if no copy is in
+   * flight.
+   *
+   * @return The copies that finished, their slots are free again.
+   */
+  std::vector<RingCopyResult> advance();
+};
+
+} // namespace zotfiles
+
+#endif // ZOTERO_TO_FILE_TREE_IOURINGCOPIER_HPP
@@ -0,0 +1,268 @@
+#include "Manifest.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <fmt/format.h>
+#include <fstream>
+#include <memory>
+
+#if defined(__linux__)
+#include <sys/stat.h>
+#endif
+
+namespace zotfiles
+{
+
+namespace
+{
+
+constexpr std::string_view manifestHeader = "zotero_to_file_tree manifest 2";
+// The optional export state follows the header. Entry lines start with the item id, so the prefix can not be confused with an entry.
+constexpr std::string_view exportStatePrefix = "state\t";
+
+// Paths are written as the last field of a line. Newlines and backslashes in file names are escaped, tabs need no escaping.
+std::string escape_path(std::string_view path) {
+  std::string escaped;
+  escaped.reserve(path.size());
+  for (const char c: path)
+  {
+    if (c == '\\')
+    {
+      escaped += "\\\\";
+    }
+    else if (c == '\n')
+    {
+      escaped += "\\n";
+    }
+    else
+    {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+std::string unescape_path(std::string_view escaped) {
+  std::string path;
+  path.reserve(escaped.size());
+  for (std::size_t i = 0; i < escaped.size(); ++i)
+  {
+    if (escaped[i] == '\\' && i + 1 < escaped.size())
+    {
+      ++i;
+      path += escaped[i] == 'n' ? '\n' : escaped[i];
+    }
+    else
+    {
+      path += escaped[i];
+    }
+  }
+  return path;
+}
+
+bool parse_link_mode_field(std::string_view& line, LinkMode& linkMode) {
+  const std::size_t tab = line.find('\t');
+  if (tab == std::string_view::npos)
+  {
+    return false;
+  }
+  const std::optional<LinkMode> parsedLinkMode = parse_link_mode(line.substr(0, tab));
+  line.remove_prefix(tab + 1);
+  if (!parsedLinkMode)
+  {
+    return false;
+  }
+  linkMode = *parsedLinkMode;
+  return true;
+}
+
+template <typename T>
+bool parse_field(std::string_view& line, T& value, int base = 10) {
+  const std::size_t tab = line.find('\t');
+  if (tab == std::string_view::npos)
+  {
+    return false;
+  }
+  const std::string_view field = line.substr(0, tab);
+  line.remove_prefix(tab + 1);
+  const auto [ptr, errorCode] = std::from_chars(field.data(), field.data() + field.size(), value, base);
+  return errorCode == std::errc() && ptr == field.data() + field.size();
+}
+
+std::uint64_t mix(std::uint64_t value) {
+  value ^= value >> 33U;
+  value *= 0xff51afd7ed558ccdULL;
+  value ^= value >> 33U;
+  value *= 0xc4ceb9fe1a85ec53ULL;
+  value ^= value >> 33U;
+  return value;
+}
+
+} // namespace
+
+Manifest Manifest::load(const std::filesystem::path& outputDir) {
+  Manifest manifest;
+  std::ifstream file(outputDir / fileName, std::ios::binary);
+  std::string line;
+  if (!file || !std::getline(file, line) || line != manifestHeader)
+  {
+    return manifest;
+  }
+
+  while (std::getline(file, line))
+  {
+    if (line.starts_with(exportStatePrefix))
+    {
+      manifest.m_exportState = line.substr(exportStatePrefix.size());
+      continue;
+    }
+
+    std::string_view fields = line;
+    ManifestEntry entry;
+    if (!parse_field(fields, entry.pdfItemId) || !parse_field(fields, entry.sourceSize) || !parse_field(fields, entry.sourceMTime) ||
+        !parse_field(fields, entry.contentHash, 16) || !parse_link_mode_field(fields, entry.linkMode) || fields.empty())
+    {
+      fmt::print("Ignoring the invalid manifest in the output directory.\n");
+      return Manifest{};
+    }
+    entry.relPath = unescape_path(fields);
+    manifest.insert(std::move(entry));
+  }
+  return manifest;
+}
+
+bool Manifest::save(const std::filesystem::path& outputDir) const {
+  std::vector<const ManifestEntry*> sortedEntries;
+  sortedEntries.reserve(m_entries.size());
+  for (const auto& [relPath, entry]: m_entries)
+  {
+    sortedEntries.push_back(&entry);
+  }
+  std::sort(sortedEntries.begin(),
+            sortedEntries.end(),
+            [](const ManifestEntry* lhs, const ManifestEntry* rhs) { return lhs->relPath < rhs->relPath; });
+
+  const std::filesystem::path manifestPath = outputDir / fileName;
+  std::filesystem::path tmpManifestPath = manifestPath;
+  tmpManifestPath += ".tmp";
+  {
+    std::ofstream file(tmpManifestPath, std::ios::binary | std::ios::trunc);
+    fmt::memory_buffer buffer;
+    fmt::format_to(std::back_inserter(buffer), "{}\n", manifestHeader);
+    if (!m_exportState.empty())
+    {
+      fmt::format_to(std::back_inserter(buffer), "{}{}\n", exportStatePrefix, m_exportState);
+    }
+    for (const ManifestEntry* entry: sortedEntries)
+    {
+      fmt::format_to(std::back_inserter(buffer),
+                     "{}\t{}\t{}\t{:x}\t{}\t{}\n",
+                     entry->pdfItemId,
+                     entry->sourceSize,
+                     entry->sourceMTime,
+                     entry->contentHash,
+                     to_string(entry->linkMode),
+                     escape_path(entry->relPath));
+    }
+    file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    if (!file.flush())
+    {
+      return false;
+    }
+  }
+
+  std::error_code errorCode;
+  std::filesystem::rename(tmpManifestPath, manifestPath, errorCode);
+  return !errorCode;
+}
+
+const ManifestEntry* Manifest::find(const std::string& relPath) const {
+  auto iter = m_entries.find(relPath);
+  if (iter == m_entries.end())
+  {
+    return nullptr;
+  }
+  return &iter->second;
+}
+
+void Manifest::insert(ManifestEntry manifestEntry) {
+  std::string relPath = manifestEntry.relPath;
+  m_entries.insert_or_assign(std::move(relPath), std::move(manifestEntry));
+}
+
+SourceFileStat source_file_stat(const std::filesystem::path& filePath) {
+#if defined(__linux__)
+  struct stat fileStat{};
+  if (::stat(filePath.c_str(), &fileStat) != 0)
+  {
+    throw std::filesystem::filesystem_error("stat", filePath, std::error_code(errno, std::generic_category()));
+  }
+  return {static_cast<std::uint64_t>(fileStat.st_size), std::int64_t{fileStat.st_mtim.tv_sec} * 1'000'000'000 + fileStat.st_mtim.tv_nsec};
+#else
+  const auto mtime = std::chrono::file_clock::to_sys(std::filesystem::last_write_time(filePath));
+  return {std::filesystem::file_size(filePath), std::chrono::duration_cast<std::chrono::nanoseconds>(mtime.time_since_epoch()).count()};
+#endif
+}
+
+void ContentHasher::update(const char* data, std::size_t size) {
+  m_length += size;
+  const char* end = data + size;
+  if (m_partialWordSize > 0)
+  {
+    const auto count = std::min<std::size_t>(sizeof(std::uint64_t) - m_partialWordSize, size);
+    std::copy(data, data + count, m_partialWord.data() + m_partialWordSize);
+    m_partialWordSize += count;
+    data += count;
+    if (m_partialWordSize < sizeof(std::uint64_t))
+    {
+      return;
+    }
+    std::uint64_t word{};
+    std::memcpy(&word, m_partialWord.data(), sizeof(word));
+    m_hash = mix(m_hash ^ word) + 0x9e3779b97f4a7c15ULL;
+    m_partialWordSize = 0;
+  }
+
+  for (; data + sizeof(std::uint64_t) <= end; data += sizeof(std::uint64_t))
+  {
+    std::uint64_t word{};
+    std::memcpy(&word, data, sizeof(word));
+    m_hash = mix(m_hash ^ word) + 0x9e3779b97f4a7c15ULL;
+  }
+  std::copy(data, end, m_partialWord.data());
+  m_partialWordSize = static_cast<std::size_t>(end - data);
+}
+
+std::uint64_t ContentHasher::finish() const {
+  // The bytes after the last complete word are mixed in one by one.
+  std::uint64_t hash = m_hash;
+  for (std::size_t i = 0; i < m_partialWordSize; ++i)
+  {
+    hash = mix(hash ^ static_cast<unsigned char>(m_partialWord[i]));
+  }
+  // 0 means "no hash" in the manifest.
+  const std::uint64_t result = mix(hash ^ m_length);
+  return result == 0 ? 1 : result;
+}
+
+std::uint64_t content_hash(const std::filesystem::path& filePath) {
+  std::ifstream file(filePath, std::ios::binary);
+  if (!file)
+  {
+    return 0;
+  }
+
+  static constexpr std::size_t bufferSize = 128 * 1024;
+  const auto buffer = std::make_unique_for_overwrite<char[]>(bufferSize);
+  ContentHasher hasher;
+  while (file)
+  {
+    file.read(buffer.get(), bufferSize);
+    hasher.update(buffer.get(), static_cast<std::size_t>(file.gcount()));
+  }
+  return hasher.finish();
+}
+
+} // namespace zotfiles
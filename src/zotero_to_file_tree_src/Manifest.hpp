@@ -0,0 +1,105 @@
+#ifndef ZOTERO_TO_FILE_TREE_MANIFEST_HPP
+#define ZOTERO_TO_FILE_TREE_MANIFEST_HPP
+
+#include "FileTransfer.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace zotfiles
+{
+
+/** @brief A pdf file written by a previous export. */
+struct ManifestEntry {
+  std::int64_t pdfItemId{};    /**< The item id of the pdf attachment in the zotero db. */
+  std::string relPath;         /**< Path of the written file relative to the output directory, in generic format. */
+  std::uint64_t sourceSize{};  /**< Size of the source pdf file when it was written. */
+  std::int64_t sourceMTime{};  /**< Modification time of the source pdf file when it was written, in nanoseconds since the epoch. */
+  std::uint64_t contentHash{}; /**< Hash of the content of byte copies, 0 if not computed yet. 0 for links, which are cheap to recreate. */
+  LinkMode linkMode{};         /**< The link mode the file was written with. */
+};
+
+/**
+ *\brief The pdf files written to an output directory, stored in the output directory for the next export.
+ *
+ * An export compares the size and modification time of every source pdf file with its manifest entry and only transfers new and changed
+ * files. If only the modification time changed, the content hash decides. A file written with another link mode than the one of the export
+ * is transferred again. Files of the manifest that are not part of the export anymore
+ * are removed. Files in the output directory that are not listed in the manifest are never removed.
+ */
+class Manifest {
+  std::unordered_map<std::string, ManifestEntry> m_entries;
+  std::string m_exportState;
+
+public:
+  static constexpr std::string_view fileName = ".zotero_to_file_tree_manifest";
+
+  /**
+   *\brief Reads the manifest of the output directory. Returns an empty manifest if there is none or if it can not be parsed.
+   */
+  [[nodiscard]] static Manifest load(const std::filesystem::path& outputDir);
+
+  /**
+   *\brief Writes the manifest to the output directory. The previous manifest is replaced atomically.
+   *
+   * @return False if the manifest could not be written.
+   */
+  bool save(const std::filesystem::path& outputDir) const;
+
+  [[nodiscard]] const ManifestEntry* find(const std::string& relPath) const;
+  void insert(ManifestEntry manifestEntry);
+
+  /**
+   *\brief Opaque single line of text that describes the source of the export, e.g. the formatted ZoteroDBState. Empty if not set.
+   */
+  [[nodiscard]] const std::string& export_state() const { return m_exportState; }
+  void set_export_state(std::string exportState) { m_exportState = std::move(exportState); }
+
+  [[nodiscard]] const std::unordered_map<std::string, ManifestEntry>& entries() const { return m_entries; }
+  [[nodiscard]] std::size_t size() const { return m_entries.size(); }
+};
+
+/** @brief The metadata of a source pdf file that is compared with its manifest entry. */
+struct SourceFileStat {
+  std::uint64_t size{};
+  std::int64_t mtime{}; /**< Modification time in nanoseconds since the epoch. */
+};
+
+/**
+ *\brief Reads the size and modification time of the file with a single stat call.
+ *
+ * @throws std::filesystem::filesystem_error if the file does not exist.
+ */
+[[nodiscard]] SourceFileStat source_file_stat(const std::filesystem::path& filePath);
+
+/**
+ *\brief Computes the content_hash of data that arrives in chunks of any size, e.g. while the data is copied.
+ */
+class ContentHasher {
+  std::uint64_t m_hash{0x9e3779b97f4a7c15ULL};
+  std::uint64_t m_length{};
+  std::array<char, sizeof(std::uint64_t)> m_partialWord{}; /**< Bytes of a word split between two chunks. */
+  std::size_t m_partialWordSize{};
+
+public:
+  void update(const char* data, std::size_t size);
+
+  /**
+   *\brief The hash of all data passed to update(). Never 0.
+   */
+  [[nodiscard]] std::uint64_t finish() const;
+};
+
+/**
+ *\brief A fast non cryptographic 64 bit hash of the file content. Returns 0 if the file can not be read.
+ */
+[[nodiscard]] std::uint64_t content_hash(const std::filesystem::path& filePath);
+
+} // namespace zotfiles
+
+#endif // ZOTERO_TO_FILE_TREE_MANIFEST_HPP
@@ -0,0 +1,409 @@
+#include "MetadataCache.hpp"
+#include "StorageIndex.hpp"
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+#include <vector>
+
+#if defined(__linux__)
+#include "FileDescriptor.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace zotfiles
+{
+
+namespace
+{
+
+constexpr std::array<char, 8> cacheMagic{'Z', 'T', 'F', 'T', 'M', 'C', 'A', 'C'};
+constexpr std::uint32_t cacheFormatVersion = 2;
+constexpr std::uint32_t cacheByteOrderMark = 0x01020304;
+
+/** @brief A string of the string table at the end of the cache. */
+struct StringRef {
+  std::uint64_t offset;
+  std::uint64_t size;
+};
+
+/** @brief The start of the cache. The records of the sections follow in the order of their counts, then the string table. */
+struct CacheHeader {
+  std::array<char, 8> magic;
+  std::uint32_t formatVersion;
+  std::uint32_t byteOrderMark;
+  ZoteroDBFileState fileState;
+  std::array<std::uint32_t, 10> dbInfo; /**< The 9 values of the ZoteroDBInfo and one padding value. */
+  std::int64_t libraryID;
+  std::uint64_t storageFingerprint;
+  StringRef zoteroDBPath;
+  StringRef dbState; /**< The formatted ZoteroDBState. */
+  std::uint64_t itemCount;
+  std::uint64_t collectionRefCount; /**< Rounded up to an even count, so the following records stay aligned. */
+  std::uint64_t collectionCount;
+  std::uint64_t treeCollectionCount;
+  std::uint64_t stringsSize;
+};
+
+struct ItemRecord {
+  std::int64_t itemID;
+  std::int64_t parentItemID;
+  StringRef path;
+  StringRef key;
+  StringRef pdfFilePath;
+  std::uint32_t firstCollectionRef;
+  std::uint32_t collectionCount;
+};
+
+struct CollectionRecord {
+  std::int64_t collectionID;
+  std::int64_t parentCollectionID;
+  StringRef name;
+};
+
+static_assert(std::is_trivially_copyable_v<CacheHeader> && std::is_trivially_copyable_v<ItemRecord> &&
+              std::is_trivially_copyable_v<CollectionRecord>);
+
+std::array<std::uint32_t, 10> db_info_values(const ZoteroDBInfo& info) {
+  return {info.userdata,
+          info.triggers,
+          info.translators,
+          info.system,
+          info.styles,
+          info.repository,
+          info.globalSchema,
+          info.deletes,
+          info.compatibility,
+          0};
+}
+
+/** @brief The byte offsets of the sections of a cache with the counts of the header. */
+struct CacheLayout {
+  std::uint64_t items;
+  std::uint64_t collectionRefs;
+  std::uint64_t collections;
+  std::uint64_t treeCollections;
+  std::uint64_t strings;
+  std::uint64_t end;
+
+  explicit CacheLayout(const CacheHeader& header)
+      : items(sizeof(CacheHeader))
+      , collectionRefs(items + header.itemCount * sizeof(ItemRecord))
+      , collections(collectionRefs + header.collectionRefCount * sizeof(std::uint32_t))
+      , treeCollections(collections + header.collectionCount * sizeof(CollectionRecord))
+      , strings(treeCollections + header.treeCollectionCount * sizeof(CollectionRecord))
+      , end(strings + header.stringsSize) {}
+};
+
+template <typename Record>
+Record read_record(const char* data, std::uint64_t sectionOffset, std::size_t index) {
+  Record record;
+  std::memcpy(&record, data + sectionOffset + index * sizeof(Record), sizeof(Record));
+  return record;
+}
+
+/**
+ *\brief The content of the cache file, memory mapped on linux and read into memory otherwise.
+ */
+class CacheFile {
+  const char* m_data{nullptr};
+  std::size_t m_size{0};
+#if !defined(__linux__)
+  std::vector<char> m_buffer;
+#endif
+
+public:
+  explicit CacheFile(const std::filesystem::path& filePath) {
+#if defined(__linux__)
+    const FileDescriptor fd(::open(filePath.c_str(), O_RDONLY | O_CLOEXEC));
+    struct stat fileStat{};
+    if (!fd.valid() || ::fstat(fd.get(), &fileStat) != 0 || fileStat.st_size <= 0)
+    {
+      return;
+    }
+    void* data = ::mmap(nullptr, static_cast<std::size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd.get(), 0);
+    if (data == MAP_FAILED)
+    {
+      return;
+    }
+    m_data = static_cast<const char*>(data);
+    m_size = static_cast<std::size_t>(fileStat.st_size);
+#else
+    std::ifstream file(filePath, std::ios::binary | std::ios::ate);
+    if (!file)
+    {
+      return;
+    }
+    m_buffer.resize(static_cast<std::size_t>(file.tellg()));
+    file.seekg(0);
+    if (file.read(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size())))
+    {
+      m_data = m_buffer.data();
+      m_size = m_buffer.size();
+    }
+#endif
+  }
+
+  ~CacheFile() {
+#if defined(__linux__)
+    if (m_data)
+    {
+      ::munmap(const_cast<char*>(m_data), m_size);
+    }
+#endif
+  }
+
+  CacheFile(const CacheFile&) = delete;
+  CacheFile& operator=(const CacheFile&) = delete;
+
+  [[nodiscard]] const char* data() const { return m_data; }
+  [[nodiscard]] std::size_t size() const { return m_size; }
+};
+
+} // namespace
+
+struct MetadataCache::Impl {
+  CacheFile file;
+  CacheHeader header{};
+  CacheLayout layout{header};
+  ZoteroDBState dbState;
+
+  explicit Impl(const std::filesystem::path& filePath)
+      : file(filePath) {}
+
+  [[nodiscard]] std::string_view string(const StringRef& stringRef) const {
+    return {file.data() + layout.strings + stringRef.offset, stringRef.size};
+  }
+  [[nodiscard]] bool valid(const StringRef& stringRef) const {
+    return stringRef.offset <= header.stringsSize && stringRef.size <= header.stringsSize - stringRef.offset;
+  }
+
+  /**
+   *\brief Checks that all references of the records point into the cache, so a damaged cache is never restored.
+   */
+  [[nodiscard]] bool valid_records() const {
+    for (std::size_t i = 0; i < header.itemCount; ++i)
+    {
+      const auto item = read_record<ItemRecord>(file.data(), layout.items, i);
+      if (!valid(item.path) || !valid(item.key) || !valid(item.pdfFilePath) || item.firstCollectionRef > header.collectionRefCount ||
+          item.collectionCount > header.collectionRefCount - item.firstCollectionRef)
+      {
+        return false;
+      }
+    }
+    for (std::size_t i = 0; i < header.collectionRefCount; ++i)
+    {
+      if (read_record<std::uint32_t>(file.data(), layout.collectionRefs, i) >= header.collectionCount)
+      {
+        return false;
+      }
+    }
+    for (std::size_t i = 0; i < header.collectionCount + header.treeCollectionCount; ++i)
+    {
+      if (!valid(read_record<CollectionRecord>(file.data(), layout.collections, i).name))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+MetadataCacheKey metadata_cache_key(ZoteroDBSession& session, std::size_t scanJobs) {
+  session.refresh_file_state();
+  return {session.zotero_db_path().string(),
+          session.file_state(),
+          zotero_db_info(session),
+          session.library_id().value_or(-1),
+          StorageIndex::key_dirs_fingerprint(session.storage_dir(), scanJobs)};
+}
+
+MetadataCache::MetadataCache(std::unique_ptr<Impl> impl)
+    : m_impl(std::move(impl)) {}
+MetadataCache::~MetadataCache() = default;
+MetadataCache::MetadataCache(MetadataCache&&) noexcept = default;
+MetadataCache& MetadataCache::operator=(MetadataCache&&) noexcept = default;
+
+std::optional<MetadataCache> MetadataCache::open(const std::filesystem::path& outputDir, const MetadataCacheKey& key) {
+  auto impl = std::make_unique<Impl>(outputDir / fileName);
+  if (impl->file.size() < sizeof(CacheHeader))
+  {
+    return std::nullopt;
+  }
+  std::memcpy(&impl->header, impl->file.data(), sizeof(CacheHeader));
+  const CacheHeader& header = impl->header;
+  if (header.magic != cacheMagic || header.formatVersion != cacheFormatVersion || header.byteOrderMark != cacheByteOrderMark)
+  {
+    return std::nullopt;
+  }
+  // The counts are checked against the file size before the layout is computed from them, so the offsets can not overflow.
+  const std::uint64_t maxCount = impl->file.size();
+  if (header.itemCount > maxCount || header.collectionRefCount > maxCount || header.collectionCount > maxCount ||
+      header.treeCollectionCount > maxCount || header.stringsSize > maxCount)
+  {
+    return std::nullopt;
+  }
+  impl->layout = CacheLayout(header);
+  if (impl->layout.end != impl->file.size() || !impl->valid(header.zoteroDBPath) || !impl->valid(header.dbState))
+  {
+    return std::nullopt;
+  }
+
+  if (header.fileState != key.fileState || header.dbInfo != db_info_values(key.dbInfo) || header.libraryID != key.libraryID ||
+      header.storageFingerprint != key.storageFingerprint || impl->string(header.zoteroDBPath) != key.zoteroDBPath)
+  {
+    return std::nullopt;
+  }
+
+  std::optional<ZoteroDBState> dbState = parse_zotero_db_state(impl->string(header.dbState));
+  if (!dbState || !impl->valid_records())
+  {
+    return std::nullopt;
+  }
+  impl->dbState = std::move(*dbState);
+  return MetadataCache(std::move(impl));
+}
+
+bool MetadataCache::save(const std::filesystem::path& outputDir,
+                         const MetadataCacheKey& key,
+                         const ZoteroDBState& dbState,
+                         const PDFItems& pdfItems,
+                         const std::unordered_map<std::int64_t, ZoteroCollection>& pdfItemCollections) {
+  std::string strings;
+  auto addString = [&strings](std::string_view value)
+  {
+    const StringRef stringRef{strings.size(), value.size()};
+    strings.append(value);
+    return stringRef;
+  };
+
+  CacheHeader header{};
+  header.magic = cacheMagic;
+  header.formatVersion = cacheFormatVersion;
+  header.byteOrderMark = cacheByteOrderMark;
+  header.fileState = key.fileState;
+  header.dbInfo = db_info_values(key.dbInfo);
+  header.libraryID = key.libraryID;
+  header.storageFingerprint = key.storageFingerprint;
+  header.zoteroDBPath = addString(key.zoteroDBPath);
+  header.dbState = addString(formatted_zotero_db_state(dbState));
+  header.itemCount = pdfItems.size();
+  header.collectionCount = pdfItems.all_collections().size();
+  header.treeCollectionCount = pdfItemCollections.size();
+
+  // The collection references are written compacted, the ranges of erased items are left out.
+  std::vector<std::uint32_t> collectionRefs;
+  std::vector<ItemRecord> itemRecords;
+  itemRecords.reserve(pdfItems.size());
+  for (const PDFItem& pdfItem: pdfItems)
+  {
+    const std::span<const std::uint32_t> itemCollectionRefs = pdfItems.collection_refs(pdfItem);
+    itemRecords.push_back(ItemRecord{pdfItem.pdfAttachment.itemID,
+                                     pdfItem.pdfAttachment.parentItemID,
+                                     addString(pdfItem.pdfAttachment.path),
+                                     addString(pdfItem.pdfAttachment.key),
+                                     addString(pdfItem.pdfFilePath.native()),
+                                     static_cast<std::uint32_t>(collectionRefs.size()),
+                                     static_cast<std::uint32_t>(itemCollectionRefs.size())});
+    collectionRefs.insert(collectionRefs.end(), itemCollectionRefs.begin(), itemCollectionRefs.end());
+  }
+  if (collectionRefs.size() % 2 != 0)
+  {
+    collectionRefs.push_back(0);
+  }
+  header.collectionRefCount = collectionRefs.size();
+
+  std::vector<CollectionRecord> collectionRecords;
+  collectionRecords.reserve(header.collectionCount + header.treeCollectionCount);
+  for (const ZoteroCollection& collection: pdfItems.all_collections())
+  {
+    collectionRecords.push_back(
+        CollectionRecord{collection.collectionID, collection.parentCollectionID, addString(collection.collectionName)});
+  }
+  for (const auto& [collectionID, collection]: pdfItemCollections)
+  {
+    collectionRecords.push_back(
+        CollectionRecord{collection.collectionID, collection.parentCollectionID, addString(collection.collectionName)});
+  }
+  header.stringsSize = strings.size();
+
+  const std::filesystem::path cachePath = outputDir / fileName;
+  std::filesystem::path tmpCachePath = cachePath;
+  tmpCachePath += ".tmp";
+  {
+    std::ofstream file(tmpCachePath, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(itemRecords.data()), static_cast<std::streamsize>(itemRecords.size() * sizeof(ItemRecord)));
+    file.write(reinterpret_cast<const char*>(collectionRefs.data()),
+               static_cast<std::streamsize>(collectionRefs.size() * sizeof(std::uint32_t)));
+    file.write(reinterpret_cast<const char*>(collectionRecords.data()),
+               static_cast<std::streamsize>(collectionRecords.size() * sizeof(CollectionRecord)));
+    file.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+    if (!file.flush())
+    {
+      return false;
+    }
+  }
+
+  std::error_code errorCode;
+  std::filesystem::rename(tmpCachePath, cachePath, errorCode);
+  return !errorCode;
+}
+
+const ZoteroDBState& MetadataCache::db_state() const {
+  return m_impl->dbState;
+}
+
+std::size_t MetadataCache::pdf_item_count() const {
+  return m_impl->header.itemCount;
+}
+
+PDFItems MetadataCache::pdf_items(std::pmr::memory_resource* memoryResource) const {
+  const char* data = m_impl->file.data();
+  const CacheLayout& layout = m_impl->layout;
+  PDFItems pdfItems(memoryResource);
+
+  std::vector<std::uint32_t> storedCollectionRefs(m_impl->header.collectionCount);
+  for (std::size_t i = 0; i < storedCollectionRefs.size(); ++i)
+  {
+    const auto collection = read_record<CollectionRecord>(data, layout.collections, i);
+    storedCollectionRefs[i] =
+        pdfItems.store_collection(collection.collectionID, collection.parentCollectionID, m_impl->string(collection.name));
+  }
+
+  // The references of the cache are translated to the references of the PDFItems, they only differ if the cache holds a collection twice.
+  std::vector<std::uint32_t> collectionRefs(m_impl->header.collectionRefCount);
+  std::memcpy(collectionRefs.data(), data + layout.collectionRefs, collectionRefs.size() * sizeof(std::uint32_t));
+  for (std::uint32_t& collectionRef: collectionRefs)
+  {
+    collectionRef = storedCollectionRefs[collectionRef];
+  }
+  for (std::size_t i = 0; i < m_impl->header.itemCount; ++i)
+  {
+    const auto item = read_record<ItemRecord>(data, layout.items, i);
+    pdfItems.add(item.itemID,
+                 item.parentItemID,
+                 m_impl->string(item.path),
+                 m_impl->string(item.key),
+                 std::filesystem::path(m_impl->string(item.pdfFilePath)),
+                 std::span(collectionRefs).subspan(item.firstCollectionRef, item.collectionCount));
+  }
+  return pdfItems;
+}
+
+std::unordered_map<std::int64_t, ZoteroCollection> MetadataCache::pdf_item_collections() const {
+  std::unordered_map<std::int64_t, ZoteroCollection> pdfItemCollections;
+  pdfItemCollections.reserve(m_impl->header.treeCollectionCount);
+  for (std::size_t i = 0; i < m_impl->header.treeCollectionCount; ++i)
+  {
+    const auto collection = read_record<CollectionRecord>(m_impl->file.data(), m_impl->layout.treeCollections, i);
+    pdfItemCollections.emplace(
+        collection.collectionID,
+        ZoteroCollection{collection.collectionID, collection.parentCollectionID, std::string(m_impl->string(collection.name))});
+  }
+  return pdfItemCollections;
+}
+
+} // namespace zotfiles
@@ -0,0 +1,102 @@
+#ifndef ZOTERO_TO_FILE_TREE_METADATACACHE_HPP
+#define ZOTERO_TO_FILE_TREE_METADATACACHE_HPP
+
+#include "PDFItems.hpp"
+#include "ZoteroCollection.hpp"
+#include "ZoteroDB.hpp"
+#include "ZoteroDBSession.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace zotfiles
+{
+
+/**
+ *\brief Identifies the state of the zotero db a MetadataCache was written for.
+ */
+struct MetadataCacheKey {
+  std::string zoteroDBPath;
+  ZoteroDBFileState fileState;        /**< The files of the zotero db before it was read, see ZoteroDBSession::file_state. */
+  ZoteroDBInfo dbInfo;                /**< The values of the version table. */
+  std::int64_t libraryID{-1};         /**< The library of the session, -1 for all libraries. */
+  std::uint64_t storageFingerprint{}; /**< The StorageIndex::key_dirs_fingerprint of the storage directory. */
+
+  bool operator==(const MetadataCacheKey& rhs) const = default;
+};
+
+/**
+ *\brief Returns the key of the current state of the zotero db of the session and of its storage directory.
+ *
+ * The file state of a live session is read again first, see ZoteroDBSession::refresh_file_state, so the key of a later export with the
+ * same session, e.g. in watch mode, reflects the changes since the session was opened.
+ *
+ * @param scanJobs Number of workers that stat the key directories of the storage directory.
+ */
+[[nodiscard]] MetadataCacheKey metadata_cache_key(ZoteroDBSession& session, std::size_t scanJobs = 1);
+
+/**
+ *\brief The resolved pdf items and collections of a full export, stored in the output directory for the next export.
+ *
+ * An export of an unchanged zotero db restores the pdf items with their pdf file paths and the collections of the collection tree from
+ * the cache, without querying the zotero db or scanning the storage directory. The cache is a binary file of fixed size records and one
+ * string table. It is memory mapped and the records are copied into the PDFItems as they are, nothing is parsed.
+ *
+ * The cache is only used if its MetadataCacheKey matches the current state. It is machine specific, caches of other versions, byte orders
+ * or truncated caches are ignored.
+ */
+class MetadataCache {
+  struct Impl;
+  std::unique_ptr<Impl> m_impl;
+
+  explicit MetadataCache(std::unique_ptr<Impl> impl);
+
+public:
+  static constexpr std::string_view fileName = ".zotero_to_file_tree_cache";
+
+  /**
+   *\brief Maps the cache of the output directory. Returns std::nullopt if there is none, if it is invalid or if its key does not match.
+   */
+  [[nodiscard]] static std::optional<MetadataCache> open(const std::filesystem::path& outputDir, const MetadataCacheKey& key);
+
+  /**
+   *\brief Writes the cache to the output directory. The previous cache is replaced atomically.
+   *
+   * @param dbState The state of the zotero db the pdf items were read from, restored by db_state().
+   * @param pdfItemCollections The collections of the pdf items and their ancestors, see all_pdf_item_collections.
+   * @return False if the cache could not be written.
+   */
+  static bool save(const std::filesystem::path& outputDir,
+                   const MetadataCacheKey& key,
+                   const ZoteroDBState& dbState,
+                   const PDFItems& pdfItems,
+                   const std::unordered_map<std::int64_t, ZoteroCollection>& pdfItemCollections);
+
+  ~MetadataCache();
+  MetadataCache(MetadataCache&&) noexcept;
+  MetadataCache& operator=(MetadataCache&&) noexcept;
+  MetadataCache(const MetadataCache&) = delete;
+  MetadataCache& operator=(const MetadataCache&) = delete;
+
+  [[nodiscard]] const ZoteroDBState& db_state() const;
+  [[nodiscard]] std::size_t pdf_item_count() const;
+
+  /**
+   *\brief Restores the pdf items, allocated from the given memory resource.
+   */
+  [[nodiscard]] PDFItems pdf_items(std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource()) const;
+
+  /**
+   *\brief Restores the collections of the pdf items and their ancestors.
+   */
+  [[nodiscard]] std::unordered_map<std::int64_t, ZoteroCollection> pdf_item_collections() const;
+};
+
+} // namespace zotfiles
+
+#endif // ZOTERO_TO_FILE_TREE_METADATACACHE_HPP
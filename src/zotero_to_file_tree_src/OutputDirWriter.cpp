@@ -0,0 +1,286 @@
+#include "OutputDirWriter.hpp"
+#include <algorithm>
+#include <fmt/format.h>
+
+namespace zotfiles
+{
+
+namespace
+{
+
+/**
+ *\brief The action of a pdf file that is placed into the output directory with the link mode.
+ */
+PlanAction transfer_action(LinkMode linkMode) {
+  return linkMode == LinkMode::HARDLINK || linkMode == LinkMode::SYMLINK ? PlanAction::LINK : PlanAction::COPY;
+}
+
+/**
+ *\brief True if the path does not leave the output directory, so a manifest entry can never remove a file outside of it.
+ */
+bool is_inside_output_dir(const std::filesystem::path& relFilePath) {
+  return relFilePath.is_relative() && std::none_of(relFilePath.begin(), relFilePath.end(), [](const auto& part) { return part == ".."; });
+}
+
+} // namespace
+
+OutputDirWriter::OutputDirWriter(std::filesystem::path outputDir, const WriteOptions& writeOptions)
+    : m_outputDir(std::move(outputDir))
+    , m_writeOptions(writeOptions)
+    , m_previousManifest(writeOptions.previousManifest ? *writeOptions.previousManifest
+                                                       : m_loadedManifest.emplace(Manifest::load(m_outputDir))) {}
+
+void OutputDirWriter::plan_directory(const std::filesystem::path& relDirPath,
+                                     const std::string& collectionName,
+                                     std::span<const CollectionPDFItem> pdfItems) {
+  std::error_code errorCode;
+  const bool dirExists = std::filesystem::is_directory(m_outputDir / relDirPath, errorCode);
+  if (!dirExists)
+  {
+    m_plan.add(PlanOperation{PlanAction::MKDIR, relDirPath.generic_string()});
+  }
+
+  for (const auto& pdfItem: pdfItems)
+  {
+    m_plan.add(plan_file(relDirPath, dirExists, collectionName, pdfItem));
+  }
+}
+
+PlanOperation OutputDirWriter::plan_file(const std::filesystem::path& relDirPath,
+                                         bool dirExists,
+                                         const std::string& collectionName,
+                                         const CollectionPDFItem& pdfItem) {
+  PlanOperation operation{PlanAction::SKIP, (relDirPath / pdfItem.pdfName).generic_string(), &pdfItem, &collectionName};
+  try
+  {
+    operation.sourceFileStat = source_file_stat(pdfItem.pdfFilePath);
+  }
+  catch (const std::filesystem::filesystem_error&)
+  {
+    // Reported by the copy worker, which reads the source file again.
+  }
+
+  if (!m_exportedRelPaths.insert(operation.relPath).second)
+  {
+    // Only possible with DuplicatePolicy::KEEP. The first pdf item wins, so concurrent copies never write the same file.
+    return operation;
+  }
+
+  operation.previousEntry = m_previousManifest.find(operation.relPath);
+  if (operation.previousEntry && operation.previousEntry->pdfItemId != pdfItem.pdfItemId && m_writeOptions.patchedItemIds &&
+      !m_writeOptions.patchedItemIds->contains(operation.previousEntry->pdfItemId))
+  {
+    // The file of an item that is not patched is kept, see finish_copies. Only possible with DuplicatePolicy::KEEP, the other policies
+    // reserve the names of the kept files when the collection tree is populated.
+    operation.previousEntry = nullptr;
+    return operation;
+  }
+  std::error_code errorCode;
+  const bool targetFileExists =
+      dirExists && std::filesystem::exists(std::filesystem::symlink_status(m_outputDir / relDirPath / pdfItem.pdfName, errorCode));
+  const bool writtenByPreviousExport = targetFileExists && operation.previousEntry != nullptr;
+  if (!m_writeOptions.overwriteExistingFiles && targetFileExists && !writtenByPreviousExport)
+  {
+    operation.action = PlanAction::SKIP;
+  }
+  else if (writtenByPreviousExport && !m_writeOptions.overwriteExistingFiles && operation.sourceFileStat &&
+           operation.previousEntry->linkMode == m_writeOptions.linkMode &&
+           (m_writeOptions.linkMode != LinkMode::SYMLINK || std::filesystem::exists(m_outputDir / operation.relPath, errorCode)) &&
+           operation.sourceFileStat->size == operation.previousEntry->sourceSize &&
+           operation.sourceFileStat->mtime == operation.previousEntry->sourceMTime)
+  {
+    operation.action = PlanAction::UNCHANGED;
+  }
+  else
+  {
+    // A copy of a source file with a new modification time may still turn out unchanged by its content hash.
+    operation.action = transfer_action(m_writeOptions.linkMode);
+  }
+  return operation;
+}
+
+const ExportPlan& OutputDirWriter::finish_plan() {
+  if (m_planFinished)
+  {
+    return m_plan;
+  }
+  m_planFinished = true;
+
+  // If patchedItemIds is set, only the files of the patched items are considered.
+  const std::set<std::int64_t>* patchedItemIds = m_writeOptions.patchedItemIds;
+  for (const auto& [relPath, entry]: m_previousManifest.entries())
+  {
+    if ((patchedItemIds && !patchedItemIds->contains(entry.pdfItemId)) || m_exportedRelPaths.contains(relPath) ||
+        !is_inside_output_dir(relPath))
+    {
+      continue;
+    }
+    std::error_code errorCode;
+    if (std::filesystem::exists(std::filesystem::symlink_status(m_outputDir / relPath, errorCode)))
+    {
+      m_plan.add(PlanOperation{PlanAction::REMOVE, relPath, nullptr, nullptr, &entry});
+    }
+  }
+  return m_plan;
+}
+
+bool OutputDirWriter::remove_stale_file(const std::string& relPath) const {
+  const std::filesystem::path relFilePath(relPath);
+  std::error_code errorCode;
+  if (!std::filesystem::remove(m_outputDir / relFilePath, errorCode))
+  {
+    return false;
+  }
+
+  for (auto relDirPath = relFilePath.parent_path(); !relDirPath.empty(); relDirPath = relDirPath.parent_path())
+  {
+    if (!std::filesystem::is_empty(m_outputDir / relDirPath, errorCode) || errorCode)
+    {
+      break;
+    }
+    std::filesystem::remove(m_outputDir / relDirPath, errorCode);
+  }
+  return true;
+}
+
+void OutputDirWriter::submit_file(const PlanOperation& operation, CopyExecutor& copyExecutor) const {
+  copyExecutor.submit(CopyJob{operation.pdfItem->pdfFilePath,
+                              m_outputDir / operation.relPath,
+                              operation.collectionName,
+                              operation.relPath,
+                              operation.pdfItem->pdfItemId,
+                              operation.previousEntry,
+                              operation.sourceFileStat});
+}
+
+WriteSummary OutputDirWriter::execute(Manifest* writtenManifest) {
+  const ExportPlan& plan = finish_plan();
+
+  CopyExecutor copyExecutor(m_writeOptions.jobs,
+                            m_writeOptions.overwriteExistingFiles,
+                            m_writeOptions.linkMode,
+                            m_writeOptions.tracer,
+                            m_writeOptions.copyBackend,
+                            m_writeOptions.queueDepth);
+  std::size_t skippedPDFs = 0;
+  for (const PlanOperation& operation: plan.operations())
+  {
+    switch (operation.action)
+    {
+    case PlanAction::MKDIR:
+    {
+      TraceSpan traceSpan(m_writeOptions.tracer, "create directory");
+      traceSpan.set_item_count(1);
+      std::filesystem::create_directories(m_outputDir / operation.relPath);
+      break;
+    }
+    case PlanAction::COPY:
+    case PlanAction::LINK:
+    case PlanAction::UNCHANGED:
+      submit_file(operation, copyExecutor);
+      break;
+    case PlanAction::SKIP:
+      ++skippedPDFs;
+      break;
+    case PlanAction::REMOVE:
+      // Removed after all copies are done.
+      break;
+    }
+  }
+  return finish_copies(copyExecutor, skippedPDFs, writtenManifest);
+}
+
+void OutputDirWriter::stream_pdf(const std::filesystem::path& relDirPath,
+                                 const std::string& collectionName,
+                                 const CollectionPDFItem& pdfItem) {
+  auto [dirIter, inserted] = m_streamedDirs.try_emplace(relDirPath.generic_string(), true);
+  if (inserted)
+  {
+    std::error_code errorCode;
+    dirIter->second = std::filesystem::is_directory(m_outputDir / relDirPath, errorCode);
+    if (!dirIter->second)
+    {
+      TraceSpan traceSpan(m_writeOptions.tracer, "create directory");
+      traceSpan.set_item_count(1);
+      std::filesystem::create_directories(m_outputDir / relDirPath);
+    }
+  }
+
+  const PlanOperation operation = plan_file(relDirPath, dirIter->second, collectionName, pdfItem);
+  if (operation.action == PlanAction::SKIP)
+  {
+    ++m_streamSkippedPDFs;
+    return;
+  }
+  submit_file(operation, stream_executor());
+}
+
+WriteSummary OutputDirWriter::finish_stream(Manifest* writtenManifest) {
+  // Only the removal of the stale files is planned, the streamed pdf files are already submitted.
+  static_cast<void>(finish_plan());
+  return finish_copies(stream_executor(), m_streamSkippedPDFs, writtenManifest);
+}
+
+CopyExecutor& OutputDirWriter::stream_executor() {
+  if (!m_streamExecutor)
+  {
+    m_streamExecutor = std::make_unique<CopyExecutor>(m_writeOptions.jobs,
+                                                      m_writeOptions.overwriteExistingFiles,
+                                                      m_writeOptions.linkMode,
+                                                      m_writeOptions.tracer,
+                                                      m_writeOptions.copyBackend,
+                                                      m_writeOptions.queueDepth);
+  }
+  return *m_streamExecutor;
+}
+
+WriteSummary OutputDirWriter::finish_copies(CopyExecutor& copyExecutor, std::size_t skippedPDFs, Manifest* writtenManifest) {
+  WriteSummary writeSummary;
+  {
+    TraceSpan traceSpan(m_writeOptions.tracer, "wait for copies");
+    writeSummary = copyExecutor.finish();
+  }
+  writeSummary.skippedPDFs += skippedPDFs;
+  {
+    TraceSpan traceSpan(m_writeOptions.tracer, "remove stale files");
+    for (const PlanOperation& operation: m_plan.operations())
+    {
+      if (operation.action == PlanAction::REMOVE && remove_stale_file(operation.relPath))
+      {
+        ++writeSummary.removedPDFs;
+      }
+    }
+    traceSpan.set_item_count(writeSummary.removedPDFs);
+  }
+
+  TraceSpan traceSpan(m_writeOptions.tracer, "save manifest");
+  Manifest manifest;
+  manifest.set_export_state(m_writeOptions.exportState);
+  if (m_writeOptions.patchedItemIds)
+  {
+    for (const auto& [relPath, entry]: m_previousManifest.entries())
+    {
+      if (!m_writeOptions.patchedItemIds->contains(entry.pdfItemId))
+      {
+        manifest.insert(entry);
+      }
+    }
+  }
+  for (ManifestEntry& entry: copyExecutor.take_manifest_entries())
+  {
+    manifest.insert(std::move(entry));
+  }
+  traceSpan.set_item_count(manifest.entries().size());
+  if (!manifest.save(m_outputDir))
+  {
+    fmt::print("Could not write the manifest to the output directory: {}\n", m_outputDir.string());
+  }
+  if (writtenManifest)
+  {
+    *writtenManifest = std::move(manifest);
+  }
+
+  return writeSummary;
+}
+
+} // namespace zotfiles
@@ -0,0 +1,140 @@
+#ifndef ZOTERO_TO_FILE_TREE_OUTPUTDIRWRITER_HPP
+#define ZOTERO_TO_FILE_TREE_OUTPUTDIRWRITER_HPP
+
+#include "CollectionPDFItem.hpp"
+#include "CopyExecutor.hpp"
+#include "ExportPlan.hpp"
+#include "Manifest.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <set>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace zotfiles
+{
+
+/** @brief Options for writing the pdf files of a CollectionTree to the output directory.
+ */
+struct WriteOptions {
+  bool overwriteExistingFiles{false};        /**< Replace pdf files that already exist in the output directory instead of skipping them. */
+  std::size_t jobs{1};                       /**< Number of pdf files that are copied concurrently. */
+  LinkMode linkMode{LinkMode::COPY};         /**< How the pdf files are placed into the output directory. */
+  const Manifest* previousManifest{nullptr}; /**< Manifest of the previous export. Loaded from the output directory if nullptr. */
+  /**
+   * If set, the collection tree only contains the pdf items with these ids, e.g. the items that changed since the previous export. The
+   * files of the previous export that belong to other items are kept.
+   */
+  const std::set<std::int64_t>* patchedItemIds{nullptr};
+  std::string exportState; /**< Stored in the manifest, see Manifest::export_state. */
+  Tracer* tracer{nullptr}; /**< If set, the directories, copies and the cleanup are recorded as spans. */
+  CopyBackend copyBackend{CopyBackend::THREADS}; /**< How the file content is copied with LinkMode::COPY. */
+  std::size_t queueDepth{64};                    /**< Number of copies in flight with CopyBackend::IO_URING. */
+};
+
+/**
+ *\brief Writes the collection directories of a collection tree and their pdf files to the output directory.
+ *
+ * An export has two phases. The collection tree hands its directories to plan_directory() in breadth-first order and the writer builds an
+ * ExportPlan of the directories to create and of the pdf files to copy, link, skip or remove. Planning reads the output directory and the
+ * source pdf files but changes nothing, so the plan of a dry run is the plan that an export would execute. execute() creates the
+ * directories in plan order in the calling thread, hands the pdf files of a directory to the copy workers once it exists, removes the
+ * stale files and saves the manifest. The copy workers check every file again, so changes between both phases are handled.
+ *
+ * A streamed export skips the plan. stream_pdf() plans a single pdf file, creates its directory on first use and hands the file to the
+ * copy workers right away, so copying starts while the pdf items are still read. finish_stream() removes the stale files and saves the
+ * manifest like execute().
+ */
+class OutputDirWriter {
+  std::filesystem::path m_outputDir;
+  const WriteOptions& m_writeOptions;
+  std::optional<Manifest> m_loadedManifest;
+  const Manifest& m_previousManifest;
+  std::unordered_set<std::string> m_exportedRelPaths;
+  ExportPlan m_plan;
+  bool m_planFinished{false};
+  std::unique_ptr<CopyExecutor> m_streamExecutor;
+  std::unordered_map<std::string, bool> m_streamedDirs; /**< Directories of the streamed pdf files, true if they existed before. */
+  std::size_t m_streamSkippedPDFs{};
+
+public:
+  OutputDirWriter(std::filesystem::path outputDir, const WriteOptions& writeOptions);
+
+  /**
+   *\brief Plans the directory and its pdf files.
+   *
+   * @param collectionName Name of the collection of the directory. Must stay valid until execute() returns, like the pdf items.
+   */
+  void plan_directory(const std::filesystem::path& relDirPath,
+                      const std::string& collectionName,
+                      std::span<const CollectionPDFItem> pdfItems);
+
+  /**
+   *\brief Adds the removal of the stale files of the previous export and returns the complete plan.
+   */
+  const ExportPlan& finish_plan();
+
+  /**
+   *\brief Executes the plan, waits for all copies, removes stale files and saves the manifest.
+   *
+   * @param writtenManifest If set, receives the manifest that was written to the output directory.
+   */
+  WriteSummary execute(Manifest* writtenManifest);
+
+  /**
+   *\brief Plans the pdf file and hands it to the copy workers, without building a plan first. The directory is created if necessary.
+   *
+   * Must not be mixed with plan_directory() on the same writer.
+   *
+   * @param collectionName Name of the collection of the directory. Must stay valid until finish_stream() returns.
+   * @param pdfItem Only used during the call.
+   */
+  void stream_pdf(const std::filesystem::path& relDirPath, const std::string& collectionName, const CollectionPDFItem& pdfItem);
+
+  /**
+   *\brief Waits for the copies of the streamed pdf files, removes stale files and saves the manifest.
+   *
+   * @param writtenManifest If set, receives the manifest that was written to the output directory.
+   */
+  WriteSummary finish_stream(Manifest* writtenManifest);
+
+private:
+  /**
+   *\brief Plans a single pdf file of the directory.
+   *
+   * @param dirExists True if the directory existed before the export. The files of a new directory need not be checked.
+   */
+  [[nodiscard]] PlanOperation plan_file(const std::filesystem::path& relDirPath,
+                                        bool dirExists,
+                                        const std::string& collectionName,
+                                        const CollectionPDFItem& pdfItem);
+
+  /**
+   *\brief Hands a planned pdf file that is copied, linked or unchanged to the copy executor.
+   */
+  void submit_file(const PlanOperation& operation, CopyExecutor& copyExecutor) const;
+
+  /**
+   *\brief The copy executor of a streamed export, created with the first streamed pdf file.
+   */
+  CopyExecutor& stream_executor();
+
+  /**
+   *\brief Waits for all copies, removes the stale files of the plan and saves the manifest.
+   */
+  WriteSummary finish_copies(CopyExecutor& copyExecutor, std::size_t skippedPDFs, Manifest* writtenManifest);
+
+
+  /**
+   *\brief Removes the file and the directories that become empty.
+   */
+  bool remove_stale_file(const std::string& relPath) const;
+};
+
+} // namespace zotfiles
+
+#endif // ZOTERO_TO_FILE_TREE_OUTPUTDIRWRITER_HPP
@@ -3,19 +3,22 @@
 
 #include "ZoteroCollection.hpp"
 #include "ZoteroPDFAttachment.hpp"
+#include <cstdint>
 #include <filesystem>
-#include <vector>
 
 namespace zotfiles
 {
 
 /**
  *\brief Represents a pdf file in the storage directory.
+ *
+ * The collections of a PDFItem are stored once in the PDFItems that own the item, see PDFItems::collections.
  */
 struct PDFItem {
-  ZoteroPDFAttachment pdfAttachment;             /**< pdfAttachment The entry in the zotero db that represents the pdf file. */
-  std::filesystem::path pdfFilePath;             /**< pdfFilePath The absolute path to the pdf file on the file system. */
-  std::vector<ZoteroCollection> collectionItems; /**< collectionItems The zotero collections that the pdf file is in. */
+  ZoteroPDFAttachment pdfAttachment;  /**< pdfAttachment The entry in the zotero db that represents the pdf file. */
+  std::filesystem::path pdfFilePath;  /**< pdfFilePath The absolute path to the pdf file on the file system. */
+  std::uint32_t firstCollectionRef{}; /**< Index of the first collection reference of the item in its PDFItems. */
+  std::uint32_t collectionCount{};    /**< Number of zotero collections that the pdf file is in. */
 };
 
 } // namespace zotfiles
@@ -0,0 +1,79 @@
+#include "PDFItems.hpp"
+#include <string>
+
+namespace zotfiles
+{
+
+PDFItems::PDFItems(const PDFItems& other)
+    : m_items(other.m_items.begin(), other.m_items.end())
+    , m_collectionRefs(other.m_collectionRefs.begin(), other.m_collectionRefs.end())
+    , m_collections(other.m_collections.begin(), other.m_collections.end())
+    , m_collectionIndex(other.m_collectionIndex.begin(), other.m_collectionIndex.end()) {
+  // The copied attachments still point into the string pool of other.
+  for (PDFItem& item: m_items)
+  {
+    item.pdfAttachment.path = m_strings.store(item.pdfAttachment.path);
+    item.pdfAttachment.key = m_strings.store(item.pdfAttachment.key);
+  }
+}
+
+PDFItems& PDFItems::operator=(const PDFItems& other) {
+  if (this != &other)
+  {
+    *this = PDFItems(other);
+  }
+  return *this;
+}
+
+std::size_t PDFItems::add(std::int64_t itemID, std::int64_t parentItemID, std::string_view path, std::string_view key) {
+  PDFItem& item = m_items.emplace_back();
+  item.pdfAttachment = ZoteroPDFAttachment{itemID, parentItemID, m_strings.store(path), m_strings.store(key)};
+  item.firstCollectionRef = static_cast<std::uint32_t>(m_collectionRefs.size());
+  return m_items.size() - 1;
+}
+
+std::size_t PDFItems::add(std::int64_t itemID,
+                          std::int64_t parentItemID,
+                          std::string_view path,
+                          std::string_view key,
+                          const std::filesystem::path& pdfFilePath,
+                          std::span<const std::uint32_t> collectionRefs) {
+  const std::size_t itemIndex = add(itemID, parentItemID, path, key);
+  PDFItem& item = m_items[itemIndex];
+  item.pdfFilePath = pdfFilePath;
+  item.collectionCount = static_cast<std::uint32_t>(collectionRefs.size());
+  m_collectionRefs.insert(m_collectionRefs.end(), collectionRefs.begin(), collectionRefs.end());
+  return itemIndex;
+}
+
+std::uint32_t PDFItems::store_collection(std::int64_t collectionID, std::int64_t parentCollectionID, std::string_view collectionName) {
+  auto [indexIter, inserted] = m_collectionIndex.try_emplace(collectionID, static_cast<std::uint32_t>(m_collections.size()));
+  if (inserted)
+  {
+    m_collections.push_back(ZoteroCollection{collectionID, parentCollectionID, std::string(collectionName)});
+  }
+  return indexIter->second;
+}
+
+void PDFItems::add_collection(std::size_t itemIndex,
+                              std::int64_t collectionID,
+                              std::int64_t parentCollectionID,
+                              std::string_view collectionName) {
+  const std::uint32_t collectionRef = store_collection(collectionID, parentCollectionID, collectionName);
+
+  PDFItem& item = m_items[itemIndex];
+  if (item.firstCollectionRef + item.collectionCount != m_collectionRefs.size())
+  {
+    // Another item added collections after this item, the range of this item is continued at the end.
+    const auto newFirstCollectionRef = static_cast<std::uint32_t>(m_collectionRefs.size());
+    for (std::size_t i = item.firstCollectionRef; i < item.firstCollectionRef + item.collectionCount; ++i)
+    {
+      m_collectionRefs.push_back(m_collectionRefs[i]);
+    }
+    item.firstCollectionRef = newFirstCollectionRef;
+  }
+  m_collectionRefs.push_back(collectionRef);
+  ++item.collectionCount;
+}
+
+} // namespace zotfiles
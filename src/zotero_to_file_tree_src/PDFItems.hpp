@@ -0,0 +1,135 @@
+#ifndef ZOTERO_TO_FILE_TREE_PDFITEMS_HPP
+#define ZOTERO_TO_FILE_TREE_PDFITEMS_HPP
+
+#include "PDFItem.hpp"
+#include "StringPool.hpp"
+#include "ZoteroCollection.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory_resource>
+#include <ranges>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace zotfiles
+{
+
+/**
+ *\brief The PDFItems of an export together with their collections.
+ *
+ * Every collection is stored once, no matter how many pdf items are part of it. A PDFItem refers to its collections with a range of
+ * collection references, which are indices into the collection array. The paths and keys of the attachments are stored in a string pool,
+ * so reading an attachment does not allocate per string. The arrays and the string pool are allocated from the given memory resource, e.g.
+ * the RunArena of an export. The pdfFilePath of the items is allocated from the heap, std::filesystem::path does not take an allocator.
+ */
+class PDFItems {
+  std::pmr::deque<PDFItem> m_items; /**< A deque, growing it in a monotonic arena does not leave the old arrays behind like a vector. */
+  std::pmr::vector<std::uint32_t> m_collectionRefs; /**< The collection ranges of all items, indices into m_collections. */
+  std::pmr::vector<ZoteroCollection> m_collections;
+  std::pmr::unordered_map<std::int64_t, std::uint32_t> m_collectionIndex; /**< Index into m_collections by collectionID. */
+  StringPool m_strings;
+
+public:
+  using iterator = std::pmr::deque<PDFItem>::iterator;
+  using const_iterator = std::pmr::deque<PDFItem>::const_iterator;
+
+  explicit PDFItems(std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource())
+      : m_items(memoryResource)
+      , m_collectionRefs(memoryResource)
+      , m_collections(memoryResource)
+      , m_collectionIndex(memoryResource)
+      , m_strings(memoryResource) {}
+  PDFItems(PDFItems&&) noexcept = default;
+  PDFItems& operator=(PDFItems&&) = default;
+  ~PDFItems() = default;
+
+  /**
+   *\brief Copies the items and their collections. The copy and its strings are allocated from the default memory resource.
+   */
+  PDFItems(const PDFItems& other);
+  PDFItems& operator=(const PDFItems& other);
+
+  /**
+   *\brief Adds a pdf item without collections and without a resolved pdf file. The path and the key are copied into the string pool.
+   *
+   * @return The index of the added item.
+   */
+  std::size_t add(std::int64_t itemID, std::int64_t parentItemID, std::string_view path, std::string_view key);
+
+  /**
+   *\brief Adds a collection to the item with the given index. The collection is stored once for all items.
+   *
+   * The collections of an item are stored as one range. Adding collections item by item, like the rows of a query grouped by item, only
+   * appends to the range. Otherwise the range of the item is moved to the end first.
+   */
+  void add_collection(std::size_t itemIndex, std::int64_t collectionID, std::int64_t parentCollectionID, std::string_view collectionName);
+
+  /**
+   *\brief Stores a collection once without adding it to an item.
+   *
+   * @return The collection reference of the collection, see add.
+   */
+  std::uint32_t store_collection(std::int64_t collectionID, std::int64_t parentCollectionID, std::string_view collectionName);
+
+  /**
+   *\brief Adds a pdf item with a resolved pdf file and known collections, e.g. an item restored from a MetadataCache.
+   *
+   * @param collectionRefs References returned by store_collection.
+   * @return The index of the added item.
+   */
+  std::size_t add(std::int64_t itemID,
+                  std::int64_t parentItemID,
+                  std::string_view path,
+                  std::string_view key,
+                  const std::filesystem::path& pdfFilePath,
+                  std::span<const std::uint32_t> collectionRefs);
+
+  /**
+   *\brief Erases the items for which the predicate returns true. The collections stay stored.
+   */
+  template <typename Predicate>
+  void erase_if(Predicate predicate) {
+    std::erase_if(m_items, predicate);
+  }
+
+  [[nodiscard]] std::span<const std::uint32_t> collection_refs(const PDFItem& item) const {
+    return std::span(m_collectionRefs).subspan(item.firstCollectionRef, item.collectionCount);
+  }
+  [[nodiscard]] const ZoteroCollection& collection(std::uint32_t collectionRef) const { return m_collections[collectionRef]; }
+
+  /**
+   *\brief The collections of the given item.
+   */
+  [[nodiscard]] auto collections(const PDFItem& item) const {
+    return collection_refs(item) |
+           std::views::transform([this](std::uint32_t collectionRef) -> const ZoteroCollection& { return collection(collectionRef); });
+  }
+
+  /**
+   *\brief All collections that were added, including the collections of erased items.
+   */
+  [[nodiscard]] std::span<const ZoteroCollection> all_collections() const { return m_collections; }
+
+  /**
+   *\brief The memory resource of the items, also used for temporary data derived from them.
+   */
+  [[nodiscard]] std::pmr::memory_resource* memory_resource() const { return m_items.get_allocator().resource(); }
+
+  [[nodiscard]] iterator begin() { return m_items.begin(); }
+  [[nodiscard]] iterator end() { return m_items.end(); }
+  [[nodiscard]] const_iterator begin() const { return m_items.begin(); }
+  [[nodiscard]] const_iterator end() const { return m_items.end(); }
+  [[nodiscard]] std::size_t size() const { return m_items.size(); }
+  [[nodiscard]] bool empty() const { return m_items.empty(); }
+  [[nodiscard]] PDFItem& operator[](std::size_t index) { return m_items[index]; }
+  [[nodiscard]] const PDFItem& operator[](std::size_t index) const { return m_items[index]; }
+};
+
+} // namespace zotfiles
+
+#endif // ZOTERO_TO_FILE_TREE_PDFITEMS_HPP
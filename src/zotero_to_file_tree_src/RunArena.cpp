@@ -0,0 +1,38 @@
+#include "RunArena.hpp"
+
+#if defined(__linux__)
+#include <sys/resource.h>
+#endif
+
+namespace zotfiles
+{
+
+void* CountingMemoryResource::do_allocate(std::size_t bytes, std::size_t alignment) {
+  ++m_allocationCount;
+  m_allocatedBytes += bytes;
+  return m_upstream->allocate(bytes, alignment);
+}
+
+void CountingMemoryResource::do_deallocate(void* pointer, std::size_t bytes, std::size_t alignment) {
+  m_upstream->deallocate(pointer, bytes, alignment);
+}
+
+ArenaStats RunArena::stats() const {
+  return ArenaStats{m_requests.allocation_count(), m_requests.allocated_bytes(), m_heap.allocation_count(), m_heap.allocated_bytes()};
+}
+
+std::size_t peak_rss_bytes() {
+#if defined(__linux__)
+  rusage usage{};
+  if (::getrusage(RUSAGE_SELF, &usage) != 0)
+  {
+    return 0;
+  }
+  // Linux reports the maximum resident set size in KiB.
+  return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+#else
+  return 0;
+#endif
+}
+
+} // namespace zotfiles
@@ -0,0 +1,66 @@
+#ifndef ZOTERO_TO_FILE_TREE_RUNARENA_HPP
+#define ZOTERO_TO_FILE_TREE_RUNARENA_HPP
+
+#include <cstddef>
+#include <memory_resource>
+
+namespace zotfiles
+{
+
+/**
+ *\brief Passes all allocations to the upstream resource and counts them. Not thread safe, like the monotonic arena it is used with.
+ */
+class CountingMemoryResource : public std::pmr::memory_resource {
+  std::pmr::memory_resource* m_upstream;
+  std::size_t m_allocationCount{};
+  std::size_t m_allocatedBytes{};
+
+public:
+  explicit CountingMemoryResource(std::pmr::memory_resource* upstream)
+      : m_upstream(upstream) {}
+
+  [[nodiscard]] std::size_t allocation_count() const { return m_allocationCount; }
+  [[nodiscard]] std::size_t allocated_bytes() const { return m_allocatedBytes; }
+
+private:
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+  void do_deallocate(void* pointer, std::size_t bytes, std::size_t alignment) override;
+  [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+struct ArenaStats {
+  std::size_t allocations{};     /**< Allocations served by the arena. */
+  std::size_t allocatedBytes{};  /**< Bytes of the allocations served by the arena. */
+  std::size_t heapAllocations{}; /**< Buffers the arena allocated from the heap to serve the allocations. */
+  std::size_t heapBytes{};       /**< Bytes of the buffers of the arena. */
+};
+
+/**
+ *\brief The monotonic arena of one export run.
+ *
+ * The pdf items of a run and the temporary indices built from them are allocated with resource(). An allocation from the arena bumps a
+ * pointer in a large buffer, and nothing is freed until the arena is destroyed, which frees all buffers at once. Memory freed by the
+ * containers before, e.g. the old buffer of a growing vector, is not reused.
+ */
+class RunArena {
+  CountingMemoryResource m_heap{std::pmr::new_delete_resource()};
+  std::pmr::monotonic_buffer_resource m_arena{&m_heap};
+  CountingMemoryResource m_requests{&m_arena};
+
+public:
+  RunArena() = default;
+  RunArena(const RunArena&) = delete;
+  RunArena& operator=(const RunArena&) = delete;
+
+  [[nodiscard]] std::pmr::memory_resource* resource() { return &m_requests; }
+  [[nodiscard]] ArenaStats stats() const;
+};
+
+/**
+ *\brief The peak resident set size of the process in bytes so far. 0 if it is not available on the platform.
+ */
+[[nodiscard]] std::size_t peak_rss_bytes();
+
+} // namespace zotfiles
+
+#endif // ZOTERO_TO_FILE_TREE_RUNARENA_HPP
@@ -0,0 +1,392 @@
+#include "StorageIndex.hpp"
+#include <algorithm>
+#include <atomic>
+#include <optional>
+#include <thread>
+
+#if defined(__linux__)
+#include "FileDescriptor.hpp"
+#include <array>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace zotfiles
+{
+
+bool is_pdf_file_name(std::string_view fileName) {
+  static constexpr std::string_view pdfExtension = ".pdf";
+  // A file named ".pdf" has no extension, see std::filesystem::path::extension.
+  return fileName.size() > pdfExtension.size() && fileName.ends_with(pdfExtension);
+}
+
+namespace
+{
+
+/**
+ *\brief Hash of one key directory for StorageIndex::key_dirs_fingerprint, mixed with the finalizer of splitmix64.
+ */
+std::uint64_t key_dir_hash(std::string_view key, std::int64_t mtime) {
+  std::uint64_t hash = std::hash<std::string_view>{}(key) ^ static_cast<std::uint64_t>(mtime);
+  hash = (hash ^ (hash >> 30U)) * 0xbf58476d1ce4e5b9ULL;
+  hash = (hash ^ (hash >> 27U)) * 0x94d049bb133111ebULL;
+  return hash ^ (hash >> 31U);
+}
+
+#if defined(__linux__)
+
+/**
+ *\brief Calls entryFunc(name, d_type) for every entry of the open directory, except "." and "..".
+ *
+ * The directory is read in large batches with getdents64, without a stat call per entry.
+ *
+ * @return False if the directory could not be read.
+ */
+template <typename EntryFunc>
+bool for_each_dir_entry(int dirFd, EntryFunc&& entryFunc) {
+  alignas(dirent64) std::array<char, 32 * 1024> buffer;
+  while (true)
+  {
+    const long readBytes = ::syscall(SYS_getdents64, dirFd, buffer.data(), buffer.size());
+    if (readBytes < 0)
+    {
+      return false;
+    }
+    if (readBytes == 0)
+    {
+      return true;
+    }
+
+    std::size_t offset = 0;
+    while (offset < static_cast<std::size_t>(readBytes))
+    {
+      const char* record = buffer.data() + offset;
+      unsigned short recordLength{};
+      std::memcpy(&recordLength, record + offsetof(dirent64, d_reclen), sizeof(recordLength));
+      unsigned char type{};
+      std::memcpy(&type, record + offsetof(dirent64, d_type), sizeof(type));
+      const std::string_view name(record + offsetof(dirent64, d_name));
+      if (name != "." && name != "..")
+      {
+        entryFunc(name, type);
+      }
+      offset += recordLength;
+    }
+  }
+}
+
+/**
+ *\brief The opened storage directory. Key directories are opened relative to its file descriptor.
+ */
+class StorageDir {
+  std::filesystem::path m_storageDir;
+  FileDescriptor m_storageFd;
+
+public:
+  explicit StorageDir(std::filesystem::path storageDir)
+      : m_storageDir(std::move(storageDir))
+      , m_storageFd(::open(m_storageDir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)) {}
+
+  [[nodiscard]] bool valid() const { return m_storageFd.valid(); }
+
+  /**
+   *\brief Names of all entries of the storage directory that may be key directories.
+   */
+  [[nodiscard]] std::vector<std::string> key_candidates() const {
+    std::vector<std::string> keys;
+    for_each_dir_entry(m_storageFd.get(),
+                       [&keys](std::string_view key, unsigned char keyType)
+                       {
+                         // Every other type, including DT_UNKNOWN, is resolved when the entry is opened as a directory.
+                         if (keyType != DT_REG)
+                         {
+                           keys.emplace_back(key);
+                         }
+                       });
+    return keys;
+  }
+
+  /**
+   *\brief Scans a key directory. Returns std::nullopt if the key is not a directory.
+   */
+  [[nodiscard]] std::optional<StorageIndex::Entry> scan_key_dir(const std::string& key) const {
+    const FileDescriptor keyFd(::openat(m_storageFd.get(), key.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (!keyFd.valid())
+    {
+      return std::nullopt;
+    }
+
+    StorageIndex::Entry entry;
+    for_each_dir_entry(keyFd.get(),
+                       [this, &entry, &key](std::string_view fileName, unsigned char fileType)
+                       {
+                         if (fileType == DT_DIR || !is_pdf_file_name(fileName))
+                         {
+                           return;
+                         }
+                         if (entry.pdfFileCount == 0)
+                         {
+                           entry.pdfFilePath = m_storageDir / key / fileName;
+                         }
+                         ++entry.pdfFileCount;
+                       });
+    return entry;
+  }
+
+  /**
+   *\brief Modification time of a key directory in nanoseconds since the epoch. Returns std::nullopt if the key is not a directory.
+   */
+  [[nodiscard]] std::optional<std::int64_t> key_dir_mtime(const std::string& key) const {
+    struct stat keyStat{};
+    if (::fstatat(m_storageFd.get(), key.c_str(), &keyStat, 0) != 0 || !S_ISDIR(keyStat.st_mode))
+    {
+      return std::nullopt;
+    }
+    return std::int64_t{keyStat.st_mtim.tv_sec} * 1'000'000'000 + keyStat.st_mtim.tv_nsec;
+  }
+};
+
+#else
+
+/**
+ *\brief The storage directory, read with std::filesystem on platforms without getdents64.
+ */
+class StorageDir {
+  std::filesystem::path m_storageDir;
+
+public:
+  explicit StorageDir(std::filesystem::path storageDir)
+      : m_storageDir(std::move(storageDir)) {}
+
+  [[nodiscard]] bool valid() const {
+    std::error_code errorCode;
+    return std::filesystem::is_directory(m_storageDir, errorCode);
+  }
+
+  [[nodiscard]] std::vector<std::string> key_candidates() const {
+    std::vector<std::string> keys;
+    std::error_code errorCode;
+    for (const auto& keyDir: std::filesystem::directory_iterator(m_storageDir, errorCode))
+    {
+      if (keyDir.is_directory(errorCode))
+      {
+        keys.push_back(keyDir.path().filename().string());
+      }
+    }
+    return keys;
+  }
+
+  [[nodiscard]] std::optional<StorageIndex::Entry> scan_key_dir(const std::string& key) const {
+    StorageIndex::Entry entry;
+    std::error_code errorCode;
+    for (const auto& file: std::filesystem::directory_iterator(m_storageDir / key, errorCode))
+    {
+      if (file.path().extension() != ".pdf")
+      {
+        continue;
+      }
+      if (entry.pdfFileCount == 0)
+      {
+        entry.pdfFilePath = file.path();
+      }
+      ++entry.pdfFileCount;
+    }
+    if (errorCode)
+    {
+      return std::nullopt;
+    }
+    return entry;
+  }
+
+  [[nodiscard]] std::optional<std::int64_t> key_dir_mtime(const std::string& key) const {
+    std::error_code errorCode;
+    const std::filesystem::path keyDir = m_storageDir / key;
+    const std::filesystem::file_time_type mtime = std::filesystem::last_write_time(keyDir, errorCode);
+    if (errorCode || !std::filesystem::is_directory(keyDir, errorCode))
+    {
+      return std::nullopt;
+    }
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(mtime.time_since_epoch()).count();
+  }
+};
+
+#endif
+
+} // namespace
+
+StorageIndex StorageIndex::build(const std::filesystem::path& storageDir, std::size_t scanJobs, Tracer* tracer) {
+  return scan(storageDir, nullptr, scanJobs, tracer);
+}
+
+StorageIndex StorageIndex::build_for_keys(const std::filesystem::path& storageDir,
+                                          const std::vector<std::string>& keys,
+                                          std::size_t scanJobs,
+                                          Tracer* tracer) {
+  return scan(storageDir, &keys, scanJobs, tracer);
+}
+
+StorageIndex StorageIndex::scan(const std::filesystem::path& storageDir,
+                                const std::vector<std::string>* selectedKeys,
+                                std::size_t scanJobs,
+                                Tracer* tracer) {
+  StorageIndex storageIndex;
+  storageIndex.m_storageDir = storageDir;
+
+  const StorageDir dir(storageDir);
+  if (!dir.valid())
+  {
+    return storageIndex;
+  }
+
+  const std::vector<std::string> keys = selectedKeys ? *selectedKeys : dir.key_candidates();
+  std::vector<std::optional<Entry>> entries(keys.size());
+
+  // Workers fetch small batches of keys, so slow directories (e.g. on network file systems) do not stall a whole partition. Every
+  // result is written to the slot of its key, which keeps the index independent of the scheduling.
+  static constexpr std::size_t batchSize = 32;
+  std::atomic<std::size_t> nextKey{0};
+  const std::size_t workerCount = std::clamp<std::size_t>(scanJobs, 1, std::max<std::size_t>(1, keys.size() / batchSize));
+  storageIndex.m_workerStats.resize(workerCount);
+
+  auto worker = [&dir, &keys, &entries, &nextKey, tracer](WorkerStats& workerStats)
+  {
+    // The span is recorded on the thread of the worker, so --trace shows every worker on its own track.
+    TraceSpan traceSpan(tracer, "storage scan worker");
+    const auto start = std::chrono::steady_clock::now();
+    while (true)
+    {
+      const std::size_t first = nextKey.fetch_add(batchSize);
+      if (first >= keys.size())
+      {
+        break;
+      }
+      const std::size_t last = std::min(first + batchSize, keys.size());
+      for (std::size_t i = first; i < last; ++i)
+      {
+        entries[i] = dir.scan_key_dir(keys[i]);
+        if (entries[i])
+        {
+          ++workerStats.scannedDirs;
+        }
+      }
+    }
+    workerStats.scanDuration = std::chrono::steady_clock::now() - start;
+    traceSpan.set_item_count(workerStats.scannedDirs);
+  };
+
+  {
+    std::vector<std::jthread> workers;
+    workers.reserve(workerCount - 1);
+    for (std::size_t i = 1; i < workerCount; ++i)
+    {
+      workers.emplace_back(worker, std::ref(storageIndex.m_workerStats[i]));
+    }
+    worker(storageIndex.m_workerStats[0]);
+  }
+
+  storageIndex.m_entries.reserve(keys.size());
+  for (std::size_t i = 0; i < keys.size(); ++i)
+  {
+    if (!entries[i])
+    {
+      continue;
+    }
+    ++storageIndex.m_scannedDirs;
+    if (entries[i]->pdfFileCount > 0)
+    {
+      storageIndex.m_entries.emplace(keys[i], std::move(*entries[i]));
+    }
+  }
+
+  return storageIndex;
+}
+
+std::uint64_t StorageIndex::key_dirs_fingerprint(const std::filesystem::path& storageDir, std::size_t scanJobs) {
+  const StorageDir dir(storageDir);
+  if (!dir.valid())
+  {
+    return 0;
+  }
+
+  // The hashes of the key directories are added up, so the fingerprint does not depend on the order of the entries or on the workers.
+  const std::vector<std::string> keys = dir.key_candidates();
+  static constexpr std::size_t batchSize = 256;
+  std::atomic<std::size_t> nextKey{0};
+  std::atomic<std::uint64_t> fingerprint{0};
+  const std::size_t workerCount = std::clamp<std::size_t>(scanJobs, 1, std::max<std::size_t>(1, keys.size() / batchSize));
+
+  auto worker = [&dir, &keys, &nextKey, &fingerprint]()
+  {
+    std::uint64_t workerFingerprint = 0;
+    while (true)
+    {
+      const std::size_t first = nextKey.fetch_add(batchSize);
+      if (first >= keys.size())
+      {
+        break;
+      }
+      const std::size_t last = std::min(first + batchSize, keys.size());
+      for (std::size_t i = first; i < last; ++i)
+      {
+        if (const std::optional<std::int64_t> mtime = dir.key_dir_mtime(keys[i]))
+        {
+          workerFingerprint += key_dir_hash(keys[i], *mtime);
+        }
+      }
+    }
+    fingerprint += workerFingerprint;
+  };
+
+  {
+    std::vector<std::jthread> workers;
+    workers.reserve(workerCount - 1);
+    for (std::size_t i = 1; i < workerCount; ++i)
+    {
+      workers.emplace_back(worker);
+    }
+    worker();
+  }
+  return fingerprint;
+}
+
+const StorageIndex::Entry* StorageIndex::find(std::string_view key) const {
+  auto iter = m_entries.find(key);
+  if (iter == m_entries.end())
+  {
+    return nullptr;
+  }
+  return &iter->second;
+}
+
+struct StorageKeyScanner::Impl {
+  explicit Impl(const std::filesystem::path& storageDir)
+      : dir(storageDir) {}
+
+  StorageDir dir;
+};
+
+StorageKeyScanner::StorageKeyScanner(const std::filesystem::path& storageDir)
+    : m_impl(std::make_unique<Impl>(storageDir)) {}
+
+StorageKeyScanner::StorageKeyScanner(StorageKeyScanner&&) noexcept = default;
+StorageKeyScanner& StorageKeyScanner::operator=(StorageKeyScanner&&) noexcept = default;
+StorageKeyScanner::~StorageKeyScanner() = default;
+
+std::optional<StorageIndex::Entry> StorageKeyScanner::scan(const std::string& key) const {
+  if (!m_impl->dir.valid())
+  {
+    return std::nullopt;
+  }
+  std::optional<StorageIndex::Entry> entry = m_impl->dir.scan_key_dir(key);
+  if (entry && entry->pdfFileCount == 0)
+  {
+    return std::nullopt;
+  }
+  return entry;
+}
+
+} // namespace zotfiles
@@ -0,0 +1,146 @@
+#ifndef ZOTERO_TO_FILE_TREE_STORAGEINDEX_HPP
+#define ZOTERO_TO_FILE_TREE_STORAGEINDEX_HPP
+
+#include "Trace.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace zotfiles
+{
+
+/**
+ *\brief Index of the pdf files in the zotero storage directory.
+ *
+ * The zotero storage directory contains one directory per attachment, named after the attachment key. The index enumerates the storage
+ * directory once and maps every key to the pdf files found in its directory, so resolving the pdf file of an attachment is a hash lookup.
+ * On linux the directories are read with getdents64 relative to the directory file descriptor of the storage directory.
+ *
+ * The key directories are independent of each other and are scanned by a configurable number of workers. The resulting index does not
+ * depend on the number of workers.
+ */
+class StorageIndex {
+public:
+  struct Entry {
+    std::filesystem::path pdfFilePath; /**< Absolute path of the first pdf file found in the key directory. */
+    std::size_t pdfFileCount{};        /**< Number of pdf files in the key directory. */
+  };
+
+  struct WorkerStats {
+    std::size_t scannedDirs{};               /**< Number of key directories scanned by the worker. */
+    std::chrono::nanoseconds scanDuration{}; /**< Wall time from the start of the worker until it ran out of key directories. */
+  };
+
+  /**
+   *\brief Enumerates the given storage directory.
+   *
+   * @param storageDir Absolute path to the zotero storage directory. An index without entries is returned if it does not exist.
+   * @param scanJobs Number of workers that scan the key directories. Values smaller than 1 are treated as 1.
+   * @param tracer Records one "storage scan worker" span per worker. May be nullptr.
+   */
+  [[nodiscard]] static StorageIndex build(const std::filesystem::path& storageDir, std::size_t scanJobs = 1, Tracer* tracer = nullptr);
+
+  /**
+   *\brief Scans only the key directories of the given attachment keys, e.g. the keys of the attachments changed since the last export.
+   *
+   * @param storageDir Absolute path to the zotero storage directory.
+   * @param keys The attachment keys to scan. Keys without a key directory have no entry.
+   * @param scanJobs Number of workers that scan the key directories. Values smaller than 1 are treated as 1.
+   * @param tracer Records one "storage scan worker" span per worker. May be nullptr.
+   */
+  [[nodiscard]] static StorageIndex build_for_keys(const std::filesystem::path& storageDir,
+                                                   const std::vector<std::string>& keys,
+                                                   std::size_t scanJobs = 1,
+                                                   Tracer* tracer = nullptr);
+
+  /**
+   *\brief Fingerprint of the names and modification times of all key directories of the storage directory.
+   *
+   * Adding, removing or renaming a pdf file changes the modification time of its key directory, so the fingerprint changes whenever a
+   * scan could find other pdf files. The key directories are only stat'ed, their entries are not read. 0 if the storage directory does not
+   * exist.
+   *
+   * @param scanJobs Number of workers that stat the key directories. Values smaller than 1 are treated as 1.
+   */
+  [[nodiscard]] static std::uint64_t key_dirs_fingerprint(const std::filesystem::path& storageDir, std::size_t scanJobs = 1);
+
+  /**
+   *\brief Returns the entry of the given attachment key or nullptr if no pdf file exists for the key.
+   */
+  [[nodiscard]] const Entry* find(std::string_view key) const;
+
+  [[nodiscard]] const std::filesystem::path& storage_dir() const { return m_storageDir; }
+
+  /**
+   *\brief Number of key directories containing at least one pdf file.
+   */
+  [[nodiscard]] std::size_t size() const { return m_entries.size(); }
+
+  /**
+   *\brief Number of key directories that were scanned, including directories without pdf files.
+   */
+  [[nodiscard]] std::size_t scanned_dirs() const { return m_scannedDirs; }
+
+  /**
+   *\brief Timing of every worker of the last build, ordered by worker index.
+   */
+  [[nodiscard]] const std::vector<WorkerStats>& worker_stats() const { return m_workerStats; }
+
+private:
+  [[nodiscard]] static StorageIndex
+  scan(const std::filesystem::path& storageDir, const std::vector<std::string>* keys, std::size_t scanJobs, Tracer* tracer);
+
+  /**
+   *\brief Hashes std::string and std::string_view alike, so an entry is found by a key view without creating a std::string.
+   */
+  struct KeyHash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view key) const noexcept { return std::hash<std::string_view>{}(key); }
+  };
+
+  std::filesystem::path m_storageDir;
+  std::unordered_map<std::string, Entry, KeyHash, std::equal_to<>> m_entries;
+  std::size_t m_scannedDirs{};
+  std::vector<WorkerStats> m_workerStats;
+};
+
+/**
+ *\brief Scans single key directories of a storage directory, e.g. the key of every attachment as it is read from the database.
+ *
+ * The storage directory is opened once, every key directory is opened relative to it. Scanning is thread safe.
+ */
+class StorageKeyScanner {
+  struct Impl;
+  std::unique_ptr<Impl> m_impl;
+
+public:
+  /**
+   *@param storageDir Absolute path to the zotero storage directory. No key is found if it does not exist.
+   */
+  explicit StorageKeyScanner(const std::filesystem::path& storageDir);
+  StorageKeyScanner(StorageKeyScanner&&) noexcept;
+  StorageKeyScanner& operator=(StorageKeyScanner&&) noexcept;
+  ~StorageKeyScanner();
+
+  /**
+   *\brief Scans the key directory of the given key. Returns std::nullopt if the key directory does not exist or contains no pdf file.
+   */
+  [[nodiscard]] std::optional<StorageIndex::Entry> scan(const std::string& key) const;
+};
+
+/**
+ *\brief Returns true if the file name has the pdf extension.
+ */
+[[nodiscard]] bool is_pdf_file_name(std::string_view fileName);
+
+} // namespace zotfiles
+
+#endif // ZOTERO_TO_FILE_TREE_STORAGEINDEX_HPP
@@ -0,0 +1,157 @@
+#include "StreamingExport.hpp"
+#include "BoundedQueue.hpp"
+#include "FlatCollectionTree.hpp"
+#include "StorageIndex.hpp"
+#include "ZoteroDB.hpp"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace zotfiles
+{
+
+namespace
+{
+
+/**
+ *\brief A pdf attachment handed from the reader thread to the calling thread. Owns its strings, the cursor reuses its buffers.
+ */
+struct StreamedAttachment {
+  std::int64_t itemID{};
+  std::int64_t parentItemID{};
+  std::string path;
+  std::string key;
+  std::vector<std::int64_t> collectionIDs;
+};
+
+using AttachmentBatch = std::vector<StreamedAttachment>;
+
+/**
+ * Small batches keep the time to the first copy short and the queue cheap. The queue holds at most queuedBatches * batchSize attachments,
+ * independent of the size of the library.
+ */
+constexpr std::size_t batchSize = 64;
+constexpr std::size_t queuedBatches = 16;
+
+/**
+ *\brief Builds the tree of all collections of the zotero db, without pdf items.
+ */
+FlatCollectionTree all_collections_tree(ZoteroDBSession& session) {
+  std::vector<ZoteroCollection> collections;
+  for (auto& [collectionID, collection]: all_collections(session))
+  {
+    collections.push_back(std::move(collection));
+  }
+  return FlatCollectionTree::build(collections, {});
+}
+
+} // namespace
+
+StreamSummary stream_pdfs(ZoteroDBSession& session,
+                          const std::filesystem::path& outputDir,
+                          const WriteOptions& writeOptions,
+                          DuplicatePolicy duplicatePolicy,
+                          Manifest* writtenManifest) {
+  Tracer* const tracer = writeOptions.tracer;
+
+  TraceSpan collectionSpan(tracer, "collection query");
+  const FlatCollectionTree collectionTree = all_collections_tree(session);
+  const std::vector<std::filesystem::path> relDirPaths = collectionTree.rel_dir_paths();
+  collectionSpan.set_item_count(collectionTree.nodes().size());
+  collectionSpan.finish();
+
+  const std::filesystem::path storageDir = session.storage_dir();
+  const StorageKeyScanner storageKeyScanner(storageDir);
+  StreamSummary streamSummary;
+  BoundedQueue<AttachmentBatch> attachmentQueue(queuedBatches);
+  std::jthread reader(
+      [&session, &attachmentQueue, &streamSummary, tracer]()
+      {
+        TraceSpan querySpan(tracer, "attachment query");
+        AttachmentBatch batch;
+        batch.reserve(batchSize);
+        streamSummary.pdfAttachments = for_each_pdf_attachment_item(
+            session,
+            [&attachmentQueue, &batch](const ZoteroPDFAttachment& pdfAttachment, std::span<const std::int64_t> collectionIDs)
+            {
+              batch.push_back(StreamedAttachment{pdfAttachment.itemID,
+                                                 pdfAttachment.parentItemID,
+                                                 std::string(pdfAttachment.path),
+                                                 std::string(pdfAttachment.key),
+                                                 std::vector<std::int64_t>(collectionIDs.begin(), collectionIDs.end())});
+              if (batch.size() == batchSize)
+              {
+                attachmentQueue.push(std::move(batch));
+                batch = AttachmentBatch();
+                batch.reserve(batchSize);
+              }
+            });
+        if (!batch.empty())
+        {
+          attachmentQueue.push(std::move(batch));
+        }
+        attachmentQueue.close();
+        querySpan.set_item_count(streamSummary.pdfAttachments);
+      });
+
+  CollectionPDFNames collectionPDFNames(duplicatePolicy);
+  OutputDirWriter outputDirWriter(outputDir, writeOptions);
+  try
+  {
+    while (std::optional<AttachmentBatch> batch = attachmentQueue.pop())
+    {
+      TraceSpan batchSpan(tracer, "resolve and stream");
+      batchSpan.set_item_count(batch->size());
+      for (const StreamedAttachment& attachment: *batch)
+      {
+        ZoteroPDFAttachment pdfAttachment{attachment.itemID, attachment.parentItemID, attachment.path, attachment.key};
+        const std::optional<StorageIndex::Entry> storageEntry = storageKeyScanner.scan(attachment.key);
+        const std::filesystem::path pdfFilePath =
+            resolve_pdf_file_path(pdfAttachment, storageEntry ? &*storageEntry : nullptr, storageDir);
+        if (pdfFilePath.empty())
+        {
+          continue;
+        }
+        ++streamSummary.pdfItems;
+
+        for (const std::int64_t collectionID: attachment.collectionIDs)
+        {
+          const FlatCollectionNode* node = collectionTree.find(collectionID);
+          if (node == nullptr)
+          {
+            continue;
+          }
+
+          std::optional<std::string> pdfName = collectionPDFNames.add(collectionID, pdfAttachment.path);
+          if (!pdfName)
+          {
+            ++streamSummary.skippedDuplicates;
+            continue;
+          }
+          if (*pdfName != pdfAttachment.path)
+          {
+            ++streamSummary.renamedDuplicates;
+          }
+          const auto nodeIndex = static_cast<std::size_t>(node - collectionTree.nodes().data());
+          outputDirWriter.stream_pdf(relDirPaths[nodeIndex],
+                                     node->collectionName,
+                                     CollectionPDFItem{attachment.itemID, std::move(*pdfName), pdfFilePath});
+        }
+      }
+    }
+  }
+  catch (...)
+  {
+    // The reader would block on the full queue forever, closing the queue lets it drop the remaining attachments.
+    attachmentQueue.close();
+    throw;
+  }
+
+  streamSummary.writeSummary = outputDirWriter.finish_stream(writtenManifest);
+  return streamSummary;
+}
+
+} // namespace zotfiles
@@ -0,0 +1,44 @@
+#ifndef ZOTERO_TO_FILE_TREE_STREAMINGEXPORT_HPP
+#define ZOTERO_TO_FILE_TREE_STREAMINGEXPORT_HPP
+
+#include "DuplicatePolicy.hpp"
+#include "Manifest.hpp"
+#include "OutputDirWriter.hpp"
+#include "ZoteroDBSession.hpp"
+#include <cstddef>
+#include <filesystem>
+
+namespace zotfiles
+{
+
+/** @brief Result of a streamed export. */
+struct StreamSummary {
+  std::size_t pdfAttachments{};    /**< Number of pdf attachments read from the zotero db. */
+  std::size_t pdfItems{};          /**< Number of pdf attachments whose pdf file was found in the storage directory. */
+  std::size_t skippedDuplicates{}; /**< Number of pdf files not exported because of a duplicate name, see DuplicatePolicy. */
+  std::size_t renamedDuplicates{}; /**< Number of pdf files exported with a suffix because of a duplicate name. */
+  WriteSummary writeSummary;
+};
+
+/**
+ *\brief Exports the pdf files of all pdf attachments while the attachments are still read from the zotero db.
+ *
+ * The collections are read first, they are few and their directory paths are needed for every pdf file. A reader thread then reads the
+ * attachments with the cursor of for_each_pdf_attachment_item and pushes them in small batches into a bounded queue. The calling thread
+ * resolves the pdf file of every attachment in its key directory, names it in its collections and hands it to OutputDirWriter::stream_pdf,
+ * whose copy workers copy it while the next attachments are read. Reading the db, scanning the key directories and copying overlap, and
+ * neither the pdf items nor a collection tree with all pdf items are held in memory. The exported files are the files of a staged export.
+ *
+ * @param session The session of the zotero db. Used by the reader thread until the function returns.
+ * @param writeOptions The options of the export. patchedItemIds must not be set, a streamed export always exports all items.
+ * @param writtenManifest If set, receives the manifest that was written to the output directory.
+ */
+[[nodiscard]] StreamSummary stream_pdfs(ZoteroDBSession& session,
+                                        const std::filesystem::path& outputDir,
+                                        const WriteOptions& writeOptions,
+                                        DuplicatePolicy duplicatePolicy,
+                                        Manifest* writtenManifest = nullptr);
+
+} // namespace zotfiles
+
+#endif // ZOTERO_TO_FILE_TREE_STREAMINGEXPORT_HPP
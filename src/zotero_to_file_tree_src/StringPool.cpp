@@ -0,0 +1,65 @@
+#include "StringPool.hpp"
+#include <algorithm>
+#include <utility>
+
+namespace zotfiles
+{
+
+StringPool::StringPool(StringPool&& other) noexcept
+    : m_memoryResource(other.m_memoryResource)
+    , m_chunks(std::exchange(other.m_chunks, {}))
+    , m_chunkEnd(std::exchange(other.m_chunkEnd, nullptr))
+    , m_chunkRemaining(std::exchange(other.m_chunkRemaining, 0)) {}
+
+StringPool& StringPool::operator=(StringPool&& other) noexcept {
+  if (this != &other)
+  {
+    // The chunks are freed with the resource they were allocated from, so the resource moves with them.
+    release();
+    m_memoryResource = other.m_memoryResource;
+    m_chunks = std::exchange(other.m_chunks, {});
+    m_chunkEnd = std::exchange(other.m_chunkEnd, nullptr);
+    m_chunkRemaining = std::exchange(other.m_chunkRemaining, 0);
+  }
+  return *this;
+}
+
+void StringPool::release() {
+  for (const std::span<char> chunk: m_chunks)
+  {
+    m_memoryResource->deallocate(chunk.data(), chunk.size(), 1);
+  }
+  m_chunks.clear();
+  m_chunkEnd = nullptr;
+  m_chunkRemaining = 0;
+}
+
+std::string_view StringPool::store(std::string_view value) {
+  if (value.empty())
+  {
+    return {};
+  }
+
+  if (value.size() > m_chunkRemaining)
+  {
+    // A string larger than a chunk gets a chunk of its own, the current chunk is kept for the following strings.
+    const std::size_t newChunkSize = std::max(chunkSize, value.size());
+    m_chunks.emplace_back(static_cast<char*>(m_memoryResource->allocate(newChunkSize, 1)), newChunkSize);
+    if (newChunkSize > chunkSize)
+    {
+      char* data = m_chunks.back().data();
+      std::copy(value.begin(), value.end(), data);
+      return {data, value.size()};
+    }
+    m_chunkEnd = m_chunks.back().data();
+    m_chunkRemaining = newChunkSize;
+  }
+
+  char* data = m_chunkEnd;
+  std::copy(value.begin(), value.end(), data);
+  m_chunkEnd += value.size();
+  m_chunkRemaining -= value.size();
+  return {data, value.size()};
+}
+
+} // namespace zotfiles
@@ -0,0 +1,46 @@
+#ifndef ZOTERO_TO_FILE_TREE_STRINGPOOL_HPP
+#define ZOTERO_TO_FILE_TREE_STRINGPOOL_HPP
+
+#include <cstddef>
+#include <memory_resource>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace zotfiles
+{
+
+/**
+ *\brief Stores strings back to back in large chunks instead of one heap allocation per string.
+ *
+ * The returned string_views stay valid until the pool is destroyed, also if the pool is moved. The strings are not deduplicated, the pool
+ * holds strings that are unique anyway, like the keys of the attachments. The chunks are allocated from the given memory resource.
+ */
+class StringPool {
+  static constexpr std::size_t chunkSize = 64 * 1024;
+
+  std::pmr::memory_resource* m_memoryResource;
+  std::vector<std::span<char>> m_chunks;
+  char* m_chunkEnd{nullptr};
+  std::size_t m_chunkRemaining{0};
+
+  void release();
+
+public:
+  explicit StringPool(std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource())
+      : m_memoryResource(memoryResource) {}
+  ~StringPool() { release(); }
+  StringPool(StringPool&& other) noexcept;
+  StringPool& operator=(StringPool&& other) noexcept;
+  StringPool(const StringPool&) = delete;
+  StringPool& operator=(const StringPool&) = delete;
+
+  /**
+   *\brief Copies the string into the pool.
+   */
+  [[nodiscard]] std::string_view store(std::string_view value);
+};
+
+} // namespace zotfiles
+
+#endif // ZOTERO_TO_FILE_TREE_STRINGPOOL_HPP
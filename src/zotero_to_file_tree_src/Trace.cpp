@@ -0,0 +1,159 @@
+#include "Trace.hpp"
+#include <algorithm>
+#include <fmt/format.h>
+#include <fstream>
+#include <iterator>
+
+namespace zotfiles
+{
+
+namespace
+{
+
+double megabytes(std::size_t bytes) {
+  return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+void print_memory_stats(const MemoryStats& memoryStats) {
+  const ArenaStats& arenaStats = memoryStats.arenaStats;
+  fmt::print("\n");
+  if (arenaStats.allocations > 0)
+  {
+    fmt::print("Arena: {} allocations with {:.1f} MB served by {} heap allocations with {:.1f} MB\n",
+               arenaStats.allocations,
+               megabytes(arenaStats.allocatedBytes),
+               arenaStats.heapAllocations,
+               megabytes(arenaStats.heapBytes));
+  }
+  if (memoryStats.peakRSSAfter > 0)
+  {
+    fmt::print("Peak RSS: {:.1f} MB before the export, {:.1f} MB after\n",
+               megabytes(memoryStats.peakRSSBefore),
+               megabytes(memoryStats.peakRSSAfter));
+  }
+}
+
+} // namespace
+
+Tracer::Tracer(bool printStats, std::filesystem::path traceFilePath)
+    : m_printStats(printStats)
+    , m_traceFilePath(std::move(traceFilePath)) {}
+
+void Tracer::record(const char* name,
+                    std::chrono::steady_clock::time_point start,
+                    std::chrono::steady_clock::time_point end,
+                    std::size_t itemCount) {
+  const std::chrono::nanoseconds relStart = start - m_startTime;
+  const std::chrono::nanoseconds relEnd = end - m_startTime;
+
+  const std::lock_guard lock(m_mutex);
+  auto [statsIter, inserted] = m_stageStats.try_emplace(name);
+  StageStats& stageStats = statsIter->second;
+  if (inserted)
+  {
+    stageStats.firstStart = relStart;
+  }
+  ++stageStats.spanCount;
+  stageStats.itemCount += itemCount;
+  stageStats.busyTime += relEnd - relStart;
+  stageStats.firstStart = std::min(stageStats.firstStart, relStart);
+  stageStats.lastEnd = std::max(stageStats.lastEnd, relEnd);
+  stageStats.wallTime = stageStats.lastEnd - stageStats.firstStart;
+
+  if (m_traceFilePath.empty())
+  {
+    return;
+  }
+  auto threadIter = m_threadIndices.try_emplace(std::this_thread::get_id(), static_cast<std::uint32_t>(m_threadIndices.size())).first;
+  m_events.push_back(TraceEvent{name, threadIter->second, relStart, relEnd - relStart, itemCount});
+}
+
+std::vector<std::pair<std::string_view, StageStats>> Tracer::stage_stats() {
+  const std::lock_guard lock(m_mutex);
+  std::vector<std::pair<std::string_view, StageStats>> stageStats(m_stageStats.begin(), m_stageStats.end());
+  std::sort(stageStats.begin(),
+            stageStats.end(),
+            [](const auto& lhs, const auto& rhs) { return lhs.second.firstStart < rhs.second.firstStart; });
+  return stageStats;
+}
+
+void Tracer::set_memory_stats(const MemoryStats& memoryStats) {
+  const std::lock_guard lock(m_mutex);
+  m_memoryStats = memoryStats;
+}
+
+bool Tracer::report() {
+  if (m_printStats)
+  {
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+    fmt::print(
+        "\n{:<28} {:>8} {:>10} {:>10} {:>10} {:>10} {:>12}\n", "Stage", "Spans", "Items", "Start ms", "Wall ms", "Busy ms", "Items/s");
+    for (const auto& [name, stageStats]: stage_stats())
+    {
+      const double wallSeconds = std::chrono::duration<double>(stageStats.wallTime).count();
+      const double itemsPerSecond = wallSeconds > 0.0 ? static_cast<double>(stageStats.itemCount) / wallSeconds : 0.0;
+      fmt::print("{:<28} {:>8} {:>10} {:>10.2f} {:>10.2f} {:>10.2f} {:>12.0f}\n",
+                 name,
+                 stageStats.spanCount,
+                 stageStats.itemCount,
+                 Milliseconds(stageStats.firstStart).count(),
+                 Milliseconds(stageStats.wallTime).count(),
+                 Milliseconds(stageStats.busyTime).count(),
+                 itemsPerSecond);
+    }
+    std::optional<MemoryStats> memoryStats;
+    {
+      const std::lock_guard lock(m_mutex);
+      memoryStats = m_memoryStats;
+    }
+    if (memoryStats)
+    {
+      print_memory_stats(*memoryStats);
+    }
+  }
+  {
+    const std::lock_guard lock(m_mutex);
+    m_stageStats.clear();
+    m_memoryStats.reset();
+  }
+
+  if (m_traceFilePath.empty())
+  {
+    return true;
+  }
+  if (!write_chrome_trace(m_traceFilePath))
+  {
+    fmt::print("Could not write the trace file: {}\n", m_traceFilePath.string());
+    return false;
+  }
+  return true;
+}
+
+bool Tracer::write_chrome_trace(const std::filesystem::path& traceFilePath) {
+  fmt::memory_buffer buffer;
+  {
+    const std::lock_guard lock(m_mutex);
+    // Stage names are string literals without characters that need escaping in JSON.
+    fmt::format_to(std::back_inserter(buffer), "{{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for (std::size_t i = 0; i < m_events.size(); ++i)
+    {
+      const TraceEvent& event = m_events[i];
+      fmt::format_to(std::back_inserter(buffer),
+                     "{}\n{{\"name\":\"{}\",\"cat\":\"export\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f},"
+                     "\"args\":{{\"items\":{}}}}}",
+                     i == 0 ? "" : ",",
+                     event.name,
+                     event.threadIndex,
+                     std::chrono::duration<double, std::micro>(event.start).count(),
+                     std::chrono::duration<double, std::micro>(event.duration).count(),
+                     event.itemCount);
+    }
+    fmt::format_to(std::back_inserter(buffer), "\n]}}\n");
+  }
+
+  std::ofstream file(traceFilePath, std::ios::binary | std::ios::trunc);
+  file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+  return static_cast<bool>(file);
+}
+
+} // namespace zotfiles
@@ -0,0 +1,144 @@
+#ifndef ZOTERO_TO_FILE_TREE_TRACE_HPP
+#define ZOTERO_TO_FILE_TREE_TRACE_HPP
+
+#include "RunArena.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace zotfiles
+{
+
+/** @brief A finished span, recorded for the Chrome trace. */
+struct TraceEvent {
+  const char* name{nullptr};           /**< Name of the stage, a string literal. */
+  std::uint32_t threadIndex{};         /**< Small index of the thread, in the order the threads recorded their first span. */
+  std::chrono::nanoseconds start{};    /**< Start relative to the creation of the Tracer. */
+  std::chrono::nanoseconds duration{}; /**< Wall time of the span. */
+  std::size_t itemCount{};             /**< Number of items processed by the span. */
+};
+
+/** @brief Wall time and item count of all spans of one stage. */
+struct StageStats {
+  std::size_t spanCount{};             /**< Number of spans of the stage. */
+  std::size_t itemCount{};             /**< Sum of the items of all spans. */
+  std::chrono::nanoseconds busyTime{}; /**< Sum of the wall times of all spans. Larger than wallTime if spans ran concurrently. */
+  std::chrono::nanoseconds wallTime{}; /**< From the start of the first span to the end of the last span. */
+  std::chrono::nanoseconds firstStart{}; /**< Start of the first span, relative to the creation of the Tracer. */
+  std::chrono::nanoseconds lastEnd{};    /**< End of the last span, relative to the creation of the Tracer. */
+};
+
+/**
+ *\brief The memory use of one export, reported with the StageStats.
+ */
+struct MemoryStats {
+  ArenaStats arenaStats;       /**< Allocations of the pdf items and the data derived from them, see RunArena. */
+  std::size_t peakRSSBefore{}; /**< Peak resident set size of the process before the export, 0 if not available. */
+  std::size_t peakRSSAfter{};  /**< Peak resident set size of the process after the export, 0 if not available. */
+};
+
+/**
+ *\brief Collects the spans of an export for the --stats summary and the --trace Chrome trace-event file.
+ *
+ * The spans are recorded by TraceSpan. Without a Tracer a TraceSpan does nothing, so spans cost one branch if neither statistics nor a
+ * trace were requested. Recording a span takes two clock reads and a short lock, which is small compared to copying a file or creating a
+ * directory, the finest spans of an export. Events are only kept if a trace file was requested.
+ */
+class Tracer {
+  bool m_printStats;
+  std::filesystem::path m_traceFilePath;
+  std::chrono::steady_clock::time_point m_startTime{std::chrono::steady_clock::now()};
+  std::mutex m_mutex;
+  std::unordered_map<std::string_view, StageStats> m_stageStats;
+  std::unordered_map<std::thread::id, std::uint32_t> m_threadIndices;
+  std::vector<TraceEvent> m_events;
+  std::optional<MemoryStats> m_memoryStats;
+
+public:
+  /**
+   * @param printStats Print the StageStats of every export in report().
+   * @param traceFilePath Write the Chrome trace to this file in report(). No events are kept if empty.
+   */
+  Tracer(bool printStats, std::filesystem::path traceFilePath);
+
+  Tracer(const Tracer&) = delete;
+  Tracer& operator=(const Tracer&) = delete;
+
+  void record(const char* name,
+              std::chrono::steady_clock::time_point start,
+              std::chrono::steady_clock::time_point end,
+              std::size_t itemCount);
+
+  /**
+   *\brief The statistics of all stages since the last report, ordered by the start of their first span.
+   */
+  [[nodiscard]] std::vector<std::pair<std::string_view, StageStats>> stage_stats();
+
+  /**
+   *\brief Sets the memory statistics that are printed by the next report().
+   */
+  void set_memory_stats(const MemoryStats& memoryStats);
+
+  /**
+   *\brief Prints the statistics and writes the trace file, if requested. The statistics start over afterwards, the trace keeps all events.
+   *
+   * @return False if the trace file could not be written.
+   */
+  bool report();
+
+  /**
+   *\brief Writes all events as Chrome trace-event JSON, loadable by chrome://tracing and Perfetto.
+   */
+  bool write_chrome_trace(const std::filesystem::path& traceFilePath);
+};
+
+/**
+ *\brief Records the wall time of a scope as a span of the Tracer. Does nothing if the tracer is nullptr.
+ */
+class TraceSpan {
+  Tracer* m_tracer;
+  const char* m_name;
+  std::size_t m_itemCount{};
+  std::chrono::steady_clock::time_point m_start;
+
+public:
+  /**
+   * @param name Name of the stage. Must be a string literal, it is stored by pointer.
+   */
+  TraceSpan(Tracer* tracer, const char* name)
+      : m_tracer(tracer)
+      , m_name(name) {
+    if (m_tracer)
+    {
+      m_start = std::chrono::steady_clock::now();
+    }
+  }
+  ~TraceSpan() { finish(); }
+
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+
+  void set_item_count(std::size_t itemCount) { m_itemCount = itemCount; }
+
+  /**
+   *\brief Ends the span before the end of the scope, e.g. if the scope also holds the object whose construction is measured.
+   */
+  void finish() {
+    if (m_tracer)
+    {
+      m_tracer->record(m_name, m_start, std::chrono::steady_clock::now(), m_itemCount);
+      m_tracer = nullptr;
+    }
+  }
+};
+
+} // namespace zotfiles
+
+#endif // ZOTERO_TO_FILE_TREE_TRACE_HPP
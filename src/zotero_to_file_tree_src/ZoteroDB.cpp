@@ -1,10 +1,13 @@
 #include "ZoteroDB.hpp"
 #include <SQLiteCpp/SQLiteCpp.h>
-#include <execution>
+#include <algorithm>
+#include <charconv>
 #include <filesystem>
 #include <fmt/format.h>
 #include <functional>
+#include <iterator>
 #include <unordered_map>
+#include <vector>
 
 namespace zotfiles
 {
@@ -44,22 +47,6 @@ public:
   [[nodiscard]] const_iterator cend() const { return pdfItemIDs.cend(); }
 };
 
-class PDFParentItemIdsPolicy {
-  std::vector<std::int64_t> pdfParentItemIDs;
-
-public:
-  using const_iterator = std::vector<std::int64_t>::const_iterator;
-
-  template <typename Iter>
-  void operator()(Iter begin, Iter end) {
-    pdfParentItemIDs.reserve(static_cast<std::size_t>(std::distance(begin, end)));
-    collect_parent_ids<PDFItem>(begin, end, std::back_inserter(pdfParentItemIDs));
-  }
-
-  [[nodiscard]] const_iterator cbegin() const { return pdfParentItemIDs.cbegin(); }
-  [[nodiscard]] const_iterator cend() const { return pdfParentItemIDs.cend(); }
-};
-
 template <typename Item, typename ForwardIter, typename OutputIter>
 void collect_ids(ForwardIter first, ForwardIter last, OutputIter outPutIter) {
   if constexpr (std::is_same_v<Item, PDFItem>)
@@ -72,15 +59,92 @@ void collect_ids(ForwardIter first, ForwardIter last, OutputIter outPutIter) {
   }
 }
 
-template <typename Item, typename ForwardIter, typename OutputIter>
-void collect_parent_ids(ForwardIter first, ForwardIter last, OutputIter outPutIter) {
-  if constexpr (std::is_same_v<Item, PDFItem>)
+/**
+ *\brief Replaces the content of the temp table idTable with the given ids.
+ *
+ * The ids are inserted one by one with a single cached statement inside of one transaction. Queries join against the temp table instead
+ * of binding one placeholder per id, so neither the query text nor the number of bound parameters grows with the number of ids.
+ */
+template <typename ForwardIter>
+static void load_id_table(ZoteroDBSession& session, std::string_view idTable, ForwardIter begin, ForwardIter end) {
+  // Temp tables live in the temp database, which is writable even if the zotero db is opened read only.
+  session.database().exec(fmt::format("CREATE TEMP TABLE IF NOT EXISTS {} (id INTEGER PRIMARY KEY)", idTable));
+
+  SQLite::Transaction transaction(session.database());
+  session.statement(fmt::format("DELETE FROM temp.{}", idTable)).exec();
+  SQLite::Statement& insert = session.statement(fmt::format("INSERT OR IGNORE INTO temp.{} (id) VALUES (?)", idTable));
+  for (auto iter = begin; iter != end; ++iter)
   {
-    std::transform(first, last, outPutIter, [](const PDFItem& item) { return item.pdfAttachment.parentItemID; });
+    insert.reset();
+    insert.bind(1, static_cast<std::int64_t>(*iter));
+    insert.exec();
   }
-  else if constexpr (std::is_same_v<Item, ZoteroCollection>)
+  transaction.commit();
+}
+
+/**
+ *\brief Replaces the content of the temp table library_versions with the latest item version of every library of the state.
+ */
+static void load_library_versions(ZoteroDBSession& session, const ZoteroDBState& state) {
+  session.database().exec("CREATE TEMP TABLE IF NOT EXISTS library_versions (libraryID INTEGER PRIMARY KEY, version INTEGER)");
+
+  SQLite::Transaction transaction(session.database());
+  session.statement("DELETE FROM temp.library_versions").exec();
+  SQLite::Statement& insert = session.statement("INSERT INTO temp.library_versions (libraryID, version) VALUES (?, ?)");
+  for (const auto& [libraryID, version]: state.itemsVersions)
   {
-    std::transform(first, last, outPutIter, [](const ZoteroCollection& collection) { return collection.parentCollectionID; });
+    insert.reset();
+    insert.bind(1, libraryID);
+    insert.bind(2, version);
+    insert.exec();
+  }
+  transaction.commit();
+}
+
+/**
+ *\brief Common table expression that resolves the collection memberships of the rows of a pdfAttachments(itemID, parentItemID, ...) CTE.
+ *
+ * An attachment that is part of at least one collection keeps its own collections. All other attachments inherit the collections of their
+ * parent item.
+ */
+static constexpr std::string_view pdfAttachmentMembershipsCTE = R"(
+        pdfAttachmentMemberships(itemID, collectionID) AS (
+          SELECT a.itemID, ci.collectionID
+          FROM pdfAttachments a
+          JOIN collectionItems ci ON ci.itemID = a.itemID
+          UNION ALL
+          SELECT a.itemID, ci.collectionID
+          FROM pdfAttachments a
+          JOIN collectionItems ci ON ci.itemID = a.parentItemID
+          WHERE NOT EXISTS (SELECT 1 FROM collectionItems own WHERE own.itemID = a.itemID)
+        ))";
+
+/**
+ *\brief Selects the rows read by read_pdf_attachment_items from the pdfAttachments CTE.
+ *
+ * Resolves the memberships like pdfAttachmentMembershipsCTE, but per attachment with the itemID index of collectionItems. Joining the
+ * materialized pdfAttachmentMemberships CTE instead scans it once per attachment, which does not finish for 100k attachments.
+ */
+static constexpr std::string_view pdfAttachmentItemsSelect = R"(
+        SELECT a.itemID, a.parentItemID, a.path, a.key, c.collectionID, c.parentCollectionID, c.collectionName
+        FROM pdfAttachments a
+        LEFT JOIN collectionItems ci ON ci.itemID = CASE
+          WHEN EXISTS (SELECT 1 FROM collectionItems own WHERE own.itemID = a.itemID) THEN a.itemID
+          ELSE a.parentItemID
+        END
+        LEFT JOIN collections c ON c.collectionID = ci.collectionID)";
+
+/**
+ *\brief Binds the library of the session to the parameter of a "(?N IS NULL OR libraryID = ?N)" filter. NULL selects all libraries.
+ */
+static void bind_library(SQLite::Statement& query, int index, const ZoteroDBSession& session) {
+  if (const std::optional<std::int64_t> libraryID = session.library_id())
+  {
+    query.bind(index, *libraryID);
+  }
+  else
+  {
+    query.bind(index);
   }
 }
 
@@ -89,20 +153,11 @@ std::string_view standard_zotero_db_name() {
   return zotero_db_name;
 }
 
-ZoteroDBInfo zotero_db_info(const std::filesystem::path& zoteroDBPath) {
-  if (!std::filesystem::exists(zoteroDBPath))
-  {
-    fmt::print("Zotero DB file does not exist: {}\n", zoteroDBPath.string());
-    std::abort();
-  }
-
+ZoteroDBInfo zotero_db_info(ZoteroDBSession& session) {
   ZoteroDBInfo zotero_db_info;
   try
   {
-    // Open a database file in create/write mode
-    SQLite::Database db(zoteroDBPath, SQLite::OPEN_READONLY);
-
-    auto query = SQLite::Statement(db, fmt::format("SELECT * FROM version"));
+    SQLite::Statement& query = session.statement("SELECT * FROM version");
     while (query.executeStep())
     {
       // Get the collection name
@@ -152,8 +207,8 @@ ZoteroDBInfo supported_zotero_db_info() {
   return supported_zotero_db_info;
 }
 
-bool is_supported_zotero_db(const std::filesystem::path& zoteroDBPath) {
-  auto zoteroDBInfo = zotero_db_info(zoteroDBPath);
+bool is_supported_zotero_db(ZoteroDBSession& session) {
+  auto zoteroDBInfo = zotero_db_info(session);
   auto supportedZoteroDBInfo = supported_zotero_db_info();
 
   if (zoteroDBInfo.userdata != supportedZoteroDBInfo.userdata)
@@ -173,8 +228,8 @@ bool is_supported_zotero_db(const std::filesystem::path& zoteroDBPath) {
   return true;
 }
 
-std::vector<ZoteroPDFAttachment> pdf_attachments(const std::filesystem::path& zoteroDBPath) {
-  static std::string_view queryString = R"(
+PDFItems pdf_attachments(ZoteroDBSession& session, std::pmr::memory_resource* memoryResource) {
+  static const std::string queryString = R"(
     SELECT
     itemAttachments.itemID,
     itemAttachments.parentItemID,
@@ -183,13 +238,14 @@ std::vector<ZoteroPDFAttachment> pdf_attachments(const std::filesystem::path& zo
     FROM
     itemAttachments
     LEFT JOIN items ON items.itemID = itemAttachments.itemID
-    WHERE itemAttachments.contentType = 'application/pdf')";
+    WHERE itemAttachments.contentType = 'application/pdf'
+      AND (?1 IS NULL OR items.libraryID = ?1))";
 
-  std::vector<ZoteroPDFAttachment> pdf_items;
+  PDFItems pdf_items(memoryResource);
   try
   {
-    const SQLite::Database db(zoteroDBPath, SQLite::OPEN_READONLY);
-    SQLite::Statement query(db, queryString.data());
+    SQLite::Statement& query = session.statement(queryString);
+    bind_library(query, 1, session);
 
     while (query.executeStep())
     {
@@ -199,7 +255,8 @@ std::vector<ZoteroPDFAttachment> pdf_attachments(const std::filesystem::path& zo
         parentItemID = query.getColumn(1).getInt64();
       }
 
-      pdf_items.emplace_back(query.getColumn(0).getInt64(), parentItemID, query.getColumn(2).getText(), query.getColumn(3).getText());
+      static_cast<void>(
+          pdf_items.add(query.getColumn(0).getInt64(), parentItemID, query.getColumn(2).getText(), query.getColumn(3).getText()));
     }
   }
   catch (std::exception& e)
@@ -210,51 +267,265 @@ std::vector<ZoteroPDFAttachment> pdf_attachments(const std::filesystem::path& zo
   return pdf_items;
 }
 
-std::set<ZoteroCollection> parent_collections(const std::set<std::int64_t>& collectionIds, const std::filesystem::path& zoteroDBPath) {
-  // Prepare the base query with placeholders
-  std::string queryString =
-      "SELECT c.collectionID, c.parentCollectionID, c.collectionName\n"
-      "FROM collections c\n"
-      "WHERE c.collectionID IN (";
-  for (size_t i = 0; i < collectionIds.size(); ++i)
+/**
+ *\brief Groups the rows of a query that selects pdfAttachmentItemsSelect into one PDFItem per attachment.
+ */
+static PDFItems read_pdf_attachment_items(SQLite::Statement& query, std::pmr::memory_resource* memoryResource) {
+  PDFItems pdfItems(memoryResource);
+  std::pmr::unordered_map<std::int64_t, std::size_t> pdfItemIndices(memoryResource);
+  while (query.executeStep())
   {
-    queryString += (i == 0 ? "?" : ",?");
+    const std::int64_t itemID = query.getColumn(0).getInt64();
+    auto [indexIter, inserted] = pdfItemIndices.try_emplace(itemID, pdfItems.size());
+    if (inserted)
+    {
+      std::int64_t parentItemID = -1;
+      if (!query.isColumnNull(1))
+      {
+        parentItemID = query.getColumn(1).getInt64();
+      }
+
+      static_cast<void>(pdfItems.add(itemID, parentItemID, query.getColumn(2).getText(), query.getColumn(3).getText()));
+    }
+
+    if (query.isColumnNull(4))
+    {
+      continue;
+    }
+
+    std::int64_t parentCollectionID = -1;
+    if (!query.isColumnNull(5))
+    {
+      parentCollectionID = query.getColumn(5).getInt64();
+    }
+
+    pdfItems.add_collection(indexIter->second, query.getColumn(4).getInt64(), parentCollectionID, query.getColumn(6).getText());
   }
-  queryString += ")";
+  return pdfItems;
+}
 
-  std::set<ZoteroCollection> result;
+/**
+ *\brief The query of the rows of all pdf attachments of the library bound to ?1, see pdfAttachmentItemsSelect.
+ */
+static const std::string& all_pdf_attachment_items_query() {
+  static const std::string queryString = fmt::format(R"(
+        WITH
+        pdfAttachments(itemID, parentItemID, path, key) AS (
+          SELECT itemAttachments.itemID, itemAttachments.parentItemID, itemAttachments.path, items.key
+          FROM itemAttachments
+          LEFT JOIN items ON items.itemID = itemAttachments.itemID
+          WHERE itemAttachments.contentType = 'application/pdf'
+            AND (?1 IS NULL OR items.libraryID = ?1)
+        ){})",
+                                                     pdfAttachmentItemsSelect);
+  return queryString;
+}
+
+PDFItems pdf_attachment_items(ZoteroDBSession& session, std::pmr::memory_resource* memoryResource) {
   try
   {
-    const SQLite::Database db(zoteroDBPath, SQLite::OPEN_READONLY);
-    SQLite::Statement query(db, queryString.data());
+    SQLite::Statement& query = session.statement(all_pdf_attachment_items_query());
+    bind_library(query, 1, session);
+    return read_pdf_attachment_items(query, memoryResource);
+  }
+  catch (std::exception& e)
+  {
+    fmt::print("SQLite exception: {}\n", std::string(e.what()));
+    std::abort();
+  }
+}
 
-    // Bind values to the placeholders
-    int count = 1;
-    for (auto iter = collectionIds.begin(); iter != collectionIds.end(); ++iter)
-    {
-      query.bind(count, *iter);
-      ++count;
-    }
+std::size_t for_each_pdf_attachment_item(
+    ZoteroDBSession& session,
+    const std::function<void(const ZoteroPDFAttachment& pdfAttachment, std::span<const std::int64_t> collectionIDs)>& attachmentFunc) {
+  // The rows of an attachment must be consecutive. The attachments are read in the order of the index on their content type, so the
+  // order does not add a sort.
+  static const std::string queryString = all_pdf_attachment_items_query() + "\n        ORDER BY a.itemID";
+
+  // The text of a column is only valid until the next step, the current attachment keeps copies. The buffers are reused.
+  std::size_t attachmentCount = 0;
+  bool hasAttachment = false;
+  ZoteroPDFAttachment pdfAttachment;
+  std::string path;
+  std::string key;
+  std::vector<std::int64_t> collectionIDs;
+  auto passAttachment = [&]()
+  {
+    pdfAttachment.path = path;
+    pdfAttachment.key = key;
+    attachmentFunc(pdfAttachment, collectionIDs);
+    ++attachmentCount;
+  };
 
+  try
+  {
+    SQLite::Statement& query = session.statement(queryString);
+    bind_library(query, 1, session);
     while (query.executeStep())
     {
-      std::int64_t collectionID = -1;
-      if (!query.isColumnNull(0))
+      const std::int64_t itemID = query.getColumn(0).getInt64();
+      if (!hasAttachment || itemID != pdfAttachment.itemID)
       {
-        collectionID = query.getColumn(0).getInt64();
+        if (hasAttachment)
+        {
+          passAttachment();
+        }
+        hasAttachment = true;
+        pdfAttachment.itemID = itemID;
+        pdfAttachment.parentItemID = query.isColumnNull(1) ? -1 : query.getColumn(1).getInt64();
+        path = query.getColumn(2).getText();
+        key = query.getColumn(3).getText();
+        collectionIDs.clear();
       }
 
+      if (!query.isColumnNull(4))
+      {
+        collectionIDs.push_back(query.getColumn(4).getInt64());
+      }
+    }
+    if (hasAttachment)
+    {
+      passAttachment();
+    }
+  }
+  catch (std::exception& e)
+  {
+    fmt::print("SQLite exception: {}\n", std::string(e.what()));
+    std::abort();
+  }
+  return attachmentCount;
+}
+
+std::unordered_map<std::int64_t, ZoteroCollection> all_collections(ZoteroDBSession& session) {
+  static const std::string queryString =
+      "SELECT collectionID, parentCollectionID, collectionName FROM collections WHERE ?1 IS NULL OR libraryID = ?1";
+
+  std::unordered_map<std::int64_t, ZoteroCollection> collectionMap;
+  try
+  {
+    SQLite::Statement& query = session.statement(queryString);
+    bind_library(query, 1, session);
+    while (query.executeStep())
+    {
       std::int64_t parentCollectionID = -1;
       if (!query.isColumnNull(1))
       {
         parentCollectionID = query.getColumn(1).getInt64();
       }
 
-      // maybe_unused, because std::set has no contains
-      if ([[maybe_unused]] auto iter = collectionIds.find(collectionID) != collectionIds.end())
+      const std::int64_t collectionID = query.getColumn(0).getInt64();
+      collectionMap.try_emplace(collectionID, ZoteroCollection{collectionID, parentCollectionID, query.getColumn(2).getString()});
+    }
+  }
+  catch (std::exception& e)
+  {
+    fmt::print("SQLite exception: {}\n", std::string(e.what()));
+    std::abort();
+  }
+  return collectionMap;
+}
+
+PDFItems changed_pdf_attachment_items(const ZoteroDBState& previousState,
+                                      ZoteroDBSession& session,
+                                      std::pmr::memory_resource* memoryResource) {
+  // clientDateModified has a resolution of one second, items modified in the second of the last export are read again. A library without
+  // a version in the state is compared with -1, all of its items changed.
+  static const std::string queryString = fmt::format(R"(
+        WITH
+        pdfAttachments(itemID, parentItemID, path, key) AS (
+          SELECT itemAttachments.itemID, itemAttachments.parentItemID, itemAttachments.path, items.key
+          FROM itemAttachments
+          LEFT JOIN items ON items.itemID = itemAttachments.itemID
+          LEFT JOIN items parentItems ON parentItems.itemID = itemAttachments.parentItemID
+          LEFT JOIN temp.library_versions versions ON versions.libraryID = items.libraryID
+          LEFT JOIN temp.library_versions parentVersions ON parentVersions.libraryID = parentItems.libraryID
+          WHERE itemAttachments.contentType = 'application/pdf'
+            AND (items.clientDateModified >= ?1 OR items.version > COALESCE(versions.version, -1)
+                 OR parentItems.clientDateModified >= ?1 OR parentItems.version > COALESCE(parentVersions.version, -1))
+            AND (?2 IS NULL OR items.libraryID = ?2)
+        ){})",
+                                                     pdfAttachmentItemsSelect);
+
+  try
+  {
+    load_library_versions(session, previousState);
+    SQLite::Statement& query = session.statement(queryString);
+    query.bind(1, previousState.itemsModified);
+    bind_library(query, 2, session);
+    return read_pdf_attachment_items(query, memoryResource);
+  }
+  catch (std::exception& e)
+  {
+    fmt::print("SQLite exception: {}\n", std::string(e.what()));
+    std::abort();
+  }
+}
+
+std::set<std::int64_t> collection_ids_by_path(std::string_view collectionPath, ZoteroDBSession& session) {
+  static const std::string queryString = R"(
+        WITH RECURSIVE collectionPaths(collectionID, path) AS (
+          SELECT collectionID, collectionName
+          FROM collections
+          WHERE parentCollectionID IS NULL AND (?2 IS NULL OR libraryID = ?2)
+          UNION ALL
+          SELECT c.collectionID, p.path || '/' || c.collectionName
+          FROM collectionPaths p
+          JOIN collections c ON c.parentCollectionID = p.collectionID
+        )
+        SELECT collectionID FROM collectionPaths WHERE path = ?1)";
+
+  while (collectionPath.starts_with('/'))
+  {
+    collectionPath.remove_prefix(1);
+  }
+  while (collectionPath.ends_with('/'))
+  {
+    collectionPath.remove_suffix(1);
+  }
+
+  std::set<std::int64_t> collectionIds;
+  try
+  {
+    SQLite::Statement& query = session.statement(queryString);
+    query.bind(1, std::string(collectionPath));
+    bind_library(query, 2, session);
+    while (query.executeStep())
+    {
+      collectionIds.insert(query.getColumn(0).getInt64());
+    }
+  }
+  catch (std::exception& e)
+  {
+    fmt::print("SQLite exception: {}\n", std::string(e.what()));
+    std::abort();
+  }
+  return collectionIds;
+}
+
+std::vector<ZoteroLibrary> zotero_libraries(ZoteroDBSession& session) {
+  static const std::string queryString = R"(
+        SELECT libraries.libraryID, libraries.type, groups.name
+        FROM libraries
+        LEFT JOIN groups ON groups.libraryID = libraries.libraryID
+        WHERE libraries.type != 'feed'
+        ORDER BY libraries.libraryID)";
+
+  std::vector<ZoteroLibrary> libraries;
+  try
+  {
+    SQLite::Statement& query = session.statement(queryString);
+    while (query.executeStep())
+    {
+      ZoteroLibrary library{query.getColumn(0).getInt64(), query.getColumn(1).getString(), query.getColumn(2).getString()};
+      if (library.type == "user")
       {
-        result.insert(ZoteroCollection{collectionID, parentCollectionID, query.getColumn(2).getText()});
+        library.name = "My Library";
       }
+      else if (library.name.empty())
+      {
+        library.name = fmt::format("Library {}", library.libraryID);
+      }
+      libraries.push_back(std::move(library));
     }
   }
   catch (std::exception& e)
@@ -262,113 +533,370 @@ std::set<ZoteroCollection> parent_collections(const std::set<std::int64_t>& coll
     fmt::print("SQLite exception: {}\n", std::string(e.what()));
     std::abort();
   }
+  return libraries;
+}
 
-  return result;
+PDFItems subtree_pdf_attachment_items(const std::set<std::int64_t>& rootCollectionIds,
+                                      ZoteroDBSession& session,
+                                      std::pmr::memory_resource* memoryResource) {
+  // The attachments are found from the items of the subtrees, through the index of collectionItems by collectionID, instead of reading
+  // all attachments. The memberships are resolved like in pdfAttachmentItemsSelect, the inner joins drop the collections outside of the
+  // subtrees and the attachments whose own collections are all outside.
+  static const std::string queryString = R"(
+        WITH RECURSIVE
+        subtree(collectionID) AS (
+          SELECT ids.id FROM temp.root_collection_ids ids
+          UNION
+          SELECT c.collectionID
+          FROM subtree s
+          JOIN collections c ON c.parentCollectionID = s.collectionID
+        ),
+        subtreeItems(itemID) AS (
+          SELECT DISTINCT ci.itemID
+          FROM subtree s
+          JOIN collectionItems ci ON ci.collectionID = s.collectionID
+        ),
+        pdfAttachments(itemID, parentItemID, path, key) AS (
+          SELECT itemAttachments.itemID, itemAttachments.parentItemID, itemAttachments.path, items.key
+          FROM subtreeItems si
+          JOIN itemAttachments ON itemAttachments.itemID = si.itemID
+          LEFT JOIN items ON items.itemID = itemAttachments.itemID
+          WHERE itemAttachments.contentType = 'application/pdf'
+          UNION
+          SELECT itemAttachments.itemID, itemAttachments.parentItemID, itemAttachments.path, items.key
+          FROM subtreeItems si
+          JOIN itemAttachments ON itemAttachments.parentItemID = si.itemID
+          LEFT JOIN items ON items.itemID = itemAttachments.itemID
+          WHERE itemAttachments.contentType = 'application/pdf'
+        )
+        SELECT a.itemID, a.parentItemID, a.path, a.key, c.collectionID, c.parentCollectionID, c.collectionName
+        FROM pdfAttachments a
+        JOIN collectionItems ci ON ci.itemID = CASE
+          WHEN EXISTS (SELECT 1 FROM collectionItems own WHERE own.itemID = a.itemID) THEN a.itemID
+          ELSE a.parentItemID
+        END
+        JOIN subtree s ON s.collectionID = ci.collectionID
+        JOIN collections c ON c.collectionID = ci.collectionID)";
+
+  try
+  {
+    load_id_table(session, "root_collection_ids", rootCollectionIds.begin(), rootCollectionIds.end());
+    return read_pdf_attachment_items(session.statement(queryString), memoryResource);
+  }
+  catch (std::exception& e)
+  {
+    fmt::print("SQLite exception: {}\n", std::string(e.what()));
+    std::abort();
+  }
 }
 
-std::vector<PDFItem> pdf_items(const std::vector<zotfiles::ZoteroPDFAttachment>& pdfAttachments,
-                               const std::filesystem::path& zoteroDBPath) {
-  std::vector<PDFItem> pdfItems;
-  pdfItems.reserve(pdfAttachments.size());
-  std::transform(pdfAttachments.begin(),
-                 pdfAttachments.end(),
-                 std::back_inserter(pdfItems),
-                 [](const zotfiles::ZoteroPDFAttachment& pdfAttachment) { return PDFItem{pdfAttachment}; });
+std::set<std::int64_t> missing_pdf_attachment_ids(const std::set<std::int64_t>& itemIds, ZoteroDBSession& session) {
+  // The ids of all pdf attachments are read from the covering index on the content type, which is much faster than loading the item ids
+  // of a large export into a temp table to look them up one by one.
+  static const std::string queryString = R"(
+        SELECT itemID FROM itemAttachments WHERE contentType = 'application/pdf')";
 
-  std::vector<std::filesystem::path> pdfFiles;
-  const std::string_view pdfItemPathPrefix = "storage:";
-  for (auto& item: pdfItems)
+  std::vector<std::int64_t> pdfAttachmentIds;
+  try
   {
+    SQLite::Statement& query = session.statement(queryString);
+    while (query.executeStep())
+    {
+      pdfAttachmentIds.push_back(query.getColumn(0).getInt64());
+    }
+  }
+  catch (std::exception& e)
+  {
+    fmt::print("SQLite exception: {}\n", std::string(e.what()));
+    std::abort();
+  }
+  std::sort(pdfAttachmentIds.begin(), pdfAttachmentIds.end());
+
+  std::set<std::int64_t> missingIds;
+  std::set_difference(itemIds.begin(),
+                      itemIds.end(),
+                      pdfAttachmentIds.begin(),
+                      pdfAttachmentIds.end(),
+                      std::inserter(missingIds, missingIds.end()));
+  return missingIds;
+}
 
-    if (item.pdfAttachment.path.find(pdfItemPathPrefix) == 0)
+ZoteroDBState zotero_db_state(ZoteroDBSession& session) {
+  static const std::string queryString = R"(
+        SELECT
+        (SELECT COALESCE(MAX(clientDateModified), '') FROM items WHERE ?1 IS NULL OR libraryID = ?1),
+        (SELECT COALESCE(MAX(clientDateModified), '') FROM collections WHERE ?1 IS NULL OR libraryID = ?1),
+        (SELECT COALESCE(MAX(version), 0) FROM collections WHERE ?1 IS NULL OR libraryID = ?1),
+        (SELECT COUNT(*) FROM collections WHERE ?1 IS NULL OR libraryID = ?1))";
+  static const std::string versionQueryString = R"(
+        SELECT libraryID, MAX(version)
+        FROM items
+        WHERE ?1 IS NULL OR libraryID = ?1
+        GROUP BY libraryID)";
+
+  ZoteroDBState state;
+  state.zoteroDBPath = session.zotero_db_path().string();
+  try
+  {
+    SQLite::Statement& query = session.statement(queryString);
+    bind_library(query, 1, session);
+    if (query.executeStep())
     {
-      item.pdfAttachment.path = item.pdfAttachment.path.substr(pdfItemPathPrefix.size());
+      state.itemsModified = query.getColumn(0).getString();
+      state.collectionsModified = query.getColumn(1).getString();
+      state.collectionsVersion = query.getColumn(2).getInt64();
+      state.collectionCount = query.getColumn(3).getInt64();
     }
+    // The statement is not stepped to its end, it would keep the read transaction on the zotero db open until its next use.
+    query.reset();
 
-    const std::filesystem::path storageDir = zoteroDBPath.parent_path() / "storage" / item.pdfAttachment.key;
-    if (!std::filesystem::exists(storageDir))
+    SQLite::Statement& versionQuery = session.statement(versionQueryString);
+    bind_library(versionQuery, 1, session);
+    while (versionQuery.executeStep())
     {
-      continue;
+      state.itemsVersions.emplace(versionQuery.getColumn(0).getInt64(), versionQuery.getColumn(1).getInt64());
     }
+  }
+  catch (std::exception& e)
+  {
+    fmt::print("SQLite exception: {}\n", std::string(e.what()));
+    std::abort();
+  }
+  return state;
+}
 
-    pdfFiles.clear();
-    for (const auto& file: std::filesystem::directory_iterator(storageDir))
+std::string formatted_zotero_db_state(const ZoteroDBState& state) {
+  // The item versions are written as libraryID:version pairs separated by commas.
+  std::string itemsVersions;
+  for (const auto& [libraryID, version]: state.itemsVersions)
+  {
+    itemsVersions += fmt::format("{}{}:{}", itemsVersions.empty() ? "" : ",", libraryID, version);
+  }
+  // The db path is the last field, so it may contain tabs.
+  return fmt::format("{}\t{}\t{}\t{}\t{}\t{}",
+                     state.itemsModified,
+                     itemsVersions,
+                     state.collectionsModified,
+                     state.collectionsVersion,
+                     state.collectionCount,
+                     state.zoteroDBPath);
+}
+
+std::optional<ZoteroDBState> parse_zotero_db_state(std::string_view formattedState) {
+  auto nextField = [&formattedState]() -> std::optional<std::string_view>
+  {
+    const std::size_t tab = formattedState.find('\t');
+    if (tab == std::string_view::npos)
     {
-      if (file.path().extension() == ".pdf")
+      return std::nullopt;
+    }
+    const std::string_view field = formattedState.substr(0, tab);
+    formattedState.remove_prefix(tab + 1);
+    return field;
+  };
+  auto toInt = [](std::string_view field, std::int64_t& value)
+  {
+    const auto [ptr, errorCode] = std::from_chars(field.data(), field.data() + field.size(), value);
+    return errorCode == std::errc() && ptr == field.data() + field.size();
+  };
+  auto toVersions = [&toInt](std::string_view field, std::map<std::int64_t, std::int64_t>& versions)
+  {
+    while (!field.empty())
+    {
+      const std::size_t comma = std::min(field.find(','), field.size());
+      const std::string_view pair = field.substr(0, comma);
+      field.remove_prefix(std::min(comma + 1, field.size()));
+      const std::size_t colon = pair.find(':');
+      std::int64_t libraryID{};
+      std::int64_t version{};
+      if (colon == std::string_view::npos || !toInt(pair.substr(0, colon), libraryID) || !toInt(pair.substr(colon + 1), version) ||
+          !versions.emplace(libraryID, version).second)
       {
-        pdfFiles.push_back(file.path());
+        return false;
       }
     }
-    if (pdfFiles.empty())
+    return true;
+  };
+
+  ZoteroDBState state;
+  const auto itemsModified = nextField();
+  const auto itemsVersions = nextField();
+  const auto collectionsModified = nextField();
+  const auto collectionsVersion = nextField();
+  const auto collectionCount = nextField();
+  if (!collectionCount || !toVersions(*itemsVersions, state.itemsVersions) || !toInt(*collectionsVersion, state.collectionsVersion) ||
+      !toInt(*collectionCount, state.collectionCount))
+  {
+    return std::nullopt;
+  }
+  state.itemsModified = *itemsModified;
+  state.collectionsModified = *collectionsModified;
+  state.zoteroDBPath = formattedState;
+  return state;
+}
+
+bool collections_unchanged(const ZoteroDBState& previousState, const ZoteroDBState& currentState) {
+  return previousState.zoteroDBPath == currentState.zoteroDBPath && previousState.collectionsModified == currentState.collectionsModified &&
+         previousState.collectionsVersion == currentState.collectionsVersion &&
+         previousState.collectionCount == currentState.collectionCount;
+}
+
+std::set<ZoteroCollection> parent_collections(const std::set<std::int64_t>& collectionIds, ZoteroDBSession& session) {
+  static const std::string queryString = R"(
+        SELECT c.collectionID, c.parentCollectionID, c.collectionName
+        FROM temp.collection_ids ids
+        JOIN collections c ON c.collectionID = ids.id)";
+
+  std::set<ZoteroCollection> result;
+  try
+  {
+    load_id_table(session, "collection_ids", collectionIds.begin(), collectionIds.end());
+    SQLite::Statement& query = session.statement(queryString);
+
+    while (query.executeStep())
     {
-      continue;
+      std::int64_t parentCollectionID = -1;
+      if (!query.isColumnNull(1))
+      {
+        parentCollectionID = query.getColumn(1).getInt64();
+      }
+
+      result.insert(ZoteroCollection{query.getColumn(0).getInt64(), parentCollectionID, query.getColumn(2).getText()});
     }
-    if (pdfFiles.size() > 1)
+  }
+  catch (std::exception& e)
+  {
+    fmt::print("SQLite exception: {}\n", std::string(e.what()));
+    std::abort();
+  }
+
+  return result;
+}
+
+std::unordered_map<std::int64_t, ZoteroCollection> collection_ancestry(const std::set<std::int64_t>& collectionIds,
+                                                                       ZoteroDBSession& session) {
+  std::unordered_map<std::int64_t, ZoteroCollection> collectionMap;
+  if (collectionIds.empty())
+  {
+    return collectionMap;
+  }
+
+  // UNION instead of UNION ALL drops already visited collections, so ancestors shared by several collections are returned once.
+  static const std::string queryString = R"(
+        WITH RECURSIVE ancestors(collectionID, parentCollectionID, collectionName) AS (
+          SELECT c.collectionID, c.parentCollectionID, c.collectionName
+          FROM temp.collection_ids ids
+          JOIN collections c ON c.collectionID = ids.id
+          UNION
+          SELECT c.collectionID, c.parentCollectionID, c.collectionName
+          FROM ancestors a
+          JOIN collections c ON c.collectionID = a.parentCollectionID
+        )
+        SELECT collectionID, parentCollectionID, collectionName FROM ancestors)";
+
+  try
+  {
+    load_id_table(session, "collection_ids", collectionIds.begin(), collectionIds.end());
+    SQLite::Statement& query = session.statement(queryString);
+
+    while (query.executeStep())
     {
-      fmt::print("More than one pdf file found in the folder: {}\n", storageDir.string());
-      continue;
+      std::int64_t parentCollectionID = -1;
+      if (!query.isColumnNull(1))
+      {
+        parentCollectionID = query.getColumn(1).getInt64();
+      }
+
+      const std::int64_t collectionID = query.getColumn(0).getInt64();
+      collectionMap.try_emplace(collectionID, ZoteroCollection{collectionID, parentCollectionID, query.getColumn(2).getString()});
     }
+  }
+  catch (std::exception& e)
+  {
+    fmt::print("SQLite exception: {}\n", std::string(e.what()));
+    std::abort();
+  }
 
-    item.pdfFilePath = pdfFiles.front();
+  return collectionMap;
+}
+
+PDFItems pdf_items(PDFItems pdfAttachments, const ZoteroDBSession& session) {
+  resolve_pdf_file_paths(pdfAttachments, session);
+  return pdfAttachments;
+}
+
+void resolve_pdf_file_paths(PDFItems& pdfItems, const ZoteroDBSession& session) {
+  resolve_pdf_file_paths(pdfItems, StorageIndex::build(session.storage_dir()));
+}
+
+std::filesystem::path resolve_pdf_file_path(ZoteroPDFAttachment& pdfAttachment,
+                                            const StorageIndex::Entry* storageEntry,
+                                            const std::filesystem::path& storageDir) {
+  const std::string_view pdfItemPathPrefix = "storage:";
+  if (pdfAttachment.path.starts_with(pdfItemPathPrefix))
+  {
+    pdfAttachment.path.remove_prefix(pdfItemPathPrefix.size());
   }
 
-  return pdfItems;
+  if (!storageEntry)
+  {
+    return {};
+  }
+  if (storageEntry->pdfFileCount > 1)
+  {
+    fmt::print("More than one pdf file found in the folder: {}\n", (storageDir / pdfAttachment.key).string());
+    return {};
+  }
+  return storageEntry->pdfFilePath;
+}
+
+void resolve_pdf_file_paths(PDFItems& pdfItems, const StorageIndex& storageIndex) {
+  for (auto& item: pdfItems)
+  {
+    item.pdfFilePath =
+        resolve_pdf_file_path(item.pdfAttachment, storageIndex.find(item.pdfAttachment.key), storageIndex.storage_dir());
+  }
 }
 
-template <typename ItemIDsPolicy, typename ForwardIter>
-static std::unordered_map<std::int64_t, std::vector<ZoteroCollection>>
-retrieve_item_collections(ForwardIter begin, ForwardIter end, const std::filesystem::path& zoteroDbPath) {
+/**
+ *\brief Calls addCollection(itemID, collectionID, parentCollectionID, collectionName) for every collection of the given items.
+ */
+template <typename ItemIDsPolicy, typename ForwardIter, typename AddCollection>
+static void retrieve_item_collections(ForwardIter begin, ForwardIter end, ZoteroDBSession& session, AddCollection addCollection) {
   ItemIDsPolicy itemIDsPolicy;
   itemIDsPolicy(begin, end);
 
-  // Prepare the base query with placeholders
-  std::string queryString = R"(
+  static const std::string queryString = fmt::format(R"(
+        WITH
+        pdfAttachments(itemID, parentItemID) AS (
+          SELECT itemAttachments.itemID, itemAttachments.parentItemID
+          FROM temp.item_ids ids
+          JOIN itemAttachments ON itemAttachments.itemID = ids.id
+        ),{}
         SELECT
-        items.itemID,
-        collectionItems.collectionID,
+        m.itemID,
+        collections.collectionID,
         collections.parentCollectionID,
         collections.collectionName
         FROM
-        items
-        LEFT JOIN collectionItems ON collectionItems.itemID = items.itemID
-        LEFT JOIN collections ON collections.collectionID = collectionItems.collectionID
-        WHERE items.itemID IN ()";
-  int count = 0;
-  for (auto iter = itemIDsPolicy.cbegin(); iter != itemIDsPolicy.cend(); ++iter)
-  {
-    queryString += (count == 0 ? "?" : ",?");
-    ++count;
-  }
-  queryString += ")";
+        pdfAttachmentMemberships m
+        JOIN collections ON collections.collectionID = m.collectionID)",
+                                                     pdfAttachmentMembershipsCTE);
 
-  std::unordered_map<std::int64_t, std::vector<ZoteroCollection>> itemCollectionMap;
   try
   {
-    const SQLite::Database db(zoteroDbPath, SQLite::OPEN_READONLY);
-    SQLite::Statement query(db, queryString);
-
-    int placeholderIndex = 1;
-    for (auto it = itemIDsPolicy.cbegin(); it != itemIDsPolicy.cend(); ++it)
-    {
-      query.bind(placeholderIndex++, *it);
-    }
+    load_id_table(session, "item_ids", itemIDsPolicy.cbegin(), itemIDsPolicy.cend());
+    SQLite::Statement& query = session.statement(queryString);
 
     while (query.executeStep())
     {
-      if (query.isColumnNull(1))
-      {
-        continue;
-      }
-
       std::int64_t parentCollectionID = -1;
       if (!query.isColumnNull(2))
       {
         parentCollectionID = query.getColumn(2).getInt64();
       }
 
-      itemCollectionMap[query.getColumn(0).getInt64()].emplace_back(query.getColumn(1).getInt64(),
-                                                                    parentCollectionID,
-                                                                    query.getColumn(3).getString());
+      addCollection(query.getColumn(0).getInt64(), query.getColumn(1).getInt64(), parentCollectionID, query.getColumn(3).getText());
     }
   }
   catch (std::exception& e)
@@ -376,102 +904,65 @@ retrieve_item_collections(ForwardIter begin, ForwardIter end, const std::filesys
     fmt::print("SQLite exception: {}\n", std::string(e.what()));
     std::abort();
   }
+}
 
-  return itemCollectionMap;
-}
-
-void retrieve_pdf_item_collections(std::vector<PDFItem>& pdfItems, const std::filesystem::path& zoteroDBPath) {
-  // Find collections of the pdf items.
-  const std::unordered_map<std::int64_t, std::vector<ZoteroCollection>> itemCollectionMap =
-      retrieve_item_collections<PDFItemIDsPolicy>(pdfItems.begin(), pdfItems.end(), zoteroDBPath);
-
-  std::for_each(std::execution::par_unseq,
-                pdfItems.begin(),
-                pdfItems.end(),
-                [&itemCollectionMap](auto& pdfItem)
-                {
-                  auto iter = itemCollectionMap.find(pdfItem.pdfAttachment.itemID);
-                  if (iter != itemCollectionMap.end())
-                  {
-                    pdfItem.collectionItems = iter->second;
-                  }
-                });
-
-  // PDF items without a collection but a parent item id.
-  auto noCollectionEndIter = std::partition(std::execution::par_unseq,
-                                            pdfItems.begin(),
-                                            pdfItems.end(),
-                                            [](const PDFItem& pdfItem) { return pdfItem.collectionItems.empty(); });
-
-  // Find collections of the parent items.
-  const std::unordered_map<std::int64_t, std::vector<ZoteroCollection>> parentItemMap =
-      retrieve_item_collections<PDFParentItemIdsPolicy>(pdfItems.begin(), noCollectionEndIter, zoteroDBPath);
-
-  // Add the collections of the parent items to the pdf items.
-  std::for_each(pdfItems.begin(),
-                noCollectionEndIter,
-                [&parentItemMap](PDFItem& pdfItem)
-                {
-                  auto collectionIter = parentItemMap.find(pdfItem.pdfAttachment.parentItemID);
-                  if (collectionIter != parentItemMap.end())
-                  {
-                    pdfItem.collectionItems = collectionIter->second;
-                  }
-                });
-}
-std::unordered_map<std::int64_t, ZoteroCollection> all_pdf_item_collections(const std::vector<PDFItem>& pdfItems,
-                                                                            const std::filesystem::path& zoteroDBPath) {
-  std::unordered_map<std::int64_t, ZoteroCollection> collectionMap;
-  std::for_each(pdfItems.begin(),
-                pdfItems.end(),
-                [&collectionMap](const PDFItem& pdfItem)
-                {
-                  for (const auto& collection: pdfItem.collectionItems)
-                  {
-                    collectionMap.try_emplace(collection.collectionID, collection);
-                  }
-                });
-
-  std::set<std::int64_t> missingParentCollections;
-  for (const auto& pdfItem: pdfItems)
+void retrieve_pdf_item_collections(PDFItems& pdfItems, ZoteroDBSession& session) {
+  std::pmr::unordered_map<std::int64_t, std::size_t> pdfItemIndices(pdfItems.memory_resource());
+  pdfItemIndices.reserve(pdfItems.size());
+  for (std::size_t i = 0; i < pdfItems.size(); ++i)
   {
-    for (const auto& collection: pdfItem.collectionItems)
-    {
-      if (collection.parentCollectionID == -1)
-      {
-        continue;
-      }
+    pdfItemIndices.try_emplace(pdfItems[i].pdfAttachment.itemID, i);
+  }
 
-      auto iter = collectionMap.find(collection.parentCollectionID);
-      if (iter == collectionMap.end())
+  retrieve_item_collections<PDFItemIDsPolicy>(
+      pdfItems.begin(),
+      pdfItems.end(),
+      session,
+      [&pdfItems, &pdfItemIndices](std::int64_t itemID, std::int64_t collectionID, std::int64_t parentCollectionID, std::string_view name)
       {
-        missingParentCollections.emplace(collection.parentCollectionID);
-      }
+        auto iter = pdfItemIndices.find(itemID);
+        if (iter != pdfItemIndices.end())
+        {
+          pdfItems.add_collection(iter->second, collectionID, parentCollectionID, name);
+        }
+      });
+}
+
+std::unordered_map<std::int64_t, ZoteroCollection> all_pdf_item_collections(const PDFItems& pdfItems, ZoteroDBSession& session) {
+  // Every collection is stored once in the pdf items, only the collections of items that were not erased are collected.
+  std::vector<bool> usedCollections(pdfItems.all_collections().size());
+  for (const PDFItem& pdfItem: pdfItems)
+  {
+    for (std::uint32_t collectionRef: pdfItems.collection_refs(pdfItem))
+    {
+      usedCollections[collectionRef] = true;
     }
   }
 
-  while (!missingParentCollections.empty())
+  std::unordered_map<std::int64_t, ZoteroCollection> collectionMap;
+  for (std::size_t i = 0; i < usedCollections.size(); ++i)
   {
-    auto res = parent_collections(missingParentCollections, zoteroDBPath);
-    missingParentCollections.clear();
-    for (const auto& collection: res)
+    if (usedCollections[i])
     {
-      const std::int64_t collectionID = collection.collectionID;
-      auto idIter = collectionMap.find(collectionID);
-      if (idIter == collectionMap.end())
-      {
-        collectionMap.try_emplace(collectionID, collection);
-      }
+      const ZoteroCollection& collection = pdfItems.all_collections()[i];
+      collectionMap.try_emplace(collection.collectionID, collection);
+    }
+  }
 
-      const std::int64_t parentCollectionID = collection.parentCollectionID;
-      auto parentIDIter = collectionMap.find(parentCollectionID);
-      if (parentIDIter == collectionMap.end())
-      {
-        missingParentCollections.emplace(parentCollectionID);
-      }
+  std::set<std::int64_t> missingParentCollections;
+  for (const auto& [collectionID, collection]: collectionMap)
+  {
+    if (collection.parentCollectionID != -1 && !collectionMap.contains(collection.parentCollectionID))
+    {
+      missingParentCollections.emplace(collection.parentCollectionID);
     }
   }
 
+  for (auto& [collectionID, collection]: collection_ancestry(missingParentCollections, session))
+  {
+    collectionMap.try_emplace(collectionID, std::move(collection));
+  }
+
   return collectionMap;
 }
 } // namespace zotfiles
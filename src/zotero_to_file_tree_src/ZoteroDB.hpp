@@ -1,12 +1,23 @@
 #ifndef ZOTERO_TO_FILE_TREE_ZOTERODB_H
 #define ZOTERO_TO_FILE_TREE_ZOTERODB_H
 
-#include "PDFItem.hpp"
+#include "PDFItems.hpp"
+#include "StorageIndex.hpp"
 #include "ZoteroCollection.hpp"
+#include "ZoteroDBSession.hpp"
+#include "ZoteroLibrary.hpp"
 #include <cstdint>
 #include <filesystem>
+#include <functional>
+#include <map>
+#include <optional>
 #include <set>
+#include <span>
+#include <string>
+#include <string_view>
+#include <memory_resource>
 #include <unordered_map>
+#include <vector>
 
 namespace zotfiles
 {
@@ -22,6 +33,26 @@ struct ZoteroDBInfo {
   std::uint32_t globalSchema{};
   std::uint32_t deletes{}; // original: delete, but delete is a keyword
   std::uint32_t compatibility{};
+
+  bool operator==(const ZoteroDBInfo& rhs) const = default;
+};
+
+/**
+ *\brief The modification state of the items and collections of a zotero db.
+ *
+ * The state is stored with an export. A later export compares it with the current state to query only the items that changed since.
+ * Local changes update clientDateModified, changes downloaded by the zotero sync update the version. Sync versions are counted per
+ * library, so the latest item version is kept for every library.
+ */
+struct ZoteroDBState {
+  std::string zoteroDBPath;          /**< The zotero db the state belongs to. */
+  std::string itemsModified;         /**< Latest clientDateModified of all items. */
+  std::map<std::int64_t, std::int64_t> itemsVersions; /**< Latest sync version of the items of every library, by libraryID. */
+  std::string collectionsModified;   /**< Latest clientDateModified of all collections. */
+  std::int64_t collectionsVersion{}; /**< Latest sync version of all collections. */
+  std::int64_t collectionCount{};    /**< Number of collections, changes if a collection is deleted. */
+
+  bool operator==(const ZoteroDBState& rhs) const = default;
 };
 
 /**
@@ -32,12 +63,12 @@ struct ZoteroDBInfo {
 /**
  *\brief Returns the zotero db info.
  *
- * Returns the zotero db info for the given zotero db file path or aborts if the zotero db file does not exist.
+ * Returns the zotero db info of the zotero db opened by the given session.
  *
- * @param zoteroDBPath Absolute path to the zotero db file.
- * @return The ZoteroDBInfo for the given path.
+ * @param session The session of the zotero db.
+ * @return The ZoteroDBInfo of the session's zotero db.
  */
-[[nodiscard]] ZoteroDBInfo zotero_db_info(const std::filesystem::path& zoteroDBPath);
+[[nodiscard]] ZoteroDBInfo zotero_db_info(ZoteroDBSession& session);
 
 /**
  *\brief Returns a formatted string of the given ZoteroDBInfo.
@@ -56,27 +87,205 @@ struct ZoteroDBInfo {
 /**
  *\brief Returns true if the given zotero db info is supported.
  *
- * @param zoteroDBPath Absolute path to the zotero db file.
+ * @param session The session of the zotero db.
  *
  * @return True if the given zotero db info is supported.
  */
-[[nodiscard]] bool is_supported_zotero_db(const std::filesystem::path& zoteroDBPath);
+[[nodiscard]] bool is_supported_zotero_db(ZoteroDBSession& session);
 
 /**
  *\brief Retrieves all pdf attachments from the zotero db.
  *
- * @param zoteroDBPath Absolute path to the zotero db file.
+ * @param session The session of the zotero db.
+ * @param memoryResource The memory resource of the returned PDFItems.
+ *
+ * @return One PDFItem without collections and without a resolved pdf file for each pdf attachment.
  */
-[[nodiscard]] std::vector<ZoteroPDFAttachment> pdf_attachments(const std::filesystem::path& zoteroDBPath);
+[[nodiscard]] PDFItems pdf_attachments(ZoteroDBSession& session,
+                                       std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource());
 
 /**
  *\brief Retrieves all collections that are parents of the given collectionIDs that are not already in the given collections.
  *
  * @param collectionIds The collection IDs to retrieve the parent collections for.
- * @param zoteroDBPath Absolute path to the zotero db file.
+ * @param session The session of the zotero db.
+ */
+[[nodiscard]] std::set<ZoteroCollection> parent_collections(const std::set<std::int64_t>& collectionIds, ZoteroDBSession& session);
+
+/**
+ *\brief Retrieves the given collections and all of their ancestor collections.
+ *
+ * The whole ancestry is resolved with a single recursive query, independent of the depth of the collection hierarchy.
+ *
+ * @param collectionIds The collection IDs to start the ancestry from.
+ * @param session The session of the zotero db.
+ *
+ * @return A map of collection IDs to ZoteroCollection containing the given collections and all of their ancestors.
+ */
+[[nodiscard]] std::unordered_map<std::int64_t, ZoteroCollection> collection_ancestry(const std::set<std::int64_t>& collectionIds,
+                                                                                     ZoteroDBSession& session);
+
+/**
+ *\brief Retrieves all pdf attachments from the zotero db together with their collections.
+ *
+ * Attachments that are not part of any collection inherit the collections of their parent item. The attachments and their resolved
+ * collections are read with a single query. The pdfFilePath of the returned PDFItems is not resolved, see resolve_pdf_file_paths.
+ *
+ * @param session The session of the zotero db.
+ * @param memoryResource The memory resource of the returned PDFItems and of the index used to group the rows.
+ *
+ * @return One PDFItem for each pdf attachment.
+ */
+[[nodiscard]] PDFItems pdf_attachment_items(ZoteroDBSession& session,
+                                            std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource());
+
+/**
+ *\brief Reads the pdf attachments with the ids of their collections and calls attachmentFunc for every attachment as it is read.
+ *
+ * Reads the same rows as pdf_attachment_items ordered by the attachment, but does not keep them. The rows of an attachment are
+ * consecutive, so every attachment is passed as soon as its last row is read. The path and the key of the attachment are only valid during
+ * the call.
+ *
+ * @param session The session of the zotero db. Must not be used by another thread until the function returns.
+ * @param attachmentFunc Called with the attachment and the ids of its own or inherited collections, which may be empty.
+ *
+ * @return The number of attachments passed to attachmentFunc.
+ */
+std::size_t for_each_pdf_attachment_item(
+    ZoteroDBSession& session,
+    const std::function<void(const ZoteroPDFAttachment& pdfAttachment, std::span<const std::int64_t> collectionIDs)>& attachmentFunc);
+
+/**
+ *\brief Retrieves all collections of the zotero db, or of the library set with ZoteroDBSession::set_library_id.
+ *
+ * @param session The session of the zotero db.
+ *
+ * @return A map of collection IDs to ZoteroCollection.
+ */
+[[nodiscard]] std::unordered_map<std::int64_t, ZoteroCollection> all_collections(ZoteroDBSession& session);
+
+/**
+ *\brief Returns the current modification state of the zotero db, or of the library set with ZoteroDBSession::set_library_id.
+ *
+ * @param session The session of the zotero db.
+ */
+[[nodiscard]] ZoteroDBState zotero_db_state(ZoteroDBSession& session);
+
+/**
+ *\brief Returns the ZoteroDBState as a single line of text, see parse_zotero_db_state.
+ */
+[[nodiscard]] std::string formatted_zotero_db_state(const ZoteroDBState& state);
+
+/**
+ *\brief Parses a ZoteroDBState written by formatted_zotero_db_state. Returns std::nullopt if the text is not a valid state.
+ */
+[[nodiscard]] std::optional<ZoteroDBState> parse_zotero_db_state(std::string_view formattedState);
+
+/**
+ *\brief Returns true if the collections did not change between the two states.
+ *
+ * Renamed, moved and deleted collections change the paths of all of their pdf files, so an export can only be updated with the changed
+ * items if the collections are unchanged.
+ */
+[[nodiscard]] bool collections_unchanged(const ZoteroDBState& previousState, const ZoteroDBState& currentState);
+
+/**
+ *\brief Retrieves the pdf attachments that changed since the given state together with their collections.
+ *
+ * An attachment changed if the attachment itself or its parent item was modified locally or by the zotero sync since the state was taken.
+ * The sync version of an item is compared with the latest version of its own library in the state, every item of a library that is not
+ * in the state changed.
+ * The parent item is included, because attachments without own collections inherit the collections of their parent item. The returned
+ * PDFItems match the PDFItems of pdf_attachment_items.
+ *
+ * @param previousState The state of the last export.
+ * @param session The session of the zotero db.
+ * @param memoryResource The memory resource of the returned PDFItems and of the index used to group the rows.
+ */
+[[nodiscard]] PDFItems changed_pdf_attachment_items(const ZoteroDBState& previousState,
+                                                    ZoteroDBSession& session,
+                                                    std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource());
+
+/**
+ *\brief Returns the ids of the collections with the given path, e.g. "Papers/Geometry".
+ *
+ * The path consists of the collection names from a top level collection down to the collection, separated by '/'. Leading and trailing
+ * separators are ignored. The paths of all collections are built with a single recursive query. Collections of different libraries can
+ * have the same path, so several ids can be returned, unless the session is restricted to one library.
+ *
+ * @param collectionPath The path of the collection.
+ * @param session The session of the zotero db.
+ *
+ * @return The ids of the collections with the path, empty if there is none.
+ */
+[[nodiscard]] std::set<std::int64_t> collection_ids_by_path(std::string_view collectionPath, ZoteroDBSession& session);
+
+/**
+ *\brief Returns the user and group libraries of the zotero db ordered by libraryID. Feeds are not included, they hold no attachments.
+ *
+ * @param session The session of the zotero db.
+ */
+[[nodiscard]] std::vector<ZoteroLibrary> zotero_libraries(ZoteroDBSession& session);
+
+/**
+ *\brief Retrieves the pdf attachments in the subtrees of the given collections together with their collections in these subtrees.
+ *
+ * The subtrees are resolved with a recursive query over the collections, so only the attachments that are part of a subtree, directly or
+ * through their parent item, are read. The collections of an attachment are resolved like in pdf_attachment_items, collections outside of
+ * the subtrees are left out. The returned PDFItems match the PDFItems of pdf_attachment_items restricted to the subtrees.
+ *
+ * @param rootCollectionIds The ids of the root collections of the subtrees.
+ * @param session The session of the zotero db.
+ * @param memoryResource The memory resource of the returned PDFItems and of the index used to group the rows.
+ */
+[[nodiscard]] PDFItems subtree_pdf_attachment_items(const std::set<std::int64_t>& rootCollectionIds,
+                                                    ZoteroDBSession& session,
+                                                    std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource());
+
+/**
+ *\brief Returns the ids of the given item ids that are not pdf attachments anymore, e.g. because the items were deleted.
+ *
+ * @param itemIds The item ids of the pdf attachments of the last export.
+ * @param session The session of the zotero db.
+ */
+[[nodiscard]] std::set<std::int64_t> missing_pdf_attachment_ids(const std::set<std::int64_t>& itemIds, ZoteroDBSession& session);
+
+/**
+ *\brief Resolves the pdf files of the given PDFItems in the zotero storage directory.
+ *
+ * A ZoteroPDFAttachment is an entry in the zotero db that may contain multiple pdf files. The pdfFilePath is only set if exactly one pdf
+ * file is found for an attachment. It is possible that no pdf files are found for a ZoteroPDFAttachment, because the pdf files were
+ * deleted separately. The PDFItems are modified in place.
+ *
+ * @param pdfItems The pdf items to resolve the pdf files for.
+ * @param session The session of the zotero db. The storage directory is located next to the zotero db file.
+ */
+void resolve_pdf_file_paths(PDFItems& pdfItems, const ZoteroDBSession& session);
+
+/**
+ *\brief Resolves the pdf files of the given PDFItems with a prebuilt index of the storage directory.
+ *
+ * Resolving a pdf file is a hash lookup of the attachment key in the storageIndex. The PDFItems are modified in place.
+ *
+ * @param pdfItems The pdf items to resolve the pdf files for.
+ * @param storageIndex The index of the zotero storage directory.
+ */
+void resolve_pdf_file_paths(PDFItems& pdfItems, const StorageIndex& storageIndex);
+
+/**
+ *\brief Resolves the pdf file of a single attachment from the entry of its key directory.
+ *
+ * The "storage:" prefix of the path of attachments stored in the storage directory is removed, the remaining path is the pdf name.
+ *
+ * @param pdfAttachment The attachment, its path is modified in place.
+ * @param storageEntry The entry of the key directory of the attachment or nullptr if it has none.
+ * @param storageDir The zotero storage directory, used in messages.
+ *
+ * @return The pdf file or an empty path if the key directory has no pdf file or more than one.
  */
-[[nodiscard]] std::set<ZoteroCollection> parent_collections(const std::set<std::int64_t>& collectionIds,
-                                                            const std::filesystem::path& zoteroDBPath);
+[[nodiscard]] std::filesystem::path resolve_pdf_file_path(ZoteroPDFAttachment& pdfAttachment,
+                                                        const StorageIndex::Entry* storageEntry,
+                                                        const std::filesystem::path& storageDir);
 
 /**
  *\brief Retrieves all pdf items from the given ZoteroPDFAttachments.
@@ -85,36 +294,34 @@ struct ZoteroDBInfo {
  * contain multiple pdf items. It is possible that no pdf files are found for a ZoteroPDFAttachment, because the pdf files were deleted
  * separately.
  *
- * @param pdfAttachments The pdf attachments to retrieve the pdf items for.
- * @param zoteroDBPath Absolute path to the zotero db file.
+ * @param pdfAttachments The pdf attachments to retrieve the pdf items for, see pdf_attachments.
+ * @param session The session of the zotero db. The storage directory is located next to the zotero db file.
  *
- * @return The found pdf files.
+ * @return The pdf attachments with their resolved pdf files.
  */
-[[nodiscard]] std::vector<PDFItem> pdf_items(const std::vector<zotfiles::ZoteroPDFAttachment>& pdfAttachments,
-                                             const std::filesystem::path& zoteroDBPath);
+[[nodiscard]] PDFItems pdf_items(PDFItems pdfAttachments, const ZoteroDBSession& session);
 
 /**
- *\brief Retrieves all collections of the given PDFItems and their parent collections.
+ *\brief Retrieves all collections of the given PDFItems.
  *
- * Most pdf items have a parent item that holds the information about the collection hierarchy.
- * This function adds the missing information to each PDFItem. That holds all relevant information about the pdf file and the collections
- * its belonging to. The PDFItems are modified in place.
+ * Most pdf items have a parent item that holds the information about the collection hierarchy. PDF items that are not part of any
+ * collection inherit the collections of their parent item. The own and inherited collections are resolved with a single query. The
+ * PDFItems are modified in place, the index of the items by itemID is allocated from their memory resource.
  *
  * @param pdfItems The pdf items to retrieve the collections for.
- * @param zoteroDBPath Absolute path to the zotero db file.
+ * @param session The session of the zotero db.
  */
-void retrieve_pdf_item_collections(std::vector<PDFItem>& pdfItems, const std::filesystem::path& zoteroDBPath);
+void retrieve_pdf_item_collections(PDFItems& pdfItems, ZoteroDBSession& session);
 
 /**
  *\brief Collects all pdf item collections and their parent collections
  *
  * @param pdfItems The pdf items to retrieve the collections for.
- * @param zoteroDBPath Absolute path to the zotero db file.
+ * @param session The session of the zotero db.
  *
  * @return A map of collection IDs to ZoteroCollection.
  */
-std::unordered_map<std::int64_t, ZoteroCollection> all_pdf_item_collections(const std::vector<PDFItem>& pdfItems,
-                                                                            const std::filesystem::path& zoteroDBPath);
+std::unordered_map<std::int64_t, ZoteroCollection> all_pdf_item_collections(const PDFItems& pdfItems, ZoteroDBSession& session);
 
 } // namespace zotfiles
 
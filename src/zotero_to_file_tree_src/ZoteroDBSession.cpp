@@ -0,0 +1,296 @@
+#include "ZoteroDBSession.hpp"
+#include <SQLiteCpp/SQLiteCpp.h>
+#include <algorithm>
+#include <chrono>
+#include <fmt/format.h>
+#include <sqlite3.h>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+
+namespace zotfiles
+{
+
+namespace
+{
+
+/** Time a read waits for a lock of the zotero client before it fails. */
+constexpr int busyTimeoutMs = 5000;
+
+SQLite::Database open_zotero_db(const std::filesystem::path& zoteroDBPath) {
+  return SQLite::Database(zoteroDBPath, SQLite::OPEN_READONLY, busyTimeoutMs);
+}
+
+/**
+ *\brief Exponential backoff for reads that found the zotero db locked by the zotero client for longer than the busy timeout.
+ */
+class LockBackoff {
+  static constexpr int maxRetries = 7;
+  static constexpr std::chrono::milliseconds maxBackoff{8000};
+  int m_retries{0};
+  std::chrono::milliseconds m_backoff{250};
+
+public:
+  /**
+   *\brief Waits before the next retry. Returns false if all retries are used up.
+   */
+  bool wait() {
+    if (m_retries == maxRetries)
+    {
+      return false;
+    }
+    ++m_retries;
+    fmt::print("The zotero db is locked, retrying in {} ms.\n", m_backoff.count());
+    std::this_thread::sleep_for(m_backoff);
+    m_backoff = std::min(m_backoff * 2, maxBackoff);
+    return true;
+  }
+};
+
+/**
+ *\brief Copies the zotero db into the snapshot db with the online backup API.
+ *
+ * If the zotero client holds a lock on the zotero db for longer than the busy timeout, the backup is retried with a LockBackoff.
+ * Throws a SQLite::Exception if the zotero db is still locked after the last attempt.
+ */
+void copy_snapshot(const std::filesystem::path& zoteroDBPath, SQLite::Database& snapshotDB) {
+  SQLite::Database zoteroDB = open_zotero_db(zoteroDBPath);
+  LockBackoff lockBackoff;
+  while (true)
+  {
+    SQLite::Backup backup(snapshotDB, zoteroDB);
+    const int result = backup.executeStep(-1);
+    if (result == SQLITE_DONE)
+    {
+      return;
+    }
+    if (!lockBackoff.wait())
+    {
+      throw SQLite::Exception("The zotero db is locked by another process", result);
+    }
+  }
+}
+
+/**
+ *\brief The lock wait of a connection that queries the zotero db directly, see wait_for_lock.
+ */
+struct LockWait {
+  std::chrono::steady_clock::time_point start;
+  LockBackoff backoff;
+};
+
+/**
+ *\brief Busy handler of a connection that queries the zotero db directly.
+ *
+ * Polls for the lock during the busy timeout like sqlite3_busy_timeout, then retries with the LockBackoff of copy_snapshot. Returns 0 to
+ * let the query fail with SQLITE_BUSY.
+ *
+ * @param count Number of times the handler was called for the current lock.
+ */
+int wait_for_lock(void* lockWaitPtr, int count) {
+  static constexpr std::chrono::milliseconds pollInterval{10};
+  auto& lockWait = *static_cast<LockWait*>(lockWaitPtr);
+  const auto now = std::chrono::steady_clock::now();
+  if (count == 0)
+  {
+    lockWait = LockWait{now, LockBackoff()};
+  }
+  if (now - lockWait.start < std::chrono::milliseconds(busyTimeoutMs))
+  {
+    std::this_thread::sleep_for(pollInterval);
+    return 1;
+  }
+  return lockWait.backoff.wait() ? 1 : 0;
+}
+
+/**
+ *\brief Returns the size and the modification time of the file or directory, 0 for both if it does not exist.
+ */
+std::pair<std::uint64_t, std::int64_t> file_size_and_mtime(const std::filesystem::path& filePath) {
+  std::error_code errorCode;
+  const std::filesystem::file_time_type mtime = std::filesystem::last_write_time(filePath, errorCode);
+  if (errorCode)
+  {
+    return {0, 0};
+  }
+  const std::uint64_t size = std::filesystem::is_directory(filePath, errorCode) ? 0 : std::filesystem::file_size(filePath, errorCode);
+  return {errorCode ? 0 : size, std::chrono::duration_cast<std::chrono::nanoseconds>(mtime.time_since_epoch()).count()};
+}
+
+ZoteroDBFileState read_file_state(const std::filesystem::path& zoteroDBPath) {
+  ZoteroDBFileState fileState;
+  std::filesystem::path walPath = zoteroDBPath;
+  walPath += "-wal";
+  std::tie(fileState.dbSize, fileState.dbMTime) = file_size_and_mtime(zoteroDBPath);
+  std::tie(fileState.walSize, fileState.walMTime) = file_size_and_mtime(walPath);
+  fileState.storageMTime = file_size_and_mtime(zoteroDBPath.parent_path() / "storage").second;
+  return fileState;
+}
+
+SQLite::Database open_snapshot(const std::filesystem::path& zoteroDBPath) {
+  SQLite::Database snapshotDB(":memory:", SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+  copy_snapshot(zoteroDBPath, snapshotDB);
+  return snapshotDB;
+}
+
+} // namespace
+
+struct ZoteroDBSession::Impl {
+  std::filesystem::path zoteroDBPath;
+  bool snapshot;
+  bool copy{false}; /**< True if db is a copy written by write_copy(), which can not be refreshed. */
+  std::optional<std::int64_t> libraryID;
+  ZoteroDBFileState fileState;
+  LockWait lockWait; /**< Declared before db, the busy handler of db uses it until db is closed. */
+  SQLite::Database db;
+  std::unordered_map<std::string, std::unique_ptr<SQLite::Statement>> statements;
+
+  Impl(std::filesystem::path dbPath, bool snapshotDB)
+      : zoteroDBPath(std::move(dbPath))
+      , snapshot(snapshotDB)
+      , fileState(read_file_state(zoteroDBPath))
+      , db(snapshot ? open_snapshot(zoteroDBPath) : open_zotero_db(zoteroDBPath)) {
+    // A snapshot is only locked while it is copied, the queries of a live session retry like the copy does.
+    if (!snapshot)
+    {
+      sqlite3_busy_handler(db.getHandle(), wait_for_lock, &lockWait);
+    }
+  }
+
+  Impl(const Impl& source, const std::filesystem::path& copyPath)
+      : zoteroDBPath(source.zoteroDBPath)
+      , snapshot(true)
+      , copy(true)
+      , fileState(source.fileState)
+      , db(open_zotero_db(copyPath)) {}
+};
+
+ZoteroDBSession::ZoteroDBSession(std::filesystem::path zoteroDBPath, bool snapshot) {
+  if (!std::filesystem::exists(zoteroDBPath))
+  {
+    fmt::print("Zotero DB file does not exist: {}\n", zoteroDBPath.string());
+    std::abort();
+  }
+
+  try
+  { m_impl = std::make_unique<Impl>(std::move(zoteroDBPath), snapshot); }
+  catch (std::exception& e)
+  {
+    fmt::print("SQLite exception: {}\n", std::string(e.what()));
+    std::abort();
+  }
+}
+
+ZoteroDBSession::ZoteroDBSession(std::unique_ptr<Impl> impl)
+    : m_impl(std::move(impl)) {}
+
+ZoteroDBSession::~ZoteroDBSession() = default;
+ZoteroDBSession::ZoteroDBSession(ZoteroDBSession&&) noexcept = default;
+ZoteroDBSession& ZoteroDBSession::operator=(ZoteroDBSession&&) noexcept = default;
+
+const std::filesystem::path& ZoteroDBSession::zotero_db_path() const {
+  return m_impl->zoteroDBPath;
+}
+
+std::filesystem::path ZoteroDBSession::storage_dir() const {
+  return m_impl->zoteroDBPath.parent_path() / "storage";
+}
+
+bool ZoteroDBSession::is_snapshot() const {
+  return m_impl->snapshot;
+}
+
+void ZoteroDBSession::refresh_snapshot() {
+  if (!m_impl->snapshot || m_impl->copy)
+  {
+    return;
+  }
+
+  m_impl->statements.clear();
+  m_impl->fileState = read_file_state(m_impl->zoteroDBPath);
+  try
+  { copy_snapshot(m_impl->zoteroDBPath, m_impl->db); }
+  catch (std::exception& e)
+  {
+    fmt::print("SQLite exception: {}\n", std::string(e.what()));
+    std::abort();
+  }
+}
+
+void ZoteroDBSession::write_copy(const std::filesystem::path& copyPath) {
+  try
+  {
+    SQLite::Database copyDB(copyPath, SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE);
+    SQLite::Backup backup(copyDB, m_impl->db);
+    // A partial copy must not be read by the sessions of other threads.
+    const int result = backup.executeStep(-1);
+    if (result != SQLITE_DONE)
+    {
+      throw SQLite::Exception("The db could not be copied completely", result);
+    }
+  }
+  catch (std::exception& e)
+  {
+    fmt::print("SQLite exception: {}\n", std::string(e.what()));
+    std::error_code errorCode;
+    std::filesystem::remove(copyPath, errorCode);
+    std::abort();
+  }
+}
+
+ZoteroDBSession ZoteroDBSession::open_copy(const std::filesystem::path& copyPath) const {
+  try
+  {
+    return ZoteroDBSession(std::make_unique<Impl>(*m_impl, copyPath));
+  }
+  catch (std::exception& e)
+  {
+    fmt::print("SQLite exception: {}\n", std::string(e.what()));
+    std::abort();
+  }
+}
+
+void ZoteroDBSession::refresh_file_state() {
+  // The file state of a snapshot belongs to the copied db, it only changes with the copy.
+  if (m_impl->snapshot)
+  {
+    return;
+  }
+  m_impl->fileState = read_file_state(m_impl->zoteroDBPath);
+}
+
+const ZoteroDBFileState& ZoteroDBSession::file_state() const {
+  return m_impl->fileState;
+}
+
+SQLite::Database& ZoteroDBSession::database() {
+  return m_impl->db;
+}
+
+SQLite::Statement& ZoteroDBSession::statement(const std::string& sql) {
+  auto iter = m_impl->statements.find(sql);
+  if (iter == m_impl->statements.end())
+  {
+    iter = m_impl->statements.emplace(sql, std::make_unique<SQLite::Statement>(m_impl->db, sql)).first;
+    return *iter->second;
+  }
+
+  SQLite::Statement& statement = *iter->second;
+  statement.reset();
+  statement.clearBindings();
+  return statement;
+}
+
+void ZoteroDBSession::set_library_id(std::optional<std::int64_t> libraryID) {
+  m_impl->libraryID = libraryID;
+}
+
+std::optional<std::int64_t> ZoteroDBSession::library_id() const {
+  return m_impl->libraryID;
+}
+
+std::size_t ZoteroDBSession::prepared_statement_count() const {
+  return m_impl->statements.size();
+}
+
+} // namespace zotfiles
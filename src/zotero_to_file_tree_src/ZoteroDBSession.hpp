@@ -0,0 +1,152 @@
+#ifndef ZOTERO_TO_FILE_TREE_ZOTERODBSESSION_HPP
+#define ZOTERO_TO_FILE_TREE_ZOTERODBSESSION_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace SQLite
+{
+class Database;
+class Statement;
+} // namespace SQLite
+
+namespace zotfiles
+{
+
+/**
+ *\brief The sizes and modification times of the zotero db file, its write-ahead log and the storage directory.
+ *
+ * Zotero changes at least one of them whenever it writes to the library. Modification times are in nanoseconds of the file clock, sizes
+ * and times of files that do not exist are 0.
+ */
+struct ZoteroDBFileState {
+  std::uint64_t dbSize{};
+  std::int64_t dbMTime{};
+  std::uint64_t walSize{};
+  std::int64_t walMTime{};
+  std::int64_t storageMTime{};
+
+  bool operator==(const ZoteroDBFileState& rhs) const = default;
+};
+
+/**
+ *\brief A read only connection to the zotero db that is shared by all queries of one run.
+ *
+ * The session opens the zotero db once and keeps every prepared statement cached by its sql text. Statements handed out by the session
+ * are reset and their bindings are cleared, so they can be used like freshly prepared statements.
+ *
+ * While zotero writes to the db, reads wait for the lock with a busy timeout and then retry with an exponential backoff. A query that
+ * still finds the db locked aborts the run. A snapshot session copies the zotero db into memory with the sqlite online backup API, which
+ * retries the same way, so all queries of one run see the same state of the library and never contend with the zotero client.
+ */
+class ZoteroDBSession {
+  struct Impl;
+  std::unique_ptr<Impl> m_impl;
+
+  explicit ZoteroDBSession(std::unique_ptr<Impl> impl);
+
+public:
+  /**
+   *\brief Opens the zotero db or aborts if the zotero db can not be opened.
+   *
+   * @param zoteroDBPath Absolute path to the zotero db file.
+   * @param snapshot Copy the zotero db into memory and run all queries on the copy.
+   */
+  explicit ZoteroDBSession(std::filesystem::path zoteroDBPath, bool snapshot = false);
+  ~ZoteroDBSession();
+
+  ZoteroDBSession(const ZoteroDBSession&) = delete;
+  ZoteroDBSession& operator=(const ZoteroDBSession&) = delete;
+  ZoteroDBSession(ZoteroDBSession&&) noexcept;
+  ZoteroDBSession& operator=(ZoteroDBSession&&) noexcept;
+
+  /**
+   *\brief Absolute path to the zotero db file of this session.
+   */
+  [[nodiscard]] const std::filesystem::path& zotero_db_path() const;
+
+  /**
+   *\brief Absolute path to the storage directory next to the zotero db file.
+   */
+  [[nodiscard]] std::filesystem::path storage_dir() const;
+
+  /**
+   *\brief True if the queries of this session run on an in-memory copy of the zotero db.
+   */
+  [[nodiscard]] bool is_snapshot() const;
+
+  /**
+   *\brief Copies the current state of the zotero db into the snapshot again. Does nothing if the session is not a snapshot or a copy.
+   *
+   * The cached statements are dropped. Aborts if the zotero db stays locked.
+   */
+  void refresh_snapshot();
+
+  /**
+   *\brief Writes the db of this session into a new file, e.g. a snapshot that the sessions of other threads open with open_copy().
+   *
+   * Aborts if the file can not be written or the db is not copied completely, e.g. because it is locked. A partial file is removed.
+   */
+  void write_copy(const std::filesystem::path& copyPath);
+
+  /**
+   *\brief Opens the file written by write_copy() read only, so several threads read the same snapshot without copying it again.
+   *
+   * The new session has the zotero db path, the storage directory and the file state of this session and is a snapshot session, but
+   * refresh_snapshot() does nothing. The file must exist until the new session is destroyed. Aborts if the file can not be opened.
+   */
+  [[nodiscard]] ZoteroDBSession open_copy(const std::filesystem::path& copyPath) const;
+
+  /**
+   *\brief Reads the ZoteroDBFileState of a session that queries the zotero db directly again. Does nothing for a snapshot or a copy.
+   *
+   * A live session reads the current state of the zotero db with every query, so its file state must be taken again before each export,
+   * e.g. before every update in watch mode.
+   */
+  void refresh_file_state();
+
+  /**
+   *\brief The ZoteroDBFileState when the session was opened, the snapshot was refreshed or the file state was refreshed, taken before
+   * the zotero db was read.
+   *
+   * Everything the session reads is at least as new as this state.
+   */
+  [[nodiscard]] const ZoteroDBFileState& file_state() const;
+
+  /**
+   *\brief Restricts the queries of ZoteroDB that select items or collections to the library with the given id.
+   *
+   * std::nullopt selects all libraries, the default. Queries by item or collection ids are not restricted, the ids are unique across all
+   * libraries.
+   */
+  void set_library_id(std::optional<std::int64_t> libraryID);
+
+  /**
+   *\brief The library the queries are restricted to, std::nullopt for all libraries.
+   */
+  [[nodiscard]] std::optional<std::int64_t> library_id() const;
+
+  [[nodiscard]] SQLite::Database& database();
+
+  /**
+   *\brief Returns the cached prepared statement for the given sql text.
+   *
+   * The statement is prepared on first use. Every later call returns the same statement after resetting it and clearing its bindings.
+   * A statement that is not stepped until it returns false must be reset after its rows are read, otherwise it keeps a read transaction
+   * on the zotero db open, which blocks the writes of the zotero client.
+   */
+  [[nodiscard]] SQLite::Statement& statement(const std::string& sql);
+
+  /**
+   *\brief Number of statements that have been prepared by this session.
+   */
+  [[nodiscard]] std::size_t prepared_statement_count() const;
+};
+
+} // namespace zotfiles
+
+#endif // ZOTERO_TO_FILE_TREE_ZOTERODBSESSION_HPP
@@ -0,0 +1,23 @@
+#ifndef ZOTERO_TO_FILE_TREE_ZOTEROLIBRARY_HPP
+#define ZOTERO_TO_FILE_TREE_ZOTEROLIBRARY_HPP
+
+#include <cstdint>
+#include <string>
+
+namespace zotfiles
+{
+
+/**
+ *\brief Represents a Zotero library, the user library or the library of a group.
+ *
+ * Every item and collection belongs to exactly one library.
+ */
+struct ZoteroLibrary {
+  std::int64_t libraryID{}; /**< The libraryID is the primary key of the libraries table. */
+  std::string type;         /**< "user" or "group" */
+  std::string name;         /**< "My Library" for the user library, the name of the group for a group library. */
+};
+
+} // namespace zotfiles
+
+#endif // ZOTERO_TO_FILE_TREE_ZOTEROLIBRARY_HPP
@@ -1,14 +1,28 @@
 #include "ZoteroToFileTree.hpp"
 #include "CLI/Error.hpp"
-#include "CollectionTree.hpp"
+#include "FlatCollectionTree.hpp"
 #include "ErrorCodes.hpp"
+#include "FileWatcher.hpp"
+#include "MetadataCache.hpp"
 #include "ZoteroDB.hpp"
 #include "fmt/core.h"
 #include <CLI/CLI.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
 #include <filesystem>
+#include <fstream>
+#include <optional>
+#include <random>
+#include <set>
+#include <span>
 #include <fmt/format.h>
 #include <string_view>
 #include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace zotfiles
@@ -16,71 +30,223 @@ namespace zotfiles
 
 /*
  * TODO:
- * - add a command line option to specify the collection name (optional)
- * - allow or disallow duplicates paths of pdfs in the tree. Currently, PDFs that are in multiple collections, will be written in every
- * collection directory
  * - add option to query only files of a specific user name
- * - add option to query only files of a specific library
  */
 
-[[nodiscard]] std::vector<PDFItem> ZoteroToFileTree::create_pdfitems(const std::filesystem::path& zoteroDbPath) {
-  const std::vector<zotfiles::ZoteroPDFAttachment> pdfAttachments = zotfiles::pdf_attachments(zoteroDbPath);
-  std::vector<zotfiles::PDFItem> pdfItems = zotfiles::pdf_items(pdfAttachments, zoteroDbPath);
-  auto removeEndIter = std::remove_if(pdfItems.begin(),
-                                      pdfItems.end(),
-                                      [](const zotfiles::PDFItem& item) { return !std::filesystem::exists(item.pdfFilePath); });
-  pdfItems.erase(removeEndIter, pdfItems.end());
-  zotfiles::retrieve_pdf_item_collections(pdfItems, zoteroDbPath);
+/**
+ *\brief Erases the PDFItems whose pdf file was not found in the storage directory.
+ */
+static void erase_items_without_pdf_file(PDFItems& pdfItems) {
+  // Only pdf files found in the storage index are resolved, so an empty path marks a missing pdf file.
+  pdfItems.erase_if([](const zotfiles::PDFItem& item) { return item.pdfFilePath.empty(); });
+}
+
+/**
+ *\brief Resolves the pdf file paths with the storage index and erases the PDFItems whose pdf file was not found.
+ */
+static void resolve_pdf_files(PDFItems& pdfItems, const StorageIndex& storageIndex, Tracer* tracer) {
+  TraceSpan traceSpan(tracer, "resolve pdf paths");
+  zotfiles::resolve_pdf_file_paths(pdfItems, storageIndex);
+  erase_items_without_pdf_file(pdfItems);
+  traceSpan.set_item_count(pdfItems.size());
+}
+
+/**
+ *\brief Scans the storage directory. Without keys the whole directory is scanned, otherwise only the attachment directories of the keys.
+ */
+static StorageIndex scan_storage_dir(ZoteroDBSession& session,
+                                     const std::vector<std::string>* keys,
+                                     std::size_t scanJobs,
+                                     Tracer* tracer) {
+  TraceSpan traceSpan(tracer, "storage scan");
+  StorageIndex storageIndex = keys ? zotfiles::StorageIndex::build_for_keys(session.storage_dir(), *keys, scanJobs, tracer)
+                                   : zotfiles::StorageIndex::build(session.storage_dir(), scanJobs, tracer);
+  traceSpan.set_item_count(storageIndex.scanned_dirs());
+  return storageIndex;
+}
+
+[[nodiscard]] PDFItems ZoteroToFileTree::create_pdfitems(ZoteroDBSession& session,
+                                                         std::size_t scanJobs,
+                                                         Tracer* tracer,
+                                                         std::pmr::memory_resource* memoryResource) {
+  TraceSpan querySpan(tracer, "attachment query");
+  zotfiles::PDFItems pdfItems = zotfiles::pdf_attachment_items(session, memoryResource);
+  querySpan.set_item_count(pdfItems.size());
+  querySpan.finish();
+
+  // The storage directory is shared by all libraries, so an export of one library only scans the key directories of its attachments.
+  if (!session.library_id())
+  {
+    resolve_pdf_files(pdfItems, scan_storage_dir(session, nullptr, scanJobs, tracer), tracer);
+    return pdfItems;
+  }
+  std::vector<std::string> keys;
+  keys.reserve(pdfItems.size());
+  for (const zotfiles::PDFItem& pdfItem: pdfItems)
+  {
+    keys.emplace_back(pdfItem.pdfAttachment.key);
+  }
+  resolve_pdf_files(pdfItems, scan_storage_dir(session, &keys, scanJobs, tracer), tracer);
+  return pdfItems;
+}
+
+/**
+ *\brief Returns the ids of the pdf items whose files are in the manifest.
+ */
+static std::set<std::int64_t> exported_item_ids(const Manifest& manifest) {
+  std::set<std::int64_t> exportedItemIds;
+  for (const auto& [relPath, entry]: manifest.entries())
+  {
+    exportedItemIds.insert(entry.pdfItemId);
+  }
+  return exportedItemIds;
+}
+
+[[nodiscard]] PDFItems ZoteroToFileTree::create_changed_pdfitems(ZoteroDBSession& session,
+                                                                 std::size_t scanJobs,
+                                                                 Tracer* tracer,
+                                                                 std::pmr::memory_resource* memoryResource,
+                                                                 const ZoteroDBState& previousState,
+                                                                 const std::set<std::int64_t>& exportedItemIds,
+                                                                 std::set<std::int64_t>& patchedItemIds,
+                                                                 std::string_view summaryPrefix) {
+  TraceSpan querySpan(tracer, "changed attachment query");
+  zotfiles::PDFItems pdfItems = zotfiles::changed_pdf_attachment_items(previousState, session, memoryResource);
+  querySpan.set_item_count(pdfItems.size());
+  querySpan.finish();
+
+  TraceSpan missingSpan(tracer, "deleted attachment query");
+  patchedItemIds = zotfiles::missing_pdf_attachment_ids(exportedItemIds, session);
+  missingSpan.set_item_count(exportedItemIds.size());
+  missingSpan.finish();
+  fmt::print("{0}Number of changed PDF items: {1}\n{0}Number of deleted PDF items: {2}\n",
+             summaryPrefix,
+             pdfItems.size(),
+             patchedItemIds.size());
+
+  std::vector<std::string> keys;
+  keys.reserve(pdfItems.size());
+  for (const zotfiles::PDFItem& pdfItem: pdfItems)
+  {
+    patchedItemIds.insert(pdfItem.pdfAttachment.itemID);
+    keys.emplace_back(pdfItem.pdfAttachment.key);
+  }
+
+  resolve_pdf_files(pdfItems, scan_storage_dir(session, &keys, scanJobs, tracer), tracer);
   return pdfItems;
 }
 
-[[nodiscard]] CollectionTree ZoteroToFileTree::create_collectiontree(const std::vector<zotfiles::PDFItem>& pdfItems,
-                                                                     const std::filesystem::path& zoteroDbPath) {
+[[nodiscard]] PDFItems ZoteroToFileTree::create_subtree_pdfitems(ZoteroDBSession& session,
+                                                                 std::size_t scanJobs,
+                                                                 Tracer* tracer,
+                                                                 std::pmr::memory_resource* memoryResource,
+                                                                 const std::set<std::int64_t>& rootCollectionIds) {
+  TraceSpan querySpan(tracer, "subtree attachment query");
+  zotfiles::PDFItems pdfItems = zotfiles::subtree_pdf_attachment_items(rootCollectionIds, session, memoryResource);
+  querySpan.set_item_count(pdfItems.size());
+  querySpan.finish();
+
+  // Only the key directories of the attachments in the subtrees are scanned.
+  std::vector<std::string> keys;
+  keys.reserve(pdfItems.size());
+  for (const zotfiles::PDFItem& pdfItem: pdfItems)
+  {
+    keys.emplace_back(pdfItem.pdfAttachment.key);
+  }
+
+  resolve_pdf_files(pdfItems, scan_storage_dir(session, &keys, scanJobs, tracer), tracer);
+  return pdfItems;
+}
+
+[[nodiscard]] FlatCollectionTree ZoteroToFileTree::create_collectiontree(const PDFItems& pdfItems,
+                                                                         ZoteroDBSession& session,
+                                                                         DuplicatePolicy duplicatePolicy,
+                                                                         Tracer* tracer) {
+  TraceSpan querySpan(tracer, "collection query");
   const std::unordered_map<std::int64_t, zotfiles::ZoteroCollection> pdfItemCollections =
-      zotfiles::all_pdf_item_collections(pdfItems, zoteroDbPath);
+      zotfiles::all_pdf_item_collections(pdfItems, session);
+  querySpan.set_item_count(pdfItemCollections.size());
+  querySpan.finish();
+
+  return create_collectiontree(pdfItems, pdfItemCollections, duplicatePolicy, tracer);
+}
+
+[[nodiscard]] FlatCollectionTree
+ZoteroToFileTree::create_collectiontree(const PDFItems& pdfItems,
+                                        const std::unordered_map<std::int64_t, ZoteroCollection>& pdfItemCollections,
+                                        DuplicatePolicy duplicatePolicy,
+                                        Tracer* tracer,
+                                        std::span<const std::pair<std::int64_t, std::string>> reservedPDFNames,
+                                        std::string_view summaryPrefix) {
+  CollectionPDFNames collectionPDFNames(duplicatePolicy, pdfItems.memory_resource());
+  for (const auto& [collectionID, pdfName]: reservedPDFNames)
+  {
+    collectionPDFNames.reserve(collectionID, pdfName);
+  }
+  return create_collectiontree(pdfItems, pdfItemCollections, collectionPDFNames, tracer, summaryPrefix);
+}
+
+[[nodiscard]] FlatCollectionTree
+ZoteroToFileTree::create_collectiontree(const PDFItems& pdfItems,
+                                        const std::unordered_map<std::int64_t, ZoteroCollection>& pdfItemCollections,
+                                        CollectionPDFNames& collectionPDFNames,
+                                        Tracer* tracer,
+                                        std::string_view summaryPrefix) {
+  TraceSpan populateSpan(tracer, "tree population");
 
-  // Create the collection tree from the collectionItems
-  std::unordered_map<std::int64_t, std::shared_ptr<zotfiles::CollectionNode>> collectionNodes;
+  // The collections are indexed in the order of a vector, the pdf items refer to their collection by that index.
+  std::vector<zotfiles::ZoteroCollection> collections;
+  collections.reserve(pdfItemCollections.size());
+  std::unordered_map<std::int64_t, std::uint32_t> collectionIndices;
+  collectionIndices.reserve(pdfItemCollections.size());
   for (const auto& [collectionId, collection]: pdfItemCollections)
   {
+    collectionIndices.emplace(collectionId, static_cast<std::uint32_t>(collections.size()));
+    collections.push_back(collection);
+  }
 
-    collectionNodes.emplace(
-        collectionId,
-        std::make_shared<zotfiles::CollectionNode>(
-            zotfiles::CollectionNode{collection.collectionID, collection.parentCollectionID, collection.collectionName}));
-  }
-
-  zotfiles::CollectionTree collectionTree = zotfiles::CollectionTree::build(std::move(collectionNodes));
-
-  std::for_each(pdfItems.begin(),
-                pdfItems.end(),
-                [&collectionTree](const zotfiles::PDFItem& pdfItem)
-                {
-                  for (const auto& collectionItem: pdfItem.collectionItems)
-                  {
-                    auto collection = collectionTree.find(collectionItem.collectionID);
-                    if (collection)
-                    {
-                      auto iter = std::find_if(collection->collectionPDFItems.begin(),
-                                               collection->collectionPDFItems.end(),
-                                               [&pdfItem](const zotfiles::CollectionPDFItem& item)
-                                               { return item.pdfName == pdfItem.pdfAttachment.path; });
-                      if (iter == collection->collectionPDFItems.end())
-                      {
-                        collection->collectionPDFItems.emplace_back(
-                            zotfiles::CollectionPDFItem{pdfItem.pdfAttachment.itemID, pdfItem.pdfAttachment.path, pdfItem.pdfFilePath});
-                      }
-                      else
-                      {
-                        fmt::print("Duplicate pdf item found: {} in collection: {}. Skipping.\n",
-                                   pdfItem.pdfAttachment.path,
-                                   collection->collectionName);
-                      }
-                    }
-                  }
-                });
-
-  return collectionTree;
+  std::vector<std::pair<std::uint32_t, zotfiles::CollectionPDFItem>> collectionPDFItems;
+  collectionPDFItems.reserve(pdfItems.size());
+  std::size_t skippedDuplicates = 0;
+  std::size_t renamedDuplicates = 0;
+  for (const zotfiles::PDFItem& pdfItem: pdfItems)
+  {
+    for (const zotfiles::ZoteroCollection& collectionItem: pdfItems.collections(pdfItem))
+    {
+      auto collectionIter = collectionIndices.find(collectionItem.collectionID);
+      if (collectionIter == collectionIndices.end())
+      {
+        continue;
+      }
+
+      std::optional<std::string> pdfName = collectionPDFNames.add(collectionItem.collectionID, pdfItem.pdfAttachment.path);
+      if (!pdfName)
+      {
+        ++skippedDuplicates;
+        continue;
+      }
+      if (*pdfName != pdfItem.pdfAttachment.path)
+      {
+        ++renamedDuplicates;
+      }
+      collectionPDFItems.emplace_back(
+          collectionIter->second, zotfiles::CollectionPDFItem{pdfItem.pdfAttachment.itemID, std::move(*pdfName), pdfItem.pdfFilePath});
+    }
+  }
+  if (skippedDuplicates > 0)
+  {
+    fmt::print("{}Number of duplicate pdf names skipped: {}\n", summaryPrefix, skippedDuplicates);
+  }
+  if (renamedDuplicates > 0)
+  {
+    fmt::print("{}Number of duplicate pdf names renamed: {}\n", summaryPrefix, renamedDuplicates);
+  }
+  populateSpan.set_item_count(pdfItems.size());
+  populateSpan.finish();
+
+  TraceSpan buildSpan(tracer, "tree build");
+  buildSpan.set_item_count(collections.size());
+  return zotfiles::FlatCollectionTree::build(collections, std::move(collectionPDFItems));
 }
 
 [[nodiscard]] std::filesystem::path ZoteroToFileTree::create_output_dir(const std::string& outputDirStr, bool overwriteOutputDir) {
@@ -145,6 +311,616 @@ namespace zotfiles
   return zotero_lib_path;
 }
 
+/**
+ *\brief Returns the collectionIDs by the directory of the collection relative to the output directory.
+ *
+ * The directory of a collection is the path of the collection names from the root collection, like FlatCollectionTree::rel_dir_paths.
+ * Collections without all of their ancestors in the given collections are not part of the collection tree and left out.
+ */
+static std::unordered_multimap<std::string, std::int64_t>
+collection_ids_by_rel_dir_path(const std::unordered_map<std::int64_t, ZoteroCollection>& collections) {
+  std::unordered_multimap<std::string, std::int64_t> collectionIdsByRelDirPath;
+  for (const auto& [collectionId, collection]: collections)
+  {
+    std::filesystem::path relDirPath(collection.collectionName);
+    std::int64_t parentCollectionId = collection.parentCollectionID;
+    while (parentCollectionId != -1)
+    {
+      auto parentIter = collections.find(parentCollectionId);
+      if (parentIter == collections.end())
+      {
+        break;
+      }
+      relDirPath = std::filesystem::path(parentIter->second.collectionName) / relDirPath;
+      parentCollectionId = parentIter->second.parentCollectionID;
+    }
+    if (parentCollectionId == -1)
+    {
+      collectionIdsByRelDirPath.emplace(relDirPath.generic_string(), collectionId);
+    }
+  }
+  return collectionIdsByRelDirPath;
+}
+
+/**
+ *\brief Returns the pdf names of the files of the previous export that a delta export keeps, with the collectionID of their directory.
+ *
+ * The files of the items that are not patched are kept. Only the directories of the given collections are looked up, the patched pdf
+ * items are never placed into other directories.
+ */
+static std::vector<std::pair<std::int64_t, std::string>>
+kept_pdf_names(const Manifest& manifest,
+               const std::set<std::int64_t>& patchedItemIds,
+               const std::unordered_map<std::int64_t, ZoteroCollection>& pdfItemCollections) {
+  const std::unordered_multimap<std::string, std::int64_t> collectionIdsByRelDirPath = collection_ids_by_rel_dir_path(pdfItemCollections);
+
+  std::vector<std::pair<std::int64_t, std::string>> keptPDFNames;
+  for (const auto& [relPath, entry]: manifest.entries())
+  {
+    if (patchedItemIds.contains(entry.pdfItemId))
+    {
+      continue;
+    }
+    const std::filesystem::path relFilePath(relPath);
+    auto [first, last] = collectionIdsByRelDirPath.equal_range(relFilePath.parent_path().generic_string());
+    for (auto collectionIter = first; collectionIter != last; ++collectionIter)
+    {
+      keptPDFNames.emplace_back(collectionIter->second, relFilePath.filename().string());
+    }
+  }
+  return keptPDFNames;
+}
+
+/**
+ *\brief Returns the prefix of the summary lines of the export, which names the library if ExportOptions::libraryName is set.
+ */
+static std::string summary_prefix(const ExportOptions& exportOptions) {
+  return exportOptions.libraryName.empty() ? std::string() : fmt::format("[{}] ", exportOptions.libraryName);
+}
+
+/**
+ *\brief Prints the number of written, skipped, unchanged and removed pdf files.
+ *
+ * The summary is printed at once, so the summaries of libraries that are exported at the same time do not interleave.
+ */
+static void print_write_summary(const WriteSummary& writeSummary, std::string_view summaryPrefix) {
+  std::string summary = fmt::format("\n{}Number of written PDFs: {}", summaryPrefix, writeSummary.writtenPDFs);
+  for (std::size_t i = 0; i < transferMethodCount; ++i)
+  {
+    if (writeSummary.transferCounts[i] > 0)
+    {
+      summary += fmt::format("\n{}  {}: {}", summaryPrefix, to_string(static_cast<TransferMethod>(i)), writeSummary.transferCounts[i]);
+    }
+  }
+  if (writeSummary.skippedPDFs > 0)
+  {
+    summary += fmt::format("\n{}Number of existing PDFs skipped: {}", summaryPrefix, writeSummary.skippedPDFs);
+  }
+  if (writeSummary.unchangedPDFs > 0)
+  {
+    summary += fmt::format("\n{}Number of unchanged PDFs: {}", summaryPrefix, writeSummary.unchangedPDFs);
+  }
+  if (writeSummary.removedPDFs > 0)
+  {
+    summary += fmt::format("\n{}Number of removed PDFs: {}", summaryPrefix, writeSummary.removedPDFs);
+  }
+  fmt::print("{}\n", summary);
+}
+
+/**
+ *\brief Plans the export of the collection tree without changing the output directory.
+ *
+ * @param planFilePath If not empty, the plan is written to this file as JSON Lines instead of being printed.
+ */
+static void print_export_plan(const FlatCollectionTree& collectionTree,
+                              const std::filesystem::path& outputDirPath,
+                              const WriteOptions& writeOptions,
+                              const std::filesystem::path& planFilePath) {
+  OutputDirWriter outputDirWriter(outputDirPath, writeOptions);
+  TraceSpan traceSpan(writeOptions.tracer, "plan");
+  collectionTree.plan_pdfs(outputDirWriter);
+  const ExportPlan& plan = outputDirWriter.finish_plan();
+  traceSpan.set_item_count(plan.operations().size());
+  traceSpan.finish();
+
+  if (planFilePath.empty())
+  {
+    fmt::print("\nDry run, the output directory is not changed.\n");
+    plan.print();
+    return;
+  }
+
+  std::ofstream planFile(planFilePath, std::ios::binary | std::ios::trunc);
+  plan.write_jsonl(planFile);
+  if (!planFile)
+  {
+    fmt::print("Could not write the plan to: {}\n", planFilePath.string());
+    return;
+  }
+  const PlanTotals planTotals = plan.totals();
+  fmt::print("\nDry run, wrote {} planned operations to: {}\n", plan.operations().size(), planFilePath.string());
+  for (std::size_t i = 0; i < planActionCount; ++i)
+  {
+    fmt::print("  {}: {} ({} bytes)\n", to_string(static_cast<PlanAction>(i)), planTotals.counts[i], planTotals.bytes[i]);
+  }
+}
+
+/**
+ *\brief Exports the pdf items into the output directory.
+ *
+ * @param manifest The manifest of the previous export. Replaced by the manifest of this export.
+ */
+void ZoteroToFileTree::export_pdfs(ZoteroDBSession& session,
+                                   const std::filesystem::path& outputDirPath,
+                                   const ExportOptions& exportOptions,
+                                   Manifest& manifest) {
+  const std::size_t peakRSSBefore = peak_rss_bytes();
+  const std::string summaryPrefix = summary_prefix(exportOptions);
+  // A full export of an unchanged zotero db restores the pdf items and their collections from the metadata cache of the output directory
+  // instead of querying the zotero db and scanning the storage directory.
+  std::optional<MetadataCacheKey> cacheKey;
+  std::optional<MetadataCache> metadataCache;
+  if (exportOptions.metadataCache && !exportOptions.deltaExport && exportOptions.collectionIds.empty())
+  {
+    TraceSpan cacheSpan(exportOptions.tracer, "metadata cache open");
+    cacheKey = zotfiles::metadata_cache_key(session, exportOptions.scanJobs);
+    metadataCache = MetadataCache::open(outputDirPath, *cacheKey);
+  }
+
+  // The state is taken before the items are read, so changes made while the export runs are read again by the next delta export.
+  ZoteroDBState dbState;
+  if (metadataCache)
+  {
+    dbState = metadataCache->db_state();
+  }
+  else
+  {
+    TraceSpan stateSpan(exportOptions.tracer, "db state query");
+    dbState = zotfiles::zotero_db_state(session);
+  }
+  const std::optional<ZoteroDBState> previousDBState = zotfiles::parse_zotero_db_state(manifest.export_state());
+  bool deltaExport = exportOptions.deltaExport;
+  if (deltaExport &&
+      (exportOptions.overwriteExistingFiles || !previousDBState || !zotfiles::collections_unchanged(*previousDBState, dbState)))
+  {
+    fmt::print("{}No previous export with the same collections found, exporting all items.\n", summaryPrefix);
+    deltaExport = false;
+  }
+
+  std::set<std::int64_t> patchedItemIds;
+  zotfiles::FlatCollectionTree collectionTree;
+  ArenaStats arenaStats;
+  {
+    // The pdf items and the data derived from them are allocated from the arena of the run. The arena is released before the export is
+    // planned, the tree holds its own copies of the names and paths.
+    RunArena runArena;
+    std::unordered_map<std::int64_t, zotfiles::ZoteroCollection> pdfItemCollections;
+    const zotfiles::PDFItems pdfItems = [&]()
+    {
+      if (metadataCache)
+      {
+        fmt::print("{}The zotero db is unchanged, the PDF items are restored from the metadata cache.\n", summaryPrefix);
+        TraceSpan loadSpan(exportOptions.tracer, "metadata cache load");
+        zotfiles::PDFItems cachedItems = metadataCache->pdf_items(runArena.resource());
+        pdfItemCollections = metadataCache->pdf_item_collections();
+        loadSpan.set_item_count(cachedItems.size());
+        return cachedItems;
+      }
+      if (deltaExport)
+      {
+        return create_changed_pdfitems(session,
+                                       exportOptions.scanJobs,
+                                       exportOptions.tracer,
+                                       runArena.resource(),
+                                       *previousDBState,
+                                       exported_item_ids(manifest),
+                                       patchedItemIds,
+                                       summaryPrefix);
+      }
+      if (!exportOptions.collectionIds.empty())
+      {
+        return create_subtree_pdfitems(
+            session, exportOptions.scanJobs, exportOptions.tracer, runArena.resource(), exportOptions.collectionIds);
+      }
+      return create_pdfitems(session, exportOptions.scanJobs, exportOptions.tracer, runArena.resource());
+    }();
+
+    fmt::print("{}Number of PDF items with a valid pdf path: {}\n", summaryPrefix, pdfItems.size());
+
+    fmt::print("\n");
+    if (!metadataCache)
+    {
+      TraceSpan querySpan(exportOptions.tracer, "collection query");
+      pdfItemCollections = zotfiles::all_pdf_item_collections(pdfItems, session);
+      querySpan.set_item_count(pdfItemCollections.size());
+    }
+    // A dry run leaves the output directory as it is, the cache is written by the next export.
+    if (cacheKey && !metadataCache && !exportOptions.dryRun)
+    {
+      TraceSpan saveSpan(exportOptions.tracer, "metadata cache save");
+      if (!MetadataCache::save(outputDirPath, *cacheKey, dbState, pdfItems, pdfItemCollections))
+      {
+        fmt::print("Could not write the metadata cache into the output directory.\n");
+      }
+      saveSpan.set_item_count(pdfItems.size());
+    }
+    // The changed pdf items of a delta export must not take the names of the files that are kept.
+    const std::vector<std::pair<std::int64_t, std::string>> keptPDFNames =
+        deltaExport ? kept_pdf_names(manifest, patchedItemIds, pdfItemCollections) : std::vector<std::pair<std::int64_t, std::string>>();
+    collectionTree = create_collectiontree(
+        pdfItems, pdfItemCollections, exportOptions.duplicatePolicy, exportOptions.tracer, keptPDFNames, summaryPrefix);
+    arenaStats = runArena.stats();
+  }
+  // The state of a subtree export is not stored, so a delta export into its output directory exports all items.
+  const WriteOptions writeOptions{exportOptions.overwriteExistingFiles,
+                                  exportOptions.jobs,
+                                  exportOptions.linkMode,
+                                  &manifest,
+                                  deltaExport ? &patchedItemIds : nullptr,
+                                  exportOptions.collectionIds.empty() ? zotfiles::formatted_zotero_db_state(dbState) : std::string(),
+                                  exportOptions.tracer,
+                                  exportOptions.copyBackend,
+                                  exportOptions.queueDepth};
+  if (exportOptions.dryRun)
+  {
+    print_export_plan(collectionTree, outputDirPath, writeOptions, exportOptions.planFilePath);
+  }
+  else
+  {
+    TraceSpan writeSpan(exportOptions.tracer, "write pdfs");
+    const WriteSummary writeSummary = collectionTree.write_pdfs(outputDirPath, writeOptions, &manifest);
+    writeSpan.set_item_count(writeSummary.writtenPDFs);
+    writeSpan.finish();
+    print_write_summary(writeSummary, summaryPrefix);
+  }
+
+  if (exportOptions.tracer && exportOptions.reportTrace)
+  {
+    exportOptions.tracer->set_memory_stats(MemoryStats{arenaStats, peakRSSBefore, peak_rss_bytes()});
+    exportOptions.tracer->report();
+  }
+}
+
+/**
+ *\brief Exports the pdf items into the output directory while they are read from the zotero db, see stream_pdfs.
+ *
+ * @param manifest The manifest of the previous export. Replaced by the manifest of this export.
+ */
+void ZoteroToFileTree::export_pdfs_streamed(ZoteroDBSession& session,
+                                            const std::filesystem::path& outputDirPath,
+                                            const ExportOptions& exportOptions,
+                                            Manifest& manifest) {
+  const std::size_t peakRSSBefore = peak_rss_bytes();
+  TraceSpan stateSpan(exportOptions.tracer, "db state query");
+  const ZoteroDBState dbState = zotfiles::zotero_db_state(session);
+  stateSpan.finish();
+
+  const WriteOptions writeOptions{exportOptions.overwriteExistingFiles,
+                                  exportOptions.jobs,
+                                  exportOptions.linkMode,
+                                  &manifest,
+                                  nullptr,
+                                  zotfiles::formatted_zotero_db_state(dbState),
+                                  exportOptions.tracer,
+                                  exportOptions.copyBackend,
+                                  exportOptions.queueDepth};
+  TraceSpan writeSpan(exportOptions.tracer, "write pdfs");
+  const StreamSummary streamSummary =
+      zotfiles::stream_pdfs(session, outputDirPath, writeOptions, exportOptions.duplicatePolicy, &manifest);
+  writeSpan.set_item_count(streamSummary.writeSummary.writtenPDFs);
+  writeSpan.finish();
+
+  const std::string summaryPrefix = summary_prefix(exportOptions);
+  fmt::print("{}Number of PDF items with a valid pdf path: {}\n", summaryPrefix, streamSummary.pdfItems);
+  if (streamSummary.skippedDuplicates > 0)
+  {
+    fmt::print("{}Number of duplicate pdf names skipped: {}\n", summaryPrefix, streamSummary.skippedDuplicates);
+  }
+  if (streamSummary.renamedDuplicates > 0)
+  {
+    fmt::print("{}Number of duplicate pdf names renamed: {}\n", summaryPrefix, streamSummary.renamedDuplicates);
+  }
+  print_write_summary(streamSummary.writeSummary, summaryPrefix);
+
+  if (exportOptions.tracer && exportOptions.reportTrace)
+  {
+    // Nothing of a streamed export is allocated from a RunArena.
+    exportOptions.tracer->set_memory_stats(MemoryStats{ArenaStats{}, peakRSSBefore, peak_rss_bytes()});
+    exportOptions.tracer->report();
+  }
+}
+
+/**
+ *\brief The export that watch mode keeps between its updates.
+ *
+ * Instead of the collection tree of all pdf items, the pdf names of every collection and the names of every exported pdf item are kept.
+ * An update builds the collection tree of the changed pdf items only, their names are decided against the kept names of the other items.
+ */
+struct ZoteroToFileTree::WatchState {
+  ZoteroDBState dbState;                 /**< The state of the zotero db that the export is up to date with. */
+  CollectionPDFNames collectionPDFNames; /**< The pdf names that are used in every collection. */
+  std::set<std::int64_t> exportedItemIds; /**< The ids of the pdf items whose files are in the manifest. */
+  std::unordered_map<std::int64_t, std::vector<std::pair<std::int64_t, std::string>>>
+      itemPDFNames; /**< The collectionIDs and pdf names of every exported pdf item by its pdfItemId. */
+};
+
+/**
+ *\brief Returns the WatchState of the export in the manifest. The pdf names are taken from the files in the manifest.
+ */
+ZoteroToFileTree::WatchState
+ZoteroToFileTree::watch_state(ZoteroDBSession& session, const Manifest& manifest, DuplicatePolicy duplicatePolicy) {
+  std::optional<ZoteroDBState> dbState = zotfiles::parse_zotero_db_state(manifest.export_state());
+  if (!dbState)
+  {
+    dbState = zotfiles::zotero_db_state(session);
+  }
+  WatchState watchState{std::move(*dbState), CollectionPDFNames(duplicatePolicy), exported_item_ids(manifest), {}};
+
+  const std::unordered_multimap<std::string, std::int64_t> collectionIdsByRelDirPath =
+      collection_ids_by_rel_dir_path(zotfiles::all_collections(session));
+  for (const auto& [relPath, entry]: manifest.entries())
+  {
+    const std::filesystem::path relFilePath(relPath);
+    auto [first, last] = collectionIdsByRelDirPath.equal_range(relFilePath.parent_path().generic_string());
+    for (auto collectionIter = first; collectionIter != last; ++collectionIter)
+    {
+      std::string pdfName = relFilePath.filename().string();
+      watchState.collectionPDFNames.reserve(collectionIter->second, pdfName);
+      watchState.itemPDFNames[entry.pdfItemId].emplace_back(collectionIter->second, std::move(pdfName));
+    }
+  }
+  return watchState;
+}
+
+/**
+ *\brief Updates the export with the pdf items that changed or were deleted since the state of the WatchState.
+ *
+ * Like a delta export, only the changed pdf items are queried and only their key directories are scanned. The names of the kept files are
+ * taken from the WatchState instead of the manifest, and the WatchState is patched with the names of the changed pdf items. If the
+ * collections changed, all items are exported and the WatchState is taken again.
+ */
+void ZoteroToFileTree::update_export(ZoteroDBSession& session,
+                                     const std::filesystem::path& outputDirPath,
+                                     const ExportOptions& exportOptions,
+                                     Manifest& manifest,
+                                     WatchState& watchState) {
+  const std::size_t peakRSSBefore = peak_rss_bytes();
+  const std::string summaryPrefix = summary_prefix(exportOptions);
+  TraceSpan stateSpan(exportOptions.tracer, "db state query");
+  const ZoteroDBState dbState = zotfiles::zotero_db_state(session);
+  stateSpan.finish();
+  if (!zotfiles::collections_unchanged(watchState.dbState, dbState))
+  {
+    fmt::print("{}The collections changed, exporting all items.\n", summaryPrefix);
+    ExportOptions fullExportOptions = exportOptions;
+    fullExportOptions.deltaExport = false;
+    export_pdfs(session, outputDirPath, fullExportOptions, manifest);
+    watchState = watch_state(session, manifest, exportOptions.duplicatePolicy);
+    return;
+  }
+
+  std::set<std::int64_t> patchedItemIds;
+  zotfiles::FlatCollectionTree collectionTree;
+  ArenaStats arenaStats;
+  {
+    RunArena runArena;
+    const zotfiles::PDFItems pdfItems = create_changed_pdfitems(session,
+                                                                exportOptions.scanJobs,
+                                                                exportOptions.tracer,
+                                                                runArena.resource(),
+                                                                watchState.dbState,
+                                                                watchState.exportedItemIds,
+                                                                patchedItemIds,
+                                                                summaryPrefix);
+    fmt::print("{}Number of PDF items with a valid pdf path: {}\n", summaryPrefix, pdfItems.size());
+
+    // The changed pdf items take their names again, unless another pdf item took them in the meantime.
+    for (const std::int64_t itemId: patchedItemIds)
+    {
+      watchState.exportedItemIds.erase(itemId);
+      auto itemIter = watchState.itemPDFNames.find(itemId);
+      if (itemIter == watchState.itemPDFNames.end())
+      {
+        continue;
+      }
+      for (const auto& [collectionId, pdfName]: itemIter->second)
+      {
+        watchState.collectionPDFNames.release(collectionId, pdfName);
+      }
+      watchState.itemPDFNames.erase(itemIter);
+    }
+
+    TraceSpan querySpan(exportOptions.tracer, "collection query");
+    const std::unordered_map<std::int64_t, zotfiles::ZoteroCollection> pdfItemCollections =
+        zotfiles::all_pdf_item_collections(pdfItems, session);
+    querySpan.set_item_count(pdfItemCollections.size());
+    querySpan.finish();
+    collectionTree =
+        create_collectiontree(pdfItems, pdfItemCollections, watchState.collectionPDFNames, exportOptions.tracer, summaryPrefix);
+    arenaStats = runArena.stats();
+  }
+  for (const FlatCollectionNode& node: collectionTree.nodes())
+  {
+    for (const CollectionPDFItem& pdfItem: collectionTree.pdf_items(node))
+    {
+      watchState.itemPDFNames[pdfItem.pdfItemId].emplace_back(node.collectionID, pdfItem.pdfName);
+      watchState.exportedItemIds.insert(pdfItem.pdfItemId);
+    }
+  }
+
+  const WriteOptions writeOptions{exportOptions.overwriteExistingFiles,
+                                  exportOptions.jobs,
+                                  exportOptions.linkMode,
+                                  &manifest,
+                                  &patchedItemIds,
+                                  zotfiles::formatted_zotero_db_state(dbState),
+                                  exportOptions.tracer,
+                                  exportOptions.copyBackend,
+                                  exportOptions.queueDepth};
+  TraceSpan writeSpan(exportOptions.tracer, "write pdfs");
+  const WriteSummary writeSummary = collectionTree.write_pdfs(outputDirPath, writeOptions, &manifest);
+  writeSpan.set_item_count(writeSummary.writtenPDFs);
+  writeSpan.finish();
+  print_write_summary(writeSummary, summaryPrefix);
+  watchState.dbState = dbState;
+
+  if (exportOptions.tracer && exportOptions.reportTrace)
+  {
+    exportOptions.tracer->set_memory_stats(MemoryStats{arenaStats, peakRSSBefore, peak_rss_bytes()});
+    exportOptions.tracer->report();
+  }
+}
+
+/**
+ *\brief Watches the zotero db and the storage directory and updates the export after every burst of changes.
+ *
+ * The session, the manifest and the pdf names of the previous export are kept in a WatchState, so every update only reads and names the
+ * changed items, see update_export. Zotero writes the db whenever an attachment is added or changed, so watching the storage directory
+ * without its subdirectories suffices.
+ *
+ * @return Only returns if watching failed.
+ */
+std::error_code ZoteroToFileTree::watch_and_export(ZoteroDBSession& session,
+                                                   const std::filesystem::path& outputDirPath,
+                                                   const ExportOptions& exportOptions,
+                                                   std::chrono::milliseconds debounce,
+                                                   Manifest& manifest) {
+  const std::filesystem::path zoteroDbPath = session.zotero_db_path();
+  const std::string zoteroDbName = zoteroDbPath.filename().string();
+  FileWatcher fileWatcher({WatchedDir{zoteroDbPath.parent_path(), {zoteroDbName, zoteroDbName + "-wal", zoteroDbName + "-journal"}},
+                           WatchedDir{session.storage_dir(), {}}});
+
+  ExportOptions updateOptions = exportOptions;
+  updateOptions.overwriteExistingFiles = false;
+  WatchState watchState = watch_state(session, manifest, exportOptions.duplicatePolicy);
+
+  fmt::print("\nWatching the zotero library for changes.\n");
+  while (fileWatcher.wait_for_changes(debounce))
+  {
+    fmt::print("\nChange detected, updating the export.\n");
+    TraceSpan refreshSpan(exportOptions.tracer, "db snapshot refresh");
+    session.refresh_snapshot();
+    refreshSpan.finish();
+    update_export(session, outputDirPath, updateOptions, manifest, watchState);
+  }
+
+  fmt::print("Watching the zotero library failed.\n");
+  return make_error_code(ErrorCodes::WATCH_FAILED);
+}
+
+/**
+ *\brief Returns the names of the output directories of the libraries. Characters that separate paths are replaced, libraries with a name
+ * that is already taken get their id appended.
+ */
+static std::vector<std::string> library_dir_names(const std::vector<ZoteroLibrary>& libraries) {
+  std::vector<std::string> dirNames;
+  std::set<std::string> takenNames;
+  for (const ZoteroLibrary& library: libraries)
+  {
+    std::string dirName = library.name;
+    std::replace(dirName.begin(), dirName.end(), '/', '_');
+    std::replace(dirName.begin(), dirName.end(), '\\', '_');
+    if (dirName.empty() || dirName == "." || dirName == ".." || takenNames.contains(dirName))
+    {
+      dirName = fmt::format("{} ({})", dirName, library.libraryID);
+    }
+    takenNames.insert(dirName);
+    dirNames.push_back(std::move(dirName));
+  }
+  return dirNames;
+}
+
+/**
+ *\brief Exports every library into its own subdirectory of the output directory, up to libraryJobs libraries at the same time.
+ *
+ * Each library runs as an independent export on a worker with its own session of the zotero db, storage scan and manifest. The workers
+ * take the next library when their export is done, so one large library does not hold back the others. If the session is a snapshot, it
+ * is written once into a temporary file that the sessions of the workers open read only. The copy and scan workers of the export options
+ * are shared by the libraries that are exported at the same time. A library whose export throws is reported and the other libraries are
+ * still exported.
+ *
+ * @return ErrorCodes::LIBRARY_EXPORT_FAILED if the export of a library failed.
+ */
+std::error_code ZoteroToFileTree::export_libraries(ZoteroDBSession& session,
+                                                   const std::vector<ZoteroLibrary>& libraries,
+                                                   const std::filesystem::path& outputDirPath,
+                                                   const ExportOptions& exportOptions,
+                                                   std::size_t libraryJobs) {
+  const std::vector<std::string> dirNames = library_dir_names(libraries);
+  const std::size_t workerCount = std::clamp<std::size_t>(libraryJobs, 1, std::max<std::size_t>(1, libraries.size()));
+  ExportOptions libraryOptions = exportOptions;
+  libraryOptions.reportTrace = false;
+  libraryOptions.jobs = std::max<std::size_t>(1, exportOptions.jobs / workerCount);
+  libraryOptions.scanJobs = std::max<std::size_t>(1, exportOptions.scanJobs / workerCount);
+
+  std::filesystem::path snapshotCopyPath;
+  if (session.is_snapshot())
+  {
+    snapshotCopyPath =
+        std::filesystem::temp_directory_path() / fmt::format("zotero_to_file_tree_snapshot_{:08x}.sqlite", std::random_device{}());
+    session.write_copy(snapshotCopyPath);
+  }
+
+  std::atomic<std::size_t> nextLibrary{0};
+  std::atomic<std::size_t> failedLibraries{0};
+  auto exportWorker = [&]()
+  {
+    for (std::size_t i = nextLibrary++; i < libraries.size(); i = nextLibrary++)
+    {
+      try
+      {
+        const std::filesystem::path libraryDirPath = outputDirPath / dirNames[i];
+        if (!exportOptions.dryRun)
+        {
+          std::filesystem::create_directories(libraryDirPath);
+        }
+        fmt::print("Exporting library '{}' into {}\n", libraries[i].name, libraryDirPath.string());
+
+        zotfiles::ZoteroDBSession librarySession =
+            snapshotCopyPath.empty() ? zotfiles::ZoteroDBSession(session.zotero_db_path()) : session.open_copy(snapshotCopyPath);
+        librarySession.set_library_id(libraries[i].libraryID);
+        Manifest manifest = Manifest::load(libraryDirPath);
+        ExportOptions options = libraryOptions;
+        options.libraryName = libraries[i].name;
+        if (options.stream)
+        {
+          export_pdfs_streamed(librarySession, libraryDirPath, options, manifest);
+        }
+        else
+        {
+          export_pdfs(librarySession, libraryDirPath, options, manifest);
+        }
+      }
+      catch (const std::exception& e)
+      {
+        fmt::print("Exporting library '{}' failed: {}\n", libraries[i].name, e.what());
+        ++failedLibraries;
+      }
+    }
+  };
+
+  {
+    std::vector<std::jthread> workers;
+    workers.reserve(workerCount);
+    for (std::size_t i = 0; i < workerCount; ++i)
+    {
+      workers.emplace_back(exportWorker);
+    }
+  }
+
+  if (!snapshotCopyPath.empty())
+  {
+    std::error_code errorCode;
+    std::filesystem::remove(snapshotCopyPath, errorCode);
+  }
+  if (failedLibraries > 0)
+  {
+    fmt::print("Number of libraries whose export failed: {}\n", failedLibraries.load());
+    return make_error_code(ErrorCodes::LIBRARY_EXPORT_FAILED);
+  }
+  return make_error_code(ErrorCodes::SUCCESS);
+}
+
 std::error_code ZoteroToFileTree::run(int argc, char** argv) {
   std::locale::global(std::locale("en_US.UTF-8"));
 
@@ -160,11 +936,130 @@ std::error_code ZoteroToFileTree::run(int argc, char** argv) {
   app.add_flag("--print_db_info", printZoteroDBInfo, "Print the zotero db info.");
 
   bool overwriteOutputDir{false};
-  app.add_flag("--overwrite_dir", overwriteOutputDir, "Overwrite the output directory if it exists.");
+  CLI::Option* overwriteDirOption = app.add_flag("--overwrite_dir", overwriteOutputDir, "Overwrite the output directory if it exists.");
 
   bool overwriteExistingFiles{false};
   app.add_flag("--overwrite_files", overwriteExistingFiles, "Overwrite existing files if they exist in the output directory.");
 
+  std::size_t jobs = 1;
+  app.add_option("-j,--jobs", jobs, "Number of pdf files that are copied concurrently. Default is 1.")->check(CLI::PositiveNumber);
+
+  std::string linkModeStr = "copy";
+  app.add_option("--link-mode",
+                 linkModeStr,
+                 "How the pdf files are placed into the output directory: copy, hardlink, symlink, reflink or auto. Default is copy.")
+      ->check(CLI::IsMember({"copy", "hardlink", "symlink", "reflink", "auto"}));
+
+  std::string copyBackendStr = "threads";
+  app.add_option("--copy-backend",
+                 copyBackendStr,
+                 "How --link-mode copy copies the pdf files: threads or io_uring. io_uring falls back to threads if it is not available. "
+                 "Default is threads.")
+      ->check(CLI::IsMember({"threads", "io_uring"}));
+
+  std::size_t queueDepth = 64;
+  app.add_option("--queue-depth", queueDepth, "Number of pdf files copied at the same time with --copy-backend io_uring. Default is 64.")
+      ->check(CLI::PositiveNumber);
+
+  std::string duplicatePolicyStr = "skip";
+  app.add_option("--duplicates",
+                 duplicatePolicyStr,
+                 "What happens to pdf files with the same name in one collection: skip, rename or keep. Default is skip.")
+      ->check(CLI::IsMember({"skip", "rename", "keep"}));
+
+  std::vector<std::string> collectionPaths;
+  CLI::Option* collectionOption =
+      app.add_option("--collection",
+                     collectionPaths,
+                     "Only export this collection and its subcollections, given by its path from a top level collection, e.g. "
+                     "\"Papers/Geometry\". Can be repeated.");
+
+  std::string libraryStr;
+  CLI::Option* libraryOption =
+      app.add_option("--library",
+                     libraryStr,
+                     "Only export the items of this library, given by its name, e.g. \"My Library\" or the name of a group, or by its id.");
+
+  bool allLibraries{false};
+  CLI::Option* allLibrariesOption =
+      app.add_flag("--all-libraries",
+                   allLibraries,
+                   "Export every library into its own subdirectory of the output directory, named after the library.");
+
+  std::size_t libraryJobs = std::max(1U, std::thread::hardware_concurrency());
+  app.add_option("--library-jobs",
+                 libraryJobs,
+                 "Number of libraries that are exported at the same time with --all-libraries. The --jobs and --scan-jobs workers are "
+                 "split between them. Default is the number of cores.")
+      ->check(CLI::PositiveNumber)
+      ->needs(allLibrariesOption);
+
+  bool deltaExport{false};
+  CLI::Option* deltaOption =
+      app.add_flag("--delta",
+                   deltaExport,
+                   "Only query the items that changed since the last export into the output directory. Falls back to a full export if "
+                   "collections changed.");
+
+  std::size_t scanJobs = std::max(1U, std::thread::hardware_concurrency());
+  app.add_option("--scan-jobs", scanJobs, "Number of workers that scan the zotero storage directory. Default is the number of cores.")
+      ->check(CLI::PositiveNumber);
+
+  bool snapshot{false};
+  app.add_flag("--snapshot",
+               snapshot,
+               "Copy the zotero db into memory before the export, so the export sees one consistent state of a zotero db that is in use.");
+
+  bool watch{false};
+  CLI::Option* watchOption =
+      app.add_flag("--watch",
+                   watch,
+                   "Keep running after the export and update the export whenever the zotero db or the storage directory changes.");
+
+  std::size_t watchDebounceMs = 2000;
+  app.add_option("--watch-debounce",
+                 watchDebounceMs,
+                 "Milliseconds without changes before the export is updated in watch mode. Default is 2000.");
+
+  collectionOption->excludes(deltaOption)->excludes(watchOption);
+  allLibrariesOption->excludes(libraryOption)->excludes(collectionOption)->excludes(watchOption);
+
+  bool dryRun{false};
+  CLI::Option* dryRunOption =
+      app.add_flag("--dry-run", dryRun, "Print the directories and pdf files the export would create, copy, link, skip or remove.")
+          ->excludes(overwriteDirOption)
+          ->excludes(watchOption);
+
+  bool stream{false};
+  app.add_flag("--stream",
+               stream,
+               "Copy the pdf files while the attachments are still read from the zotero db, instead of reading all attachments first.")
+      ->excludes(deltaOption)
+      ->excludes(dryRunOption)
+      ->excludes(watchOption)
+      ->excludes(collectionOption);
+
+  bool noCache{false};
+  app.add_flag("--no-cache",
+               noCache,
+               "Do not restore the PDF items from the metadata cache in the output directory if the zotero db is unchanged, and do "
+               "not write the cache.");
+
+  std::string planFileStr;
+  app.add_option("--plan-file", planFileStr, "With --dry-run, write the plan as JSON Lines to this file instead of printing it.")
+      ->needs(dryRunOption)
+      ->excludes(allLibrariesOption);
+
+  bool printStats{false};
+  app.add_flag("--stats",
+               printStats,
+               "Print the wall time, item count and throughput of every stage of the export, the arena allocations and the peak RSS.");
+
+  std::string traceFileStr;
+  app.add_option("--trace",
+                 traceFileStr,
+                 "Write the stages of the export to this file in the Chrome trace-event format, viewable in chrome://tracing or Perfetto.");
+
   try
   { app.parse((argc), (argv)); }
   catch (const CLI::ParseError& e)
@@ -188,44 +1083,116 @@ std::error_code ZoteroToFileTree::run(int argc, char** argv) {
     return make_error_code(ErrorCodes::ZOTERO_DB_DOES_NOT_EXIST);
   }
 
+  std::optional<Tracer> tracer;
+  if (printStats || !traceFileStr.empty())
+  {
+    tracer.emplace(printStats, std::filesystem::path(traceFileStr));
+  }
+  Tracer* const tracerPtr = tracer ? &*tracer : nullptr;
+
+  TraceSpan openSpan(tracerPtr, "db open");
+  zotfiles::ZoteroDBSession session(zoteroDbPath, snapshot);
+  openSpan.finish();
+
   if (printZoteroDBInfo)
   {
-    const zotfiles::ZoteroDBInfo zoteroDBInfo = zotfiles::zotero_db_info(zoteroDbPath);
+    const zotfiles::ZoteroDBInfo zoteroDBInfo = zotfiles::zotero_db_info(session);
     fmt::print("Zotero db info:");
     fmt::print("\n{}\n", zotfiles::formatted_zotero_db_info(zoteroDBInfo));
     return make_error_code(zotfiles::ErrorCodes::SUCCESS);
   }
 
-  if (!zotfiles::is_supported_zotero_db(zoteroDbPath))
+  TraceSpan versionSpan(tracerPtr, "version check");
+  const bool supportedZoteroDB = zotfiles::is_supported_zotero_db(session);
+  versionSpan.finish();
+  if (!supportedZoteroDB)
   {
     return make_error_code(ErrorCodes::ZOTERO_DB_NOT_SUPPORTED);
   }
 
-  std::filesystem::path outputDirPath = create_output_dir(outputDirStr, overwriteOutputDir);
+  std::vector<ZoteroLibrary> libraries;
+  if (allLibraries || !libraryStr.empty())
+  {
+    libraries = zotfiles::zotero_libraries(session);
+  }
+  if (!libraryStr.empty())
+  {
+    std::erase_if(libraries,
+                  [&libraryStr](const ZoteroLibrary& library)
+                  { return library.name != libraryStr && std::to_string(library.libraryID) != libraryStr; });
+    if (libraries.empty())
+    {
+      fmt::print("No library found with the name or id: {}\n", libraryStr);
+      return make_error_code(ErrorCodes::LIBRARY_NOT_FOUND);
+    }
+    if (libraries.size() > 1)
+    {
+      fmt::print("Several libraries are named {}, select the library by its id.\n", libraryStr);
+      return make_error_code(ErrorCodes::LIBRARY_NOT_FOUND);
+    }
+    fmt::print("Library: {} (id {})\n", libraries.front().name, libraries.front().libraryID);
+    session.set_library_id(libraries.front().libraryID);
+  }
+
+  std::set<std::int64_t> collectionIds;
+  for (const std::string& collectionPath: collectionPaths)
+  {
+    const std::set<std::int64_t> pathCollectionIds = zotfiles::collection_ids_by_path(collectionPath, session);
+    if (pathCollectionIds.empty())
+    {
+      fmt::print("No collection found with the path: {}\n", collectionPath);
+      return make_error_code(ErrorCodes::COLLECTION_NOT_FOUND);
+    }
+    collectionIds.insert(pathCollectionIds.begin(), pathCollectionIds.end());
+  }
+
+  // A dry run leaves the output directory as it is, even if it does not exist.
+  std::filesystem::path outputDirPath = dryRun ? std::filesystem::path(outputDirStr) : create_output_dir(outputDirStr, overwriteOutputDir);
   if (outputDirPath.empty())
   {
     fmt::print("The output directory path is not valid.\n");
     return make_error_code(ErrorCodes::OUTPUT_DIR_INVALID);
   }
 
-  const std::vector<zotfiles::PDFItem> pdfItems = create_pdfitems(zoteroDbPath);
-
-  const auto numPdfItems = pdfItems.size();
-  fmt::print("Number of PDF items with a valid pdf path: {}\n", numPdfItems);
-  const auto numInvalidPdfItems = numPdfItems - pdfItems.size();
-  if (numInvalidPdfItems > 0)
+  const ExportOptions exportOptions{deltaExport,
+                                    overwriteExistingFiles,
+                                    jobs,
+                                    parse_link_mode(linkModeStr).value_or(LinkMode::COPY),
+                                    scanJobs,
+                                    parse_duplicate_policy(duplicatePolicyStr).value_or(DuplicatePolicy::SKIP),
+                                    tracerPtr,
+                                    dryRun,
+                                    std::filesystem::path(planFileStr),
+                                    stream,
+                                    parse_copy_backend(copyBackendStr).value_or(CopyBackend::THREADS),
+                                    queueDepth,
+                                    std::move(collectionIds),
+                                    true,
+                                    !noCache};
+  if (allLibraries)
   {
-    fmt::print("Number of PDF items with an invalid pdf path: {}\n", numInvalidPdfItems);
+    const std::size_t peakRSSBefore = peak_rss_bytes();
+    const std::error_code exportError = export_libraries(session, libraries, outputDirPath, exportOptions, libraryJobs);
+    if (tracerPtr)
+    {
+      // The exports of the libraries share the tracer and are reported together.
+      tracerPtr->set_memory_stats(MemoryStats{ArenaStats{}, peakRSSBefore, peak_rss_bytes()});
+      tracerPtr->report();
+    }
+    return exportError;
   }
 
-  fmt::print("\n");
-  zotfiles::CollectionTree collectionTree = create_collectiontree(pdfItems, zoteroDbPath);
-  auto [writtenPDFs, skippedPDFs] = collectionTree.write_pdfs(outputDirPath, overwriteExistingFiles);
+  Manifest manifest = Manifest::load(outputDirPath);
+  if (exportOptions.stream)
+  {
+    export_pdfs_streamed(session, outputDirPath, exportOptions, manifest);
+    return make_error_code(ErrorCodes::SUCCESS);
+  }
+  export_pdfs(session, outputDirPath, exportOptions, manifest);
 
-  fmt::print("\nNumber of written PDFs: {}", writtenPDFs);
-  if (skippedPDFs > 0)
+  if (watch)
   {
-    fmt::print("\nNumber of existing PDFs skipped: {}", skippedPDFs);
+    return watch_and_export(session, outputDirPath, exportOptions, std::chrono::milliseconds(watchDebounceMs), manifest);
   }
 
   return make_error_code(ErrorCodes::SUCCESS);
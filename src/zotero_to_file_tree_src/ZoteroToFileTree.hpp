@@ -1,23 +1,134 @@
 #ifndef ZOTERO_TO_FILE_TREE_ZOTEROTOFILETREE_H
 #define ZOTERO_TO_FILE_TREE_ZOTEROTOFILETREE_H
 
-#include "CollectionTree.hpp"
+#include "DuplicatePolicy.hpp"
 #include "ErrorCodes.hpp"
+#include "FlatCollectionTree.hpp"
+#include "Manifest.hpp"
+#include "StreamingExport.hpp"
+#include "Trace.hpp"
 #include "ZoteroDB.hpp"
 #include <CLI/Error.hpp>
+#include <chrono>
 #include <filesystem>
+#include <set>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace zotfiles
 {
 
+/** @brief Options of a single export of the zotero library into the output directory. */
+struct ExportOptions {
+  bool deltaExport{false};                                /**< Only query the items that changed since the export in the manifest. */
+  bool overwriteExistingFiles{false};                     /**< Replace pdf files that already exist in the output directory. */
+  std::size_t jobs{1};                                    /**< Number of pdf files that are copied concurrently. */
+  LinkMode linkMode{LinkMode::COPY};                      /**< How the pdf files are placed into the output directory. */
+  std::size_t scanJobs{1};                                /**< Number of workers that scan the zotero storage directory. */
+  DuplicatePolicy duplicatePolicy{DuplicatePolicy::SKIP}; /**< What happens to pdf items with the same name in one collection. */
+  Tracer* tracer{nullptr};                                /**< If set, the stages of the export are recorded and reported. */
+  bool dryRun{false};                                     /**< Only plan the export and report the plan, see OutputDirWriter. */
+  std::filesystem::path planFilePath;                     /**< With dryRun, write the plan as JSON Lines to this file if not empty. */
+  bool stream{false};                                     /**< Copy the pdf files while the attachments are read, see stream_pdfs. */
+  CopyBackend copyBackend{CopyBackend::THREADS};          /**< How the file content is copied with LinkMode::COPY. */
+  std::size_t queueDepth{64};                             /**< Number of copies in flight with CopyBackend::IO_URING. */
+  std::set<std::int64_t> collectionIds;                   /**< If not empty, only the subtrees of these collections are exported. */
+  bool reportTrace{true};                                 /**< Report the tracer at the end of the export, see Tracer::report. */
+  bool metadataCache{true};                               /**< Restore a full export of an unchanged zotero db from a MetadataCache. */
+  std::string libraryName;                                /**< If not empty, the summary lines of the export name this library. */
+};
+
 class ZoteroToFileTree {
 public:
   static std::error_code run(int argc, char** argv);
 
+  /**
+   *\brief Builds the collection tree of the given pdf items. The collections of the pdf items and their ancestors are queried.
+   *
+   * @param tracer If set, the collection query, the population of the nodes and the tree build are recorded as spans.
+   */
+  [[nodiscard]] static FlatCollectionTree create_collectiontree(const PDFItems& pdfItems,
+                                                                ZoteroDBSession& session,
+                                                                DuplicatePolicy duplicatePolicy = DuplicatePolicy::SKIP,
+                                                                Tracer* tracer = nullptr);
+
+  /**
+   *\brief Builds the collection tree of the given pdf items from the already known collections of the pdf items and their ancestors.
+   *
+   * @param tracer If set, the population of the nodes and the tree build are recorded as spans.
+   * @param reservedPDFNames Pdf names by collectionID that are already used, see CollectionPDFNames::reserve.
+   * @param summaryPrefix Prepended to the printed summary lines, e.g. to name the library of the export.
+   */
+  [[nodiscard]] static FlatCollectionTree
+  create_collectiontree(const PDFItems& pdfItems,
+                        const std::unordered_map<std::int64_t, ZoteroCollection>& pdfItemCollections,
+                        DuplicatePolicy duplicatePolicy = DuplicatePolicy::SKIP,
+                        Tracer* tracer = nullptr,
+                        std::span<const std::pair<std::int64_t, std::string>> reservedPDFNames = {},
+                        std::string_view summaryPrefix = {});
+
+  /**
+   *\brief Builds the collection tree of the given pdf items, with the pdf names of the collections kept in collectionPDFNames.
+   *
+   * The names of the pdf items are added to collectionPDFNames, so a later call with other pdf items, e.g. the changed items of a watch
+   * mode update, applies the duplicate policy against them.
+   *
+   * @param tracer If set, the population of the nodes and the tree build are recorded as spans.
+   * @param summaryPrefix Prepended to the printed summary lines, e.g. to name the library of the export.
+   */
+  [[nodiscard]] static FlatCollectionTree
+  create_collectiontree(const PDFItems& pdfItems,
+                        const std::unordered_map<std::int64_t, ZoteroCollection>& pdfItemCollections,
+                        CollectionPDFNames& collectionPDFNames,
+                        Tracer* tracer = nullptr,
+                        std::string_view summaryPrefix = {});
+
 private:
-  [[nodiscard]] static std::vector<PDFItem> create_pdfitems(const std::filesystem::path& zoteroDbPath);
-  [[nodiscard]] static CollectionTree create_collectiontree(const std::vector<zotfiles::PDFItem>& pdfItems,
-                                                            const std::filesystem::path& zoteroDbPath);
+  struct WatchState;
+
+  static void export_pdfs(ZoteroDBSession& session,
+                          const std::filesystem::path& outputDirPath,
+                          const ExportOptions& exportOptions,
+                          Manifest& manifest);
+  static void export_pdfs_streamed(ZoteroDBSession& session,
+                                   const std::filesystem::path& outputDirPath,
+                                   const ExportOptions& exportOptions,
+                                   Manifest& manifest);
+  static std::error_code export_libraries(ZoteroDBSession& session,
+                                          const std::vector<ZoteroLibrary>& libraries,
+                                          const std::filesystem::path& outputDirPath,
+                                          const ExportOptions& exportOptions,
+                                          std::size_t libraryJobs);
+  static std::error_code watch_and_export(ZoteroDBSession& session,
+                                          const std::filesystem::path& outputDirPath,
+                                          const ExportOptions& exportOptions,
+                                          std::chrono::milliseconds debounce,
+                                          Manifest& manifest);
+  [[nodiscard]] static WatchState watch_state(ZoteroDBSession& session, const Manifest& manifest, DuplicatePolicy duplicatePolicy);
+  static void update_export(ZoteroDBSession& session,
+                            const std::filesystem::path& outputDirPath,
+                            const ExportOptions& exportOptions,
+                            Manifest& manifest,
+                            WatchState& watchState);
+  [[nodiscard]] static PDFItems
+  create_pdfitems(ZoteroDBSession& session, std::size_t scanJobs, Tracer* tracer, std::pmr::memory_resource* memoryResource);
+  [[nodiscard]] static PDFItems create_changed_pdfitems(ZoteroDBSession& session,
+                                                        std::size_t scanJobs,
+                                                        Tracer* tracer,
+                                                        std::pmr::memory_resource* memoryResource,
+                                                        const ZoteroDBState& previousState,
+                                                        const std::set<std::int64_t>& exportedItemIds,
+                                                        std::set<std::int64_t>& patchedItemIds,
+                                                        std::string_view summaryPrefix);
+  [[nodiscard]] static PDFItems create_subtree_pdfitems(ZoteroDBSession& session,
+                                                        std::size_t scanJobs,
+                                                        Tracer* tracer,
+                                                        std::pmr::memory_resource* memoryResource,
+                                                        const std::set<std::int64_t>& rootCollectionIds);
   [[nodiscard]] static std::filesystem::path create_output_dir(const std::string& outputDirStr, bool overwriteOutputDir);
   [[nodiscard]] static std::filesystem::path create_zotero_db_path(const std::string& library_path_str);
 };
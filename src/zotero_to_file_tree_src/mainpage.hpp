@@ -24,6 +24,26 @@
 * | -\-print_db_info | | Print the zotero db info. |
 * | -\-overwrite_dir | | Overwrite the output directory if it exists. |
 * | -\-overwrite_files | | Overwrite existing files if they exist in the output directory. |
+* | -j | -\-jobs | Number of pdf files that are copied concurrently. Default is 1. |
+* | -\-link-mode | | How the pdf files are placed into the output directory: copy, hardlink, symlink, reflink or auto. Default is copy. |
+* | -\-copy-backend | | How -\-link-mode copy copies the pdf files: threads or io_uring. Default is threads. |
+* | -\-queue-depth | | Number of pdf files copied at the same time with -\-copy-backend io_uring. Default is 64. |
+* | -\-duplicates | | What happens to pdf files with the same name in one collection: skip, rename or keep. Default is skip. |
+* | -\-collection | | Only export this collection and its subcollections, given by its path, e.g. "Papers/Geometry". Can be repeated. |
+* | -\-library | | Only export the items of this library, given by its name, e.g. "My Library" or the name of a group, or by its id. |
+* | -\-all-libraries | | Export every library into its own subdirectory of the output directory, named after the library. |
+* | -\-library-jobs | | Number of libraries that are exported at the same time with -\-all-libraries. The -\-jobs and -\-scan-jobs workers are split between them. Default is the number of cores. |
+* | -\-delta | | Only query the items that changed since the last export into the output directory. |
+* | -\-scan-jobs | | Number of workers that scan the zotero storage directory. Default is the number of cores. |
+* | -\-snapshot | | Copy the zotero db into memory before the export, so the export sees one consistent state of a zotero db that is in use. |
+* | -\-watch | | Keep running and update the export whenever the zotero db or the storage directory changes. |
+* | -\-watch-debounce | | Milliseconds without changes before the export is updated in watch mode. Default is 2000. |
+* | -\-dry-run | | Print the directories and pdf files the export would create, copy, link, skip or remove. |
+* | -\-stream | | Copy the pdf files while the attachments are still read from the zotero db, instead of reading all attachments first. |
+* | -\-no-cache | | Do not read or write the metadata cache in the output directory. |
+* | -\-plan-file | | With -\-dry-run, write the plan as JSON Lines to this file instead of printing it. |
+* | -\-stats | | Print the wall time, item count and throughput of every stage of the export, the arena allocations and the peak RSS. |
+* | -\-trace | | Write the stages of the export to this file in the Chrome trace-event format. |
 *
 * \section example_sec Examples
 *
@@ -45,4 +65,29 @@
 * ```
 * zotero_to_file_tree -l /path/to/library -o /path/to/output --overwrite_files
 * ```
+*
+* Show what an export would change without changing the output directory:
+* ```
+* zotero_to_file_tree -l /path/to/library -o /path/to/output --dry-run
+* ```
+*
+* Export only one collection and its subcollections:
+* ```
+* zotero_to_file_tree -l /path/to/library -o /path/to/output --collection "Papers/Geometry"
+* ```
+*
+* Export the user library and every group library into their own subdirectories, two libraries at a time:
+* ```
+* zotero_to_file_tree -l /path/to/library -o /path/to/output --all-libraries --library-jobs 2
+* ```
+*
+* Start copying while the attachments of a large library are still read:
+* ```
+* zotero_to_file_tree -l /path/to/library -o /path/to/output --stream -j 4
+* ```
+*
+* Keep the output directory up to date while Zotero is running:
+* ```
+* zotero_to_file_tree -l /path/to/library -o /path/to/output --watch
+* ```
 */
\ No newline at end of file
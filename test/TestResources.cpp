@@ -1,4 +1,8 @@
 #include "TestResources.h"
+#include <ZoteroToFileTree.hpp>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
 
 #define STRINGIFY(x) #x
 #define TOSTRING(x) STRINGIFY(x)
@@ -18,3 +22,15 @@ std::filesystem::path zotero_example_db() {
   static_assert(false, "RESOURCE_DIR is not defined");
 #endif
 }
+
+std::string read_file(const std::filesystem::path& filePath) {
+  std::ifstream file(filePath, std::ios::binary);
+  return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+zotfiles::ErrorCodes run_cli(std::vector<std::string> args) {
+  args.insert(args.begin(), "zotero_to_file_tree");
+  std::vector<char*> argv(args.size());
+  std::transform(args.begin(), args.end(), argv.begin(), [](std::string& arg) { return arg.data(); });
+  return static_cast<zotfiles::ErrorCodes>(zotfiles::ZoteroToFileTree::run(static_cast<int>(argv.size()), argv.data()).value());
+}
@@ -1,7 +1,10 @@
 #ifndef ZOTERO_TO_FILE_TREE_TESTRESOURCES_H
 #define ZOTERO_TO_FILE_TREE_TESTRESOURCES_H
 
+#include <ErrorCodes.hpp>
 #include <filesystem>
+#include <string>
+#include <vector>
 
 /** @brief Returns the path to the test resources directory of a depr zotero db.
  */
@@ -11,4 +14,12 @@ std::filesystem::path zotero_example_db_depr();
  */
 std::filesystem::path zotero_example_db();
 
+/** @brief Returns the content of the file, an empty string if it can not be read.
+ */
+std::string read_file(const std::filesystem::path& filePath);
+
+/** @brief Runs zotero_to_file_tree with the given command line arguments, without the program name.
+ */
+zotfiles::ErrorCodes run_cli(std::vector<std::string> args);
+
 #endif // ZOTERO_TO_FILE_TREE_TESTRESOURCES_H
@@ -0,0 +1,86 @@
+#include "TestResources.h"
+#include <gtest/gtest.h>
+
+#include <ZoteroDB.hpp>
+#include <map>
+#include <set>
+
+namespace
+{
+
+/**
+ *\brief The ids of the collection and of all of its descendants.
+ */
+std::set<std::int64_t> subtree_ids(std::int64_t rootCollectionId, zotfiles::ZoteroDBSession& session) {
+  const auto collections = zotfiles::all_collections(session);
+  std::set<std::int64_t> subtreeIds{rootCollectionId};
+  for (const auto& [collectionId, collection]: collections)
+  {
+    for (std::int64_t ancestorId = collectionId; ancestorId != -1; ancestorId = collections.at(ancestorId).parentCollectionID)
+    {
+      if (ancestorId == rootCollectionId)
+      {
+        subtreeIds.insert(collectionId);
+        break;
+      }
+    }
+  }
+  return subtreeIds;
+}
+
+/**
+ *\brief The collection ids of every pdf item by item id.
+ */
+std::map<std::int64_t, std::set<std::int64_t>> item_collection_ids(const zotfiles::PDFItems& pdfItems) {
+  std::map<std::int64_t, std::set<std::int64_t>> itemCollectionIds;
+  for (const zotfiles::PDFItem& pdfItem: pdfItems)
+  {
+    auto& collectionIds = itemCollectionIds[pdfItem.pdfAttachment.itemID];
+    for (const zotfiles::ZoteroCollection& collection: pdfItems.collections(pdfItem))
+    {
+      collectionIds.insert(collection.collectionID);
+    }
+  }
+  return itemCollectionIds;
+}
+
+} // namespace
+
+TEST(CollectionFilterTest, collection_ids_by_path) {
+  zotfiles::ZoteroDBSession session(zotero_example_db() / "zotero.sqlite");
+  const std::set<std::int64_t> papersIds = zotfiles::collection_ids_by_path("Papers", session);
+  ASSERT_EQ(papersIds.size(), 1U);
+  EXPECT_EQ(zotfiles::collection_ids_by_path("/Papers/", session), papersIds);
+
+  const std::set<std::int64_t> geometryIds = zotfiles::collection_ids_by_path("Papers/Geometry", session);
+  ASSERT_EQ(geometryIds.size(), 1U);
+  EXPECT_EQ(zotfiles::all_collections(session).at(*geometryIds.begin()).parentCollectionID, *papersIds.begin());
+
+  // Paths start at a top level collection.
+  EXPECT_TRUE(zotfiles::collection_ids_by_path("Geometry", session).empty());
+  EXPECT_TRUE(zotfiles::collection_ids_by_path("Papers/Missing", session).empty());
+}
+
+TEST(CollectionFilterTest, subtree_items_match_filtered_pdf_attachment_items) {
+  zotfiles::ZoteroDBSession session(zotero_example_db() / "zotero.sqlite");
+  const auto allItemCollectionIds = item_collection_ids(zotfiles::pdf_attachment_items(session));
+
+  for (const auto& [collectionId, collection]: zotfiles::all_collections(session))
+  {
+    const std::set<std::int64_t> subtreeIds = subtree_ids(collectionId, session);
+    std::map<std::int64_t, std::set<std::int64_t>> expected;
+    for (const auto& [itemId, collectionIds]: allItemCollectionIds)
+    {
+      for (const std::int64_t itemCollectionId: collectionIds)
+      {
+        if (subtreeIds.contains(itemCollectionId))
+        {
+          expected[itemId].insert(itemCollectionId);
+        }
+      }
+    }
+
+    const zotfiles::PDFItems subtreeItems = zotfiles::subtree_pdf_attachment_items({collectionId}, session);
+    EXPECT_EQ(item_collection_ids(subtreeItems), expected) << collection.collectionName;
+  }
+}
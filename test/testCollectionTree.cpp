@@ -0,0 +1,135 @@
+#include "TestResources.h"
+#include <gtest/gtest.h>
+
+#include <DuplicatePolicy.hpp>
+#include <FlatCollectionTree.hpp>
+
+namespace
+{
+
+std::unordered_map<std::int64_t, std::shared_ptr<zotfiles::CollectionNode>> collection_nodes(
+    const std::vector<std::pair<std::int64_t, std::int64_t>>& collectionParentIDs) {
+  std::unordered_map<std::int64_t, std::shared_ptr<zotfiles::CollectionNode>> collectionNodes;
+  for (const auto& [collectionID, parentCollectionID]: collectionParentIDs)
+  {
+    collectionNodes.emplace(collectionID,
+                            std::make_shared<zotfiles::CollectionNode>(
+                                zotfiles::CollectionNode{collectionID, parentCollectionID, "Collection " + std::to_string(collectionID)}));
+  }
+  return collectionNodes;
+}
+
+} // namespace
+
+TEST(CollectionTreeTest, find_nodes_of_the_tree) {
+  // 1 -> 2 -> 3 and 4 -> 5, 7 has the missing parent 6.
+  const zotfiles::CollectionTree collectionTree =
+      zotfiles::CollectionTree::build(collection_nodes({{1, -1}, {2, 1}, {3, 2}, {4, -1}, {5, 4}, {7, 6}}));
+
+  for (std::int64_t collectionID: {1, 2, 3, 4, 5})
+  {
+    const auto node = collectionTree.find(collectionID);
+    ASSERT_NE(node, nullptr);
+    EXPECT_EQ(node->collectionID, collectionID);
+  }
+  EXPECT_EQ(collectionTree.find(3)->parentCollectionID, 2);
+  EXPECT_EQ(collectionTree.find(2)->childrenNodes.front(), collectionTree.find(3));
+
+  EXPECT_EQ(collectionTree.find(6), nullptr);
+  EXPECT_EQ(collectionTree.find(7), nullptr);
+  EXPECT_EQ(collectionTree.find(-1), nullptr);
+}
+
+TEST(CollectionTreeTest, remove_subtrees) {
+  // 1 -> 2 -> 3, 1 -> 4 and 5.
+  zotfiles::CollectionTree collectionTree = zotfiles::CollectionTree::build(collection_nodes({{1, -1}, {2, 1}, {3, 2}, {4, 1}, {5, -1}}));
+
+  EXPECT_TRUE(collectionTree.remove(*collectionTree.find(2)));
+  EXPECT_EQ(collectionTree.find(2), nullptr);
+  EXPECT_EQ(collectionTree.find(3), nullptr);
+  ASSERT_NE(collectionTree.find(1), nullptr);
+  ASSERT_EQ(collectionTree.find(1)->childrenNodes.size(), 1U);
+  EXPECT_EQ(collectionTree.find(1)->childrenNodes.front(), collectionTree.find(4));
+  EXPECT_FALSE(collectionTree.remove(zotfiles::CollectionNode{2, 1, "Collection 2"}));
+
+  // A root node is removed from the roots, the other roots stay.
+  EXPECT_TRUE(collectionTree.remove(zotfiles::CollectionNode{1, -1, "Collection 1"}));
+  EXPECT_EQ(collectionTree.find(1), nullptr);
+  EXPECT_EQ(collectionTree.find(4), nullptr);
+  EXPECT_NE(collectionTree.find(5), nullptr);
+}
+
+TEST(CollectionTreeTest, flat_tree_matches_tree) {
+  auto collectionNodes = collection_nodes({{1, -1}, {2, 1}, {3, 2}, {4, -1}, {5, 4}, {6, 4}, {8, 7}});
+  collectionNodes.at(3)->collectionPDFItems.push_back(zotfiles::CollectionPDFItem{30, "a.pdf", "/storage/a.pdf"});
+  collectionNodes.at(5)->collectionPDFItems.push_back(zotfiles::CollectionPDFItem{50, "b.pdf", "/storage/b.pdf"});
+  collectionNodes.at(5)->collectionPDFItems.push_back(zotfiles::CollectionPDFItem{51, "c.pdf", "/storage/c.pdf"});
+  const zotfiles::FlatCollectionTree flatTree = zotfiles::FlatCollectionTree::build(collectionNodes);
+
+  EXPECT_EQ(flatTree.nodes().size(), 6U);
+  EXPECT_EQ(flatTree.roots().size(), 2U);
+  EXPECT_EQ(flatTree.find(8), nullptr);
+
+  const zotfiles::FlatCollectionNode* node4 = flatTree.find(4);
+  ASSERT_NE(node4, nullptr);
+  std::vector<std::int64_t> childIDs;
+  for (const auto& childNode: flatTree.children(*node4))
+  {
+    childIDs.push_back(childNode.collectionID);
+    EXPECT_EQ(childNode.parentCollectionID, 4);
+  }
+  std::sort(childIDs.begin(), childIDs.end());
+  EXPECT_EQ(childIDs, (std::vector<std::int64_t>{5, 6}));
+
+  const auto pdfItems = flatTree.pdf_items(*flatTree.find(5));
+  ASSERT_EQ(pdfItems.size(), 2U);
+  EXPECT_EQ(pdfItems[0].pdfItemId, 50);
+  EXPECT_EQ(pdfItems[1].pdfName, "c.pdf");
+  EXPECT_EQ(flatTree.pdf_items(*flatTree.find(3)).front().pdfItemId, 30);
+  EXPECT_TRUE(flatTree.pdf_items(*flatTree.find(1)).empty());
+}
+
+TEST(CollectionTreeTest, flat_tree_from_collections_and_pdf_items) {
+  // 1 -> 2 and 4, 8 has the missing parent 7.
+  const std::vector<zotfiles::ZoteroCollection> collections{
+      {2, 1, "Collection 2"}, {8, 7, "Collection 8"}, {1, -1, "Collection 1"}, {4, -1, "Collection 4"}};
+  std::vector<std::pair<std::uint32_t, zotfiles::CollectionPDFItem>> pdfItems{{0, {20, "a.pdf", "/storage/a.pdf"}},
+                                                                                {1, {80, "b.pdf", "/storage/b.pdf"}},
+                                                                                {3, {40, "c.pdf", "/storage/c.pdf"}},
+                                                                                {0, {21, "d.pdf", "/storage/d.pdf"}}};
+  const zotfiles::FlatCollectionTree flatTree = zotfiles::FlatCollectionTree::build(collections, std::move(pdfItems));
+
+  EXPECT_EQ(flatTree.nodes().size(), 3U);
+  EXPECT_EQ(flatTree.roots().size(), 2U);
+  EXPECT_EQ(flatTree.find(8), nullptr);
+  ASSERT_NE(flatTree.find(2), nullptr);
+  EXPECT_EQ(flatTree.children(*flatTree.find(1)).front().collectionID, 2);
+
+  const auto pdfItems2 = flatTree.pdf_items(*flatTree.find(2));
+  ASSERT_EQ(pdfItems2.size(), 2U);
+  EXPECT_EQ(pdfItems2[0].pdfItemId, 20);
+  EXPECT_EQ(pdfItems2[1].pdfName, "d.pdf");
+  EXPECT_EQ(flatTree.pdf_items(*flatTree.find(4)).front().pdfItemId, 40);
+  EXPECT_TRUE(flatTree.pdf_items(*flatTree.find(1)).empty());
+}
+
+TEST(CollectionTreeTest, duplicate_pdf_names) {
+  zotfiles::CollectionPDFNames skipNames(zotfiles::DuplicatePolicy::SKIP);
+  EXPECT_EQ(skipNames.add(1, "a.pdf"), "a.pdf");
+  EXPECT_EQ(skipNames.add(1, "a.pdf"), std::nullopt);
+  EXPECT_EQ(skipNames.add(2, "a.pdf"), "a.pdf");
+
+  zotfiles::CollectionPDFNames renameNames(zotfiles::DuplicatePolicy::RENAME);
+  EXPECT_EQ(renameNames.add(1, "a.pdf"), "a.pdf");
+  EXPECT_EQ(renameNames.add(1, "a.pdf"), "a (2).pdf");
+  EXPECT_EQ(renameNames.add(1, "a (3).pdf"), "a (3).pdf");
+  EXPECT_EQ(renameNames.add(1, "a.pdf"), "a (4).pdf");
+  EXPECT_EQ(renameNames.add(2, "a.pdf"), "a.pdf");
+  renameNames.release(1, "a (2).pdf");
+  renameNames.release(3, "a.pdf");
+  EXPECT_EQ(renameNames.add(1, "a.pdf"), "a (2).pdf");
+
+  zotfiles::CollectionPDFNames keepNames(zotfiles::DuplicatePolicy::KEEP);
+  EXPECT_EQ(keepNames.add(1, "a.pdf"), "a.pdf");
+  EXPECT_EQ(keepNames.add(1, "a.pdf"), "a.pdf");
+}
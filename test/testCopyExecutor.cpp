@@ -0,0 +1,146 @@
+#include "TestResources.h"
+#include <gtest/gtest.h>
+
+#include <CopyExecutor.hpp>
+#include <IoUringCopier.hpp>
+#include <fstream>
+
+TEST(CopyExecutorTest, counts_independent_of_jobs) {
+  const std::filesystem::path testDir = std::filesystem::temp_directory_path() / "zotero_to_file_tree_test_copy_executor";
+  std::filesystem::remove_all(testDir);
+  std::filesystem::create_directories(testDir / "source");
+  for (int i = 0; i < 200; ++i)
+  {
+    std::ofstream(testDir / "source" / (std::to_string(i) + ".pdf")) << "pdf " << i;
+  }
+
+  const std::string collectionName = "Collection";
+  auto copyAll = [&testDir, &collectionName](const std::filesystem::path& targetDir, std::size_t jobs, bool overwrite)
+  {
+    std::filesystem::create_directories(targetDir);
+    zotfiles::CopyExecutor copyExecutor(jobs, overwrite);
+    for (int i = 0; i < 200; ++i)
+    {
+      const std::string fileName = std::to_string(i) + ".pdf";
+      copyExecutor.submit(zotfiles::CopyJob{testDir / "source" / fileName, targetDir / fileName, &collectionName});
+    }
+    const zotfiles::WriteSummary writeSummary = copyExecutor.finish();
+    return std::make_pair(writeSummary.writtenPDFs, writeSummary.skippedPDFs);
+  };
+
+  for (std::size_t jobs: {1U, 4U})
+  {
+    const std::filesystem::path targetDir = testDir / ("target" + std::to_string(jobs));
+    EXPECT_EQ(copyAll(targetDir, jobs, false), std::make_pair(std::size_t{200}, std::size_t{0}));
+    EXPECT_EQ(copyAll(targetDir, jobs, false), std::make_pair(std::size_t{0}, std::size_t{200}));
+    EXPECT_EQ(copyAll(targetDir, jobs, true), std::make_pair(std::size_t{200}, std::size_t{0}));
+
+    std::ifstream copiedFile(targetDir / "42.pdf");
+    std::string content;
+    std::getline(copiedFile, content);
+    EXPECT_EQ(content, "pdf 42");
+  }
+
+  std::filesystem::remove_all(testDir);
+}
+
+TEST(CopyExecutorTest, io_uring_backend_matches_threads) {
+  if (!zotfiles::IoUringCopier::create(1))
+  {
+    GTEST_SKIP() << "io_uring is not available";
+  }
+
+  const std::filesystem::path testDir = std::filesystem::temp_directory_path() / "zotero_to_file_tree_test_copy_executor_io_uring";
+  std::filesystem::remove_all(testDir);
+  std::filesystem::create_directories(testDir / "source");
+  std::filesystem::create_directories(testDir / "target");
+  // Small files and files that need several reads of the copy buffer.
+  for (int i = 0; i < 50; ++i)
+  {
+    std::ofstream(testDir / "source" / (std::to_string(i) + ".pdf"), std::ios::binary)
+        << std::string(static_cast<std::size_t>(i) * 7919 + (i % 2 == 0 ? 0 : 300 * 1024), static_cast<char>('a' + i % 26));
+  }
+
+  const std::string collectionName = "Collection";
+  auto copyAll = [&testDir, &collectionName](bool overwrite)
+  {
+    zotfiles::CopyExecutor copyExecutor(1, overwrite, zotfiles::LinkMode::COPY, nullptr, zotfiles::CopyBackend::IO_URING, 8);
+    for (int i = 0; i < 50; ++i)
+    {
+      const std::string fileName = std::to_string(i) + ".pdf";
+      copyExecutor.submit(zotfiles::CopyJob{testDir / "source" / fileName, testDir / "target" / fileName, &collectionName, fileName});
+    }
+    // A missing source file is reported and leaves no target file behind.
+    copyExecutor.submit(zotfiles::CopyJob{testDir / "source" / "missing.pdf", testDir / "target" / "missing.pdf", &collectionName});
+    const zotfiles::WriteSummary writeSummary = copyExecutor.finish();
+    return std::make_pair(writeSummary, copyExecutor.take_manifest_entries());
+  };
+
+  auto [writeSummary, manifestEntries] = copyAll(false);
+  EXPECT_EQ(writeSummary.writtenPDFs, 50U);
+  EXPECT_EQ(writeSummary.transferCounts[static_cast<std::size_t>(zotfiles::TransferMethod::IO_URING)], 50U);
+  EXPECT_FALSE(std::filesystem::exists(testDir / "target" / "missing.pdf"));
+  ASSERT_EQ(manifestEntries.size(), 50U);
+  for (const zotfiles::ManifestEntry& entry: manifestEntries)
+  {
+    EXPECT_EQ(entry.contentHash, zotfiles::content_hash(testDir / "source" / entry.relPath)) << entry.relPath;
+    EXPECT_EQ(std::filesystem::file_size(testDir / "target" / entry.relPath),
+              std::filesystem::file_size(testDir / "source" / entry.relPath));
+  }
+
+  std::tie(writeSummary, manifestEntries) = copyAll(false);
+  EXPECT_EQ(writeSummary.skippedPDFs, 50U);
+  std::tie(writeSummary, manifestEntries) = copyAll(true);
+  EXPECT_EQ(writeSummary.writtenPDFs, 50U);
+
+  std::filesystem::remove_all(testDir);
+}
+
+TEST(CopyExecutorTest, compares_byte_copies_without_hash_by_content) {
+  const std::filesystem::path testDir = std::filesystem::temp_directory_path() / "zotero_to_file_tree_test_copy_executor_hash";
+  std::filesystem::remove_all(testDir);
+  std::filesystem::create_directories(testDir / "target");
+  const std::filesystem::path sourceFilePath = testDir / "source.pdf";
+  const std::filesystem::path targetFilePath = testDir / "target" / "source.pdf";
+  std::ofstream(sourceFilePath, std::ios::binary) << "pdf content A";
+
+  const std::string collectionName = "Collection";
+  auto copy = [&sourceFilePath, &targetFilePath, &collectionName](const zotfiles::ManifestEntry* previousEntry)
+  {
+    zotfiles::CopyExecutor copyExecutor(1, false, zotfiles::LinkMode::COPY);
+    copyExecutor.submit(zotfiles::CopyJob{sourceFilePath, targetFilePath, &collectionName, "source.pdf", 1, previousEntry});
+    const zotfiles::WriteSummary writeSummary = copyExecutor.finish();
+    std::vector<zotfiles::ManifestEntry> manifestEntries = copyExecutor.take_manifest_entries();
+    EXPECT_EQ(manifestEntries.size(), 1U);
+    return std::make_pair(writeSummary, manifestEntries.front());
+  };
+  auto touchSource = [&sourceFilePath]()
+  {
+    std::filesystem::last_write_time(sourceFilePath, std::filesystem::last_write_time(sourceFilePath) + std::chrono::seconds(1));
+  };
+
+  // A buffered copy hashes while copying, copy_file_range leaves the hash to the next export.
+  auto [writeSummary, entry] = copy(nullptr);
+  EXPECT_EQ(writeSummary.writtenPDFs, 1U);
+  EXPECT_TRUE(entry.contentHash == 0 || entry.contentHash == zotfiles::content_hash(sourceFilePath));
+  entry.contentHash = 0;
+
+  // Same content with a new mtime: the copy is hashed and kept.
+  touchSource();
+  std::tie(writeSummary, entry) = copy(&entry);
+  EXPECT_EQ(writeSummary.unchangedPDFs, 1U);
+  EXPECT_EQ(entry.contentHash, zotfiles::content_hash(sourceFilePath));
+
+  // Same size with new content: the copy is replaced.
+  entry.contentHash = 0;
+  std::ofstream(sourceFilePath, std::ios::binary) << "pdf content B";
+  touchSource();
+  std::tie(writeSummary, entry) = copy(&entry);
+  EXPECT_EQ(writeSummary.writtenPDFs, 1U);
+  std::ifstream copiedFile(targetFilePath);
+  std::string content;
+  std::getline(copiedFile, content);
+  EXPECT_EQ(content, "pdf content B");
+
+  std::filesystem::remove_all(testDir);
+}
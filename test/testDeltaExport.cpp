@@ -0,0 +1,152 @@
+#include "TestResources.h"
+#include <gtest/gtest.h>
+
+#include <ErrorCodes.hpp>
+#include <Manifest.hpp>
+#include <SQLiteCpp/SQLiteCpp.h>
+#include <ZoteroDB.hpp>
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <string>
+#include <vector>
+
+TEST(DeltaExportTest, db_state_round_trip) {
+  zotfiles::ZoteroDBSession session(zotero_example_db() / "zotero.sqlite");
+  const zotfiles::ZoteroDBState state = zotfiles::zotero_db_state(session);
+  EXPECT_FALSE(state.itemsModified.empty());
+  EXPECT_EQ(state.zoteroDBPath, (zotero_example_db() / "zotero.sqlite").string());
+
+  const std::optional<zotfiles::ZoteroDBState> parsedState = zotfiles::parse_zotero_db_state(zotfiles::formatted_zotero_db_state(state));
+  ASSERT_TRUE(parsedState);
+  EXPECT_EQ(*parsedState, state);
+  EXPECT_TRUE(zotfiles::collections_unchanged(*parsedState, state));
+
+  zotfiles::ZoteroDBState renamedCollection = state;
+  renamedCollection.collectionsModified = "2100-01-01 00:00:00";
+  EXPECT_FALSE(zotfiles::collections_unchanged(state, renamedCollection));
+
+  zotfiles::ZoteroDBState groupLibraries = state;
+  groupLibraries.itemsVersions = {{1, 120}, {3, 7}, {12, 0}};
+  EXPECT_EQ(zotfiles::parse_zotero_db_state(zotfiles::formatted_zotero_db_state(groupLibraries)), groupLibraries);
+
+  EXPECT_FALSE(zotfiles::parse_zotero_db_state(""));
+  EXPECT_FALSE(zotfiles::parse_zotero_db_state("2023-01-01 00:00:00\tx\t\t1\t2\tpath"));
+  EXPECT_FALSE(zotfiles::parse_zotero_db_state("2023-01-01 00:00:00\t1:2:3\t\t1\t2\tpath"));
+  EXPECT_FALSE(zotfiles::parse_zotero_db_state("2023-01-01 00:00:00\t1:2,1:3\t\t1\t2\tpath"));
+}
+
+TEST(DeltaExportTest, changed_pdf_attachment_items) {
+  zotfiles::ZoteroDBSession session(zotero_example_db() / "zotero.sqlite");
+  const zotfiles::ZoteroDBState state = zotfiles::zotero_db_state(session);
+
+  // Nothing changed after the latest modification.
+  zotfiles::ZoteroDBState futureState = state;
+  futureState.itemsModified = "9999-12-31 23:59:59";
+  EXPECT_TRUE(zotfiles::changed_pdf_attachment_items(futureState, session).empty());
+
+  // Everything changed after an empty state.
+  const zotfiles::PDFItems allItems = zotfiles::pdf_attachment_items(session);
+  const zotfiles::PDFItems changedItems = zotfiles::changed_pdf_attachment_items(zotfiles::ZoteroDBState{}, session);
+  ASSERT_EQ(changedItems.size(), allItems.size());
+  for (std::size_t i = 0; i < allItems.size(); ++i)
+  {
+    EXPECT_EQ(changedItems[i].pdfAttachment.itemID, allItems[i].pdfAttachment.itemID);
+    EXPECT_EQ(changedItems[i].collectionCount, allItems[i].collectionCount);
+  }
+}
+
+TEST(DeltaExportTest, changed_pdf_attachment_items_compares_versions_per_library) {
+  zotfiles::ZoteroDBSession session(zotero_example_db() / "zotero.sqlite");
+  zotfiles::ZoteroDBState state = zotfiles::zotero_db_state(session);
+  state.itemsModified = "9999-12-31 23:59:59";
+  ASSERT_FALSE(state.itemsVersions.empty());
+  const std::int64_t otherLibraryID = state.itemsVersions.rbegin()->first + 1;
+
+  // A lower version of another library does not mark the items of a library as changed.
+  state.itemsVersions.emplace(otherLibraryID, 0);
+  EXPECT_TRUE(zotfiles::changed_pdf_attachment_items(state, session).empty());
+
+  // A higher version of another library does not hide the items of a library that is not in the state.
+  zotfiles::ZoteroDBState otherLibraryState = state;
+  otherLibraryState.itemsVersions = {{otherLibraryID, 1'000'000}};
+  EXPECT_EQ(zotfiles::changed_pdf_attachment_items(otherLibraryState, session).size(), zotfiles::pdf_attachment_items(session).size());
+}
+
+TEST(DeltaExportTest, missing_pdf_attachment_ids) {
+  zotfiles::ZoteroDBSession session(zotero_example_db() / "zotero.sqlite");
+  std::set<std::int64_t> itemIds;
+  for (const zotfiles::PDFItem& pdfItem: zotfiles::pdf_attachment_items(session))
+  {
+    itemIds.insert(pdfItem.pdfAttachment.itemID);
+  }
+  EXPECT_TRUE(zotfiles::missing_pdf_attachment_ids(itemIds, session).empty());
+
+  itemIds.insert(-1);
+  EXPECT_EQ(zotfiles::missing_pdf_attachment_ids(itemIds, session), std::set<std::int64_t>{-1});
+}
+
+TEST(DeltaExportTest, delta_export_keeps_files_of_unchanged_items) {
+  const std::filesystem::path testDir = std::filesystem::temp_directory_path() / "zotero_to_file_tree_test_delta_export";
+  std::filesystem::remove_all(testDir);
+  const std::filesystem::path zoteroDir = testDir / "zotero";
+  std::filesystem::create_directories(testDir);
+  std::filesystem::copy(zotero_example_db(), zoteroDir, std::filesystem::copy_options::recursive);
+
+  // Two standalone pdf attachments with the same name in the same collection, older than the other items of the db.
+  const std::array<std::int64_t, 2> itemIds{3, 4};
+  {
+    SQLite::Database db(zoteroDir / "zotero.sqlite", SQLite::OPEN_READWRITE);
+    db.exec("UPDATE itemAttachments SET path = 'storage:Same.pdf', contentType = 'application/pdf' WHERE itemID IN (3, 4)");
+    db.exec("UPDATE items SET clientDateModified = '2000-01-01 00:00:00', version = 0 WHERE itemID IN (3, 4)");
+    db.exec("INSERT OR IGNORE INTO collectionItems (collectionID, itemID, orderIndex) VALUES (4, 3, 0), (4, 4, 1)");
+  }
+  auto pdfFilePath = [&zoteroDir](std::int64_t itemId)
+  {
+    zotfiles::ZoteroDBSession session(zoteroDir / "zotero.sqlite");
+    zotfiles::PDFItems pdfItems = zotfiles::pdf_attachment_items(session);
+    auto itemIter = std::find_if(
+        pdfItems.begin(), pdfItems.end(), [itemId](const zotfiles::PDFItem& pdfItem) { return pdfItem.pdfAttachment.itemID == itemId; });
+    return zoteroDir / "storage" / std::string(itemIter->pdfAttachment.key) / "Same.pdf";
+  };
+  for (const std::int64_t itemId: itemIds)
+  {
+    std::filesystem::create_directories(pdfFilePath(itemId).parent_path());
+    std::ofstream(pdfFilePath(itemId), std::ios::binary) << std::string(static_cast<std::size_t>(itemId), static_cast<char>('A' + itemId));
+  }
+
+  // Only the item without the file "Same.pdf" of the full export changes.
+  auto changeSecondItem = [&zoteroDir, &itemIds, &pdfFilePath](const std::filesystem::path& outputDir)
+  {
+    const zotfiles::Manifest manifest = zotfiles::Manifest::load(outputDir);
+    const zotfiles::ManifestEntry* firstEntry = manifest.find("Graphics/Same.pdf");
+    EXPECT_NE(firstEntry, nullptr);
+    const std::int64_t secondItemId = firstEntry && firstEntry->pdfItemId == itemIds[0] ? itemIds[1] : itemIds[0];
+    SQLite::Database db(zoteroDir / "zotero.sqlite", SQLite::OPEN_READWRITE);
+    db.exec("UPDATE items SET clientDateModified = '2100-01-01 00:00:00', version = version + 1000 WHERE itemID = " +
+            std::to_string(secondItemId));
+    std::ofstream(pdfFilePath(secondItemId), std::ios::binary | std::ios::trunc) << "changed";
+    return read_file(outputDir / "Graphics" / "Same.pdf");
+  };
+
+  const std::filesystem::path renameDir = testDir / "rename";
+  std::vector<std::string> renameArgs{"-l", zoteroDir.string(), "-o", renameDir.string(), "--duplicates", "rename", "--no-cache"};
+  ASSERT_EQ(run_cli(renameArgs), zotfiles::ErrorCodes::SUCCESS);
+  ASSERT_TRUE(std::filesystem::exists(renameDir / "Graphics" / "Same (2).pdf"));
+  const std::string firstContent = changeSecondItem(renameDir);
+  renameArgs.emplace_back("--delta");
+  ASSERT_EQ(run_cli(renameArgs), zotfiles::ErrorCodes::SUCCESS);
+  EXPECT_EQ(read_file(renameDir / "Graphics" / "Same.pdf"), firstContent);
+  EXPECT_EQ(read_file(renameDir / "Graphics" / "Same (2).pdf"), "changed");
+
+  // The changed item is skipped again instead of replacing the file of the unchanged item.
+  const std::filesystem::path skipDir = testDir / "skip";
+  std::vector<std::string> skipArgs{"-l", zoteroDir.string(), "-o", skipDir.string(), "--duplicates", "skip", "--no-cache"};
+  ASSERT_EQ(run_cli(skipArgs), zotfiles::ErrorCodes::SUCCESS);
+  const std::string skippedContent = changeSecondItem(skipDir);
+  skipArgs.emplace_back("--delta");
+  ASSERT_EQ(run_cli(skipArgs), zotfiles::ErrorCodes::SUCCESS);
+  EXPECT_EQ(read_file(skipDir / "Graphics" / "Same.pdf"), skippedContent);
+  EXPECT_FALSE(std::filesystem::exists(skipDir / "Graphics" / "Same (2).pdf"));
+  std::filesystem::remove_all(testDir);
+}
@@ -0,0 +1,100 @@
+#include "TestResources.h"
+#include <gtest/gtest.h>
+
+#include <FlatCollectionTree.hpp>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+
+zotfiles::FlatCollectionTree collection_tree(const std::filesystem::path& sourceDir,
+                                             const std::vector<std::tuple<std::int64_t, std::int64_t, std::string>>& collectionPDFs) {
+  std::unordered_map<std::int64_t, std::shared_ptr<zotfiles::CollectionNode>> collectionNodes;
+  for (const auto& [collectionID, parentCollectionID, pdfName]: collectionPDFs)
+  {
+    auto& collectionNode = collectionNodes[collectionID];
+    if (!collectionNode)
+    {
+      collectionNode = std::make_shared<zotfiles::CollectionNode>(
+          zotfiles::CollectionNode{collectionID, parentCollectionID, "Collection " + std::to_string(collectionID)});
+    }
+    const auto pdfItemId = static_cast<std::int64_t>(pdfName[0]);
+    collectionNode->collectionPDFItems.push_back(zotfiles::CollectionPDFItem{pdfItemId, pdfName, sourceDir / pdfName});
+  }
+  return zotfiles::FlatCollectionTree::build(std::move(collectionNodes));
+}
+
+zotfiles::PlanTotals plan_totals(const zotfiles::FlatCollectionTree& collectionTree,
+                                 const std::filesystem::path& outputDir,
+                                 const zotfiles::WriteOptions& writeOptions) {
+  zotfiles::OutputDirWriter outputDirWriter(outputDir, writeOptions);
+  collectionTree.plan_pdfs(outputDirWriter);
+  return outputDirWriter.finish_plan().totals();
+}
+
+std::size_t count(const zotfiles::PlanTotals& planTotals, zotfiles::PlanAction planAction) {
+  return planTotals.counts[static_cast<std::size_t>(planAction)];
+}
+
+} // namespace
+
+TEST(ExportPlanTest, plan_matches_the_executed_export) {
+  const std::filesystem::path testDir = std::filesystem::temp_directory_path() / "zotero_to_file_tree_test_export_plan";
+  std::filesystem::remove_all(testDir);
+  std::filesystem::create_directories(testDir / "source");
+  for (const std::string pdfName: {"a.pdf", "b.pdf", "c.pdf"})
+  {
+    std::ofstream(testDir / "source" / pdfName) << "pdf " << pdfName;
+  }
+  const std::filesystem::path outputDir = testDir / "output";
+  const zotfiles::WriteOptions writeOptions;
+
+  // Collection 2 is a sub collection of collection 1.
+  const zotfiles::FlatCollectionTree collectionTree =
+      collection_tree(testDir / "source", {{1, -1, "a.pdf"}, {1, -1, "b.pdf"}, {2, 1, "a.pdf"}});
+  zotfiles::PlanTotals planTotals = plan_totals(collectionTree, outputDir, writeOptions);
+  EXPECT_EQ(count(planTotals, zotfiles::PlanAction::MKDIR), 2U);
+  EXPECT_EQ(count(planTotals, zotfiles::PlanAction::COPY), 3U);
+  EXPECT_EQ(planTotals.bytes[static_cast<std::size_t>(zotfiles::PlanAction::COPY)], 3 * std::string("pdf a.pdf").size());
+  EXPECT_FALSE(std::filesystem::exists(outputDir));
+
+  EXPECT_EQ(collectionTree.write_pdfs(outputDir, writeOptions).writtenPDFs, 3U);
+  planTotals = plan_totals(collectionTree, outputDir, writeOptions);
+  EXPECT_EQ(count(planTotals, zotfiles::PlanAction::MKDIR), 0U);
+  EXPECT_EQ(count(planTotals, zotfiles::PlanAction::UNCHANGED), 3U);
+
+  // c.pdf exists but was not written by the export, b.pdf and the sub collection are not part of the export anymore.
+  std::ofstream(outputDir / "Collection 1" / "c.pdf") << "not exported";
+  const zotfiles::FlatCollectionTree changedTree = collection_tree(testDir / "source", {{1, -1, "a.pdf"}, {1, -1, "c.pdf"}});
+  zotfiles::OutputDirWriter outputDirWriter(outputDir, writeOptions);
+  changedTree.plan_pdfs(outputDirWriter);
+  const zotfiles::ExportPlan& plan = outputDirWriter.finish_plan();
+  planTotals = plan.totals();
+  EXPECT_EQ(count(planTotals, zotfiles::PlanAction::UNCHANGED), 1U);
+  EXPECT_EQ(count(planTotals, zotfiles::PlanAction::SKIP), 1U);
+  EXPECT_EQ(count(planTotals, zotfiles::PlanAction::REMOVE), 2U);
+
+  std::stringstream jsonLines;
+  plan.write_jsonl(jsonLines);
+  std::string line;
+  std::string lastLine;
+  std::size_t lineCount = 0;
+  while (std::getline(jsonLines, line))
+  {
+    ++lineCount;
+    lastLine = line;
+  }
+  EXPECT_EQ(lineCount, plan.operations().size() + 1);
+  EXPECT_NE(lastLine.find("\"op\":\"totals\""), std::string::npos);
+  EXPECT_NE(lastLine.find("\"remove\":2"), std::string::npos);
+
+  const zotfiles::WriteSummary writeSummary = outputDirWriter.execute(nullptr);
+  EXPECT_EQ(writeSummary.writtenPDFs, 0U);
+  EXPECT_EQ(writeSummary.unchangedPDFs, 1U);
+  EXPECT_EQ(writeSummary.skippedPDFs, 1U);
+  EXPECT_EQ(writeSummary.removedPDFs, 2U);
+  EXPECT_FALSE(std::filesystem::exists(outputDir / "Collection 1" / "Collection 2"));
+
+  std::filesystem::remove_all(testDir);
+}
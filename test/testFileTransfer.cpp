@@ -0,0 +1,66 @@
+#include "TestResources.h"
+#include <gtest/gtest.h>
+
+#include <FileTransfer.hpp>
+#include <Manifest.hpp>
+#include <fstream>
+
+TEST(FileTransferTest, parse_link_mode) {
+  EXPECT_EQ(zotfiles::parse_link_mode("copy"), zotfiles::LinkMode::COPY);
+  EXPECT_EQ(zotfiles::parse_link_mode("hardlink"), zotfiles::LinkMode::HARDLINK);
+  EXPECT_EQ(zotfiles::parse_link_mode("symlink"), zotfiles::LinkMode::SYMLINK);
+  EXPECT_EQ(zotfiles::parse_link_mode("reflink"), zotfiles::LinkMode::REFLINK);
+  EXPECT_EQ(zotfiles::parse_link_mode("auto"), zotfiles::LinkMode::AUTO);
+  EXPECT_EQ(zotfiles::parse_link_mode("move"), std::nullopt);
+}
+
+TEST(FileTransferTest, link_modes) {
+  const std::filesystem::path testDir = std::filesystem::temp_directory_path() / "zotero_to_file_tree_test_file_transfer";
+  std::filesystem::remove_all(testDir);
+  std::filesystem::create_directories(testDir);
+  const std::filesystem::path sourceFilePath = testDir / "source.pdf";
+  std::ofstream(sourceFilePath) << "pdf content";
+
+  EXPECT_NE(zotfiles::FileTransfer(zotfiles::LinkMode::COPY).transfer(sourceFilePath, testDir / "copy.pdf"),
+            zotfiles::TransferMethod::HARDLINK);
+  EXPECT_EQ(read_file(testDir / "copy.pdf"), "pdf content");
+  EXPECT_FALSE(std::filesystem::equivalent(sourceFilePath, testDir / "copy.pdf"));
+
+  // A buffered copy reports the hash of the copied data, the other methods leave it to the caller.
+  std::uint64_t contentHash = 1;
+  const zotfiles::TransferMethod copyMethod =
+      zotfiles::FileTransfer(zotfiles::LinkMode::COPY).transfer(sourceFilePath, testDir / "hashed_copy.pdf", &contentHash);
+  EXPECT_EQ(contentHash, copyMethod == zotfiles::TransferMethod::BUFFERED_COPY ? zotfiles::content_hash(sourceFilePath) : 0);
+
+  EXPECT_EQ(zotfiles::FileTransfer(zotfiles::LinkMode::HARDLINK).transfer(sourceFilePath, testDir / "hardlink.pdf"),
+            zotfiles::TransferMethod::HARDLINK);
+  EXPECT_TRUE(std::filesystem::equivalent(sourceFilePath, testDir / "hardlink.pdf"));
+
+  EXPECT_EQ(zotfiles::FileTransfer(zotfiles::LinkMode::SYMLINK).transfer(sourceFilePath, testDir / "symlink.pdf"),
+            zotfiles::TransferMethod::SYMLINK);
+  EXPECT_TRUE(std::filesystem::is_symlink(testDir / "symlink.pdf"));
+  EXPECT_EQ(read_file(testDir / "symlink.pdf"), "pdf content");
+
+  // A relative source path is linked with its absolute path, the link resolves from any directory.
+  std::filesystem::create_directories(testDir / "collection");
+  const std::filesystem::path relativeSourcePath = std::filesystem::relative(sourceFilePath);
+  ASSERT_TRUE(relativeSourcePath.is_relative());
+  zotfiles::FileTransfer(zotfiles::LinkMode::SYMLINK).transfer(relativeSourcePath, testDir / "collection" / "symlink.pdf");
+  EXPECT_TRUE(std::filesystem::read_symlink(testDir / "collection" / "symlink.pdf").is_absolute());
+  EXPECT_EQ(read_file(testDir / "collection" / "symlink.pdf"), "pdf content");
+
+  // Within one directory auto never needs a byte copy.
+  zotfiles::FileTransfer autoTransfer(zotfiles::LinkMode::AUTO);
+  const zotfiles::TransferMethod autoMethod = autoTransfer.transfer(sourceFilePath, testDir / "auto.pdf");
+  EXPECT_TRUE(autoMethod == zotfiles::TransferMethod::REFLINK || autoMethod == zotfiles::TransferMethod::HARDLINK);
+  EXPECT_EQ(read_file(testDir / "auto.pdf"), "pdf content");
+
+  // Existing targets are never replaced.
+  EXPECT_THROW(zotfiles::FileTransfer(zotfiles::LinkMode::COPY).transfer(sourceFilePath, testDir / "copy.pdf"),
+               std::filesystem::filesystem_error);
+  EXPECT_THROW(zotfiles::FileTransfer(zotfiles::LinkMode::AUTO).transfer(testDir / "missing.pdf", testDir / "missing_copy.pdf"),
+               std::filesystem::filesystem_error);
+  EXPECT_FALSE(std::filesystem::exists(testDir / "missing_copy.pdf"));
+
+  std::filesystem::remove_all(testDir);
+}
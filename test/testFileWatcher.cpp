@@ -0,0 +1,47 @@
+#include "TestResources.h"
+#include <gtest/gtest.h>
+
+#include <FileWatcher.hpp>
+#include <fstream>
+#include <thread>
+
+TEST(FileWatcherTest, reports_watched_file_changes) {
+  const std::filesystem::path testDir = std::filesystem::temp_directory_path() / "zotero_to_file_tree_test_file_watcher";
+  std::filesystem::remove_all(testDir);
+  std::filesystem::create_directories(testDir);
+  std::ofstream(testDir / "zotero.sqlite") << "db";
+
+  zotfiles::FileWatcher fileWatcher({zotfiles::WatchedDir{testDir, {"zotero.sqlite"}}});
+  std::jthread writer(
+      [&testDir]
+      {
+        // Changes of other files in the directory are not reported.
+        std::ofstream(testDir / "other.txt") << "other";
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        std::ofstream(testDir / "zotero.sqlite", std::ios::app) << "changed";
+      });
+
+  const auto waitStart = std::chrono::steady_clock::now();
+  EXPECT_TRUE(fileWatcher.wait_for_changes(std::chrono::milliseconds(50)));
+  EXPECT_GE(std::chrono::steady_clock::now() - waitStart, std::chrono::milliseconds(100));
+}
+
+TEST(FileWatcherTest, fails_without_watched_dirs) {
+  zotfiles::FileWatcher fileWatcher({zotfiles::WatchedDir{std::filesystem::temp_directory_path() / "zotero_to_file_tree_missing_dir", {}}});
+  EXPECT_FALSE(fileWatcher.wait_for_changes(std::chrono::milliseconds(50)));
+}
+
+TEST(FileWatcherTest, fails_after_the_watched_dirs_were_deleted) {
+  const std::filesystem::path testDir = std::filesystem::temp_directory_path() / "zotero_to_file_tree_test_file_watcher_deleted";
+  std::filesystem::remove_all(testDir);
+  std::filesystem::create_directories(testDir / "storage");
+
+  zotfiles::FileWatcher fileWatcher({zotfiles::WatchedDir{testDir, {"zotero.sqlite"}}, zotfiles::WatchedDir{testDir / "storage", {}}});
+  std::jthread remover(
+      [&testDir]
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        std::filesystem::remove_all(testDir);
+      });
+  EXPECT_FALSE(fileWatcher.wait_for_changes(std::chrono::milliseconds(50)));
+}
@@ -0,0 +1,111 @@
+#include "TestResources.h"
+#include <gtest/gtest.h>
+
+#include <ErrorCodes.hpp>
+#include <ZoteroDB.hpp>
+#include <algorithm>
+#include <fstream>
+#include <set>
+
+TEST(LibrariesTest, zotero_libraries) {
+  zotfiles::ZoteroDBSession session(zotero_example_db() / "zotero.sqlite");
+  const std::vector<zotfiles::ZoteroLibrary> libraries = zotfiles::zotero_libraries(session);
+  ASSERT_FALSE(libraries.empty());
+  EXPECT_EQ(libraries.front().type, "user");
+  EXPECT_EQ(libraries.front().name, "My Library");
+  EXPECT_TRUE(std::is_sorted(libraries.begin(),
+                             libraries.end(),
+                             [](const zotfiles::ZoteroLibrary& lhs, const zotfiles::ZoteroLibrary& rhs)
+                             { return lhs.libraryID < rhs.libraryID; }));
+}
+
+TEST(LibrariesTest, library_filter_partitions_items_and_collections) {
+  zotfiles::ZoteroDBSession session(zotero_example_db() / "zotero.sqlite");
+  const std::size_t allItemCount = zotfiles::pdf_attachment_items(session).size();
+  const std::size_t allCollectionCount = zotfiles::all_collections(session).size();
+
+  std::set<std::int64_t> itemIds;
+  std::set<std::int64_t> collectionIds;
+  for (const zotfiles::ZoteroLibrary& library: zotfiles::zotero_libraries(session))
+  {
+    session.set_library_id(library.libraryID);
+    for (const zotfiles::PDFItem& pdfItem: zotfiles::pdf_attachment_items(session))
+    {
+      EXPECT_TRUE(itemIds.insert(pdfItem.pdfAttachment.itemID).second) << library.name;
+    }
+    for (const auto& [collectionId, collection]: zotfiles::all_collections(session))
+    {
+      EXPECT_TRUE(collectionIds.insert(collectionId).second) << library.name;
+    }
+  }
+  EXPECT_EQ(itemIds.size(), allItemCount);
+  EXPECT_EQ(collectionIds.size(), allCollectionCount);
+
+  // A library without items.
+  session.set_library_id(-1);
+  EXPECT_TRUE(zotfiles::pdf_attachment_items(session).empty());
+  EXPECT_TRUE(zotfiles::all_collections(session).empty());
+  EXPECT_EQ(zotfiles::zotero_db_state(session).collectionCount, 0);
+
+  session.set_library_id(std::nullopt);
+  EXPECT_EQ(zotfiles::pdf_attachment_items(session).size(), allItemCount);
+}
+
+TEST(LibrariesTest, export_all_libraries) {
+  const std::filesystem::path outputDir = std::filesystem::temp_directory_path() / "zotero_to_file_tree_test_all_libraries";
+  std::filesystem::remove_all(outputDir);
+  EXPECT_EQ(run_cli({"-l", zotero_example_db().string(), "-o", outputDir.string(), "--all-libraries", "--library-jobs=2"}),
+            zotfiles::ErrorCodes::SUCCESS);
+
+  zotfiles::ZoteroDBSession session(zotero_example_db() / "zotero.sqlite");
+  for (const zotfiles::ZoteroLibrary& library: zotfiles::zotero_libraries(session))
+  {
+    EXPECT_TRUE(std::filesystem::is_directory(outputDir / library.name)) << library.name;
+  }
+
+  EXPECT_EQ(run_cli({"-l", zotero_example_db().string(), "-o", outputDir.string(), "--library", "No Library"}),
+            zotfiles::ErrorCodes::LIBRARY_NOT_FOUND);
+  std::filesystem::remove_all(outputDir);
+}
+
+TEST(LibrariesTest, export_all_libraries_from_one_snapshot) {
+  const std::filesystem::path outputDir = std::filesystem::temp_directory_path() / "zotero_to_file_tree_test_all_libraries_snapshot";
+  std::filesystem::remove_all(outputDir);
+  testing::internal::CaptureStdout();
+  const zotfiles::ErrorCodes errorCode =
+      run_cli({"-l", zotero_example_db().string(), "-o", outputDir.string(), "--all-libraries", "--library-jobs=2", "--snapshot"});
+  const std::string output = testing::internal::GetCapturedStdout();
+  EXPECT_EQ(errorCode, zotfiles::ErrorCodes::SUCCESS);
+
+  zotfiles::ZoteroDBSession session(zotero_example_db() / "zotero.sqlite");
+  for (const zotfiles::ZoteroLibrary& library: zotfiles::zotero_libraries(session))
+  {
+    EXPECT_TRUE(std::filesystem::is_directory(outputDir / library.name)) << library.name;
+    // The summary lines name their library.
+    EXPECT_NE(output.find("[" + library.name + "] Number of written PDFs: "), std::string::npos) << output;
+  }
+  std::filesystem::remove_all(outputDir);
+}
+
+TEST(LibrariesTest, failed_library_export_is_reported) {
+  const std::filesystem::path outputDir = std::filesystem::temp_directory_path() / "zotero_to_file_tree_test_failed_library";
+  std::filesystem::remove_all(outputDir);
+  std::filesystem::create_directories(outputDir);
+  zotfiles::ZoteroDBSession session(zotero_example_db() / "zotero.sqlite");
+  const std::vector<zotfiles::ZoteroLibrary> libraries = zotfiles::zotero_libraries(session);
+  ASSERT_FALSE(libraries.empty());
+  // A file in place of the output directory of the first library fails its export.
+  std::ofstream(outputDir / libraries.front().name) << "not a directory";
+
+  testing::internal::CaptureStdout();
+  const zotfiles::ErrorCodes errorCode =
+      run_cli({"-l", zotero_example_db().string(), "-o", outputDir.string(), "--all-libraries", "--library-jobs=2"});
+  const std::string output = testing::internal::GetCapturedStdout();
+  EXPECT_EQ(errorCode, zotfiles::ErrorCodes::LIBRARY_EXPORT_FAILED);
+  EXPECT_NE(output.find("Exporting library '" + libraries.front().name + "' failed: "), std::string::npos) << output;
+  for (std::size_t i = 1; i < libraries.size(); ++i)
+  {
+    EXPECT_TRUE(std::filesystem::is_directory(outputDir / libraries[i].name)) << libraries[i].name;
+  }
+  std::filesystem::remove_all(outputDir);
+}
@@ -0,0 +1,137 @@
+#include "TestResources.h"
+#include <gtest/gtest.h>
+
+#include <CollectionTree.hpp>
+#include <Manifest.hpp>
+#include <fstream>
+
+namespace
+{
+
+zotfiles::CollectionTree collection_tree(const std::vector<std::filesystem::path>& pdfFilePaths) {
+  auto collectionNode = std::make_shared<zotfiles::CollectionNode>(zotfiles::CollectionNode{1, -1, "Papers"});
+  for (std::size_t i = 0; i < pdfFilePaths.size(); ++i)
+  {
+    collectionNode->collectionPDFItems.push_back(
+        zotfiles::CollectionPDFItem{static_cast<std::int64_t>(i), pdfFilePaths[i].filename().string(), pdfFilePaths[i]});
+  }
+  return zotfiles::CollectionTree::build({{1, collectionNode}});
+}
+
+} // namespace
+
+TEST(ManifestTest, save_and_load) {
+  const std::filesystem::path outputDir = std::filesystem::temp_directory_path() / "zotero_to_file_tree_test_manifest";
+  std::filesystem::remove_all(outputDir);
+  std::filesystem::create_directories(outputDir);
+
+  zotfiles::Manifest manifest;
+  manifest.insert(zotfiles::ManifestEntry{7, "A/b\tc\nd\\e.pdf", 42, -5, 0xabcdef});
+  manifest.insert(zotfiles::ManifestEntry{8, "A/f.pdf", 1, 2, 0, zotfiles::LinkMode::SYMLINK});
+  ASSERT_TRUE(manifest.save(outputDir));
+
+  const zotfiles::Manifest loadedManifest = zotfiles::Manifest::load(outputDir);
+  std::filesystem::remove_all(outputDir);
+
+  ASSERT_EQ(loadedManifest.size(), 2U);
+  const zotfiles::ManifestEntry* entry = loadedManifest.find("A/b\tc\nd\\e.pdf");
+  ASSERT_NE(entry, nullptr);
+  EXPECT_EQ(entry->pdfItemId, 7);
+  EXPECT_EQ(entry->sourceSize, 42U);
+  EXPECT_EQ(entry->sourceMTime, -5);
+  EXPECT_EQ(entry->contentHash, 0xabcdefU);
+  EXPECT_EQ(entry->linkMode, zotfiles::LinkMode::COPY);
+  ASSERT_NE(loadedManifest.find("A/f.pdf"), nullptr);
+  EXPECT_EQ(loadedManifest.find("A/f.pdf")->linkMode, zotfiles::LinkMode::SYMLINK);
+}
+
+TEST(ManifestTest, incremental_write) {
+  const std::filesystem::path testDir = std::filesystem::temp_directory_path() / "zotero_to_file_tree_test_manifest_write";
+  std::filesystem::remove_all(testDir);
+  std::filesystem::create_directories(testDir / "storage");
+  const std::filesystem::path outputDir = testDir / "output";
+  const std::vector<std::filesystem::path> pdfFilePaths = {testDir / "storage" / "a.pdf", testDir / "storage" / "b.pdf"};
+  std::ofstream(pdfFilePaths[0]) << "a";
+  std::ofstream(pdfFilePaths[1]) << "b";
+
+  zotfiles::WriteSummary writeSummary = collection_tree(pdfFilePaths).write_pdfs(outputDir, zotfiles::WriteOptions{});
+  EXPECT_EQ(writeSummary.writtenPDFs, 2U);
+  EXPECT_EQ(zotfiles::Manifest::load(outputDir).size(), 2U);
+
+  writeSummary = collection_tree(pdfFilePaths).write_pdfs(outputDir, zotfiles::WriteOptions{});
+  EXPECT_EQ(writeSummary.writtenPDFs, 0U);
+  EXPECT_EQ(writeSummary.unchangedPDFs, 2U);
+
+  // A changed pdf is written again, although the target file exists.
+  std::ofstream(pdfFilePaths[0]) << "changed";
+  writeSummary = collection_tree(pdfFilePaths).write_pdfs(outputDir, zotfiles::WriteOptions{});
+  EXPECT_EQ(writeSummary.writtenPDFs, 1U);
+  EXPECT_EQ(writeSummary.unchangedPDFs, 1U);
+  EXPECT_EQ(std::filesystem::file_size(outputDir / "Papers" / "a.pdf"), 7U);
+
+  // Files of the previous export are removed, other files are kept.
+  std::ofstream(outputDir / "Papers" / "notes.txt") << "notes";
+  writeSummary = collection_tree({pdfFilePaths[0]}).write_pdfs(outputDir, zotfiles::WriteOptions{});
+  EXPECT_EQ(writeSummary.removedPDFs, 1U);
+  EXPECT_FALSE(std::filesystem::exists(outputDir / "Papers" / "b.pdf"));
+  EXPECT_TRUE(std::filesystem::exists(outputDir / "Papers" / "notes.txt"));
+  EXPECT_EQ(zotfiles::Manifest::load(outputDir).size(), 1U);
+
+  std::filesystem::remove_all(testDir);
+}
+
+TEST(ManifestTest, changed_link_mode_transfers_again) {
+  const std::filesystem::path testDir = std::filesystem::temp_directory_path() / "zotero_to_file_tree_test_manifest_link_mode";
+  std::filesystem::remove_all(testDir);
+  std::filesystem::create_directories(testDir / "storage");
+  const std::filesystem::path outputDir = testDir / "output";
+  const std::vector<std::filesystem::path> pdfFilePaths = {testDir / "storage" / "a.pdf"};
+  std::ofstream(pdfFilePaths[0]) << "a";
+
+  zotfiles::WriteSummary writeSummary = collection_tree(pdfFilePaths).write_pdfs(outputDir, zotfiles::WriteOptions{});
+  EXPECT_EQ(writeSummary.writtenPDFs, 1U);
+
+  // The unchanged source file is linked instead of copied.
+  zotfiles::WriteOptions symlinkOptions;
+  symlinkOptions.linkMode = zotfiles::LinkMode::SYMLINK;
+  writeSummary = collection_tree(pdfFilePaths).write_pdfs(outputDir, symlinkOptions);
+  EXPECT_EQ(writeSummary.writtenPDFs, 1U);
+  EXPECT_EQ(writeSummary.unchangedPDFs, 0U);
+  EXPECT_TRUE(std::filesystem::is_symlink(outputDir / "Papers" / "a.pdf"));
+  writeSummary = collection_tree(pdfFilePaths).write_pdfs(outputDir, symlinkOptions);
+  EXPECT_EQ(writeSummary.unchangedPDFs, 1U);
+
+  // And copied again.
+  writeSummary = collection_tree(pdfFilePaths).write_pdfs(outputDir, zotfiles::WriteOptions{});
+  EXPECT_EQ(writeSummary.writtenPDFs, 1U);
+  EXPECT_FALSE(std::filesystem::is_symlink(outputDir / "Papers" / "a.pdf"));
+  EXPECT_EQ(zotfiles::Manifest::load(outputDir).find("Papers/a.pdf")->linkMode, zotfiles::LinkMode::COPY);
+
+  std::filesystem::remove_all(testDir);
+}
+
+TEST(ManifestTest, content_hasher_matches_content_hash) {
+  const std::filesystem::path testDir = std::filesystem::temp_directory_path() / "zotero_to_file_tree_test_content_hasher";
+  std::filesystem::remove_all(testDir);
+  std::filesystem::create_directories(testDir);
+
+  // Longer than the read buffer of content_hash and not a multiple of the word size.
+  std::string content(300 * 1024 + 5, '\0');
+  for (std::size_t i = 0; i < content.size(); ++i)
+  {
+    content[i] = static_cast<char>(i * 31 % 251);
+  }
+  std::ofstream(testDir / "a.pdf", std::ios::binary) << content;
+
+  for (const std::size_t chunkSize: {1U, 3U, 8U, 1000U, 128U * 1024U})
+  {
+    zotfiles::ContentHasher hasher;
+    for (std::size_t offset = 0; offset < content.size(); offset += chunkSize)
+    {
+      hasher.update(content.data() + offset, std::min(chunkSize, content.size() - offset));
+    }
+    EXPECT_EQ(hasher.finish(), zotfiles::content_hash(testDir / "a.pdf")) << "chunk size " << chunkSize;
+  }
+
+  std::filesystem::remove_all(testDir);
+}
@@ -0,0 +1,161 @@
+#include "TestResources.h"
+#include <gtest/gtest.h>
+
+#include <ErrorCodes.hpp>
+#include <MetadataCache.hpp>
+#include <SQLiteCpp/SQLiteCpp.h>
+#include <ZoteroDB.hpp>
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(MetadataCacheTest, restores_pdf_items_and_collections) {
+  const std::filesystem::path testDir = std::filesystem::temp_directory_path() / "zotero_to_file_tree_test_metadata_cache";
+  std::filesystem::remove_all(testDir);
+  std::filesystem::create_directories(testDir);
+
+  zotfiles::ZoteroDBSession session(zotero_example_db() / "zotero.sqlite");
+  zotfiles::PDFItems pdfItems = zotfiles::pdf_attachment_items(session);
+  zotfiles::resolve_pdf_file_paths(pdfItems, session);
+  const auto pdfItemCollections = zotfiles::all_pdf_item_collections(pdfItems, session);
+  const zotfiles::ZoteroDBState dbState = zotfiles::zotero_db_state(session);
+  const zotfiles::MetadataCacheKey key = zotfiles::metadata_cache_key(session);
+  EXPECT_FALSE(zotfiles::MetadataCache::open(testDir, key));
+  ASSERT_TRUE(zotfiles::MetadataCache::save(testDir, key, dbState, pdfItems, pdfItemCollections));
+
+  const std::optional<zotfiles::MetadataCache> metadataCache = zotfiles::MetadataCache::open(testDir, key);
+  ASSERT_TRUE(metadataCache);
+  EXPECT_EQ(metadataCache->db_state(), dbState);
+  const zotfiles::PDFItems cachedItems = metadataCache->pdf_items();
+  ASSERT_EQ(cachedItems.size(), pdfItems.size());
+  for (std::size_t i = 0; i < pdfItems.size(); ++i)
+  {
+    EXPECT_EQ(cachedItems[i].pdfAttachment.itemID, pdfItems[i].pdfAttachment.itemID);
+    EXPECT_EQ(cachedItems[i].pdfAttachment.parentItemID, pdfItems[i].pdfAttachment.parentItemID);
+    EXPECT_EQ(cachedItems[i].pdfAttachment.path, pdfItems[i].pdfAttachment.path);
+    EXPECT_EQ(cachedItems[i].pdfAttachment.key, pdfItems[i].pdfAttachment.key);
+    EXPECT_EQ(cachedItems[i].pdfFilePath, pdfItems[i].pdfFilePath);
+    ASSERT_EQ(cachedItems[i].collectionCount, pdfItems[i].collectionCount);
+    for (std::uint32_t j = 0; j < pdfItems[i].collectionCount; ++j)
+    {
+      EXPECT_EQ(cachedItems.collection(cachedItems.collection_refs(cachedItems[i])[j]).collectionID,
+                pdfItems.collection(pdfItems.collection_refs(pdfItems[i])[j]).collectionID);
+    }
+  }
+  const auto cachedCollections = metadataCache->pdf_item_collections();
+  ASSERT_EQ(cachedCollections.size(), pdfItemCollections.size());
+  for (const auto& [collectionId, collection]: pdfItemCollections)
+  {
+    ASSERT_TRUE(cachedCollections.contains(collectionId));
+    EXPECT_EQ(cachedCollections.at(collectionId).parentCollectionID, collection.parentCollectionID);
+    EXPECT_EQ(cachedCollections.at(collectionId).collectionName, collection.collectionName);
+  }
+  std::filesystem::remove_all(testDir);
+}
+
+TEST(MetadataCacheTest, ignores_changed_key_and_damaged_cache) {
+  const std::filesystem::path testDir = std::filesystem::temp_directory_path() / "zotero_to_file_tree_test_metadata_cache_key";
+  std::filesystem::remove_all(testDir);
+  std::filesystem::create_directories(testDir);
+
+  zotfiles::ZoteroDBSession session(zotero_example_db() / "zotero.sqlite");
+  const zotfiles::PDFItems pdfItems = zotfiles::pdf_attachment_items(session);
+  const zotfiles::MetadataCacheKey key = zotfiles::metadata_cache_key(session);
+  ASSERT_TRUE(zotfiles::MetadataCache::save(testDir, key, zotfiles::zotero_db_state(session), pdfItems, {}));
+  EXPECT_TRUE(zotfiles::MetadataCache::open(testDir, key));
+
+  zotfiles::MetadataCacheKey changedKey = key;
+  changedKey.fileState.walSize += 4096;
+  EXPECT_FALSE(zotfiles::MetadataCache::open(testDir, changedKey));
+  changedKey = key;
+  changedKey.dbInfo.userdata += 1;
+  EXPECT_FALSE(zotfiles::MetadataCache::open(testDir, changedKey));
+  changedKey = key;
+  changedKey.libraryID = 2;
+  EXPECT_FALSE(zotfiles::MetadataCache::open(testDir, changedKey));
+  changedKey = key;
+  changedKey.storageFingerprint += 1;
+  EXPECT_FALSE(zotfiles::MetadataCache::open(testDir, changedKey));
+
+  const std::filesystem::path cachePath = testDir / zotfiles::MetadataCache::fileName;
+  std::filesystem::resize_file(cachePath, std::filesystem::file_size(cachePath) - 1);
+  EXPECT_FALSE(zotfiles::MetadataCache::open(testDir, key));
+  std::ofstream(cachePath, std::ios::trunc) << "not a cache";
+  EXPECT_FALSE(zotfiles::MetadataCache::open(testDir, key));
+  std::filesystem::remove_all(testDir);
+}
+
+TEST(MetadataCacheTest, ignores_cache_after_pdf_files_of_a_key_dir_changed) {
+  const std::filesystem::path testDir = std::filesystem::temp_directory_path() / "zotero_to_file_tree_test_metadata_cache_storage";
+  std::filesystem::remove_all(testDir);
+  const std::filesystem::path zoteroDir = testDir / "zotero";
+  const std::filesystem::path outputDir = testDir / "output";
+  std::filesystem::create_directories(testDir);
+  std::filesystem::copy(zotero_example_db(), zoteroDir, std::filesystem::copy_options::recursive);
+  const std::filesystem::path keyDir = zoteroDir / "storage" / "4WJP46FK";
+  const std::filesystem::path exportedFile = outputDir / "Graphics" / "Attene - 2017 - ImatiSTL - Fast and Reliable Mesh Processing with .pdf";
+
+  ASSERT_EQ(run_cli({"-l", zoteroDir.string(), "-o", outputDir.string()}), zotfiles::ErrorCodes::SUCCESS);
+  ASSERT_TRUE(std::filesystem::exists(outputDir / zotfiles::MetadataCache::fileName));
+  ASSERT_TRUE(std::filesystem::exists(exportedFile));
+
+  // The pdf file is replaced by one with another name, the storage directory itself does not change.
+  std::filesystem::remove(keyDir / exportedFile.filename());
+  std::ofstream(keyDir / "Swapped.pdf", std::ios::binary) << "swapped pdf";
+  ASSERT_EQ(run_cli({"-l", zoteroDir.string(), "-o", outputDir.string()}), zotfiles::ErrorCodes::SUCCESS);
+  EXPECT_EQ(read_file(exportedFile), "swapped pdf");
+
+  // A second pdf file makes the attachment ambiguous, it is not exported anymore.
+  std::ofstream(keyDir / "Second.pdf", std::ios::binary) << "second pdf";
+  ASSERT_EQ(run_cli({"-l", zoteroDir.string(), "-o", outputDir.string()}), zotfiles::ErrorCodes::SUCCESS);
+  EXPECT_FALSE(std::filesystem::exists(exportedFile));
+  std::filesystem::remove_all(testDir);
+}
+
+TEST(MetadataCacheTest, watch_mode_exports_a_renamed_collection) {
+  const std::filesystem::path testDir = std::filesystem::temp_directory_path() / "zotero_to_file_tree_test_metadata_cache_watch";
+  std::filesystem::remove_all(testDir);
+  const std::filesystem::path zoteroDir = testDir / "zotero";
+  const std::filesystem::path outputDir = testDir / "output";
+  std::filesystem::create_directories(testDir);
+  std::filesystem::copy(zotero_example_db(), zoteroDir, std::filesystem::copy_options::recursive);
+  const std::string pdfName = "Attene - 2017 - ImatiSTL - Fast and Reliable Mesh Processing with .pdf";
+
+  // The live session of watch mode writes the metadata cache with its first export.
+  const std::vector<std::string> watchArgs{"-l", zoteroDir.string(), "-o", outputDir.string(), "--watch", "--watch-debounce", "100"};
+  std::future<zotfiles::ErrorCodes> watchResult = std::async(std::launch::async, [&watchArgs]() { return run_cli(watchArgs); });
+  auto waitFor = [](const std::filesystem::path& filePath)
+  {
+    for (int i = 0; i < 100 && !std::filesystem::exists(filePath); ++i)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    return std::filesystem::exists(filePath);
+  };
+  // The watch mode export only returns once watching failed, so the test does not stop before the zotero directory is removed.
+  EXPECT_TRUE(waitFor(outputDir / zotfiles::MetadataCache::fileName));
+  EXPECT_TRUE(waitFor(outputDir / "Graphics" / pdfName));
+
+  // The rename is written again until the watcher, which starts after the first export, reports it.
+  const std::filesystem::path renamedFile = outputDir / "Renamed Graphics" / pdfName;
+  for (int i = 0; i < 5 && !std::filesystem::exists(renamedFile); ++i)
+  {
+    {
+      SQLite::Database db(zoteroDir / "zotero.sqlite", SQLite::OPEN_READWRITE);
+      db.exec("UPDATE collections SET collectionName = 'Renamed Graphics', clientDateModified = '2100-01-01 00:00:00', "
+              "version = version + 1 WHERE collectionName IN ('Graphics', 'Renamed Graphics')");
+    }
+    waitFor(renamedFile);
+  }
+  EXPECT_TRUE(std::filesystem::exists(renamedFile));
+  EXPECT_FALSE(std::filesystem::exists(outputDir / "Graphics" / pdfName));
+
+  // Watching fails once the zotero directory is gone, which ends the export.
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  std::filesystem::remove_all(zoteroDir);
+  EXPECT_EQ(watchResult.get(), zotfiles::ErrorCodes::WATCH_FAILED);
+  std::filesystem::remove_all(testDir);
+}
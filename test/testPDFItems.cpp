@@ -0,0 +1,90 @@
+#include "TestResources.h"
+#include <gtest/gtest.h>
+
+#include <PDFItems.hpp>
+#include <RunArena.hpp>
+#include <ZoteroDB.hpp>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+std::vector<std::int64_t> collection_ids(const zotfiles::PDFItems& pdfItems, const zotfiles::PDFItem& pdfItem) {
+  std::vector<std::int64_t> collectionIDs;
+  for (const zotfiles::ZoteroCollection& collection: pdfItems.collections(pdfItem))
+  {
+    collectionIDs.push_back(collection.collectionID);
+  }
+  return collectionIDs;
+}
+
+} // namespace
+
+TEST(PDFItemsTest, collections_are_stored_once) {
+  zotfiles::PDFItems pdfItems;
+  const std::size_t first = pdfItems.add(10, -1, "storage:a.pdf", "AAAAAAAA");
+  const std::size_t second = pdfItems.add(20, 2, "storage:b.pdf", "BBBBBBBB");
+  pdfItems.add_collection(first, 1, -1, "Papers");
+  pdfItems.add_collection(second, 1, -1, "Papers");
+  // Continues the range of the first item after the second item added its collection.
+  pdfItems.add_collection(first, 3, 1, "Meshes");
+
+  EXPECT_EQ(pdfItems.all_collections().size(), 2U);
+  EXPECT_EQ(collection_ids(pdfItems, pdfItems[first]), (std::vector<std::int64_t>{1, 3}));
+  EXPECT_EQ(collection_ids(pdfItems, pdfItems[second]), (std::vector<std::int64_t>{1}));
+  EXPECT_EQ(&*pdfItems.collections(pdfItems[first]).begin(), &*pdfItems.collections(pdfItems[second]).begin());
+
+  // The copy does not refer to the strings of the original.
+  zotfiles::PDFItems copiedItems;
+  {
+    const zotfiles::PDFItems original = pdfItems;
+    copiedItems = original;
+  }
+  EXPECT_EQ(copiedItems[first].pdfAttachment.key, "AAAAAAAA");
+  EXPECT_EQ(copiedItems[second].pdfAttachment.path, "storage:b.pdf");
+  EXPECT_EQ(collection_ids(copiedItems, copiedItems[first]), (std::vector<std::int64_t>{1, 3}));
+
+  pdfItems.erase_if([](const zotfiles::PDFItem& pdfItem) { return pdfItem.pdfAttachment.itemID == 10; });
+  ASSERT_EQ(pdfItems.size(), 1U);
+  EXPECT_EQ(collection_ids(pdfItems, pdfItems[0]), (std::vector<std::int64_t>{1}));
+}
+
+TEST(PDFItemsTest, retrieved_collections_match_the_attachment_query) {
+  zotfiles::ZoteroDBSession session(zotero_example_db() / "zotero.sqlite");
+  const zotfiles::PDFItems pdfItems = zotfiles::pdf_attachment_items(session);
+  zotfiles::PDFItems retrievedItems = zotfiles::pdf_attachments(session);
+  zotfiles::retrieve_pdf_item_collections(retrievedItems, session);
+
+  ASSERT_EQ(retrievedItems.size(), pdfItems.size());
+  for (std::size_t i = 0; i < pdfItems.size(); ++i)
+  {
+    EXPECT_EQ(retrievedItems[i].pdfAttachment.itemID, pdfItems[i].pdfAttachment.itemID);
+    EXPECT_EQ(retrievedItems[i].pdfAttachment.key, pdfItems[i].pdfAttachment.key);
+    std::vector<std::int64_t> retrievedIDs = collection_ids(retrievedItems, retrievedItems[i]);
+    std::vector<std::int64_t> expectedIDs = collection_ids(pdfItems, pdfItems[i]);
+    std::ranges::sort(retrievedIDs);
+    std::ranges::sort(expectedIDs);
+    EXPECT_EQ(retrievedIDs, expectedIDs);
+  }
+}
+
+TEST(PDFItemsTest, items_are_allocated_from_the_memory_resource) {
+  zotfiles::RunArena runArena;
+  {
+    zotfiles::PDFItems pdfItems(runArena.resource());
+    for (std::int64_t itemID = 0; itemID < 1000; ++itemID)
+    {
+      pdfItems.add_collection(pdfItems.add(itemID, -1, "storage:" + std::to_string(itemID) + ".pdf", "KEY" + std::to_string(itemID)),
+                              itemID % 10,
+                              -1,
+                              "Collection");
+    }
+    EXPECT_EQ(pdfItems.memory_resource(), runArena.resource());
+  }
+  const zotfiles::ArenaStats arenaStats = runArena.stats();
+  EXPECT_GT(arenaStats.allocations, 0U);
+  EXPECT_LT(arenaStats.heapAllocations, arenaStats.allocations);
+  EXPECT_GE(arenaStats.heapBytes, arenaStats.allocatedBytes);
+}
@@ -0,0 +1,77 @@
+#include "TestResources.h"
+#include <gtest/gtest.h>
+
+#include <StorageIndex.hpp>
+#include <fstream>
+
+TEST(StorageIndexTest, example_db_storage) {
+  const std::filesystem::path storageDir = zotero_example_db() / "storage";
+  const zotfiles::StorageIndex storageIndex = zotfiles::StorageIndex::build(storageDir);
+
+  EXPECT_EQ(storageIndex.size(), 1U);
+
+  const zotfiles::StorageIndex::Entry* entry = storageIndex.find("4WJP46FK");
+  ASSERT_NE(entry, nullptr);
+  EXPECT_EQ(entry->pdfFileCount, 1U);
+  EXPECT_EQ(entry->pdfFilePath, storageDir / "4WJP46FK" / "Attene - 2017 - ImatiSTL - Fast and Reliable Mesh Processing with .pdf");
+
+  // Directories without pdf files are not part of the index.
+  EXPECT_EQ(storageIndex.find("2AQ92AS2"), nullptr);
+  EXPECT_EQ(storageIndex.find("9TKS7AWI"), nullptr);
+}
+
+TEST(StorageIndexTest, multiple_pdfs_in_key_dir) {
+  const std::filesystem::path storageDir = std::filesystem::temp_directory_path() / "zotero_to_file_tree_test_storage_index";
+  std::filesystem::remove_all(storageDir);
+  std::filesystem::create_directories(storageDir / "KEY00001");
+  std::filesystem::create_directories(storageDir / "KEY00002");
+  std::ofstream(storageDir / "KEY00001" / "a.pdf") << "a";
+  std::ofstream(storageDir / "KEY00001" / "b.pdf") << "b";
+  std::ofstream(storageDir / "KEY00002" / ".pdf") << "c";
+  std::ofstream(storageDir / "not_a_key.pdf") << "d";
+
+  const zotfiles::StorageIndex storageIndex = zotfiles::StorageIndex::build(storageDir);
+  std::filesystem::remove_all(storageDir);
+
+  const zotfiles::StorageIndex::Entry* entry = storageIndex.find("KEY00001");
+  ASSERT_NE(entry, nullptr);
+  EXPECT_EQ(entry->pdfFileCount, 2U);
+  EXPECT_EQ(storageIndex.find("KEY00002"), nullptr);
+  EXPECT_EQ(storageIndex.size(), 1U);
+}
+
+TEST(StorageIndexTest, missing_storage_dir) {
+  const zotfiles::StorageIndex storageIndex = zotfiles::StorageIndex::build(zotero_example_db() / "does_not_exist");
+  EXPECT_EQ(storageIndex.size(), 0U);
+}
+
+TEST(StorageIndexTest, result_independent_of_scan_jobs) {
+  const std::filesystem::path storageDir = std::filesystem::temp_directory_path() / "zotero_to_file_tree_test_storage_index_jobs";
+  std::filesystem::remove_all(storageDir);
+  for (int i = 0; i < 500; ++i)
+  {
+    const std::filesystem::path keyDir = storageDir / ("KEY" + std::to_string(i));
+    std::filesystem::create_directories(keyDir);
+    if (i % 2 == 0)
+    {
+      std::ofstream(keyDir / "paper.pdf") << "pdf";
+    }
+  }
+
+  const zotfiles::StorageIndex serialIndex = zotfiles::StorageIndex::build(storageDir, 1);
+  const zotfiles::StorageIndex parallelIndex = zotfiles::StorageIndex::build(storageDir, 4);
+  std::filesystem::remove_all(storageDir);
+
+  EXPECT_EQ(serialIndex.worker_stats().size(), 1U);
+  EXPECT_EQ(parallelIndex.worker_stats().size(), 4U);
+  EXPECT_EQ(serialIndex.scanned_dirs(), 500U);
+  EXPECT_EQ(parallelIndex.scanned_dirs(), 500U);
+  ASSERT_EQ(serialIndex.size(), 250U);
+  ASSERT_EQ(parallelIndex.size(), 250U);
+  for (int i = 0; i < 500; i += 2)
+  {
+    const std::string key = "KEY" + std::to_string(i);
+    ASSERT_NE(parallelIndex.find(key), nullptr);
+    EXPECT_EQ(parallelIndex.find(key)->pdfFilePath, serialIndex.find(key)->pdfFilePath);
+  }
+}
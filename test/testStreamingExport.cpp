@@ -0,0 +1,80 @@
+#include "TestResources.h"
+#include <gtest/gtest.h>
+
+#include <StreamingExport.hpp>
+#include <ZoteroDB.hpp>
+#include <ZoteroToFileTree.hpp>
+#include <set>
+#include <string>
+
+namespace
+{
+
+/**
+ *\brief The relative paths of all files in the directory, except the manifest.
+ */
+std::set<std::string> exported_files(const std::filesystem::path& outputDir) {
+  std::set<std::string> relPaths;
+  for (const auto& entry: std::filesystem::recursive_directory_iterator(outputDir))
+  {
+    if (entry.is_regular_file() && entry.path().filename() != zotfiles::Manifest::fileName)
+    {
+      relPaths.insert(std::filesystem::relative(entry.path(), outputDir).generic_string());
+    }
+  }
+  return relPaths;
+}
+
+} // namespace
+
+TEST(StreamingExportTest, for_each_pdf_attachment_item_matches_pdf_attachment_items) {
+  zotfiles::ZoteroDBSession session(zotero_example_db() / "zotero.sqlite");
+  const zotfiles::PDFItems pdfItems = zotfiles::pdf_attachment_items(session);
+
+  std::vector<std::pair<std::int64_t, std::size_t>> streamedItems;
+  const std::size_t attachmentCount = zotfiles::for_each_pdf_attachment_item(
+      session,
+      [&streamedItems](const zotfiles::ZoteroPDFAttachment& pdfAttachment, std::span<const std::int64_t> collectionIDs)
+      { streamedItems.emplace_back(pdfAttachment.itemID, collectionIDs.size()); });
+
+  ASSERT_EQ(attachmentCount, pdfItems.size());
+  ASSERT_EQ(streamedItems.size(), pdfItems.size());
+  for (std::size_t i = 0; i < pdfItems.size(); ++i)
+  {
+    EXPECT_EQ(streamedItems[i].first, pdfItems[i].pdfAttachment.itemID);
+    EXPECT_EQ(streamedItems[i].second, pdfItems[i].collectionCount);
+  }
+}
+
+TEST(StreamingExportTest, streamed_export_matches_staged_export) {
+  const std::filesystem::path testDir = std::filesystem::temp_directory_path() / "zotero_to_file_tree_test_streaming_export";
+  std::filesystem::remove_all(testDir);
+  zotfiles::ZoteroDBSession session(zotero_example_db() / "zotero.sqlite");
+  const zotfiles::WriteOptions writeOptions;
+
+  zotfiles::PDFItems pdfItems = zotfiles::pdf_attachment_items(session);
+  zotfiles::resolve_pdf_file_paths(pdfItems, zotfiles::StorageIndex::build(session.storage_dir()));
+  pdfItems.erase_if([](const zotfiles::PDFItem& item) { return item.pdfFilePath.empty(); });
+  const zotfiles::FlatCollectionTree collectionTree = zotfiles::ZoteroToFileTree::create_collectiontree(pdfItems, session);
+  const zotfiles::WriteSummary stagedSummary = collectionTree.write_pdfs(testDir / "staged", writeOptions);
+
+  zotfiles::Manifest streamedManifest;
+  const zotfiles::StreamSummary streamSummary =
+      zotfiles::stream_pdfs(session, testDir / "streamed", writeOptions, zotfiles::DuplicatePolicy::SKIP, &streamedManifest);
+  EXPECT_EQ(streamSummary.pdfAttachments, zotfiles::pdf_attachment_items(session).size());
+  EXPECT_EQ(streamSummary.pdfItems, pdfItems.size());
+  EXPECT_EQ(streamSummary.writeSummary.writtenPDFs, stagedSummary.writtenPDFs);
+  EXPECT_GT(streamSummary.writeSummary.writtenPDFs, 0U);
+  EXPECT_EQ(exported_files(testDir / "streamed"), exported_files(testDir / "staged"));
+  EXPECT_EQ(streamedManifest.entries().size(), streamSummary.writeSummary.writtenPDFs);
+
+  // A second streamed export finds all files of the first one unchanged.
+  const zotfiles::WriteOptions updateOptions{false, 1, zotfiles::LinkMode::COPY, &streamedManifest};
+  const zotfiles::StreamSummary updateSummary =
+      zotfiles::stream_pdfs(session, testDir / "streamed", updateOptions, zotfiles::DuplicatePolicy::SKIP);
+  EXPECT_EQ(updateSummary.writeSummary.writtenPDFs, 0U);
+  EXPECT_EQ(updateSummary.writeSummary.unchangedPDFs, streamSummary.writeSummary.writtenPDFs);
+  EXPECT_EQ(updateSummary.writeSummary.removedPDFs, 0U);
+
+  std::filesystem::remove_all(testDir);
+}
@@ -0,0 +1,71 @@
+#include "TestResources.h"
+#include <gtest/gtest.h>
+
+#include <Trace.hpp>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+TEST(TraceTest, spans_are_aggregated_per_stage) {
+  zotfiles::Tracer tracer(false, {});
+  {
+    zotfiles::TraceSpan traceSpan(&tracer, "query");
+    traceSpan.set_item_count(10);
+  }
+  {
+    std::jthread worker(
+        [&tracer]()
+        {
+          for (int i = 0; i < 3; ++i)
+          {
+            zotfiles::TraceSpan traceSpan(&tracer, "copy");
+            traceSpan.set_item_count(1);
+          }
+        });
+  }
+  {
+    // A span without a tracer records nothing.
+    zotfiles::TraceSpan traceSpan(nullptr, "ignored");
+  }
+
+  const auto stageStats = tracer.stage_stats();
+  ASSERT_EQ(stageStats.size(), 2U);
+  EXPECT_EQ(stageStats[0].first, "query");
+  EXPECT_EQ(stageStats[0].second.spanCount, 1U);
+  EXPECT_EQ(stageStats[0].second.itemCount, 10U);
+  EXPECT_EQ(stageStats[1].first, "copy");
+  EXPECT_EQ(stageStats[1].second.spanCount, 3U);
+  EXPECT_EQ(stageStats[1].second.itemCount, 3U);
+  EXPECT_GE(stageStats[1].second.wallTime, stageStats[1].second.busyTime);
+
+  EXPECT_TRUE(tracer.report());
+  EXPECT_TRUE(tracer.stage_stats().empty());
+}
+
+TEST(TraceTest, chrome_trace_contains_all_events) {
+  const std::filesystem::path traceFilePath = std::filesystem::temp_directory_path() / "zotero_to_file_tree_test_trace.json";
+  std::filesystem::remove(traceFilePath);
+
+  zotfiles::Tracer tracer(false, traceFilePath);
+  {
+    zotfiles::TraceSpan outerSpan(&tracer, "write pdfs");
+    zotfiles::TraceSpan innerSpan(&tracer, "create directory");
+    innerSpan.set_item_count(1);
+    innerSpan.finish();
+    innerSpan.finish();
+  }
+  ASSERT_TRUE(tracer.report());
+
+  std::ifstream traceFile(traceFilePath);
+  std::stringstream traceContent;
+  traceContent << traceFile.rdbuf();
+  const std::string trace = traceContent.str();
+  EXPECT_EQ(trace.rfind("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", 0), 0U);
+  EXPECT_NE(trace.find("\"name\":\"create directory\",\"cat\":\"export\",\"ph\":\"X\""), std::string::npos);
+  EXPECT_NE(trace.find("\"name\":\"write pdfs\""), std::string::npos);
+  EXPECT_NE(trace.find("\"args\":{\"items\":1}"), std::string::npos);
+  EXPECT_EQ(trace.find("create directory"), trace.rfind("create directory"));
+  EXPECT_EQ(trace.substr(trace.size() - 3), "]}\n");
+
+  std::filesystem::remove(traceFilePath);
+}
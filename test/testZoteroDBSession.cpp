@@ -0,0 +1,121 @@
+#include "TestResources.h"
+#include <gtest/gtest.h>
+
+#include <SQLiteCpp/SQLiteCpp.h>
+#include <ZoteroDB.hpp>
+#include <chrono>
+#include <fstream>
+#include <thread>
+
+TEST(ZoteroDBSessionTest, snapshot_reads_the_same_items) {
+  zotfiles::ZoteroDBSession session(zotero_example_db() / "zotero.sqlite");
+  zotfiles::ZoteroDBSession snapshotSession(zotero_example_db() / "zotero.sqlite", true);
+  EXPECT_FALSE(session.is_snapshot());
+  EXPECT_TRUE(snapshotSession.is_snapshot());
+
+  EXPECT_EQ(zotfiles::formatted_zotero_db_info(zotfiles::zotero_db_info(snapshotSession)),
+            zotfiles::formatted_zotero_db_info(zotfiles::zotero_db_info(session)));
+  EXPECT_EQ(zotfiles::pdf_attachment_items(snapshotSession).size(), zotfiles::pdf_attachment_items(session).size());
+  EXPECT_EQ(snapshotSession.storage_dir(), session.storage_dir());
+}
+
+TEST(ZoteroDBSessionTest, statements_are_prepared_once_per_session) {
+  zotfiles::ZoteroDBSession session(zotero_example_db() / "zotero.sqlite");
+  auto runQueries = [&session]()
+  {
+    zotfiles::PDFItems pdfItems = zotfiles::pdf_attachment_items(session);
+    zotfiles::resolve_pdf_file_paths(pdfItems, session);
+    const auto pdfItemCollections = zotfiles::all_pdf_item_collections(pdfItems, session);
+    EXPECT_FALSE(pdfItemCollections.empty());
+    EXPECT_FALSE(zotfiles::zotero_db_state(session).itemsModified.empty());
+    return pdfItems.size();
+  };
+
+  const std::size_t pdfItemCount = runQueries();
+  const std::size_t statementCount = session.prepared_statement_count();
+  EXPECT_GT(statementCount, 0U);
+  // The queries of a second export reuse the statements prepared by the first one.
+  EXPECT_EQ(runQueries(), pdfItemCount);
+  EXPECT_EQ(session.prepared_statement_count(), statementCount);
+
+  SQLite::Statement& statement = session.statement("SELECT COUNT(*) FROM items");
+  EXPECT_EQ(&session.statement("SELECT COUNT(*) FROM items"), &statement);
+  EXPECT_EQ(session.prepared_statement_count(), statementCount + 1);
+}
+
+TEST(ZoteroDBSessionTest, snapshot_is_independent_of_the_db_file) {
+  const std::filesystem::path testDir = std::filesystem::temp_directory_path() / "zotero_to_file_tree_test_db_session";
+  std::filesystem::remove_all(testDir);
+  std::filesystem::create_directories(testDir);
+  std::filesystem::copy_file(zotero_example_db() / "zotero.sqlite", testDir / "zotero.sqlite");
+
+  zotfiles::ZoteroDBSession snapshotSession(testDir / "zotero.sqlite", true);
+  const std::size_t pdfItemCount = zotfiles::pdf_attachment_items(snapshotSession).size();
+  ASSERT_GT(pdfItemCount, 0U);
+
+  std::filesystem::remove(testDir / "zotero.sqlite");
+  std::ofstream(testDir / "zotero.sqlite") << "not a zotero db";
+  EXPECT_EQ(zotfiles::pdf_attachment_items(snapshotSession).size(), pdfItemCount);
+
+  std::filesystem::remove_all(testDir);
+}
+
+TEST(ZoteroDBSessionTest, copy_of_a_snapshot_reads_the_same_items) {
+  const std::filesystem::path copyPath = std::filesystem::temp_directory_path() / "zotero_to_file_tree_test_snapshot_copy.sqlite";
+  std::filesystem::remove(copyPath);
+
+  zotfiles::ZoteroDBSession snapshotSession(zotero_example_db() / "zotero.sqlite", true);
+  snapshotSession.write_copy(copyPath);
+  {
+    zotfiles::ZoteroDBSession copySession = snapshotSession.open_copy(copyPath);
+    EXPECT_TRUE(copySession.is_snapshot());
+    EXPECT_EQ(copySession.zotero_db_path(), snapshotSession.zotero_db_path());
+    EXPECT_EQ(copySession.storage_dir(), snapshotSession.storage_dir());
+    EXPECT_EQ(zotfiles::pdf_attachment_items(copySession).size(), zotfiles::pdf_attachment_items(snapshotSession).size());
+    copySession.refresh_snapshot();
+    EXPECT_EQ(zotfiles::pdf_attachment_items(copySession).size(), zotfiles::pdf_attachment_items(snapshotSession).size());
+  }
+  std::filesystem::remove(copyPath);
+}
+
+TEST(ZoteroDBSessionTest, db_state_query_does_not_keep_the_db_locked) {
+  const std::filesystem::path testDir = std::filesystem::temp_directory_path() / "zotero_to_file_tree_test_db_lock";
+  std::filesystem::remove_all(testDir);
+  std::filesystem::create_directories(testDir);
+  std::filesystem::copy_file(zotero_example_db() / "zotero.sqlite", testDir / "zotero.sqlite");
+
+  zotfiles::ZoteroDBSession session(testDir / "zotero.sqlite");
+  const zotfiles::ZoteroDBState state = zotfiles::zotero_db_state(session);
+  EXPECT_FALSE(state.itemsModified.empty());
+
+  // The zotero client writes to the db while an export in watch mode waits for changes.
+  SQLite::Database writerDB(testDir / "zotero.sqlite", SQLite::OPEN_READWRITE);
+  EXPECT_NO_THROW(writerDB.exec("BEGIN EXCLUSIVE; UPDATE items SET version = version + 1; COMMIT;"));
+  EXPECT_NE(zotfiles::zotero_db_state(session).itemsVersions, state.itemsVersions);
+
+  std::filesystem::remove_all(testDir);
+}
+
+TEST(ZoteroDBSessionTest, live_query_waits_for_a_lock_longer_than_the_busy_timeout) {
+  const std::filesystem::path testDir = std::filesystem::temp_directory_path() / "zotero_to_file_tree_test_db_busy";
+  std::filesystem::remove_all(testDir);
+  std::filesystem::create_directories(testDir);
+  std::filesystem::copy_file(zotero_example_db() / "zotero.sqlite", testDir / "zotero.sqlite");
+
+  zotfiles::ZoteroDBSession session(testDir / "zotero.sqlite");
+  const zotfiles::ZoteroDBState state = zotfiles::zotero_db_state(session);
+
+  // The zotero client holds the db locked for a little longer than the busy timeout of 5 seconds.
+  SQLite::Database writerDB(testDir / "zotero.sqlite", SQLite::OPEN_READWRITE);
+  writerDB.exec("BEGIN EXCLUSIVE; UPDATE items SET version = version + 1;");
+  std::jthread writer(
+      [&writerDB]()
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5200));
+        writerDB.exec("COMMIT;");
+      });
+  EXPECT_NE(zotfiles::zotero_db_state(session).itemsVersions, state.itemsVersions);
+  writer.join();
+
+  std::filesystem::remove_all(testDir);
+}